@@ -1,5 +1,6 @@
 #include "Assembly/Options.h"
 #include "AssemblyAlgorithms.h"
+#include "BloomAssembly.h"
 #include "DotWriter.h"
 #include "FastaWriter.h"
 #include "Histogram.h"
@@ -47,6 +48,40 @@ static void write_graph(const string& path,
 	DotWriter::write(out, c);
 }
 
+/** Assemble unitigs using a Bloom filter de Bruijn graph. */
+static void assembleBloom(const string& pathOut)
+{
+	Timer timer(__func__);
+
+	// A counting Bloom filter requires two bits per element.
+	size_t bits = opt::bloomSize * 8 / CascadingBloomFilter::MAX_COUNT;
+	BloomFilter solid;
+	loadSolidKmers(solid, bits, opt::inFiles, opt::verbose > 0);
+	cout << "Loaded " << solid.popcount() << " solid k-mer\n"
+		"The Bloom filter FPR is " << 100 * solid.FPR() << "%\n";
+
+	BloomAssembler assembler(solid, opt::trimLen);
+	FastaWriter writer(pathOut.c_str());
+	for (vector<string>::const_iterator it = opt::inFiles.begin();
+			it != opt::inFiles.end(); ++it)
+		assembler.assemble(*it, writer);
+
+	const BloomAssembler::Stats& stats = assembler.stats();
+	cout << "Removed " << stats.tips << " tips\n"
+		"Found " << stats.falseBranches
+		<< " false positive and tip k-mer\n"
+		"Assembled " << stats.unitigs << " unitigs\n";
+	if (stats.unitigs == 0) {
+		cerr << "error: no contigs assembled\n";
+		exit(EXIT_FAILURE);
+	}
+
+	// Bubbles are popped by PopBubbles. Create the bubble file for
+	// compatibility with the hash table assembler.
+	ofstream out;
+	AssemblyAlgorithms::openBubbleFile(out);
+}
+
 static void assemble(const string& pathIn, const string& pathOut)
 {
 	Timer timer(__func__);
@@ -147,7 +182,10 @@ int main(int argc, char* const* argv)
 			k1 << "contigs-k" << k << ".fa";
 		else
 			k1 << opt::contigsPath.c_str();
-		assemble(k0.str(), k1.str());
+		if (opt::bloomSize > 0)
+			assembleBloom(k1.str());
+		else
+			assemble(k0.str(), k1.str());
 	}
 	return 0;
 }
@@ -80,17 +80,22 @@ static void alignPair(const string& seq0, const string& seq1,
 }
 
 /** Align multiple sequences using DIALIGN-TX. */
-static void alignMulti(const vector<string>& seq, ostream& out)
+static void alignMulti(const Dialign& dialign,
+		DialignWorkspace& workspace,
+		const vector<string>& seq, ostream& out)
 {
 	unsigned match;
 	string alignment;
-	string consensus = dialign(seq, alignment, match);
+	string consensus = dialign.align(seq, alignment, match,
+			workspace);
 	float identity = (float)match / consensus.size();
 	out << alignment << consensus << '\n' << identity << "\n\n";
 }
 
 /** Align the specified sequences. */
-static void align(const vector<string>& seq, ostream& out)
+static void align(const Dialign& dialign,
+		DialignWorkspace& workspace,
+		const vector<string>& seq, ostream& out)
 {
 	switch (seq.size()) {
 	  case 0:
@@ -101,13 +106,14 @@ static void align(const vector<string>& seq, ostream& out)
 	  case 2:
 		return alignPair(seq[0], seq[1], out);
 	  default:
-		return alignMulti(seq, out);
+		return alignMulti(dialign, workspace, seq, out);
 	}
 }
 
 
 /** Align multiple sequences. */
-static void alignFile(const char* path) {
+static void alignFile(const Dialign& dialign,
+		DialignWorkspace& workspace, const char* path) {
 	if (opt::verbose > 0)
 		cerr << "Aligning `" << path << "'\n";
 	FastaReader in(path, FastaReader::NO_FOLD_CASE);
@@ -118,7 +124,7 @@ static void alignFile(const char* path) {
 			seq.push_back(fa.seq);
 		while (in.peek() == '>' && in >> fa)
 			seq.push_back(fa.seq);
-		align(seq, cout);
+		align(dialign, workspace, seq, cout);
 	}
 	assert(in.eof());
 }
@@ -161,12 +167,14 @@ int main(int argc, char** argv)
 	para->DEBUG = opt::dialign_debug;
 	para->SCR_MATRIX_FILE_NAME = (char*)opt::dialign_score.c_str();
 	para->DIAG_PROB_FILE_NAME = (char*)opt::dialign_prob.c_str();
-	initDialign();
+	Dialign dialign(*para);
+	DialignWorkspace workspace;
 
 	if (optind < argc)
-		for_each(&argv[optind], &argv[argc], alignFile);
+		for (int i = optind; i < argc; ++i)
+			alignFile(dialign, workspace, argv[i]);
 	else
-		alignFile("-");
+		alignFile(dialign, workspace, "-");
 
 	return 0;
 }
@@ -5,11 +5,17 @@
 
 #include "alignGlobal.h"
 #include "Sequence.h"
+#include "city.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <climits>
+#include <cmath> // for sqrt
 #include <cstdlib> // for abort
+#include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 
@@ -28,6 +34,23 @@ static const int GAP_OPEN = -12;
 /** The penalty of extending a gap. */
 static const int GAP_EXTEND = -4;
 
+/** A score smaller than the score of any alignment. */
+static const int MINUS_INF = INT_MIN/2;
+
+/** The initial number of diagonals of the band on either side of the
+ * diagonals that join the two corners of the matrix. */
+static const int BAND_MARGIN = 32;
+
+/** The largest number of cells of the score matrices that are kept
+ * in memory. A larger matrix keeps only every kth row, and the rows
+ * in between are computed again for the backtrack. */
+static size_t g_maxCells = 1 << 22;
+
+void setAlignGlobalMaxCells(size_t n)
+{
+	g_maxCells = n;
+}
+
 /** Return the score of the alignment of a and b.
  * @param [out] consensus the consensus of a and b
  * @return the score
@@ -50,21 +73,216 @@ static int score(char a, char b)
 	return score(a, b, c);
 }
 
+/**
+ * The score matrices of the Gotoh algorithm restricted to a band of
+ * diagonals. Row i stores the columns i+dmin <= j <= i+dmax, and the
+ * cells outside the band score MINUS_INF.
+ *
+ * When the matrices are too large to keep in memory, only every kth
+ * row is stored by the forward pass. The backtrack computes the rows
+ * of a block again from the row that precedes it, so that the memory
+ * used is proportional to the square root of the length of seqA.
+ */
+class BandedMatrix
+{
+  public:
+	BandedMatrix(const string& seqA, const string& seqB,
+			int dmin, int dmax)
+		: m_lenA(seqA.size()), m_lenB(seqB.size()),
+		m_dmin(dmin), m_width(dmax - dmin + 1), m_stride(m_width + 2)
+	{
+		// The score of each character of seqA against each
+		// character of seqB.
+		int codes[256];
+		std::fill(codes, codes + 256, -1);
+		m_code.resize(m_lenA);
+		for (unsigned i = 0; i < m_lenA; i++) {
+			unsigned char a = seqA[i];
+			if (codes[a] < 0) {
+				codes[a] = m_profile.size();
+				m_profile.push_back(vector<int>(m_lenB + 1));
+				vector<int>& profile = m_profile.back();
+				for (unsigned j = 1; j <= m_lenB; j++)
+					profile[j] = score(a, seqB[j-1]);
+			}
+			m_code[i] = codes[a];
+		}
+
+		size_t rows = m_lenA + 1;
+		m_blockSize = rows * m_stride <= g_maxCells ? m_lenA
+			: max(2u, (unsigned)sqrt((double)rows));
+		m_block.resize(3 * m_stride * (min(m_blockSize, m_lenA) + 1));
+		if (m_blockSize < m_lenA)
+			m_checkpoints.resize(
+					3 * m_stride * (m_lenA / m_blockSize + 1));
+		m_first = m_last = 0;
+	}
+
+	/** Compute the score matrices.
+	 * @return the score of the global alignment
+	 */
+	int fill()
+	{
+		initRow(row(0));
+		if (m_blockSize >= m_lenA) {
+			for (unsigned i = 1; i <= m_lenA; i++)
+				computeRow(i, row(i - 1), row(i));
+			m_last = m_lenA;
+			return at(m_lenA, m_lenB, 0);
+		}
+
+		// Keep only every kth row.
+		copy(row(0), row(0) + 3 * m_stride, checkpoint(0));
+		for (unsigned i = 1; i <= m_lenA; i++) {
+			computeRow(i, row((i - 1) % 2), row(i % 2));
+			if (i % m_blockSize == 0)
+				copy(row(i % 2), row(i % 2) + 3 * m_stride,
+						checkpoint(i / m_blockSize));
+		}
+		int score = row(m_lenA % 2)[column(m_lenA, m_lenB)];
+		m_first = 1;
+		m_last = 0;
+		return score;
+	}
+
+	int f(unsigned i, unsigned j) { return at(i, j, 0); }
+	int g(unsigned i, unsigned j) { return at(i, j, 1); }
+	int h(unsigned i, unsigned j) { return at(i, j, 2); }
+
+  private:
+	/** Return the index of column j in the storage of row i. */
+	int column(unsigned i, unsigned j) const
+	{
+		return (int)j - (int)i - m_dmin + 1;
+	}
+
+	/** Return the specified row of the block in memory. The scores
+	 * f, g and h of the row are stored one after the other. */
+	int* row(unsigned r) { return &m_block[3 * m_stride * r]; }
+
+	/** Return the specified stored row. */
+	int* checkpoint(unsigned k)
+	{
+		return &m_checkpoints[3 * m_stride * k];
+	}
+
+	/** Return the score of the matrix (f, g or h) at (i, j). */
+	int at(unsigned i, unsigned j, unsigned matrix)
+	{
+		int k = column(i, j);
+		if (k < 1 || k > (int)m_width)
+			return MINUS_INF;
+		if (i < m_first || i > m_last)
+			loadBlock(i == 0 ? 0 : (i - 1) / m_blockSize);
+		return row(i - m_first)[matrix * m_stride + k];
+	}
+
+	/** Compute the rows of the specified block from the stored row
+	 * that precedes it. */
+	void loadBlock(unsigned b)
+	{
+		m_first = b * m_blockSize;
+		m_last = min(m_first + m_blockSize, m_lenA);
+		copy(checkpoint(b), checkpoint(b) + 3 * m_stride, row(0));
+		for (unsigned i = m_first + 1; i <= m_last; i++)
+			computeRow(i, row(i - 1 - m_first), row(i - m_first));
+	}
+
+	/** Initialize the first row. */
+	void initRow(int* out)
+	{
+		int* f = out;
+		int* g = f + m_stride;
+		int* h = g + m_stride;
+		std::fill(out, out + 3 * m_stride, MINUS_INF);
+		for (int k = 1; k <= (int)m_width; k++) {
+			int j = m_dmin + k - 1;
+			if (j < 0 || j > (int)m_lenB)
+				continue;
+			f[k] = h[k] = j == 0 ? 0 : GAP_OPEN + GAP_EXTEND * (j - 1);
+		}
+	}
+
+	/** Compute row i from row i-1. The vertical gaps and the
+	 * diagonal depend only on the previous row, and are computed
+	 * first in a loop that may be vectorized. The horizontal gaps
+	 * are then computed from left to right. */
+	void computeRow(unsigned i, const int* in, int* out)
+	{
+		const int* fp = in;
+		const int* gp = fp + m_stride;
+		int* f = out;
+		int* g = f + m_stride;
+		int* h = g + m_stride;
+		std::fill(out, out + 3 * m_stride, MINUS_INF);
+
+		// The band of row i is clipped to 0 <= j <= lenB.
+		int kmin = max(1, column(i, 0));
+		int kmax = min((int)m_width, column(i, m_lenB));
+		if (kmin > kmax)
+			return;
+		if (kmin == column(i, 0)) {
+			f[kmin] = g[kmin] = GAP_OPEN + GAP_EXTEND * ((int)i - 1);
+			kmin++;
+		}
+
+		// Column j is stored at k = j - offset.
+		const int* profile = &m_profile[m_code[i - 1]][0];
+		int offset = (int)i + m_dmin - 1;
+		for (int k = kmin; k <= kmax; k++) {
+			g[k] = max(fp[k + 1] + GAP_OPEN, gp[k + 1] + GAP_EXTEND);
+			f[k] = max(fp[k] + profile[k + offset], g[k]);
+		}
+		for (int k = kmin; k <= kmax; k++) {
+			h[k] = max(f[k - 1] + GAP_OPEN, h[k - 1] + GAP_EXTEND);
+			f[k] = max(f[k], h[k]);
+		}
+	}
+
+	unsigned m_lenA, m_lenB;
+
+	/** The first diagonal of the band */
+	int m_dmin;
+
+	/** The number of diagonals of the band */
+	unsigned m_width;
+
+	/** The size of the storage of a row, including a cell of
+	 * padding on either side */
+	unsigned m_stride;
+
+	/** The code of each character of seqA */
+	vector<unsigned> m_code;
+
+	/** The score of each code against each character of seqB */
+	vector<vector<int> > m_profile;
+
+	/** The number of rows of a block */
+	unsigned m_blockSize;
+
+	/** The rows [m_first, m_last] */
+	vector<int> m_block;
+	unsigned m_first, m_last;
+
+	/** The last row of each block */
+	vector<int> m_checkpoints;
+};
+
 /** Find the optimal alignment from the score matrices.
  * @param[out] align the alignment
  * @return the number of matches
  */
-static unsigned backtrack(int** f, int** g, int** h,
+static unsigned backtrack(BandedMatrix& m,
 		const string& seqA, const string& seqB, NWAlignment& align)
 {
 	string alignmentA, alignmentB, consensus;
 	unsigned matches = 0;
 	unsigned i = seqA.size(), j = seqB.size();
 	while (i > 0 && j > 0) {
-		int fij = f[i][j];
+		int fij = m.f(i, j);
 		char a = seqA[i-1], b = seqB[j-1], c;
 		int s = score(a, b, c);
-		if (fij == f[i-1][j-1] + s) {
+		if (fij == m.f(i-1, j-1) + s) {
 			alignmentA += a;
 			alignmentB += b;
 			consensus += c;
@@ -72,9 +290,9 @@ static unsigned backtrack(int** f, int** g, int** h,
 				matches++;
 			i--;
 			j--;
-		} else if (fij == f[i-1][j] + GAP_OPEN
-				|| fij == g[i-1][j] + GAP_EXTEND) {
-			while (g[i][j] == g[i-1][j] + GAP_EXTEND) {
+		} else if (fij == m.f(i-1, j) + GAP_OPEN
+				|| fij == m.g(i-1, j) + GAP_EXTEND) {
+			while (m.g(i, j) == m.g(i-1, j) + GAP_EXTEND) {
 				char a = seqA[i-1];
 				alignmentA += a;
 				alignmentB += GAP;
@@ -82,15 +300,15 @@ static unsigned backtrack(int** f, int** g, int** h,
 				i--;
 				assert(i > 0);
 			}
-			assert(g[i][j] == f[i-1][j] + GAP_OPEN);
+			assert(m.g(i, j) == m.f(i-1, j) + GAP_OPEN);
 			char a = seqA[i-1];
 			alignmentA += a;
 			alignmentB += GAP;
 			consensus += tolower(a);
 			i--;
-		} else if (fij == f[i][j-1] + GAP_OPEN
-				|| fij == h[i][j-1] + GAP_EXTEND) {
-			while (h[i][j] == h[i][j-1] + GAP_EXTEND) {
+		} else if (fij == m.f(i, j-1) + GAP_OPEN
+				|| fij == m.h(i, j-1) + GAP_EXTEND) {
+			while (m.h(i, j) == m.h(i, j-1) + GAP_EXTEND) {
 				char b = seqB[j-1];
 				alignmentA += GAP;
 				alignmentB += b;
@@ -98,7 +316,7 @@ static unsigned backtrack(int** f, int** g, int** h,
 				j--;
 				assert(j > 0);
 			}
-			assert(h[i][j] == f[i][j-1] + GAP_OPEN);
+			assert(m.h(i, j) == m.f(i, j-1) + GAP_OPEN);
 			char b = seqB[j-1];
 			alignmentA += GAP;
 			alignmentB += b;
@@ -135,64 +353,341 @@ static unsigned backtrack(int** f, int** g, int** h,
 	return matches;
 }
 
+/** Return an upper bound of the score of an alignment of sequences
+ * of lengths lenA and lenB that leaves the band [dmin, dmax].
+ * Such an alignment has at least one gap in each sequence, and a
+ * total length of gaps of at least minGap.
+ * @return MINUS_INF if no alignment leaves the band
+ */
+static int outsideBandScore(int lenA, int lenB, int dmin, int dmax)
+{
+	int d = lenB - lenA;
+	int minGap = INT_MAX;
+	if (dmax < lenB)
+		minGap = 2 * (dmax + 1) - d;
+	if (dmin > -lenA)
+		minGap = min(minGap, 2 * (1 - dmin) + d);
+	if (minGap == INT_MAX || minGap > lenA + lenB)
+		return MINUS_INF;
+	return MATCH * ((lenA + lenB - minGap) / 2)
+		+ 2 * GAP_OPEN + (minGap - 2) * GAP_EXTEND;
+}
+
 /** Find the optimal global alignment of the two sequences using the
  * Needleman-Wunsch algorithm and the improvement by Gotoh to use an
  * affine gap penalty rather than a linear gap penalty.
+ *
+ * The score matrices are computed within a band of diagonals around
+ * the difference of the lengths of the sequences. When an alignment
+ * outside the band could score as well as the best alignment within
+ * the band, the band is widened and the matrices computed again, so
+ * that the alignment is the same as that of the full matrices.
  * @param[out] align the alignment
  * @return the number of matches
  */
-unsigned alignGlobal(const string& seqA, const string& seqB,
-		NWAlignment& align)
+static unsigned alignGlobalUncached(const string& seqA,
+		const string& seqB, NWAlignment& align)
+{
+	int lenA = seqA.size();
+	int lenB = seqB.size();
+	for (int margin = BAND_MARGIN;; margin *= 2) {
+		int dmin = max(min(0, lenB - lenA) - margin, -lenA);
+		int dmax = min(max(0, lenB - lenA) + margin, lenB);
+		BandedMatrix m(seqA, seqB, dmin, dmax);
+		int score = m.fill();
+		if (score > outsideBandScore(lenA, lenB, dmin, dmax))
+			return backtrack(m, seqA, seqB, align);
+	}
+}
+
+/** Return whether the aligned sequence is seq with gaps inserted. */
+static bool isAlignmentOf(const string& aligned, const string& seq)
 {
-	unsigned lenA = seqA.size();
-	unsigned lenB = seqB.size();
-	int** f = new int*[lenA + 1];
-	int** g = new int*[lenA + 1];
-	int** h = new int*[lenA + 1];
-	for (unsigned i = 0; i <= lenA; i++) {
-		f[i] = new int[lenB + 1];
-		g[i] = new int[lenB + 1];
-		h[i] = new int[lenB + 1];
-	}
-
-	// Initialize the score matrix.
-	for (unsigned i = 0; i <= lenA; i++) {
-		f[i][0] = g[i][0] = i == 0 ? 0
-			: GAP_OPEN + GAP_EXTEND * ((int)i - 1);
-		h[i][0] = INT_MIN/2;
-	}
-	for (unsigned j = 0; j <= lenB; j++) {
-		f[0][j] = h[0][j] = j == 0 ? 0
-			: GAP_OPEN + GAP_EXTEND * ((int)j - 1);
-		g[0][j] = INT_MIN/2;
-	}
-
-	// Calculate the score matrix.
-	for (unsigned i = 1; i <= lenA; i++) {
-		for (unsigned j = 1; j <= lenB; j++) {
-			g[i][j] = max(
-					f[i-1][j] + GAP_OPEN,
-					g[i-1][j] + GAP_EXTEND);
-			h[i][j] = max(
-					f[i][j-1] + GAP_OPEN,
-					h[i][j-1] + GAP_EXTEND);
-			f[i][j] = max(
-					f[i-1][j-1] + score(seqA[i-1], seqB[j-1]),
-					max(g[i][j], h[i][j]));
+	string::const_iterator it = seq.begin();
+	for (string::const_iterator p = aligned.begin();
+			p != aligned.end(); ++p) {
+		if (*p == GAP)
+			continue;
+		if (it == seq.end() || *p != *it)
+			return false;
+		++it;
+	}
+	return it == seq.end();
+}
+
+/**
+ * A bounded cache of global alignments, which may be shared by
+ * threads.
+ *
+ * An alignment is stored in the slot given by the hash of its pair of
+ * sequences and replaces the alignment already in that slot. The
+ * alignments of all the slots share one budget of bytes. When an
+ * alignment would exceed the budget, the alignments of other slots
+ * are evicted in turn until it fits, so that one slot may hold a long
+ * alignment. The slots are guarded by a fixed number of locks, and
+ * the count of bytes by another lock. A hit is verified against the
+ * sequences themselves, so that a collision of the hash never returns
+ * the alignment of a different pair.
+ */
+class AlignmentCache
+{
+  public:
+	AlignmentCache()
+		: m_maxBytes(0), m_bytes(0), m_next(0), m_hits(0), m_lookups(0)
+	{
+#if _OPENMP
+		for (unsigned i = 0; i < NUM_LOCKS; ++i)
+			omp_init_lock(&m_locks[i]);
+		omp_init_lock(&m_bytesLock);
+#endif
+	}
+
+	~AlignmentCache()
+	{
+#if _OPENMP
+		for (unsigned i = 0; i < NUM_LOCKS; ++i)
+			omp_destroy_lock(&m_locks[i]);
+		omp_destroy_lock(&m_bytesLock);
+#endif
+	}
+
+	/** Set the number of slots and the budget of bytes of the
+	 * alignments, and discard the cached alignments.
+	 * This function is not thread-safe. */
+	void resize(size_t n, size_t bytes)
+	{
+		m_slots.clear();
+		m_slots.resize(n);
+		m_maxBytes = bytes;
+		m_bytes = m_next = 0;
+		m_hits = m_lookups = 0;
+	}
+
+	/** Return whether the cache is enabled. */
+	bool enabled() const { return !m_slots.empty(); }
+
+	/** Return the hash of the pair of sequences and the scores. */
+	static uint128 hash(const string& a, const string& b)
+	{
+		static const uint128 seed(
+				uint64(MATCH) << 32 | uint32(MISMATCH),
+				uint64(GAP_OPEN) << 32 | uint32(GAP_EXTEND));
+		return CityHash128WithSeed(b.data(), b.size(),
+				CityHash128WithSeed(a.data(), a.size(), seed));
+	}
+
+	/** Find the alignment of a and b.
+	 * @return whether the alignment is found
+	 */
+	bool find(const uint128& key, const string& a, const string& b,
+			NWAlignment& align, unsigned& matches)
+	{
+#pragma omp atomic
+		++m_lookups;
+		size_t i = index(key);
+		const Slot& slot = m_slots[i];
+		bool found = false;
+		lock(i);
+		if (slot.valid && slot.key == key
+				&& isAlignmentOf(slot.align.query_align, a)
+				&& isAlignmentOf(slot.align.target_align, b)) {
+			align = slot.align;
+			matches = slot.matches;
+			found = true;
+		}
+		unlock(i);
+		if (found) {
+#pragma omp atomic
+			++m_hits;
+		}
+		return found;
+	}
+
+	/** Store the alignment of the pair of sequences of key, unless
+	 * it is larger than the budget, and evict the alignments of
+	 * other slots while the cache exceeds its budget. */
+	void insert(const uint128& key,
+			const NWAlignment& align, unsigned matches)
+	{
+		size_t bytes = sizeOf(align);
+		if (bytes > m_maxBytes)
+			return;
+		size_t i = index(key);
+		Slot& slot = m_slots[i];
+		lock(i);
+		addBytes(bytes, slot.bytes);
+		slot.valid = true;
+		slot.key = key;
+		slot.align = align;
+		slot.matches = matches;
+		slot.bytes = bytes;
+		unlock(i);
+		evict(i);
+	}
+
+	/** Print the number of hits and lookups. */
+	void printStats(ostream& out) const
+	{
+		out << "Alignment cache: " << m_hits << " hits of "
+			<< m_lookups << " lookups";
+		if (m_lookups > 0)
+			out << " (" << 100 * m_hits / m_lookups << "%)";
+		out << '\n';
+	}
+
+  private:
+	AlignmentCache(const AlignmentCache&);
+	AlignmentCache& operator=(const AlignmentCache&);
+
+	/** The number of locks that guard the slots */
+	static const unsigned NUM_LOCKS = 64;
+
+	/** A cached alignment. */
+	struct Slot {
+		bool valid;
+		uint128 key;
+		NWAlignment align;
+		unsigned matches;
+		/** The number of bytes of the alignment */
+		size_t bytes;
+		Slot() : valid(false), matches(0), bytes(0) { }
+	};
+
+	size_t index(const uint128& key) const
+	{
+		return Uint128Low64(key) % m_slots.size();
+	}
+
+	/** Return the number of bytes of the specified alignment. */
+	static size_t sizeOf(const NWAlignment& align)
+	{
+		return align.query_align.size() + align.target_align.size()
+			+ align.match_align.size();
+	}
+
+	/** Add the bytes of an alignment to the count of bytes, and
+	 * remove the bytes of the alignment that it replaces. */
+	void addBytes(size_t added, size_t removed)
+	{
+		lockBytes();
+		m_bytes += added;
+		m_bytes -= removed;
+		unlockBytes();
+	}
+
+	/** Evict the alignments of the slots other than slot keep in
+	 * turn, until the cache is within its budget. */
+	void evict(size_t keep)
+	{
+		for (size_t n = m_slots.size(); n > 0; --n) {
+			lockBytes();
+			bool full = m_bytes > m_maxBytes;
+			size_t i = m_next;
+			m_next = (m_next + 1) % m_slots.size();
+			unlockBytes();
+			if (!full)
+				return;
+			if (i == keep)
+				continue;
+
+			Slot& slot = m_slots[i];
+			lock(i);
+			if (slot.valid) {
+				addBytes(0, slot.bytes);
+				slot.valid = false;
+				slot.bytes = 0;
+				std::string().swap(slot.align.query_align);
+				std::string().swap(slot.align.target_align);
+				std::string().swap(slot.align.match_align);
+			}
+			unlock(i);
 		}
 	}
 
-	// Find the best alignment.
-	unsigned matches = backtrack(f, g, h, seqA, seqB, align);
+	/** Acquire the lock of slot i. */
+	void lock(size_t i)
+	{
+#if _OPENMP
+		omp_set_lock(&m_locks[i % NUM_LOCKS]);
+#else
+		(void)i;
+#endif
+	}
+
+	/** Release the lock of slot i. */
+	void unlock(size_t i)
+	{
+#if _OPENMP
+		omp_unset_lock(&m_locks[i % NUM_LOCKS]);
+#else
+		(void)i;
+#endif
+	}
+
+	/** Acquire the lock of the count of bytes, which is acquired
+	 * after the lock of a slot when both are held. */
+	void lockBytes()
+	{
+#if _OPENMP
+		omp_set_lock(&m_bytesLock);
+#endif
+	}
 
-	for (unsigned i = 0; i <= lenA; i++) {
-		delete[] f[i];
-		delete[] g[i];
-		delete[] h[i];
+	/** Release the lock of the count of bytes. */
+	void unlockBytes()
+	{
+#if _OPENMP
+		omp_unset_lock(&m_bytesLock);
+#endif
 	}
-	delete[] f;
-	delete[] g;
-	delete[] h;
 
+	std::vector<Slot> m_slots;
+
+	/** The budget of bytes of the alignments of all the slots */
+	size_t m_maxBytes;
+
+	/** The number of bytes of the cached alignments */
+	size_t m_bytes;
+
+	/** The next slot to evict */
+	size_t m_next;
+
+#if _OPENMP
+	omp_lock_t m_locks[NUM_LOCKS];
+	omp_lock_t m_bytesLock;
+#endif
+	size_t m_hits;
+	size_t m_lookups;
+};
+
+/** The alignments of alignGlobal */
+static AlignmentCache g_cache;
+
+void setAlignGlobalCacheSize(size_t n, size_t bytes)
+{
+	g_cache.resize(n, bytes);
+}
+
+void printAlignGlobalCacheStats(ostream& out)
+{
+	g_cache.printStats(out);
+}
+
+/** Find the optimal global alignment of the two sequences, or return
+ * the alignment of the cache when the pair was aligned before.
+ * @param[out] align the alignment
+ * @return the number of matches
+ */
+unsigned alignGlobal(const string& seqA, const string& seqB,
+		NWAlignment& align)
+{
+	if (!g_cache.enabled())
+		return alignGlobalUncached(seqA, seqB, align);
+	uint128 key = AlignmentCache::hash(seqA, seqB);
+	unsigned matches;
+	if (g_cache.find(key, seqA, seqB, align, matches))
+		return matches;
+	matches = alignGlobalUncached(seqA, seqB, align);
+	g_cache.insert(key, align, matches);
 	return matches;
 }
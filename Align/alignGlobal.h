@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <cctype>
+#include <cstddef>
 #include <utility>
 #include <iostream>
 #include <string>
@@ -41,6 +42,24 @@ unsigned alignGlobal(
 		const std::string& a, const std::string& b,
 		NWAlignment& align);
 
+/** Keep the alignments of up to the specified number of pairs of
+ * sequences, so that alignGlobal does not align the same pair of
+ * sequences twice. The alignments use at most the specified number
+ * of bytes in total, and older alignments are evicted to make room
+ * for a new one. The cache is disabled when the size is zero, which
+ * is the initial size of the cache.
+ */
+void setAlignGlobalCacheSize(size_t n = 4096, size_t bytes = 64 << 20);
+
+/** Keep the score matrices of an alignment in memory when they have
+ * at most the specified number of cells. A larger alignment keeps
+ * only some of the rows, and computes the others again as needed.
+ */
+void setAlignGlobalMaxCells(size_t n = 1 << 22);
+
+/** Print the number of hits and lookups of the alignment cache. */
+void printAlignGlobalCacheStats(std::ostream& out);
+
 /** Align the specified pair of sequences.
  * @return the number of matches and size of the consensus
  */
@@ -15,17 +15,26 @@
 
 using namespace std;
 
-/** Score matrix. */
-scr_matrix* smatrix;
+/** Set the parameters of this thread, and restore the previous
+ * parameters when destroyed. */
+class ParametersScope
+{
+  public:
+	explicit ParametersScope(struct parameters* p) : m_saved(para)
+	{
+		para = p;
+	}
+	~ParametersScope() { para = m_saved; }
 
-/** Diagonal length probability distribution. */
-prob_dist* pdist;
+  private:
+	struct parameters* m_saved;
+};
 
 /** Return a DNA score matrix. */
 static scr_matrix* newDefaultScoreMatrix()
 {
 	string s("ACGT?#$");
-	struct scr_matrix* p = (scr_matrix*)calloc(1, sizeof *smatrix);
+	struct scr_matrix* p = (scr_matrix*)calloc(1, sizeof *p);
 	p->length = s.size();
 	p->num2char = (int*)calloc(256, sizeof(int));
 	p->char2num = (int*)calloc(256, sizeof(int));
@@ -48,51 +57,93 @@ static scr_matrix* newDefaultScoreMatrix()
 	return p;
 }
 
+/** The default probability distribution for diagonal lengths for
+ * a DNA score matrix, whose maximum score is 1. The rows are
+ * converted once per process from the constant table, and shared by
+ * every Dialign.
+ */
+class DefaultDiagProb
+{
+  public:
+	/** The maximum diagonal length */
+	static const unsigned MAX_DLEN = 100;
+
+	DefaultDiagProb()
+	{
+		const double* p = dna_diag_prob_100_exp_550000;
+		m_data[0] = NULL;
+		m_logData[0] = NULL;
+		for (unsigned i = 1; i <= MAX_DLEN; i++) {
+			m_data[i] = new long double[i + 1];
+			m_logData[i] = new double[i + 1];
+			for (unsigned scr = 0; scr <= i; scr++) {
+				double weight = *p++;
+				assert(weight > 0);
+				m_data[i][scr] = weight;
+				m_logData[i][scr] = -log(weight);
+			}
+		}
+	}
+
+	~DefaultDiagProb()
+	{
+		for (unsigned i = 1; i <= MAX_DLEN; i++) {
+			delete[] m_data[i];
+			delete[] m_logData[i];
+		}
+	}
+
+	/** Return the rows of the probabilities. */
+	long double** data() { return m_data; }
+
+	/** Return the rows of the negative log probabilities. */
+	double** logData() { return m_logData; }
+
+  private:
+	long double* m_data[MAX_DLEN + 1];
+	double* m_logData[MAX_DLEN + 1];
+};
+
+static DefaultDiagProb g_defaultDiagProb;
+
 /** Return a probability distribution for diagonal lengths
- * for a DNA score matrix.
+ * for a DNA score matrix, which shares the rows of the default
+ * distribution.
  */
-static prob_dist* newDefaultDiagProbDist()
+static prob_dist* newDefaultDiagProbDist(scr_matrix* smatrix)
 {
+	if (smatrix->max_score != 1) {
+		cerr << "error: the default diagonal length probability "
+			"distribution requires a score matrix whose maximum "
+			"score is 1, but the maximum score is "
+			<< smatrix->max_score << '\n';
+		exit(EXIT_FAILURE);
+	}
 	prob_dist *o = (prob_dist*)calloc(1, sizeof *o);
 	o->smatrix = smatrix;
-	unsigned length = 100;
-	o->max_dlen = length;
-	o->data = (long double**)calloc(
-			length + 1, sizeof(long double *));
-	o->log_data = (double**)calloc(length + 1, sizeof(double *));
-
-	long double **dist = o->data;
-	double **log_dist = o->log_data;
-	const double* p = dna_diag_prob_100_exp_550000;
-	for (unsigned i = 1; i <= length; i++) {
-		unsigned mxscr = i * smatrix->max_score;
-		dist[i] = (long double*)calloc(
-				mxscr + 1, sizeof(long double));
-		log_dist[i] = (double*)calloc(mxscr + 1, sizeof(double));
-		for (unsigned scr = 0; scr <= mxscr; scr++) {
-			double weight = *p++;
-			assert(weight > 0);
-			dist[i][scr] = weight;
-			log_dist[i][scr] = -log(weight);
-		}
-	}
+	o->max_dlen = DefaultDiagProb::MAX_DLEN;
+	o->data = g_defaultDiagProb.data();
+	o->log_data = g_defaultDiagProb.logData();
 	return o;
 }
 
-/** Initialize dialign. */
-void initDialign()
+/** Load the score matrix and the probability distribution. */
+Dialign::Dialign(const struct parameters& p)
+	: m_para(p)
 {
+	ParametersScope scope(&m_para);
+
 	// Score matrix
-	smatrix = strlen(para->SCR_MATRIX_FILE_NAME) > 0
+	m_smatrix = strlen(para->SCR_MATRIX_FILE_NAME) > 0
 		? read_scr_matrix(para->SCR_MATRIX_FILE_NAME)
 		: newDefaultScoreMatrix();
 	if (para->DEBUG > 5)
-		print_scr_matrix(smatrix);
+		print_scr_matrix(m_smatrix);
 
 	// Probability distribution for diagonal lengths
-	pdist = strlen(para->DIAG_PROB_FILE_NAME) > 0
-		? read_diag_prob_dist(smatrix, para->DIAG_PROB_FILE_NAME)
-		: newDefaultDiagProbDist();
+	m_pdist = strlen(para->DIAG_PROB_FILE_NAME) > 0
+		? read_diag_prob_dist(m_smatrix, para->DIAG_PROB_FILE_NAME)
+		: newDefaultDiagProbDist(m_smatrix);
 }
 
 static void free_scr_matrix(struct scr_matrix* smatrix)
@@ -104,20 +155,28 @@ static void free_scr_matrix(struct scr_matrix* smatrix)
 	free(smatrix);
 }
 
-void free_prob_dist(struct prob_dist* pdist)
+static void free_prob_dist(struct prob_dist* pdist)
 {
-	unsigned int length = pdist->max_dlen;
-	unsigned int i;
-	for (i=1; i<=length; i++) {
-		free(pdist->data[i]);
-		free(pdist->log_data[i]);
+	// The default distribution is shared.
+	if (pdist->data != g_defaultDiagProb.data()) {
+		unsigned int length = pdist->max_dlen;
+		unsigned int i;
+		for (i=1; i<=length; i++) {
+			free(pdist->data[i]);
+			free(pdist->log_data[i]);
+		}
+		free(pdist->data);
+		free(pdist->log_data);
 	}
-	free(pdist->data);
-	free(pdist->log_data);
 	free_scr_matrix(pdist->smatrix);
 	free(pdist);
 }
 
+Dialign::~Dialign()
+{
+	free_prob_dist(m_pdist);
+}
+
 static void free_seq_col(struct seq_col* scol)
 {
 	unsigned int length = scol->length;
@@ -273,7 +332,8 @@ static string get_alignment_consensus(struct alignment *algn)
  * @param [out] matches the minimum number of matches
  * @return the consensus sequence
  */
-string dialign(const vector<string>& amb_seqs,
+static string dialign(scr_matrix* smatrix, prob_dist* pdist,
+		diag_scratch* scratch, const vector<string>& amb_seqs,
 		string& alignment, unsigned& matches)
 {
 	int i;
@@ -296,8 +356,8 @@ string dialign(const vector<string>& amb_seqs,
 		printf("empty alignments created\n");
 
 	// Compute pairwise diagonals
-	struct diag_col *all_diags = find_all_diags(smatrix, pdist,
-		in_seq_col, salgn, 1);
+	struct diag_col *all_diags = find_all_diags_scratch(smatrix, pdist,
+		in_seq_col, salgn, 1, scratch);
 	double duration = (clock()-tim)/CLOCKS_PER_SEC;
 	if (dialign_para->DEBUG > 1)
 		printf("Found %i diags in %f secs\n",
@@ -361,8 +421,8 @@ string dialign(const vector<string>& amb_seqs,
 	for (type = stype; type < 2; type++) {
 		for (round = 2; round <= 20; round++) {
 			tim2 = clock();
-			all_diags = find_all_diags(smatrix, pdist,
-				in_seq_col, (type ? salgn : algn), round);
+			all_diags = find_all_diags_scratch(smatrix, pdist,
+				in_seq_col, (type ? salgn : algn), round, scratch);
 			duration = (clock()-tim2)/CLOCKS_PER_SEC;
 			if (dialign_para->DEBUG > 1)
 				printf("Found %i diags after %f secs\n",
@@ -421,3 +481,26 @@ string dialign(const vector<string>& amb_seqs,
 	free_seq_col(in_seq_col);
 	return consensus;
 }
+
+/** Align multiple sequences using DIALIGN-TX. The parameters are
+ * copied, because an alignment modifies its parameters.
+ */
+string Dialign::align(const vector<string>& amb_seqs,
+		string& alignment, unsigned& matches) const
+{
+	DialignWorkspace workspace;
+	return align(amb_seqs, alignment, matches, workspace);
+}
+
+/** Align multiple sequences using DIALIGN-TX, and reuse the scratch
+ * space of the workspace.
+ */
+string Dialign::align(const vector<string>& amb_seqs,
+		string& alignment, unsigned& matches,
+		DialignWorkspace& workspace) const
+{
+	struct parameters p = m_para;
+	ParametersScope scope(&p);
+	return dialign(m_smatrix, m_pdist, workspace.scratch(),
+			amb_seqs, alignment, matches);
+}
@@ -6,14 +6,18 @@ extern "C" {
 #include "dialign/parameters.h"
 #include "dialign/struct.h"
 
-extern struct scr_matrix *smatrix;
-extern struct prob_dist *pdist;
 extern const double dna_diag_prob_100_exp_550000[5151];
 
 struct alignment* create_empty_alignment(struct seq_col *scol);
 struct diag_col *find_all_diags(struct scr_matrix *smatrix,
 	struct prob_dist *pdist,
 	struct seq_col *in_seq_col, struct alignment *algn, int round);
+struct diag_col *find_all_diags_scratch(struct scr_matrix *smatrix,
+	struct prob_dist *pdist,
+	struct seq_col *in_seq_col, struct alignment *algn, int round,
+	struct diag_scratch *scratch);
+void init_diag_scratch(struct diag_scratch *scratch);
+void free_diag_scratch(struct diag_scratch *scratch);
 struct alignment* guided_aligner(struct alignment *palgn,
 	struct seq_col *scol, struct diag_col *dcol,
 	struct scr_matrix* smatrix,
@@ -33,9 +37,72 @@ void free_diag_col(struct diag_col* dcol);
 #include <string>
 #include <vector>
 
-void initDialign();
-void free_prob_dist(struct prob_dist* pdist);
-std::string dialign(const std::vector<std::string>& amb_seqs,
-		std::string& alignment, unsigned& matches);
+/**
+ * The scratch space of the alignments of one thread. The weights of
+ * the diagonals are computed again only when the lengths of the
+ * aligned sequences change.
+ */
+class DialignWorkspace
+{
+  public:
+	DialignWorkspace() { init_diag_scratch(&m_scratch); }
+	~DialignWorkspace() { free_diag_scratch(&m_scratch); }
+	struct diag_scratch* scratch() { return &m_scratch; }
+
+  private:
+	DialignWorkspace(const DialignWorkspace&);
+	DialignWorkspace& operator=(const DialignWorkspace&);
+
+	struct diag_scratch m_scratch;
+};
+
+/**
+ * The score matrix and the diagonal length probability distribution
+ * of DIALIGN-TX. The tables are loaded once, and aligning sequences
+ * does not modify them, so that one Dialign may align sequences in
+ * many threads at once. The default probability distribution is
+ * converted once per process and shared by every Dialign.
+ */
+class Dialign
+{
+  public:
+	/** Load the score matrix and the probability distribution named
+	 * by the specified parameters, which are copied for each
+	 * alignment. */
+	explicit Dialign(const struct parameters& para);
+	~Dialign();
+
+	/** Align multiple sequences using DIALIGN-TX.
+	 * @param [out] alignment the alignment
+	 * @param [out] matches the minimum number of matches
+	 * @return the consensus sequence
+	 */
+	std::string align(const std::vector<std::string>& amb_seqs,
+			std::string& alignment, unsigned& matches) const;
+
+	/** Align multiple sequences using DIALIGN-TX, and reuse the
+	 * scratch space of the specified workspace, which may not be
+	 * shared by threads.
+	 * @param [out] alignment the alignment
+	 * @param [out] matches the minimum number of matches
+	 * @return the consensus sequence
+	 */
+	std::string align(const std::vector<std::string>& amb_seqs,
+			std::string& alignment, unsigned& matches,
+			DialignWorkspace& workspace) const;
+
+  private:
+	Dialign(const Dialign&);
+	Dialign& operator=(const Dialign&);
+
+	/** The parameters of an alignment */
+	struct parameters m_para;
+
+	/** Score matrix */
+	struct scr_matrix* m_smatrix;
+
+	/** Diagonal length probability distribution */
+	struct prob_dist* m_pdist;
+};
 
 #endif
@@ -9,12 +9,16 @@
 #include "alignGlobal.h"
 #include <algorithm>
 #include <cassert>
+#include <cstddef> // for ptrdiff_t
 #include <cstdlib>
 #include <getopt.h>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 
@@ -39,6 +43,7 @@ static const char USAGE_MESSAGE[] =
 "                          down to a maximum of N bp long [inf]\n"
 "  -2, --length2=N         trim bases from 3' end of second read\n"
 "                          down to a maximum of N bp long [inf]\n"
+"  -j, --threads=N         use N parallel threads [1]\n"
 "      --chastity          discard unchaste reads [default]\n"
 "      --no-chastity       do not discard unchaste reads\n"
 "      --trim-masked       trim masked bases from the ends of reads\n"
@@ -66,9 +71,13 @@ namespace opt {
 
 	/** Max length of read 2. */
 	static int max_len_2 = 0;
+
+	/** Number of threads. */
+	static int threads = 1;
 }
 
-static struct {
+/** Counts of the outcomes of merging the read pairs. */
+struct Stats {
 	unsigned total_reads;
 	unsigned merged_reads;
 	unsigned unmerged_reads;
@@ -78,9 +87,32 @@ static struct {
 	unsigned low_matches;
 	unsigned has_indel;
 	unsigned pid_low;
-} stats;
 
-static const char shortopts[] = "o:p:m:q:1:2:v";
+	Stats() : total_reads(0), merged_reads(0), unmerged_reads(0),
+		unchaste_reads(0), no_alignment(0), too_many_aligns(0),
+		low_matches(0), has_indel(0), pid_low(0) { }
+
+	Stats& operator+=(const Stats& o)
+	{
+		total_reads += o.total_reads;
+		merged_reads += o.merged_reads;
+		unmerged_reads += o.unmerged_reads;
+		unchaste_reads += o.unchaste_reads;
+		no_alignment += o.no_alignment;
+		too_many_aligns += o.too_many_aligns;
+		low_matches += o.low_matches;
+		has_indel += o.has_indel;
+		pid_low += o.pid_low;
+		return *this;
+	}
+};
+
+static Stats stats;
+
+/** The number of read pairs that are read and merged at once. */
+static const unsigned BATCH_SIZE = 4096;
+
+static const char shortopts[] = "o:p:m:q:1:2:j:v";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
@@ -91,6 +123,7 @@ static const struct option longopts[] = {
 	{ "verbose",          no_argument,       NULL, 'v' },
 	{ "length1",          no_argument,       NULL, '1' },
 	{ "length2",          no_argument,       NULL, '2' },
+	{ "threads",          required_argument, NULL, 'j' },
 	{ "chastity",         no_argument,       &opt::chastityFilter, 1 },
 	{ "no-chastity",      no_argument,       &opt::chastityFilter, 0 },
 	{ "trim-masked",      no_argument,       &opt::trimMasked, 1 },
@@ -159,51 +192,104 @@ static void mergeReads(overlap_align& overlap, FastqRecord& rec1,
 	out = FastqRecord(rec1.id, rec1.comment, out_seq, out_qual);
 }
 
-bool isGapless(overlap_align& o, Sequence& s) {
+bool isGapless(const overlap_align& o, const Sequence& s) {
 	return o.length() == s.length() - o.overlap_t_pos &&
 		o.length() == o.overlap_h_pos + 1;
 }
 
+/** Return whether an overlap has too few matches. */
+struct HasLowMatches {
+	bool operator()(const overlap_align& o) const
+	{
+		return o.overlap_match < opt::min_matches;
+	}
+};
+
+/** Return whether an overlap has too low identity. */
+struct HasLowIdentity {
+	bool operator()(const overlap_align& o) const
+	{
+		return o.pid() < opt::identity;
+	}
+};
+
+/** Return whether an overlap of the specified read has a gap. */
+struct HasIndel {
+	const Sequence& seq;
+	HasIndel(const Sequence& seq) : seq(seq) { }
+	bool operator()(const overlap_align& o) const
+	{
+		return !isGapless(o, seq);
+	}
+};
+
 static void filterAlignments(vector<overlap_align>& overlaps,
-		FastaRecord& rec)
+		FastaRecord& rec, Stats& stats)
 {
 	if (overlaps.empty()) {
 		stats.no_alignment++;
 		return;
 	}
 
-	vector<overlap_align>::iterator it;
-	for (it = overlaps.begin(); it != overlaps.end(); it++ ) {
-		overlap_align o = *it;
-		if (o.overlap_match < opt::min_matches)
-			overlaps.erase(it--);
-	}
+	overlaps.erase(remove_if(overlaps.begin(), overlaps.end(),
+				HasLowMatches()), overlaps.end());
 	if (overlaps.empty()) {
 		stats.low_matches++;
 		return;
 	}
 
-	for (it = overlaps.begin(); it != overlaps.end(); it++ ) {
-		overlap_align o = *it;
-		if (o.pid() < opt::identity)
-			overlaps.erase(it--);
-	}
+	overlaps.erase(remove_if(overlaps.begin(), overlaps.end(),
+				HasLowIdentity()), overlaps.end());
 	if (overlaps.empty()) {
 		stats.pid_low++;
 		return;
 	}
 
-	for (it = overlaps.begin(); it != overlaps.end(); it++ ) {
-		overlap_align o = *it;
-		if (!isGapless(o, rec.seq))
-			overlaps.erase(it--);
-	}
+	overlaps.erase(remove_if(overlaps.begin(), overlaps.end(),
+				HasIndel(rec.seq)), overlaps.end());
 	if (overlaps.empty()) {
 		stats.has_indel++;
 		return;
 	}
 }
 
+/** The result of merging a read pair. */
+struct MergeResult {
+	/** Whether the reads were merged */
+	bool merged;
+	/** The merged read */
+	FastqRecord out;
+	/** The overlap of the reads */
+	overlap_align overlap;
+};
+
+/** Merge a read pair. */
+static void mergePair(FastqRecord& rec1, FastqRecord& rec2,
+		MergeResult& result, Stats& stats, OverlapWorkspace& workspace)
+{
+	stats.total_reads++;
+	Sequence rc_seq2 = reverseComplement(rec2.seq);
+	vector<overlap_align> overlaps;
+	if (opt::verbose > 2
+			|| !findUngappedOverlaps(rec1.seq, rc_seq2, overlaps))
+		alignOverlap(rec1.seq, rc_seq2, 0, overlaps,
+				true, opt::verbose > 2, workspace);
+
+	filterAlignments(overlaps, rec1, stats);
+
+	result.merged = overlaps.size() == 1;
+	if (result.merged) {
+		// If there is only one good alignment, merge reads
+		stats.merged_reads++;
+		mergeReads(overlaps[0], rec1, rec2, result.out);
+		result.overlap = overlaps[0];
+	} else {
+		if (overlaps.size() > 1)
+			stats.too_many_aligns++;
+		stats.unmerged_reads++;
+	}
+}
+
 /** Align read pairs. */
 static void alignFiles(const char* reads1, const char* reads2)
 {
@@ -223,37 +309,50 @@ static void alignFiles(const char* reads1, const char* reads2)
 	name.append("_merged.fastq");
 	ofstream merged(name.c_str());
 
+	// Read a batch of pairs, merge them in parallel, and write them
+	// in the order in which they were read.
+	vector<FastqRecord> batch1, batch2;
+	vector<MergeResult> results;
 	FastqRecord rec1, rec2;
 	int x = 0;
-	while (r1 >> rec1 && r2 >> rec2) {
-		stats.total_reads++;
-		string rc_qual2(rec2.qual);
-		reverse(rc_qual2.begin(), rc_qual2.end());
-		vector<overlap_align> overlaps;
-		alignOverlap(rec1.seq, reverseComplement(rec2.seq), 0, overlaps,
-				true, opt::verbose > 2);
-
-		filterAlignments(overlaps, rec1);
-
-		if (overlaps.size() == 1) {
-			// If there is only one good alignment, merge reads and
-			// print to merged file
-			stats.merged_reads++;
-			FastqRecord out;
-			mergeReads(overlaps[0], rec1, rec2, out);
-			merged << out;
-			cout << overlaps[0].length() << ' ' <<
-				overlaps[0].overlap_match << '\n';
-		} else {
-			// print reads to separate files
-			if (overlaps.size() > 1)
-				stats.too_many_aligns++;
-			stats.unmerged_reads++;
-			unmerged1 << rec1;
-			unmerged2 << rec2;
+	for (bool good = true; good;) {
+		batch1.clear();
+		batch2.clear();
+		while (batch1.size() < BATCH_SIZE
+				&& (good = r1 >> rec1 && r2 >> rec2)) {
+			batch1.push_back(rec1);
+			batch2.push_back(rec2);
 		}
-		if (opt::verbose > 0 && ++x % 10000 == 0) {
-			cerr << "Aligned " << x << " reads.\n";
+		results.resize(batch1.size());
+
+		ptrdiff_t n = batch1.size();
+#pragma omp parallel
+		{
+			Stats local;
+			OverlapWorkspace workspace;
+#pragma omp for schedule(dynamic, 64)
+			for (ptrdiff_t i = 0; i < n; i++)
+				mergePair(batch1[i], batch2[i], results[i], local,
+						workspace);
+#pragma omp critical(stats)
+			stats += local;
+		}
+
+		for (ptrdiff_t i = 0; i < n; i++) {
+			const MergeResult& result = results[i];
+			if (result.merged) {
+				// print merged reads to merged file
+				merged << result.out;
+				cout << result.overlap.length() << ' ' <<
+					result.overlap.overlap_match << '\n';
+			} else {
+				// print reads to separate files
+				unmerged1 << batch1[i];
+				unmerged2 << batch2[i];
+			}
+			if (opt::verbose > 0 && ++x % 10000 == 0) {
+				cerr << "Aligned " << x << " reads.\n";
+			}
 		}
 	}
 	r2 >> rec2;
@@ -287,6 +386,7 @@ int main(int argc, char** argv)
 			case 'q': arg >> opt::qualityThreshold; break;
 			case '1': arg >> opt::max_len_1; break;
 			case '2': arg >> opt::max_len_2; break;
+			case 'j': arg >> opt::threads; break;
 			case 'v': opt::verbose++; break;
 			case OPT_HELP:
 					  cerr << USAGE_MESSAGE;
@@ -321,6 +421,11 @@ int main(int argc, char** argv)
 	const char* reads1 = argv[optind++];
 	const char* reads2 = argv[optind++];
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	alignFiles(reads1, reads2);
 
 	cerr << "Pair merging stats: total=" << stats.total_reads
@@ -8,11 +8,17 @@
 #include "smith_waterman.h"
 #include "Sequence.h"
 #include "Align/Options.h"
+#include "BitUtil.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
-#include <cfloat> // for DBL_MAX
+#include <climits> // for INT_MIN
+#include <cstring> // for memcpy
 #include <iostream>
+#include <stdint.h>
+#if __SSE2__
+# include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -79,38 +85,322 @@ static bool isMatch(char a, char b, char& c)
 	return true;
 }
 
-/** Return the score of the alignment of a and b. */
-static int matchScore(const char a, const char b)
-{
-	char consensus;
-	return isMatch(a, b, consensus) ? opt::match : opt::mismatch;
-}
-
 /** Return the score of a gap, either newly opened or extended. */
 static int gapScore(bool prev_is_gap)
 {
 	return prev_is_gap ? opt::gap_extend : opt::gap_open;
 }
 
+/** The direction of the previous cell of an alignment. */
+enum Direction {
+	DIAGONAL, // match or mismatch
+	UP, // deletion in sequence A
+	LEFT // deletion in sequence B
+};
+
+/** A score smaller than any score of a valid alignment. */
+static const int INVALID = INT_MIN / 2;
+
+/** The working storage of alignOverlap, which is owned by an
+ * OverlapWorkspace. The dynamic programming matrix is computed
+ * one anti-diagonal at a time, since the cells of an anti-diagonal
+ * are independent of each other. Only the last three anti-diagonals
+ * of the scores are kept, and the direction of each cell is stored
+ * in one byte for the backtrack.
+ */
+struct OverlapMatrix {
+	/** The lengths of the sequences */
+	int N_a, N_b;
+
+	/** The score of the cells of three consecutive anti-diagonals,
+	 * indexed by the row */
+	vector<int> H[3];
+
+	/** The score of a gap that follows the cell vertically (U) and
+	 * horizontally (L), indexed by the row */
+	vector<int> U[3], L[3];
+
+	/** The code of each character of A, indexed by the row */
+	vector<int> codeA;
+
+	/** The code of each character of B in reverse order */
+	vector<int> codeB;
+
+	/** The number of distinct characters of B */
+	unsigned nb;
+
+	/** Whether the characters of each pair of codes match */
+	vector<unsigned char> matchTable;
+
+	/** The bitmask of the codes of B that match each character of
+	 * A, indexed by the row */
+	vector<uint32_t> matchA;
+
+	/** The bit of the code of each character of B in reverse order */
+	vector<uint32_t> bitB;
+
+	/** The direction of each cell, stored by anti-diagonal */
+	vector<unsigned char> dir;
+
+	/** The offset of each anti-diagonal in dir */
+	vector<size_t> diagonal;
+
+	/** The scores of the last row */
+	vector<int> last;
+
+	/** Return the first row of the specified anti-diagonal. */
+	int first(int d) const { return max(1, d - N_b); }
+
+	/** Return the direction of the cell (i, j). */
+	Direction direction(int i, int j) const
+	{
+		int d = i + j;
+		return Direction(dir[diagonal[d] + i - first(d)]);
+	}
+};
+
+/** The number of cells of an anti-diagonal that are computed at once.
+ * The arrays of the workspace are padded by this many elements. */
+static const int LANES = 4;
+
+/** The number of directions that a workspace keeps between calls.
+ * A workspace releases the directions of a larger alignment when
+ * the alignment is done. */
+static const size_t MAX_KEPT_CELLS = 1 << 24;
+
+/** Whether the cells are computed using SSE2 when it is available */
+static bool g_useSIMD = true;
+
+void setAlignOverlapSIMD(bool enable)
+{
+	g_useSIMD = enable;
+}
+
+#if __SSE2__
+/** Compute the cells [lo, hi] of an anti-diagonal four at a time.
+ * The last few cells past hi are also computed, and are ignored.
+ */
+static void alignDiagonalSIMD(const OverlapMatrix& ws, int lo, int hi,
+		int k0, const int* Hpp, const int* Up, const int* Lp,
+		int* Hc, int* Uc, int* Lc, unsigned char* dir)
+{
+	const __m128i match = _mm_set1_epi32(opt::match);
+	const __m128i mismatch = _mm_set1_epi32(opt::mismatch);
+	const __m128i gap_open = _mm_set1_epi32(opt::gap_open);
+	const __m128i gap_extend = _mm_set1_epi32(opt::gap_extend);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i two = _mm_set1_epi32(2);
+	for (int i = lo; i <= hi; i += LANES, dir += LANES) {
+		__m128i ma = _mm_loadu_si128((const __m128i*)&ws.matchA[i]);
+		__m128i bb = _mm_loadu_si128(
+				(const __m128i*)&ws.bitB[k0 + i]);
+		__m128i isMismatch = _mm_cmpeq_epi32(_mm_and_si128(ma, bb), zero);
+		__m128i score = _mm_or_si128(
+				_mm_and_si128(isMismatch, mismatch),
+				_mm_andnot_si128(isMismatch, match));
+
+		__m128i d = _mm_add_epi32(
+				_mm_loadu_si128((const __m128i*)&Hpp[i-1]), score);
+		__m128i u = _mm_loadu_si128((const __m128i*)&Up[i-1]);
+		__m128i l = _mm_loadu_si128((const __m128i*)&Lp[i]);
+
+		// Break ties in the order diagonal, up and left.
+		__m128i notD = _mm_or_si128(
+				_mm_cmpgt_epi32(u, d), _mm_cmpgt_epi32(l, d));
+		__m128i isL = _mm_cmpgt_epi32(l, u);
+		__m128i isU = _mm_andnot_si128(isL, notD);
+		isL = _mm_and_si128(isL, notD);
+		__m128i h = _mm_or_si128(_mm_andnot_si128(notD, d),
+				_mm_or_si128(_mm_and_si128(isU, u),
+					_mm_and_si128(isL, l)));
+		_mm_storeu_si128((__m128i*)&Hc[i], h);
+		_mm_storeu_si128((__m128i*)&Uc[i], _mm_add_epi32(h,
+					_mm_or_si128(_mm_and_si128(isU, gap_extend),
+						_mm_andnot_si128(isU, gap_open))));
+		_mm_storeu_si128((__m128i*)&Lc[i], _mm_add_epi32(h,
+					_mm_or_si128(_mm_and_si128(isL, gap_extend),
+						_mm_andnot_si128(isL, gap_open))));
+
+		__m128i v = _mm_or_si128(_mm_and_si128(isU, one),
+				_mm_and_si128(isL, two));
+		v = _mm_packs_epi32(v, v);
+		v = _mm_packus_epi16(v, v);
+		int packed = _mm_cvtsi128_si32(v);
+		memcpy(dir, &packed, LANES);
+	}
+}
+#endif
+
+/** Compute the cells [lo, hi] of an anti-diagonal one at a time. */
+static void alignDiagonal(const OverlapMatrix& ws, int lo, int hi,
+		int k0, const int* Hpp, const int* Up, const int* Lp,
+		int* Hc, int* Uc, int* Lc, unsigned char* dir)
+{
+	for (int i = lo; i <= hi; ++i, ++dir) {
+		int d = Hpp[i-1] + (ws.matchTable[ws.codeA[i] * ws.nb
+				+ ws.codeB[k0 + i]] ? opt::match : opt::mismatch);
+		int u = Up[i-1], l = Lp[i];
+		Direction x = d >= u && d >= l ? DIAGONAL
+			: u >= l ? UP : LEFT;
+		int h = x == DIAGONAL ? d : x == UP ? u : l;
+		Hc[i] = h;
+		Uc[i] = h + gapScore(x == UP);
+		Lc[i] = h + gapScore(x == LEFT);
+		*dir = x;
+	}
+}
+
+/** Fill the dynamic programming matrix of the overlap of seq_a and
+ * seq_b, and store the directions and the scores of the last row in
+ * the workspace. */
+static void fillMatrix(OverlapMatrix& ws,
+		const string& seq_a, const string& seq_b)
+{
+	const int N_a = seq_a.length(), N_b = seq_b.length();
+	ws.N_a = N_a;
+	ws.N_b = N_b;
+
+	// Number the distinct characters of each sequence, and find
+	// which pairs of them match.
+	int codes[2][256];
+	fill(codes[0], codes[0] + 256, -1);
+	fill(codes[1], codes[1] + 256, -1);
+	string alphabet[2];
+	for (int i = 0; i < N_a; i++) {
+		unsigned char c = seq_a[i];
+		if (codes[0][c] < 0) {
+			codes[0][c] = alphabet[0].size();
+			alphabet[0] += c;
+		}
+	}
+	for (int j = 0; j < N_b; j++) {
+		unsigned char c = seq_b[j];
+		if (codes[1][c] < 0) {
+			codes[1][c] = alphabet[1].size();
+			alphabet[1] += c;
+		}
+	}
+	const unsigned na = alphabet[0].size(), nb = alphabet[1].size();
+	ws.nb = nb;
+	ws.matchTable.assign(na * nb, false);
+	for (unsigned x = 0; x < na; x++) {
+		for (unsigned y = 0; y < nb; y++) {
+			char consensus;
+			ws.matchTable[x * nb + y] = isMatch(
+					alphabet[0][x], alphabet[1][y], consensus);
+		}
+	}
+
+	ws.codeA.assign(N_a + 1 + LANES, 0);
+	ws.codeB.assign(N_b + LANES, 0);
+	for (int i = 1; i <= N_a; i++)
+		ws.codeA[i] = codes[0][(unsigned char)seq_a[i-1]];
+	for (int k = 0; k < N_b; k++)
+		ws.codeB[k] = codes[1][(unsigned char)seq_b[N_b-1-k]];
+
+	bool simd = false;
+#if __SSE2__
+	simd = g_useSIMD && nb <= 32;
+	if (simd) {
+		ws.matchA.assign(N_a + 1 + LANES, 0);
+		ws.bitB.assign(N_b + LANES, 0);
+		for (int i = 1; i <= N_a; i++)
+			for (unsigned y = 0; y < nb; y++)
+				if (ws.matchTable[ws.codeA[i] * nb + y])
+					ws.matchA[i] |= 1u << y;
+		for (int k = 0; k < N_b; k++)
+			ws.bitB[k] = 1u << ws.codeB[k];
+	}
+#endif
+
+	for (unsigned t = 0; t < 3; t++) {
+		ws.H[t].assign(N_a + 1 + LANES, INVALID);
+		ws.U[t].assign(N_a + 1 + LANES, INVALID);
+		ws.L[t].assign(N_a + 1 + LANES, INVALID);
+	}
+	// Release the directions of an alignment that is much larger.
+	size_t cells = (size_t)N_a * N_b + LANES;
+	if (ws.dir.capacity() > 2 * cells)
+		vector<unsigned char>().swap(ws.dir);
+	ws.dir.resize(cells);
+	ws.diagonal.resize(N_a + N_b + 1);
+	ws.last.assign(N_b + 1, 0);
+
+	// The cell (0, 0) is the start of the overlap. The first column
+	// is a valid start, and the rest of the first row is invalid.
+	ws.H[0][0] = 0;
+	size_t offset = 0;
+	for (int d = 1; d <= N_a + N_b; d++) {
+		int* Hc = &ws.H[d % 3][0];
+		int* Uc = &ws.U[d % 3][0];
+		int* Lc = &ws.L[d % 3][0];
+		const int* Up = &ws.U[(d + 2) % 3][0];
+		const int* Lp = &ws.L[(d + 2) % 3][0];
+		const int* Hpp = &ws.H[(d + 1) % 3][0];
+
+		int lo = ws.first(d), hi = min(N_a, d - 1);
+		ws.diagonal[d] = offset;
+		if (lo <= hi) {
+			// The cell (i, d-i) compares seq_b[d-i-1], which is
+			// codeB[N_b-d+i].
+			int k0 = N_b - d;
+			if (simd) {
+#if __SSE2__
+				alignDiagonalSIMD(ws, lo, hi, k0, Hpp, Up, Lp,
+						Hc, Uc, Lc, &ws.dir[offset]);
+#endif
+			} else
+				alignDiagonal(ws, lo, hi, k0, Hpp, Up, Lp,
+						Hc, Uc, Lc, &ws.dir[offset]);
+			offset += hi - lo + 1;
+			if (hi == N_a)
+				ws.last[d - N_a] = Hc[N_a];
+		}
+
+		// The first row (0, d) and the first column (d, 0).
+		Hc[0] = Uc[0] = Lc[0] = INVALID;
+		if (d <= N_a) {
+			Hc[d] = 0;
+			Uc[d] = INVALID;
+			Lc[d] = opt::gap_open;
+		}
+	}
+}
+
+OverlapWorkspace::OverlapWorkspace()
+	: m_matrix(new OverlapMatrix)
+{
+}
+
+OverlapWorkspace::~OverlapWorkspace()
+{
+	delete m_matrix;
+}
+
 //the backtrack step in smith_waterman
-unsigned Backtrack(const int i_max, const int j_max, int** I_i, int** I_j,
+unsigned Backtrack(const int i_max, const int j_max,
+		const OverlapMatrix& ws,
 		const string& seq_a, const string& seq_b, SMAlignment& align, unsigned* align_pos)
 {
 	// Backtracking from H_max
 	int current_i=i_max,current_j=j_max;
-	int next_i=I_i[current_i][current_j];
-	int next_j=I_j[current_i][current_j];
 	string consensus_a(""), consensus_b(""), match("");
 	unsigned num_of_match = 0;
-	while(((current_i!=next_i) || (current_j!=next_j)) && (next_j!=0) && (next_i!=0)){
-		if(next_i==current_i) {
+	for (;;) {
+		Direction x = ws.direction(current_i, current_j);
+		int next_i = x == LEFT ? current_i : current_i - 1;
+		int next_j = x == UP ? current_j : current_j - 1;
+		if (next_i == 0 || next_j == 0)
+			break;
+		if (x == LEFT) {
 			consensus_a += '-'; //deletion in A
 			match += tolower(seq_b[current_j-1]);
 			consensus_b += seq_b[current_j-1]; //b must be some actual char, cannot be '-' aligns with '-'!
 		}
 		else {
 			consensus_a += seq_a[current_i-1]; // match/mismatch in A
-			if(next_j==current_j) {
+			if (x == UP) {
 				consensus_b += '-'; // deletion in B
 				match += tolower(seq_a[current_i-1]);
 			}
@@ -131,8 +421,6 @@ unsigned Backtrack(const int i_max, const int j_max, int** I_i, int** I_j,
 
 		current_i = next_i;
 		current_j = next_j;
-		next_i=I_i[current_i][current_j];
-		next_j=I_j[current_i][current_j];
 	}
 
 	//check whether the alignment is what we want (pinned at the ends), modified version of SW (i_max is already fixed)
@@ -177,92 +465,40 @@ unsigned Backtrack(const int i_max, const int j_max, int** I_i, int** I_j,
  * of seqB).
  */
 void alignOverlap(const string& seq_a, const string& seq_b, unsigned seq_a_start_pos,
-	vector<overlap_align>& overlaps, bool multi_align, bool verbose)
+	vector<overlap_align>& overlaps, bool multi_align, bool verbose,
+	OverlapWorkspace& workspace)
 {
 	// get the actual lengths of the sequences
 	int N_a = seq_a.length();
 	int N_b = seq_b.length();
 
-	// initialize H
-	int i, j;
-	double** H;
-	int **I_i, **I_j;
-	H = new double*[N_a+1];
-	I_i = new int*[N_a+1];
-	I_j = new int*[N_a+1];
-	bool** V = new bool*[N_a+1];
-
-	for(i=0;i<=N_a;i++){
-		H[i] = new double[N_b+1];
-		I_i[i] = new int[N_b+1];
-		I_j[i] = new int[N_b+1];
-		H[i][0]=0; //only need to initialize first row and first column
-		I_i[i][0] = i-1;
-		V[i] = new bool[N_b+1];
-		V[i][0] = true; //valid start
-	}
-
-	for (j = 0; j <= N_b; j++) {
-		H[0][j] = 0; //initialize first column
-		I_j[0][j] = j-1;
-		V[0][j] = false; //wrong start, not overlap
-	}
-	V[0][0] = true;
-
-	for(i=1;i<=N_a;i++){
-		for(j=1;j<=N_b;j++){
-			char a = seq_a[i-1], b = seq_b[j-1];
-			double scores[3] = {
-				V[i-1][j-1] ? H[i-1][j-1] + matchScore(a, b)
-					: -DBL_MAX, // match or mismatch
-				V[i-1][j] ? H[i-1][j] + gapScore(I_j[i-1][j] == j)
-					: -DBL_MAX, // deletion in sequence A
-				V[i][j-1] ? H[i][j-1] + gapScore(I_i[i][j-1] == i)
-					: -DBL_MAX // deletion in sequence B
-			};
-			double* pMax = max_element(scores, scores + 3);
-			H[i][j] = *pMax;
-			switch (pMax - scores) {
-			  case 0: // match or mismatch
-				I_i[i][j] = i-1;
-				I_j[i][j] = j-1;
-				break;
-			  case 1: // deletion in sequence A
-				I_i[i][j] = i-1;
-				I_j[i][j] = j;
-				break;
-			  case 2: // deletion in sequence B
-				I_i[i][j] = i;
-				I_j[i][j] = j-1;
-				break;
-			}
-			V[i][j] = H[i][j] == -DBL_MAX ? false : true;
-		}
-	}
+	OverlapMatrix& ws = workspace.matrix();
+	fillMatrix(ws, seq_a, seq_b);
+	const int* H_last = &ws.last[0];
 
 	// search H for the maximal score
 	unsigned num_of_match = 0;
-	double H_max = 0.;
+	int H_max = 0;
 	int i_max=N_a, j_max;
 	int* j_max_indexes=new int[N_b]; //this array holds the index of j_max in H[N_a]
-	for (j=0; j<N_b; j++)
+	for (int j=0; j<N_b; j++)
 		j_max_indexes[j]=j+1;
 
 	//sort H[N_a], store the sorted index in j_max_indexes
-	sort(j_max_indexes, j_max_indexes+N_b, index_cmp<double*>(H[N_a]));
+	sort(j_max_indexes, j_max_indexes+N_b, index_cmp<const int*>(H_last));
 
 	//find ALL overlap alignments, starting from the highest score j_max
-	j = 0;
+	int j = 0;
 	bool found = false;
 	while (j < N_b) {
 		j_max = j_max_indexes[j];
-		H_max = H[N_a][j_max];
+		H_max = H_last[j_max];
 		if (H_max == 0)
 			break;
 
 		SMAlignment align;
 		unsigned align_pos[4];
-		num_of_match = Backtrack(i_max, j_max, I_i, I_j, seq_a, seq_b, align, align_pos);
+		num_of_match = Backtrack(i_max, j_max, ws, seq_a, seq_b, align, align_pos);
 		if (num_of_match) {
 			overlaps.push_back(overlap_align(seq_a_start_pos+align_pos[0], align_pos[3], align.match_align, num_of_match));
 			if (!found) {
@@ -272,21 +508,168 @@ void alignOverlap(const string& seq_a, const string& seq_b, unsigned seq_a_start
 				found = true;
 				if (!multi_align
 						|| (j+1 < N_b
-							&& H[N_a][j_max_indexes[j+1]] < H_max))
+							&& H_last[j_max_indexes[j+1]] < H_max))
 					break;
 			}
 		}
 		j++;
 	}
 	delete [] j_max_indexes;
-	for(i=0;i<=N_a;i++){
-		delete [] H[i];
-		delete [] I_i[i];
-		delete [] I_j[i];
-		delete [] V[i];
+
+	if (ws.dir.capacity() > MAX_KEPT_CELLS)
+		vector<unsigned char>().swap(ws.dir);
+}
+
+void alignOverlap(const string& seq_a, const string& seq_b, unsigned seq_a_start_pos,
+	vector<overlap_align>& overlaps, bool multi_align, bool verbose)
+{
+	OverlapWorkspace workspace;
+	alignOverlap(seq_a, seq_b, seq_a_start_pos, overlaps,
+			multi_align, verbose, workspace);
+}
+
+/** A read packed two bits per base. The bases that are N are
+ * stored separately, with the low bit of the base set. */
+struct PackedSeq {
+	vector<uint64_t> bases, unknown;
+};
+
+/** Pack the specified sequence two bits per base.
+ * @return false if the sequence has a character other than ACGTN
+ */
+static bool pack(const string& s, PackedSeq& packed)
+{
+	packed.bases.assign(s.size() / 32 + 2, 0);
+	packed.unknown.assign(s.size() / 32 + 2, 0);
+	for (unsigned i = 0; i < s.size(); i++) {
+		uint64_t x;
+		switch (s[i]) {
+		  case 'A': x = 0; break;
+		  case 'C': x = 1; break;
+		  case 'G': x = 2; break;
+		  case 'T': x = 3; break;
+		  case 'N':
+			packed.unknown[i / 32] |= (uint64_t)1 << 2 * (i % 32);
+			continue;
+		  default: return false;
+		}
+		packed.bases[i / 32] |= x << 2 * (i % 32);
 	}
-	delete [] H;
-	delete [] I_i;
-	delete [] I_j;
-	delete [] V;
+	return true;
+}
+
+/** Return the code of the base ACGT. */
+static unsigned baseCode(char c)
+{
+	return c == 'A' ? 0 : c == 'C' ? 1 : c == 'G' ? 2 : 3;
+}
+
+/** Return the consensus of the bases a and b, which are ACGTN. */
+static char consensusBase(char a, char b)
+{
+	static const char ambiguityOrTable[4][5] = {
+		"AMRW", "MCSY", "RSGK", "WYKT" };
+	return a == b ? a
+		: a == 'N' ? b
+		: b == 'N' ? a
+		: ambiguityOrTable[baseCode(a)][baseCode(b)];
+}
+
+/** Return the 32 bases that start at the specified position. */
+static uint64_t extract(const vector<uint64_t>& packed, unsigned pos)
+{
+	unsigned shift = 2 * (pos % 32);
+	uint64_t x = packed[pos / 32] >> shift;
+	if (shift > 0)
+		x |= packed[pos / 32 + 1] << (64 - shift);
+	return x;
+}
+
+/** Return the number of mismatches of the last n bases of a and the
+ * first n bases of b. An N matches any base. */
+static unsigned countMismatches(const PackedSeq& a, unsigned lenA,
+		const PackedSeq& b, unsigned n)
+{
+	unsigned count = 0;
+	for (unsigned k = 0; k < n; k += 32) {
+		unsigned pos = lenA - n + k;
+		uint64_t x = extract(a.bases, pos) ^ b.bases[k / 32];
+		x = (x | x >> 1) & 0x5555555555555555ULL;
+		x &= ~(extract(a.unknown, pos) | b.unknown[k / 32]);
+		if (n - k < 32)
+			x &= ((uint64_t)1 << 2 * (n - k)) - 1;
+		count += popcount(x);
+	}
+	return count;
+}
+
+/** Find the overlaps of a and b by comparing the packed reads. */
+bool findUngappedOverlaps(const string& a, const string& b,
+		vector<overlap_align>& overlaps)
+{
+	unsigned lenA = a.size(), lenB = b.size();
+	unsigned maxOverlap = min(lenA, lenB);
+	int gap = max(opt::gap_open, opt::gap_extend);
+	if (maxOverlap == 0 || gap >= 0
+			|| opt::match <= 0 || opt::mismatch >= 0
+			|| (opt::match - opt::mismatch) * (int)maxOverlap + gap >= 0)
+		return false;
+
+	PackedSeq pa, pb;
+	if (!pack(a, pa) || !pack(b, pb))
+		return false;
+
+	vector<int> scores(maxOverlap + 1);
+	vector<unsigned> matches(maxOverlap + 1);
+	bool hasZero = false;
+	int best = INT_MIN;
+	for (unsigned n = 1; n <= maxOverlap; n++) {
+		unsigned mismatches = countMismatches(pa, lenA, pb, n);
+		matches[n] = n - mismatches;
+		scores[n] = opt::match * (int)matches[n]
+			+ opt::mismatch * (int)mismatches;
+		hasZero = hasZero || scores[n] == 0;
+		if (matches[n] > 0)
+			best = max(best, scores[n]);
+	}
+	if (best == INT_MIN) {
+		// No overlap has a match. When b is longer than a,
+		// alignOverlap may find a match of a to the middle of b and
+		// report it as a gapped overlap.
+		return lenB <= lenA;
+	}
+	if (best == 0)
+		return true;
+
+	// Count the overlaps that score best with and without a match.
+	unsigned bestOverlap = 0, numMatched = 0, numUnmatched = 0;
+	for (unsigned n = 1; n <= maxOverlap; n++) {
+		if (scores[n] != best)
+			continue;
+		if (matches[n] > 0) {
+			bestOverlap = n;
+			numMatched++;
+		} else
+			numUnmatched++;
+	}
+
+	// The order of overlaps of equal score is not known.
+	if (numMatched == 1 && numUnmatched > 0)
+		return false;
+	bool unique = numMatched == 1;
+	if (!unique && !hasZero && lenB > lenA)
+		return false;
+
+	for (unsigned n = 1; n <= maxOverlap; n++) {
+		if (unique ? n != bestOverlap
+				: matches[n] == 0 || scores[n] > best
+					|| (hasZero && scores[n] <= 0))
+			continue;
+		string consensus(n, 'N');
+		for (unsigned i = 0; i < n; i++)
+			consensus[i] = consensusBase(a[lenA - n + i], b[i]);
+		overlaps.push_back(overlap_align(lenA - n, n - 1,
+					consensus, matches[n]));
+	}
+	return true;
 }
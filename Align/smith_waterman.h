@@ -53,7 +53,58 @@ struct overlap_align {
 	}
 };
 
+struct OverlapMatrix;
+
+/** The working storage of alignOverlap. The storage is reused by each
+ * alignment that is given the same workspace, and released when the
+ * workspace is destroyed. A workspace is used by one thread at a
+ * time. */
+class OverlapWorkspace {
+  public:
+	OverlapWorkspace();
+	~OverlapWorkspace();
+	OverlapMatrix& matrix() { return *m_matrix; }
+
+  private:
+	OverlapWorkspace(const OverlapWorkspace&);
+	OverlapWorkspace& operator=(const OverlapWorkspace&);
+
+	OverlapMatrix* m_matrix;
+};
+
 void alignOverlap(const string& seq_a, const string& seq_b,
 	unsigned seq_a_start_pos, vector<overlap_align>& overlaps, bool multi_align, bool verbose);
 
+/** Find the overlaps of seq_a and seq_b as above, using the storage
+ * of the specified workspace. */
+void alignOverlap(const string& seq_a, const string& seq_b,
+	unsigned seq_a_start_pos, vector<overlap_align>& overlaps,
+	bool multi_align, bool verbose, OverlapWorkspace& workspace);
+
+/** Find the overlaps of a and b that alignOverlap would find with
+ * multi_align set, by comparing the packed reads without aligning
+ * them.
+ *
+ * When a gap costs more than the difference between an overlap of
+ * all matches and an overlap of all mismatches, alignOverlap scores
+ * the overlap of length n by its n bases without gaps, and ranks
+ * every gapped overlap below every ungapped overlap. alignOverlap
+ * considers the overlaps from best to worst score, and stops at a
+ * score of zero. Let best be the best score of an overlap that has a
+ * match. If only one overlap scores best, that overlap alone is
+ * reported. If more than one overlap with a match scores best, every
+ * overlap with a match that scores no more than best is reported,
+ * up to the first overlap that scores zero. If no overlap has a
+ * match, such as for a pair of poly-G reads, no overlap is reported.
+ * @return false if alignOverlap must be called to find the overlaps
+ */
+bool findUngappedOverlaps(const string& a, const string& b,
+		vector<overlap_align>& overlaps);
+
+/** Compute the alignments of alignOverlap using SSE2 instructions
+ * when they are available, which is the default, or else one cell at
+ * a time. The results are the same.
+ */
+void setAlignOverlapSIMD(bool enable);
+
 #endif /* SMITH_WATERMAN_H */
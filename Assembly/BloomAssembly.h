@@ -0,0 +1,364 @@
+#ifndef BLOOMASSEMBLY_H
+#define BLOOMASSEMBLY_H 1
+
+#include "Bloom/Bloom.h"
+#include "Bloom/BloomFilter.h"
+#include "Bloom/CascadingBloomFilter.h"
+#include "Common/Kmer.h"
+#include "Common/Sense.h"
+#include "Common/UnorderedSet.h"
+#include "DataLayer/FastaReader.h"
+#include "DataLayer/FastaWriter.h"
+#include "Konnector/DBGBloom.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if _OPENMP
+# include "Bloom/ConcurrentBloomFilter.h"
+#endif
+
+/**
+ * Assemble unitigs from a de Bruijn graph that is represented
+ * implicitly by a Bloom filter of the solid k-mers, that is the
+ * k-mers that occur at least twice in the reads.
+ *
+ * A neighbour of a k-mer that leads to a dead end within trimLen
+ * k-mers is either a critical false positive of the Bloom filter or
+ * a tip caused by a read error. Such k-mers are recorded in a set
+ * and are not considered branches. Unitigs are seeded from the
+ * solid k-mers of the reads. The two ends of each assembled unitig
+ * and a sample of its k-mers are recorded exactly, so that each
+ * unitig is assembled once, and a seed is found to belong to an
+ * assembled unitig by extending it to the nearest recorded k-mer.
+ */
+class BloomAssembler
+{
+  public:
+	typedef DBGBloom<BloomFilter> Graph;
+
+	/** Assembly statistics */
+	struct Stats {
+		size_t unitigs;
+		size_t tips;
+		size_t falseBranches;
+		Stats() : unitigs(0), tips(0), falseBranches(0) { }
+	};
+
+	/**
+	 * @param solid a Bloom filter of the solid k-mers
+	 * @param trimLen remove dangling unitigs shorter than this
+	 * number of k-mers
+	 */
+	BloomAssembler(const BloomFilter& solid, unsigned trimLen)
+		: m_g(solid), m_trimLen(trimLen), m_id(0)
+	{
+	}
+
+	/** Assemble the unitigs seeded by the reads of the specified
+	 * file. */
+	void assemble(const std::string& path, FastaWriter& out)
+	{
+		const unsigned k = Kmer::length();
+		FastaReader in(path.c_str(), FastaReader::FOLD_CASE);
+		for (std::string seq; in >> seq;) {
+			if (seq.size() < k)
+				continue;
+			for (size_t i = 0; i < seq.size() - k + 1; ++i) {
+				std::string s = seq.substr(i, k);
+				size_t pos = s.find_last_not_of("ACGT");
+				if (pos != std::string::npos) {
+					i += pos;
+					continue;
+				}
+				Kmer seed(s);
+				if (!m_g.m_bloom[seed])
+					continue;
+				std::vector<Kmer> kmers;
+				if (!isVisited(seed, kmers)) {
+					kmers.clear();
+					assembleUnitig(seed, out, kmers);
+				}
+
+				// Skip the following k-mers of the read that are in
+				// the same unitig.
+				for (std::vector<Kmer>::const_iterator it
+						= kmers.begin(); it != kmers.end()
+						&& i + k < seq.size(); ++it) {
+					if (!isACGT(seq[i + k]))
+						break;
+					Kmer v = seed;
+					v.shift(SENSE, baseToCode(seq[i + k]));
+					if (v != *it)
+						break;
+					seed = v;
+					++i;
+				}
+			}
+		}
+		assert(in.eof());
+	}
+
+	const Stats& stats() const { return m_stats; }
+
+  private:
+	/** Store the neighbours of u in the specified direction.
+	 * @return the number of neighbours
+	 */
+	unsigned getNeighbours(const Kmer& u, extDirection dir,
+			Kmer neighbours[NUM_BASES]) const
+	{
+		unsigned mask = neighbourMask(m_g, u, dir);
+		unsigned n = 0;
+		Kmer v(u);
+		v.shift(dir);
+		for (uint8_t i = 0; i < NUM_BASES; ++i) {
+			if (mask & 1 << i) {
+				v.setLastBase(dir, i);
+				neighbours[n++] = v;
+			}
+		}
+		return n;
+	}
+
+	/** Return whether the path starting at v leads to a dead end
+	 * within maxLen k-mers in the specified direction. */
+	bool isDeadEnd(const Kmer& v, extDirection dir, unsigned maxLen) const
+	{
+		Kmer u = v;
+		for (unsigned i = 0; i < maxLen; ++i) {
+			Kmer neighbours[NUM_BASES];
+			unsigned n = getNeighbours(u, dir, neighbours);
+			if (n == 0)
+				return true;
+			if (n > 1)
+				return false;
+			u = neighbours[0];
+		}
+		return false;
+	}
+
+	/** Return whether the neighbour v, reached in the specified
+	 * direction, is a false positive or a tip. */
+	bool isFalseBranch(const Kmer& v, extDirection dir)
+	{
+		// Orient the k-mer so that its dead end is in the
+		// sense direction.
+		Kmer key = dir == SENSE ? v : reverseComplement(v);
+		if (m_falseBranches.count(key) > 0)
+			return true;
+		if (!isDeadEnd(v, dir, m_trimLen))
+			return false;
+		m_falseBranches.insert(key);
+		m_stats.falseBranches++;
+		return true;
+	}
+
+	/** Store the neighbours of u in the specified direction that
+	 * are not false branches.
+	 * @return the number of neighbours
+	 */
+	unsigned getTrueNeighbours(const Kmer& u, extDirection dir,
+			Kmer neighbours[NUM_BASES])
+	{
+		Kmer candidates[NUM_BASES];
+		unsigned n = getNeighbours(u, dir, candidates);
+		if (n == 1) {
+			// A sole neighbour is not a branch, even when it is
+			// the last k-mer of a dead end.
+			neighbours[0] = candidates[0];
+			return 1;
+		}
+		unsigned m = 0;
+		for (unsigned i = 0; i < n; ++i)
+			if (!isFalseBranch(candidates[i], dir))
+				neighbours[m++] = candidates[i];
+		return m;
+	}
+
+	/** The end of an extension of a unitig */
+	enum ExtensionEnd { BRANCH, DEAD_END, CYCLE };
+
+	/**
+	 * Find the k-mer that follows u in the unitig of the seed in the
+	 * specified direction.
+	 * @param [out] v the next k-mer
+	 * @param [out] end how the unitig ends when there is none
+	 * @return whether there is a next k-mer
+	 */
+	bool next(const Kmer& seed, const Kmer& rcSeed, const Kmer& u,
+			extDirection dir, Kmer& v, ExtensionEnd& end)
+	{
+		Kmer succ[NUM_BASES];
+		unsigned n = getTrueNeighbours(u, dir, succ);
+		if (n != 1) {
+			end = n == 0 ? DEAD_END : BRANCH;
+			return false;
+		}
+		v = succ[0];
+		Kmer prev[NUM_BASES];
+		if (getTrueNeighbours(v, !dir, prev) != 1 || prev[0] != u) {
+			end = BRANCH;
+			return false;
+		}
+		if (v == seed || v == rcSeed) {
+			end = CYCLE;
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Extend the unitig from the seed in the specified direction
+	 * until it reaches a branch or a dead end, or returns to the
+	 * seed.
+	 * @param kmers the k-mers of the extension are appended
+	 * @param bases the bases of the extension are appended
+	 * @return how the extension ends
+	 */
+	ExtensionEnd extend(const Kmer& seed, extDirection dir,
+			std::vector<Kmer>& kmers, std::string& bases)
+	{
+		const unsigned k = Kmer::length();
+		Kmer rcSeed = reverseComplement(seed);
+		ExtensionEnd end;
+		for (Kmer u = seed, v; next(seed, rcSeed, u, dir, v, end);
+				u = v) {
+			kmers.push_back(v);
+			bases += codeToBase(v.at(dir == SENSE ? k - 1 : 0));
+		}
+		return end;
+	}
+
+	/** Return the canonical orientation of a k-mer. */
+	static Kmer canonical(const Kmer& u)
+	{
+		Kmer v = u;
+		v.canonicalize();
+		return v;
+	}
+
+	/** Return whether a k-mer of a unitig is one of the sample of
+	 * k-mers that are recorded in m_visited. */
+	static bool isSample(const Kmer& u)
+	{
+		return canonical(u).getHashCode() % SAMPLE_RATE == 0;
+	}
+
+	/**
+	 * Return whether the unitig of the seed has been assembled. The
+	 * unitig is extended in the sense direction until it reaches a
+	 * recorded k-mer or its end, which is recorded when the unitig
+	 * is assembled. A k-mer belongs to one unitig, so that the
+	 * result is exact.
+	 * @param kmers the k-mers of the extension are appended
+	 */
+	bool isVisited(const Kmer& seed, std::vector<Kmer>& kmers)
+	{
+		if (m_visited.count(canonical(seed)) > 0)
+			return true;
+		Kmer rcSeed = reverseComplement(seed);
+		ExtensionEnd end;
+		for (Kmer u = seed, v; next(seed, rcSeed, u, SENSE, v, end);
+				u = v) {
+			kmers.push_back(v);
+			if (m_visited.count(canonical(v)) > 0)
+				return true;
+		}
+		return false;
+	}
+
+	/** Record the ends and a sample of the k-mers of a unitig.
+	 * @param kmers the seed, then the k-mers of the extension in
+	 * the antisense direction, then those of the sense direction
+	 * @param numLeft the number of k-mers of the antisense extension
+	 */
+	void visit(const std::vector<Kmer>& kmers, size_t numLeft)
+	{
+		m_visited.insert(canonical(kmers[0]));
+		m_visited.insert(canonical(kmers[numLeft]));
+		m_visited.insert(canonical(kmers.back()));
+		for (std::vector<Kmer>::const_iterator it = kmers.begin();
+				it != kmers.end(); ++it)
+			if (isSample(*it))
+				m_visited.insert(canonical(*it));
+	}
+
+	/** Assemble and write the unitig containing the seed.
+	 * @param right the k-mers of the unitig that follow the seed in
+	 * the sense direction are appended
+	 */
+	void assembleUnitig(const Kmer& seed, FastaWriter& out,
+			std::vector<Kmer>& right)
+	{
+		std::vector<Kmer> kmers(1, seed);
+		std::string leftBases, rightBases;
+		ExtensionEnd leftEnd = extend(seed, ANTISENSE, kmers, leftBases);
+		size_t numLeft = kmers.size() - 1;
+		// A cycle is walked entirely by the first extension.
+		ExtensionEnd rightEnd = leftEnd == CYCLE ? CYCLE
+			: extend(seed, SENSE, kmers, rightBases);
+		bool deadEnd = leftEnd == DEAD_END || rightEnd == DEAD_END;
+		visit(kmers, numLeft);
+		right.assign(kmers.begin() + 1 + numLeft, kmers.end());
+
+		if (deadEnd && kmers.size() < m_trimLen) {
+			m_stats.tips++;
+			return;
+		}
+
+		std::reverse(leftBases.begin(), leftBases.end());
+		Sequence seq = leftBases + seed.str() + rightBases;
+		// The count of a solid k-mer is not recorded. Report the
+		// minimum count of a solid k-mer.
+		out.WriteSequence(seq, m_id++,
+				kmers.size() * CascadingBloomFilter::MAX_COUNT);
+		m_stats.unitigs++;
+	}
+
+	/** The de Bruijn graph of the solid k-mers */
+	Graph m_g;
+
+	/** Remove dangling unitigs shorter than this many k-mers */
+	unsigned m_trimLen;
+
+	/** A k-mer of an assembled unitig is a sample when its hash is a
+	 * multiple of this rate. */
+	enum { SAMPLE_RATE = 32 };
+
+	/** The ends and a sample of the k-mers of the assembled unitigs,
+	 * in canonical orientation */
+	unordered_set<Kmer, hash<Kmer> > m_visited;
+
+	/** The critical false positives and tips, oriented so that
+	 * their dead end is in the sense direction */
+	unordered_set<Kmer, hash<Kmer> > m_falseBranches;
+
+	/** The ID of the next unitig */
+	unsigned m_id;
+
+	Stats m_stats;
+};
+
+/** Load the solid k-mers of the specified files into a Bloom
+ * filter of the specified size in bits. */
+static inline void loadSolidKmers(BloomFilter& solid, size_t bits,
+		const std::vector<std::string>& paths, bool verbose)
+{
+	CascadingBloomFilter counting(bits);
+#if _OPENMP
+	ConcurrentBloomFilter<CascadingBloomFilter> cbf(counting, 1000);
+	for (std::vector<std::string>::const_iterator it = paths.begin();
+			it != paths.end(); ++it)
+		Bloom::loadFile(cbf, Kmer::length(), *it, verbose);
+#else
+	for (std::vector<std::string>::const_iterator it = paths.begin();
+			it != paths.end(); ++it)
+		Bloom::loadFile(counting, Kmer::length(), *it, verbose);
+#endif
+	solid = counting.getBloomFilter(counting.MAX_COUNT - 1);
+}
+
+#endif
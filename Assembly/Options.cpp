@@ -4,6 +4,7 @@
 #include "Common/Options.h"
 #include "DataLayer/Options.h"
 #include "Kmer.h"
+#include "StringUtil.h" // for SIToBytes
 #include <algorithm>
 #include <climits> // for INT_MAX
 #include <getopt.h>
@@ -69,6 +70,11 @@ static const char USAGE_MESSAGE[] =
 " ABYSS Options: (won't work with ABYSS-P)\n"
 "\n"
 "  -g, --graph=FILE      generate a graph in dot format\n"
+"  -B, --bloom-size=N    assemble unitigs using a Bloom filter de Bruijn\n"
+"                        graph of N bytes, which uses much less memory\n"
+"                        than the hash table. A unit suffix k, M or G\n"
+"                        may be used. Erosion, coverage and bubble\n"
+"                        options are ignored. [disabled]\n"
 "\n"
 "Report bugs to <" PACKAGE_BUGREPORT ">.\n";
 
@@ -105,6 +111,10 @@ int ss = 0;
  */
 bool maskCov = false;
 
+/** The size of the Bloom filter in bytes, or zero to use a hash
+ * table */
+size_t bloomSize = 0;
+
 /** coverage histogram path */
 string coverageHistPath;
 
@@ -125,7 +135,7 @@ string snpPath;
 /** input FASTA files */
 vector<string> inFiles;
 
-static const char shortopts[] = "b:c:e:E:g:k:mo:Q:q:s:t:v";
+static const char shortopts[] = "b:B:c:e:E:g:k:mo:Q:q:s:t:v";
 
 enum { OPT_HELP = 1, OPT_VERSION, COVERAGE_HIST };
 
@@ -151,6 +161,7 @@ static const struct option longopts[] = {
 	{ "no-erode",    no_argument,       (int*)&erode, 0 },
 	{ "mask-cov",    no_argument, NULL, 'm' },
 	{ "graph",       required_argument, NULL, 'g' },
+	{ "bloom-size",  required_argument, NULL, 'B' },
 	{ "snp",         required_argument, NULL, 's' },
 	{ "verbose",     no_argument,       NULL, 'v' },
 	{ "help",        no_argument,       NULL, OPT_HELP },
@@ -179,6 +190,9 @@ void parse(int argc, char* const* argv)
 			case 'b':
 				arg >> bubbleLen;
 				break;
+			case 'B':
+				bloomSize = SIToBytes(arg);
+				break;
 			case 'c':
 				arg >> coverage;
 				break;
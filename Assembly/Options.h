@@ -1,6 +1,7 @@
 #ifndef ASSEMBLY_OPTIONS_H
 #define ASSEMBLY_OPTIONS_H 1
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -16,6 +17,7 @@ namespace opt {
 	extern unsigned bubbleLen;
 	extern unsigned ss;
 	extern bool maskCov;
+	extern size_t bloomSize;
 	extern std::string coverageHistPath;
 	extern std::string contigsPath;
 	extern std::string contigsTempPath;
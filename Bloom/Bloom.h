@@ -19,6 +19,7 @@
 
 #include "Common/Kmer.h"
 #include "Common/HashFunction.h"
+#include "Common/RollingHash.h"
 #include "Common/Uncompress.h"
 #include "Common/IOUtil.h"
 #include "DataLayer/FastaReader.h"
@@ -49,7 +50,7 @@ namespace Bloom {
 	/** Print a progress message after loading this many seqs */
 	static const unsigned LOAD_PROGRESS_STEP = 100000;
 	/** file format version number */
-	static const unsigned BLOOM_VERSION = 2;
+	static const unsigned BLOOM_VERSION = 3;
 	/** I/O buffer size when reading/writing bloom filter files */
 	static const unsigned long IO_BUFFER_SIZE = 32*1024;
 
@@ -63,15 +64,14 @@ namespace Bloom {
 		LOAD_INTERSECT
 	};
 
-	/** Return the hash value of this object. */
+	/**
+	 * Return the hash value of this object. This hash is a rolling
+	 * hash, so that the hashes of the neighbours of a k-mer may be
+	 * computed incrementally. See RollingHash.
+	 */
 	inline static size_t hash(const key_type& key)
 	{
-		if (key.isCanonical())
-			return hashmem(&key, sizeof key);
-
-		key_type copy(key);
-		copy.reverseComplement();
-		return hashmem(&copy, sizeof copy);
+		return RollingHash(key).hash();
 	}
 
 	/** Return the hash value of this object given seed. */
@@ -79,6 +79,25 @@ static inline std::istream& operator>>(std::istream& in, Ignore o)
 	return in.ignore(o.n, o.delim);
 }
 
+/** Read about n bytes of complete lines into block, so that the
+ * lines of a block may be parsed without the following block.
+ * @return false at the end of the input
+ */
+static inline bool readLines(std::istream& in, std::string& block,
+		size_t n)
+{
+	block.resize(n);
+	in.read(&block[0], block.size());
+	block.resize(in.gcount());
+	if (in && !block.empty() && block[block.size() - 1] != '\n') {
+		std::string line;
+		std::getline(in, line);
+		block += line;
+		block += '\n';
+	}
+	return !block.empty();
+}
+
 /** Read a file and store it in the specified vector. */
 template <typename Vector>
 static inline void readFile(const char* path, Vector& s)
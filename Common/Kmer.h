@@ -60,6 +60,9 @@ class Kmer
 	void setLastBase(extDirection dir, uint8_t base);
 	uint8_t getLastBaseChar() const;
 
+	/** Return the base code at the specified index. */
+	uint8_t at(unsigned i) const;
+
 	uint8_t shift(extDirection dir, uint8_t base = 0)
 	{
 		return dir == SENSE ? shiftAppend(base) : shiftPrepend(base);
@@ -90,7 +93,6 @@ class Kmer
 	uint8_t shiftAppend(uint8_t base);
 	uint8_t shiftPrepend(uint8_t base);
 
-	uint8_t at(unsigned i) const;
 	void set(unsigned i, uint8_t base);
 
 	static uint8_t leftShiftByte(char* pSeq,
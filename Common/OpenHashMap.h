@@ -0,0 +1,213 @@
+#ifndef OPENHASHMAP_H
+#define OPENHASHMAP_H 1
+
+#include "Common/Hash.h"
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * A hash map using open addressing with linear probing.
+ * The entries are stored in a single array, so that inserting an
+ * element does not allocate memory unless the table must grow.
+ * The map is cleared in constant time without releasing its
+ * storage, so that a map may be reused by many small searches
+ * without allocating memory once it has grown to its working size.
+ * Elements cannot be erased individually.
+ */
+template <typename K, typename T, typename Hash = hash<K> >
+class OpenHashMap
+{
+  public:
+	typedef K key_type;
+	typedef T mapped_type;
+	typedef std::pair<K, T> value_type;
+	typedef size_t size_type;
+
+  private:
+	/** A slot of the table. The slot is occupied when its
+	 * generation matches the generation of the table. */
+	struct Slot {
+		value_type value;
+		unsigned gen;
+		Slot() : gen(0) { }
+	};
+	typedef std::vector<Slot> Slots;
+
+  public:
+	/** Iterate over the elements of the map. */
+	class const_iterator
+	{
+	  public:
+		const_iterator() : m_map(NULL), m_i(0) { }
+
+		const_iterator(const OpenHashMap* map, size_t i)
+			: m_map(map), m_i(i)
+		{
+			skip();
+		}
+
+		const value_type& operator*() const
+		{
+			return m_map->m_slots[m_i].value;
+		}
+
+		const value_type* operator->() const
+		{
+			return &m_map->m_slots[m_i].value;
+		}
+
+		bool operator==(const const_iterator& it) const
+		{
+			return m_i == it.m_i;
+		}
+
+		bool operator!=(const const_iterator& it) const
+		{
+			return m_i != it.m_i;
+		}
+
+		const_iterator& operator++()
+		{
+			++m_i;
+			skip();
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			const_iterator it = *this;
+			++*this;
+			return it;
+		}
+
+	  private:
+		/** Skip to the next occupied slot. */
+		void skip()
+		{
+			for (; m_i < m_map->m_slots.size()
+					&& m_map->m_slots[m_i].gen != m_map->m_gen; ++m_i)
+				;
+		}
+
+		const OpenHashMap* m_map;
+		size_t m_i;
+	};
+
+	OpenHashMap(const Hash& hasher = Hash())
+		: m_size(0), m_gen(1), m_hash(hasher) { }
+
+	size_type size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const
+	{
+		return const_iterator(this, m_slots.size());
+	}
+
+	/** Remove all elements without releasing the storage. */
+	void clear()
+	{
+		m_size = 0;
+		if (++m_gen == 0) {
+			// The generation counter wrapped around.
+			for (typename Slots::iterator it = m_slots.begin();
+					it != m_slots.end(); ++it)
+				it->gen = 0;
+			m_gen = 1;
+		}
+	}
+
+	/** Return a pointer to the value of the specified key, or
+	 * NULL if the key is not present. */
+	const T* find(const K& key) const
+	{
+		if (m_slots.empty())
+			return NULL;
+		const Slot& slot = m_slots[probe(m_slots, key)];
+		return slot.gen == m_gen ? &slot.value.second : NULL;
+	}
+
+	T* find(const K& key)
+	{
+		return const_cast<T*>(
+				static_cast<const OpenHashMap*>(this)->find(key));
+	}
+
+	/** Return the number of elements with the specified key. */
+	size_type count(const K& key) const
+	{
+		return find(key) != NULL;
+	}
+
+	/** Insert the specified value, if its key is not present.
+	 * @return a pointer to the value of the key and whether the
+	 * element was inserted
+	 */
+	std::pair<T*, bool> insert(const value_type& x)
+	{
+		if (2 * (m_size + 1) > m_slots.size())
+			grow();
+		Slot& slot = m_slots[probe(m_slots, x.first)];
+		if (slot.gen == m_gen)
+			return std::make_pair(&slot.value.second, false);
+		slot.value = x;
+		slot.gen = m_gen;
+		++m_size;
+		return std::make_pair(&slot.value.second, true);
+	}
+
+	/** Return the value of the specified key, inserting a default
+	 * value if the key is not present. */
+	T& operator[](const K& key)
+	{
+		return *insert(value_type(key, T())).first;
+	}
+
+	/** Return the approximate number of bytes used by the elements
+	 * of this map, assuming the table is at most half full. */
+	size_t approxMemSize() const
+	{
+		return 2 * m_size * sizeof (Slot);
+	}
+
+  private:
+	/** Return the index of the slot of the specified key, which is
+	 * either the slot containing the key or an empty slot. */
+	size_t probe(const Slots& slots, const K& key) const
+	{
+		assert(!slots.empty());
+		size_t mask = slots.size() - 1;
+		size_t i = m_hash(key) & mask;
+		while (slots[i].gen == m_gen && !(slots[i].value.first == key))
+			i = (i + 1) & mask;
+		return i;
+	}
+
+	/** Double the size of the table. */
+	void grow()
+	{
+		Slots slots(m_slots.empty() ? 16 : 2 * m_slots.size());
+		for (typename Slots::const_iterator it = m_slots.begin();
+				it != m_slots.end(); ++it) {
+			if (it->gen != m_gen)
+				continue;
+			Slot& slot = slots[probe(slots, it->value.first)];
+			slot.value = it->value;
+			slot.gen = m_gen;
+		}
+		m_slots.swap(slots);
+	}
+
+	Slots m_slots;
+	size_t m_size;
+
+	/** The generation of the occupied slots. */
+	unsigned m_gen;
+
+	Hash m_hash;
+};
+
+#endif
@@ -14,13 +14,16 @@ class PMF
   public:
 	/** Construct a PMF from a histogram. */
 	PMF(const Histogram& h)
-		: m_dist(h.maximum() + 1), m_mean(h.mean()), m_stdDev(h.sd())
+		: m_dist(h.maximum() + 1), m_logDist(m_dist.size()),
+		m_mean(h.mean()), m_stdDev(h.sd())
 	{
 		unsigned count = h.size();
 		m_minp = (double)1 / count;
+		m_logMinp = log(m_minp);
 		for (size_t i = 0; i < m_dist.size(); i++) {
 			unsigned n = h.count(i);
 			m_dist[i] = n > 0 ? (double)n / count : m_minp;
+			m_logDist[i] = log(m_dist[i]);
 		}
 	}
 
@@ -30,6 +33,12 @@ class PMF
 		return x < m_dist.size() ? m_dist[x] : m_minp;
 	}
 
+	/** Return the log probability of x. */
+	double logProbability(size_t x) const
+	{
+		return x < m_logDist.size() ? m_logDist[x] : m_logMinp;
+	}
+
 	/** Return the minimum probability. */
 	double minProbability() const { return m_minp; }
 
@@ -56,9 +65,11 @@ class PMF
 
   private:
 	std::vector<double> m_dist;
+	std::vector<double> m_logDist;
 	double m_mean;
 	double m_stdDev;
 	double m_minp;
+	double m_logMinp;
 };
 
 namespace std {
@@ -0,0 +1,59 @@
+#ifndef PARALLELBATCHES_H
+#define PARALLELBATCHES_H 1
+
+/** The per-thread state of a worker that needs none. */
+struct NoWorkspace
+{
+	template <typename Worker>
+	explicit NoWorkspace(const Worker&) { }
+};
+
+/**
+ * Process the records of a stream in batches in parallel, and write
+ * the results in the order of the input.
+ *
+ * The records are read into one of two buffers, and the threads
+ * process the records of a batch in parallel. Meanwhile one thread
+ * writes the results of the previous batch from the other buffer and
+ * reads the next batch into it, so that reading and writing overlap
+ * processing. Only one thread reads or writes at a time, so that the
+ * streams, and any counters that are updated by write, need no
+ * locking.
+ *
+ * The worker provides:
+ * Workspace, the state of each thread, which is constructed from
+ * the worker;
+ * unsigned read(unsigned buf), which reads a batch into buffer buf
+ * and returns the number of records read;
+ * void process(unsigned buf, unsigned i, Workspace& ws), which
+ * processes record i of buffer buf;
+ * void write(unsigned buf, unsigned n), which writes the results of
+ * the first n records of buffer buf.
+ */
+template <typename Worker>
+void processBatches(Worker& worker)
+{
+	unsigned n[2] = { 0, 0 };
+	n[0] = worker.read(0);
+
+#pragma omp parallel
+	{
+		typename Worker::Workspace workspace(worker);
+		for (unsigned cur = 0;; cur ^= 1) {
+			unsigned next = cur ^ 1;
+#pragma omp single nowait
+			{
+				worker.write(next, n[next]);
+				n[next] = n[cur] > 0 ? worker.read(next) : 0;
+			}
+			if (n[cur] == 0)
+				break;
+
+#pragma omp for schedule(dynamic)
+			for (int i = 0; i < (int)n[cur]; i++)
+				worker.process(cur, i, workspace);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H 1
+
+#include <cassert>
+#include <cstddef>
+#include <sched.h>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+/** Give up the processor while waiting for another thread.
+ * Yield the first few times, and then sleep briefly, so that an idle
+ * thread does not spin for long.
+ * @param attempts the number of times this thread has waited, which
+ * is incremented
+ */
+static inline void backoff(unsigned& attempts)
+{
+	if (attempts++ < 16) {
+		sched_yield();
+	} else {
+		struct timespec t = { 0, 50000 };
+		nanosleep(&t, NULL);
+	}
+}
+
+/**
+ * A bounded lock-free queue, which may be used by any number of
+ * producer and consumer threads.
+ *
+ * Each slot of the ring has a sequence number, which tells a
+ * producer whether the slot is free and a consumer whether the slot
+ * is full, so that a push or a pop claims its slot with a single
+ * compare-and-swap and no thread ever blocks another.
+ * The elements should be cheap to copy, such as pointers to batches
+ * of records.
+ */
+template <typename T>
+class RingBuffer
+{
+  public:
+	/** Construct a queue of at least the specified capacity. */
+	explicit RingBuffer(size_t capacity = 1024)
+		: m_head(0), m_tail(0)
+	{
+		size_t n = 2;
+		while (n < capacity)
+			n *= 2;
+		m_mask = n - 1;
+		m_slots.resize(n);
+		for (size_t i = 0; i < n; ++i)
+			m_slots[i].seq = i;
+	}
+
+	/** Return the capacity of this queue. */
+	size_t capacity() const { return m_mask + 1; }
+
+	/** Add an element to the queue.
+	 * @return false if the queue is full
+	 */
+	bool tryPush(const T& x)
+	{
+		size_t pos = m_tail;
+		for (;;) {
+			Slot& slot = m_slots[pos & m_mask];
+			size_t seq = slot.seq;
+			__sync_synchronize();
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				if (__sync_bool_compare_and_swap(&m_tail, pos, pos + 1))
+					break;
+				pos = m_tail;
+			} else if (diff < 0) {
+				return false;
+			} else
+				pos = m_tail;
+		}
+		Slot& slot = m_slots[pos & m_mask];
+		slot.value = x;
+		__sync_synchronize();
+		slot.seq = pos + 1;
+		return true;
+	}
+
+	/** Add an element to the queue, and wait while it is full. */
+	void push(const T& x)
+	{
+		for (unsigned attempts = 0; !tryPush(x);)
+			backoff(attempts);
+	}
+
+	/** Remove the element at the front of the queue.
+	 * @return false if the queue is empty
+	 */
+	bool tryPop(T& x)
+	{
+		size_t pos = m_head;
+		for (;;) {
+			Slot& slot = m_slots[pos & m_mask];
+			size_t seq = slot.seq;
+			__sync_synchronize();
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0) {
+				if (__sync_bool_compare_and_swap(&m_head, pos, pos + 1))
+					break;
+				pos = m_head;
+			} else if (diff < 0) {
+				return false;
+			} else
+				pos = m_head;
+		}
+		Slot& slot = m_slots[pos & m_mask];
+		x = slot.value;
+		__sync_synchronize();
+		slot.seq = pos + m_mask + 1;
+		return true;
+	}
+
+  private:
+	RingBuffer(const RingBuffer&);
+	RingBuffer& operator=(const RingBuffer&);
+
+	/** A slot of the ring. */
+	struct Slot {
+		volatile size_t seq;
+		T value;
+	};
+
+	/** The size of a cache line, which separates the indices of the
+	 * producers and the consumers. */
+	static const size_t CACHE_LINE = 64;
+
+	std::vector<Slot> m_slots;
+	size_t m_mask;
+	char m_pad0[CACHE_LINE];
+
+	/** The position of the next pop */
+	volatile size_t m_head;
+	char m_pad1[CACHE_LINE];
+
+	/** The position of the next push */
+	volatile size_t m_tail;
+	char m_pad2[CACHE_LINE];
+};
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef ROLLINGHASH_H
+#define ROLLINGHASH_H 1
+
+#include "Common/Kmer.h"
+#include "Common/Options.h"
+#include "Common/SeqExt.h" // for NUM_BASES
+#include <algorithm>
+#include <cassert>
+#include <stdint.h>
+
+/**
+ * A rolling hash of a k-mer and of its reverse complement, in the
+ * style of ntHash. The hash of a neighbour of the k-mer, which is
+ * obtained by removing a base from one end and adding a base to the
+ * other end, is computed in constant time, so that the four
+ * neighbours of a vertex of a de Bruijn graph are hashed without
+ * rehashing and reverse-complementing each neighbour.
+ */
+class RollingHash
+{
+  public:
+	/** Hash the specified k-mer. */
+	explicit RollingHash(const Kmer& kmer)
+		: m_k(Kmer::length()), m_fwd(0), m_rev(0)
+	{
+		for (unsigned i = 0; i < m_k; ++i) {
+			uint8_t c = kmer.at(i);
+			m_fwd = rol(m_fwd, 1) ^ seed(c);
+			m_rev ^= rol(seed(complement(c)), i);
+		}
+	}
+
+	/** Hash the k-mer of the specified base codes. */
+	explicit RollingHash(const uint8_t* codes)
+		: m_k(Kmer::length()), m_fwd(0), m_rev(0)
+	{
+		for (unsigned i = 0; i < m_k; ++i) {
+			m_fwd = rol(m_fwd, 1) ^ seed(codes[i]);
+			m_rev ^= rol(seed(complement(codes[i])), i);
+		}
+	}
+
+	/** Roll the hash to the next k-mer of a sequence.
+	 * @param first the first base of the k-mer
+	 * @param base the base following the k-mer
+	 */
+	void rollRight(uint8_t first, uint8_t base)
+	{
+		m_fwd = rol(m_fwd, 1) ^ rol(seed(first), m_k) ^ seed(base);
+		m_rev = ror(m_rev ^ seed(complement(first)), 1)
+			^ rol(seed(complement(base)), m_k - 1);
+	}
+
+	/** Return the hash of the k-mer with the base at index i
+	 * changed from base `from' to base `to'. */
+	size_t substitute(unsigned i, uint8_t from, uint8_t to) const
+	{
+		assert(i < m_k);
+		return canonical(
+				m_fwd ^ rol(seed(from) ^ seed(to), m_k - 1 - i),
+				m_rev ^ rol(seed(complement(from))
+					^ seed(complement(to)), i));
+	}
+
+	/** Return the hash of the canonical orientation of the k-mer,
+	 * which is the same for a k-mer and its reverse complement. */
+	size_t hash() const
+	{
+		return canonical(m_fwd, m_rev);
+	}
+
+	/** Compute the hashes of the four successors of the k-mer.
+	 * @param first the first base of the k-mer
+	 * @param hashes the hash of the successor ending with base i
+	 * is stored in hashes[i]
+	 */
+	void successors(uint8_t first, size_t hashes[NUM_BASES]) const
+	{
+		uint64_t fwd = rol(m_fwd, 1) ^ rol(seed(first), m_k);
+		uint64_t rev = ror(m_rev ^ seed(complement(first)), 1);
+		for (uint8_t i = 0; i < NUM_BASES; ++i)
+			hashes[i] = canonical(fwd ^ seed(i),
+					rev ^ rol(seed(complement(i)), m_k - 1));
+	}
+
+	/** Compute the hashes of the four predecessors of the k-mer.
+	 * @param last the last base of the k-mer
+	 * @param hashes the hash of the predecessor beginning with base
+	 * i is stored in hashes[i]
+	 */
+	void predecessors(uint8_t last, size_t hashes[NUM_BASES]) const
+	{
+		uint64_t fwd = ror(m_fwd ^ seed(last), 1);
+		uint64_t rev = rol(m_rev, 1) ^ rol(seed(complement(last)), m_k);
+		for (uint8_t i = 0; i < NUM_BASES; ++i)
+			hashes[i] = canonical(fwd ^ rol(seed(i), m_k - 1),
+					rev ^ seed(complement(i)));
+	}
+
+  private:
+	/** Return the seed of the specified base. */
+	static uint64_t seed(uint8_t base)
+	{
+		static const uint64_t seeds[NUM_BASES] = {
+			0x3c8bfbb395c60474ULL, 0x3193c18562a02b4cULL,
+			0x20323ed082572324ULL, 0x295549f54be24456ULL
+		};
+		assert(base < NUM_BASES);
+		return seeds[base];
+	}
+
+	/** Return the complement of the specified base. */
+	static uint8_t complement(uint8_t base)
+	{
+		return opt::colourSpace ? base : 3 - base;
+	}
+
+	static uint64_t rol(uint64_t x, unsigned n)
+	{
+		n %= 64;
+		return n == 0 ? x : x << n | x >> (64 - n);
+	}
+
+	static uint64_t ror(uint64_t x, unsigned n)
+	{
+		return rol(x, 64 - n % 64);
+	}
+
+	/** Combine the hashes of both strands. The bits are mixed so
+	 * that the low bits are suitable for indexing a table. */
+	static size_t canonical(uint64_t fwd, uint64_t rev)
+	{
+		uint64_t x = std::min(fwd, rev);
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+		return x;
+	}
+
+	unsigned m_k;
+	uint64_t m_fwd;
+	uint64_t m_rev;
+};
+
+#endif
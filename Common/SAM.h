@@ -17,6 +17,30 @@ namespace opt {
 	static unsigned minAlign = 1;
 }
 
+/** Return whether c terminates a CIGAR string, which may be a
+ * field of a SAM record. */
+static inline bool isCigarEnd(char c)
+{
+	return c == '\0' || c == '\t' || c == '\n' || c == '\r' || c == ' ';
+}
+
+/** Return the CIGAR string that starts at the specified character. */
+static inline std::string cigarString(const char* cigar)
+{
+	const char* end = cigar;
+	while (!isCigarEnd(*end))
+		++end;
+	return std::string(cigar, end);
+}
+
+/** Report an invalid CIGAR string and exit. */
+static inline void invalidCigar(const char* cigar)
+{
+	std::cerr << "error: invalid CIGAR: `"
+		<< cigarString(cigar) << "'\n";
+	exit(EXIT_FAILURE);
+}
+
 /** A SAM alignment of a single query. */
 struct SAMAlignment {
 	std::string rname;
@@ -104,14 +128,35 @@ struct SAMAlignment {
 		CigarCoord(const std::string& cigar)
 			: qlen(0), qstart(0), qspan(0), tspan(0)
 		{
-			if (cigar == "*")
+			parse(cigar.c_str());
+		}
+
+		/** Parse the CIGAR string that starts at the specified
+		 * character and ends at white space or a null character, so
+		 * that a field of a SAM record is parsed in place.
+		 */
+		explicit CigarCoord(const char* cigar)
+			: qlen(0), qstart(0), qspan(0), tspan(0)
+		{
+			parse(cigar);
+		}
+
+	  private:
+		void parse(const char* cigar)
+		{
+			if (cigar[0] == '*' && isCigarEnd(cigar[1]))
 				return;
-			std::istringstream in(cigar);
 			bool first = true;
-			unsigned len;
-			char type;
-			while (in >> len >> type) {
-				switch (type) {
+			const char* p = cigar;
+			while (*p >= '0' && *p <= '9') {
+				char* end;
+				unsigned len = strtoul(p, &end, 10);
+				if (isCigarEnd(*end)) {
+					// Ignore a trailing length without an operation.
+					p = end;
+					break;
+				}
+				switch (*end) {
 				  case 'H': case 'S':
 					if (first)
 						qstart = len;
@@ -130,13 +175,13 @@ struct SAMAlignment {
 					tspan += len;
 					break;
 				  default:
-					std::cerr << "error: invalid CIGAR: `"
-						<< cigar << "'\n";
-					exit(EXIT_FAILURE);
+					invalidCigar(cigar);
 				}
 				first = false;
+				p = end + 1;
 			}
-			assert(in.eof());
+			if (!isCigarEnd(*p))
+				invalidCigar(cigar);
 		}
 	};
 
@@ -159,16 +204,28 @@ struct SAMAlignment {
 	 * uninitialized.
 	 */
 	static Alignment parseCigar(const std::string& cigar, bool isRC) {
+		return parseCigar(cigar.c_str(), isRC);
+	}
+
+	/** Parse the CIGAR string that starts at the specified character
+	 * and ends at white space or a null character.
+	 */
+	static Alignment parseCigar(const char* cigar, bool isRC) {
 		Alignment a;
-		std::istringstream in(cigar);
-		unsigned len;
-		char type;
 		unsigned clip0 = 0;
 		a.align_length = 0;
 		unsigned qlen = 0;
 		unsigned clip1 = 0;
-		while (in >> len >> type) {
-			switch (type) {
+		const char* p = cigar;
+		while (*p >= '0' && *p <= '9') {
+			char* end;
+			unsigned len = strtoul(p, &end, 10);
+			if (isCigarEnd(*end)) {
+				p = end;
+				break;
+			}
+			p = end + 1;
+			switch (*end) {
 			  case 'I': case 'X': case '=':
 				qlen += len;
 				clip1 += len;
@@ -177,7 +234,7 @@ struct SAMAlignment {
 					// Ignore a malformatted CIGAR string whose first
 					// non-clipping operation is not M.
 					std::cerr << "warning: malformatted CIGAR: "
-						<< cigar << std::endl;
+						<< cigarString(cigar) << std::endl;
 				}
 				break;
 			  case 'M':
@@ -193,18 +250,13 @@ struct SAMAlignment {
 				clip1 += len;
 				break;
 			  default:
-				std::cerr << "error: invalid CIGAR: `"
-					<< cigar << "'\n";
-				exit(EXIT_FAILURE);
+				invalidCigar(cigar);
 			}
 		}
 		a.read_start_pos = isRC ? clip1 : clip0;
 		a.read_length = qlen;
-		if (!in.eof()){
-			std::cerr << "error: invalid CIGAR: `"
-				<< cigar << "'\n";
-			exit(EXIT_FAILURE);
-		}
+		if (!isCigarEnd(*p))
+			invalidCigar(cigar);
 		return a;
 	}
 
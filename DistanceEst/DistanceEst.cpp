@@ -11,11 +11,11 @@
 #include <climits>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <getopt.h>
 #include <iomanip>
 #include <iostream>
-#include <iterator> // for istream_iterator
 #include <limits> // for numeric_limits
 #include <sstream>
 #include <string>
@@ -127,8 +127,33 @@ static const struct option longopts[] = {
 	{ NULL, 0, NULL, 0 }
 };
 
+/** The fields of an alignment of a read pair that are used to
+ * estimate the distance between two contigs.
+ */
+struct AlignedPair {
+	/** The contig of the read */
+	unsigned rname;
+	/** The contig of the mate */
+	unsigned mrnm;
+	/** The position of the first base of the read on its contig */
+	int tstart;
+	/** The distance to the first base of the mate */
+	int isize;
+	/** The SAM flags */
+	unsigned short flag;
+
+	bool isReverse() const { return flag & SAMAlignment::FREVERSE; }
+	bool isMateReverse() const
+	{
+		return flag & SAMAlignment::FMREVERSE;
+	}
+
+	int targetAtQueryStart() const { return tstart; }
+	int mateTargetAtQueryStart() const { return tstart + isize; }
+};
+
 /** A collection of aligned read pairs. */
-typedef vector<SAMRecord> Pairs;
+typedef vector<AlignedPair> Pairs;
 
 /** Estimate the distance between two contigs using the difference of
  * the population mean and the sample mean.
@@ -198,7 +223,9 @@ static int estimateDistance(unsigned len0, unsigned len1,
 			fragments.end());
 	numPairs = fragments.size();
 	assert((int)orig - (int)numPairs >= 0);
+#pragma omp atomic
 	stats.total_frags += orig;
+#pragma omp atomic
 	stats.dup_frags += orig - numPairs;
 
 	if (numPairs < opt::npairs)
@@ -271,13 +298,14 @@ static void writeEstimate(ostream& out,
 	}
 }
 
-/** Generate distance estimates for the specified alignments. */
+/** Generate distance estimates for the alignments [first, last) of
+ * one contig. */
 static void writeEstimates(ostream& out,
-		const vector<SAMRecord>& pairs,
+		Pairs::const_iterator first, Pairs::const_iterator last,
 		const vector<unsigned>& lengthVec, const PMF& pmf)
 {
-	assert(!pairs.empty());
-	ContigID id0(get(g_contigNames, pairs.front().rname));
+	assert(first != last);
+	ContigID id0(first->rname);
 	assert(id0 < lengthVec.size());
 	unsigned len0 = lengthVec[id0];
 	if (len0 < opt::seedLen)
@@ -285,15 +313,13 @@ static void writeEstimates(ostream& out,
 
 	ostringstream ss;
 	if (opt::format == DIST)
-		ss << pairs.front().rname;
+		ss << get(g_contigNames, id0);
 
 	typedef map<ContigNode, Pairs> PairsMap;
 	PairsMap dataMap[2];
-	for (Pairs::const_iterator it = pairs.begin();
-			it != pairs.end(); ++it)
-		dataMap[it->isReverse()][find_vertex(
-				it->mrnm, it->isReverse() == it->isMateReverse(),
-				g_contigNames)]
+	for (Pairs::const_iterator it = first; it != last; ++it)
+		dataMap[it->isReverse()][ContigNode(it->mrnm,
+				it->isReverse() == it->isMateReverse())]
 			.push_back(*it);
 
 	for (int sense0 = false; sense0 <= true; sense0++) {
@@ -308,7 +334,6 @@ static void writeEstimates(ostream& out,
 					it->second, pmf);
 	}
 	if (opt::format == DIST)
-#pragma omp critical(out)
 		out << ss.str() << '\n';
 	assert(out.good());
 }
@@ -330,41 +355,183 @@ static Histogram loadHist(const string& path)
 	return hist;
 }
 
-/** Copy records from [it, last) to out and stop before alignments to
- * the next target sequence.
- * @param[in,out] it an input iterator
+/** Report an invalid SAM record and exit. */
+static void invalidRecord(const char* record)
+{
+	cerr << PROGRAM ": error: invalid SAM record: `"
+		<< string(record, strcspn(record, "\n")) << "'\n";
+	exit(EXIT_FAILURE);
+}
+
+/** Parse the integer at the start of a field of a SAM record. */
+static long parseInteger(const char* p, const char* record)
+{
+	char* end;
+	long x = strtol(p, &end, 10);
+	if (end == p || !(*end == '\t' || *end == '\n' || *end == '\r'
+				|| *end == '\0'))
+		invalidRecord(record);
+	return x;
+}
+
+/** The number of fields of a SAM record that are parsed */
+static const unsigned NUM_FIELDS = 9;
+
+/**
+ * Parse one line of SAM in place, without copying its fields.
+ * @param record the line, which ends with a newline or a null
+ * @param[out] pair the alignment, when this record is used
+ * @param[out] name storage for looking up a contig name
+ * @return whether this record is an alignment of a read pair that
+ * spans two contigs
+ */
+static bool parseRecord(const char* record, AlignedPair& pair,
+		string& name)
+{
+	const char* fields[NUM_FIELDS];
+	const char* p = record;
+	for (unsigned i = 0; i < NUM_FIELDS; ++i) {
+		fields[i] = p;
+		while (*p != '\t' && *p != '\n' && *p != '\0')
+			++p;
+		if (*p != '\t' && i < NUM_FIELDS - 1)
+			invalidRecord(record);
+		++p;
+	}
+
+	unsigned short flag = parseInteger(fields[1], record);
+	int pos = parseInteger(fields[3], record) - 1;
+	unsigned short mapq = parseInteger(fields[4], record);
+	int isize = parseInteger(fields[8], record);
+
+	// Set the paired flags if qname ends in /1 or /2.
+	const char* qname = fields[0];
+	unsigned l = fields[1] - 1 - qname;
+	bool checkAlign = true;
+	if (l >= 2 && qname[l-2] == '/') {
+		switch (qname[l-1]) {
+			case '1':
+				flag |= SAMAlignment::FPAIRED | SAMAlignment::FREAD1;
+				break;
+			case '2': case '3':
+				flag |= SAMAlignment::FPAIRED | SAMAlignment::FREAD2;
+				break;
+			default:
+				checkAlign = false;
+		}
+	}
+
+	const char* rname = fields[2];
+	unsigned rlen = fields[3] - 1 - rname;
+	const char* mrnm = fields[6];
+	unsigned mlen = fields[7] - 1 - mrnm;
+	bool sameContig = (mlen == 1 && mrnm[0] == '=')
+		|| (mlen == rlen && memcmp(mrnm, rname, rlen) == 0);
+	if ((flag & (SAMAlignment::FUNMAP | SAMAlignment::FMUNMAP))
+			|| !(flag & SAMAlignment::FPAIRED)
+			|| sameContig || mapq < opt::minMapQ)
+		return false;
+
+	// Ignore the alignment if it is not long enough.
+	SAMAlignment::CigarCoord a(fields[5]);
+	if (checkAlign
+			&& (a.qspan < opt::minAlign || a.tspan < opt::minAlign))
+		return false;
+	assert(a.qstart + a.qspan <= a.qlen);
+
+	pair.flag = flag;
+	pair.tstart = pair.isReverse()
+		? pos + a.tspan + (a.qlen - a.qspan - a.qstart)
+		: pos - a.qstart;
+	pair.isize = isize;
+	name.assign(rname, rlen);
+	pair.rname = g_contigNames.getIndex(name);
+	name.assign(mrnm, mlen);
+	pair.mrnm = g_contigNames.getIndex(name);
+	return true;
+}
+
+/** The number of bytes of SAM that are read at once */
+static const size_t BLOCK_SIZE = 4 << 20;
+
+/** The number of bytes of SAM that are parsed by one task */
+static const size_t CHUNK_SIZE = 64 << 10;
+
+/** Parse a block of SAM in parallel, and append the alignments of
+ * read pairs that span two contigs to pairs in the order in which
+ * they occur. The block is split into chunks at line boundaries.
  */
-template<typename It>
-static void readPairs(It& it, const It& last, vector<SAMRecord>& out)
+static void parseBlock(const string& block, Pairs& pairs)
+{
+	vector<size_t> chunks(1, 0);
+	while (chunks.back() < block.size()) {
+		size_t end = chunks.back() + CHUNK_SIZE;
+		end = end < block.size() ? block.find('\n', end) : string::npos;
+		chunks.push_back(end == string::npos ? block.size() : end + 1);
+	}
+
+	vector<Pairs> parsed(chunks.size() - 1);
+#pragma omp parallel for schedule(dynamic)
+	for (ptrdiff_t i = 0; i < (ptrdiff_t)parsed.size(); ++i) {
+		string name;
+		const char* p = block.data() + chunks[i];
+		const char* end = block.data() + chunks[i + 1];
+		while (p < end) {
+			AlignedPair pair;
+			if (*p != '\n' && parseRecord(p, pair, name))
+				parsed[i].push_back(pair);
+			p = static_cast<const char*>(memchr(p, '\n', end - p));
+			p = p == NULL ? end : p + 1;
+		}
+	}
+
+	for (vector<Pairs>::const_iterator it = parsed.begin();
+			it != parsed.end(); ++it)
+		pairs.insert(pairs.end(), it->begin(), it->end());
+}
+
+/** Return the start of each contig of the alignments, and check
+ * that the input is sorted. */
+static vector<size_t> findContigs(const Pairs& pairs)
 {
-	assert(out.empty());
-	for (; it != last; ++it) {
-		if (it->isUnmapped() || it->isMateUnmapped()
-				|| !it->isPaired() || it->rname == it->mrnm
-				|| it->mapq < opt::minMapQ)
+	vector<size_t> starts;
+	for (size_t i = 0; i < pairs.size(); ++i) {
+		if (i > 0 && pairs[i].rname == pairs[i - 1].rname)
 			continue;
-		if (!out.empty() && out.back().rname != it->rname)
-			break;
-
-		out.push_back(*it);
-		SAMRecord& sam = out.back();
-		// Clear unused fields.
-		sam.qname.clear();
-#if SAM_SEQ_QUAL
-		sam.seq.clear();
-		sam.qual.clear();
-#endif
+		if (i > 0 && pairs[i].rname < pairs[i - 1].rname) {
+			cerr << "error: input must be sorted: saw `"
+				<< get(g_contigNames, pairs[i - 1].rname)
+				<< "' before `"
+				<< get(g_contigNames, pairs[i].rname) << "'\n";
+			exit(EXIT_FAILURE);
+		}
+		starts.push_back(i);
 	}
+	return starts;
+}
 
-	// Check that the input is sorted.
-	if (it != last && !out.empty()
-			&& get(g_contigNames, it->rname)
-				< get(g_contigNames, out.front().rname)) {
-		cerr << "error: input must be sorted: saw `"
-			<< out.front().rname << "' before `"
-			<< it->rname << "'\n";
-		exit(EXIT_FAILURE);
+/** Estimate the distances of the contigs that start at starts and
+ * end at last in parallel, and write them in order. */
+static void writeEstimates(ostream& out, const Pairs& pairs,
+		const vector<size_t>& starts, size_t last,
+		const vector<unsigned>& contigLens, const PMF& pmf)
+{
+	vector<string> estimates(starts.size());
+#pragma omp parallel for schedule(dynamic)
+	for (ptrdiff_t i = 0; i < (ptrdiff_t)starts.size(); ++i) {
+		size_t end = i + 1 < (ptrdiff_t)starts.size()
+			? starts[i + 1] : last;
+		if (starts[i] == end)
+			continue;
+		ostringstream ss;
+		writeEstimates(ss, pairs.begin() + starts[i],
+				pairs.begin() + end, contigLens, pmf);
+		estimates[i] = ss.str();
 	}
+	for (vector<string>::const_iterator it = estimates.begin();
+			it != estimates.end(); ++it)
+		out << *it;
+	assert(out.good());
 }
 
 int main(int argc, char** argv)
@@ -526,26 +693,33 @@ int main(int argc, char** argv)
 	readContigLengths(in, contigLens);
 	g_contigNames.lock();
 
-	// Estimate the distances between contigs.
-	istream_iterator<SAMRecord> it(in), last;
 	if (contigLens.size() == 1) {
 		// When mapping to a single contig, no alignments spanning
 		// contigs are expected.
+		in.peek();
 		assert(in.eof());
 		exit(EXIT_SUCCESS);
 	}
 	assert(in);
 
+	// Estimate the distances between contigs. The alignments of the
+	// last contig of a block may continue in the next block, and are
+	// estimated with the next block.
 	g_recMA = opt::minAlign;
-#pragma omp parallel
-	for (vector<SAMRecord> records;;) {
-		records.clear();
-#pragma omp critical(in)
-		readPairs(it, last, records);
-		if (records.empty())
-			break;
-		writeEstimates(out, records, contigLens, pmf);
+	Pairs pairs;
+	for (string block; readLines(in, block, BLOCK_SIZE);) {
+		parseBlock(block, pairs);
+		vector<size_t> starts = findContigs(pairs);
+		if (starts.size() < 2)
+			continue;
+		size_t last = starts.back();
+		starts.pop_back();
+		writeEstimates(out, pairs, starts, last, contigLens, pmf);
+		pairs.erase(pairs.begin(), pairs.begin() + last);
 	}
+	if (!pairs.empty())
+		writeEstimates(out, pairs, findContigs(pairs), pairs.size(),
+				contigLens, pmf);
 
 	if (opt::verbose > 0) {
 		float prop_dups = (float)100 * stats.dup_frags / stats.total_frags;
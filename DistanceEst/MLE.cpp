@@ -1,10 +1,12 @@
 #include "MLE.h"
 #include "PMF.h"
 #include <boost/tuple/tuple.hpp>
-#include <algorithm> // for swap
+#include <algorithm> // for fill and swap
 #include <cassert>
+#include <climits> // for INT_MIN and INT_MAX
 #include <limits> // for numeric_limits
 #include <utility>
+#include <vector>
 
 using namespace std;
 using boost::tie;
@@ -32,32 +34,113 @@ class WindowFunction {
 					: 1) / (double)x1;
 		}
 
-	private:
 		/** Parameters of this window function. */
 		int x1, x2, x3;
 };
 
+/** The normalizing constant of the PMF shifted by theta, f_theta(x),
+ * which is the sum of the PMF weighted by the window function
+ * shifted by theta. The window function is piecewise linear, so the
+ * constant of any theta is computed in constant time from the prefix
+ * sums of p(i) and i*p(i).
+ */
+class NormalizingConstant {
+	public:
+		NormalizingConstant(const PMF& pmf, const WindowFunction& window)
+			: m_window(window),
+			m_sum0(pmf.maxValue() + 2), m_sum1(pmf.maxValue() + 2)
+		{
+			for (size_t i = 0; i <= pmf.maxValue(); ++i) {
+				m_sum0[i + 1] = m_sum0[i] + pmf[i];
+				m_sum1[i + 1] = m_sum1[i] + (long double)i * pmf[i];
+			}
+		}
+
+		/** Return the normalizing constant of f_theta(x). */
+		double operator()(int theta) const
+		{
+			int x1 = m_window.x1, x2 = m_window.x2, x3 = m_window.x3;
+			long double c = sum0(INT_MIN, theta + 1)
+				+ sum1(theta + 1, theta + x1)
+				- theta * sum0(theta + 1, theta + x1)
+				+ x1 * sum0(theta + x1, theta + x2)
+				+ (x3 + (long double)theta) * sum0(theta + x2, theta + x3)
+				- sum1(theta + x2, theta + x3)
+				+ sum0(theta + x3, INT_MAX);
+			return c / x1;
+		}
+
+	private:
+		/** Return the index of the prefix sum of the values less than i.
+		 */
+		size_t index(int i) const
+		{
+			return i <= 0 ? 0 : min((size_t)i, m_sum0.size() - 1);
+		}
+
+		/** Return the sum of p(i) for i in [a, b). */
+		long double sum0(int a, int b) const
+		{
+			return m_sum0[index(b)] - m_sum0[index(a)];
+		}
+
+		/** Return the sum of i*p(i) for i in [a, b). */
+		long double sum1(int a, int b) const
+		{
+			return m_sum1[index(b)] - m_sum1[index(a)];
+		}
+
+		const WindowFunction& m_window;
+
+		/** The prefix sums of p(i) and i*p(i) */
+		vector<long double> m_sum0, m_sum1;
+};
+
 /** Compute the log likelihood that these samples came from the
- * specified distribution shifted by the parameter theta.
- * @param theta the parameter of the PMF, f_theta(x)
+ * specified distribution shifted by each parameter theta in
+ * [first, first + likelihood.size()).
+ * The log probabilities of the shifted samples are tabulated once,
+ * and each sample adds its contribution to every theta in a single
+ * pass over the table, so that no logarithm is evaluated in the
+ * inner loop, which is vectorized.
+ * @param first the first parameter of the PMF, f_theta(x)
  * @param samples the samples
  * @param pmf the probability mass function
- * @return the log likelihood
+ * @param[out] likelihood the log likelihood of each theta
+ * @param[out] nsamples the number of samples of each theta with a
+ * probability greater than the minimum probability
  */
-static pair<double, unsigned>
-computeLikelihood(int theta, const Histogram& samples, const PMF& pmf)
+static void computeLikelihoods(int first, const Histogram& samples,
+		const PMF& pmf,
+		vector<double>& likelihood, vector<unsigned>& nsamples)
 {
-	double likelihood = 0;
-	unsigned nsamples = 0;
+	const unsigned n = likelihood.size();
+	const int x0 = samples.minimum() + first;
+	const unsigned size = samples.maximum() - samples.minimum() + n;
+	vector<double> logp(size);
+	vector<unsigned> supported(size);
+	for (unsigned i = 0; i < size; ++i) {
+		size_t x = x0 + (int)i;
+		logp[i] = pmf.logProbability(x);
+		supported[i] = pmf[x] > pmf.minProbability();
+	}
+
+	fill(likelihood.begin(), likelihood.end(), 0);
+	fill(nsamples.begin(), nsamples.end(), 0);
+	double* pl = &likelihood[0];
+	unsigned* pn = &nsamples[0];
 	for (Histogram::const_iterator it = samples.begin();
 			it != samples.end(); ++it) {
-		double p = pmf[it->first + theta];
-		unsigned n = it->second;
-		likelihood += n * log(p);
-		if (p > pmf.minProbability())
-			nsamples += n;
+		unsigned i = it->first - samples.minimum();
+		const double* p = &logp[i];
+		const unsigned* s = &supported[i];
+		unsigned count = it->second;
+		double weight = count;
+		for (unsigned t = 0; t < n; ++t) {
+			pl[t] += weight * p[t];
+			pn[t] += count * s[t];
+		}
 	}
-	return make_pair(likelihood, nsamples);
 }
 
 /** Return the most likely distance between two contigs and the number
@@ -71,25 +154,28 @@ maximumLikelihoodEstimate(int first, int last,
 	first = max(first, (int)pmf.minValue() - samples.maximum());
 	last = min(last, (int)pmf.maxValue() - samples.minimum());
 
+	if (first > last)
+		return make_pair(first, 0u);
+
 	/* When randomly selecting fragments that span a given point,
 	 * longer fragments are more likely to be selected than
 	 * shorter fragments.
 	 */
 	WindowFunction window(len0, len1);
+	NormalizingConstant normalizingConstant(pmf, window);
+
+	vector<double> likelihoods(last - first + 1);
+	vector<unsigned> counts(likelihoods.size());
+	computeLikelihoods(first, samples, pmf, likelihoods, counts);
 
 	unsigned nsamples = samples.size();
 	double bestLikelihood = -numeric_limits<double>::max();
 	int bestTheta = first;
 	unsigned bestn = 0;
 	for (int theta = first; theta <= last; theta++) {
-		// Calculate the normalizing constant of the PMF, f_theta(x).
-		double c = 0;
-		for (int i = pmf.minValue(); i <= (int)pmf.maxValue(); ++i)
-			c += pmf[i] * window(i - theta);
-
-		double likelihood;
-		unsigned n;
-	   	tie(likelihood, n) = computeLikelihood(theta, samples, pmf);
+		double c = normalizingConstant(theta);
+		double likelihood = likelihoods[theta - first];
+		unsigned n = counts[theta - first];
 		likelihood -= nsamples * log(c);
 		if (n > 0 && likelihood > bestLikelihood) {
 			bestLikelihood = likelihood;
@@ -0,0 +1,119 @@
+#ifndef ALIGNEDIO_H
+#define ALIGNEDIO_H 1
+
+#include <cassert>
+#include <cerrno>
+#include <cstdlib> // for exit
+#include <cstring> // for strerror
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Read and write the arrays of an index file aligned to a cache
+ * line, so that the file may be memory mapped and used in place.
+ * The offset of the stream is tracked by the caller, so that a
+ * stream that is not seekable, such as stdout, may be written.
+ */
+
+/** The alignment of the arrays of an index file. */
+static const size_t INDEX_ALIGN = 64;
+
+/** Return the number of bytes of padding that align the offset. */
+static inline size_t alignPadding(size_t offset)
+{
+	return (INDEX_ALIGN - offset % INDEX_ALIGN) % INDEX_ALIGN;
+}
+
+/** Write n bytes at p preceded by padding.
+ * @param offset the offset of the stream, which is updated
+ */
+static inline void writeAligned(std::ostream& out,
+		const void* p, size_t n, size_t& offset)
+{
+	static const char zeros[INDEX_ALIGN] = { 0 };
+	size_t pad = alignPadding(offset);
+	out.write(zeros, pad);
+	out.write(static_cast<const char*>(p), n);
+	offset += pad + n;
+}
+
+/** Read n bytes to p preceded by padding.
+ * @param offset the offset of the stream, which is updated
+ */
+static inline void readAligned(std::istream& in,
+		void* p, size_t n, size_t& offset)
+{
+	size_t pad = alignPadding(offset);
+	in.ignore(pad);
+	in.read(static_cast<char*>(p), n);
+	offset += pad + n;
+}
+
+/** Return a pointer to n bytes of a memory mapped file preceded by
+ * padding.
+ * @param offset the offset in the file, which is updated
+ * @param size the size of the file
+ */
+static inline const char* mapAligned(const char* base, size_t size,
+		size_t n, size_t& offset)
+{
+	size_t pos = offset + alignPadding(offset);
+	if (pos > size || n > size - pos) {
+		std::cerr << "error: the index file is truncated\n";
+		exit(EXIT_FAILURE);
+	}
+	offset = pos + n;
+	return base + pos;
+}
+
+/** A read-only memory mapped file. The pages of the file are
+ * shared by all the processes that map it. */
+class MappedFile
+{
+  public:
+	explicit MappedFile(const std::string& path)
+		: m_data(NULL), m_size(0)
+	{
+		int fd = open(path.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) < 0)
+			die(path);
+		m_size = st.st_size;
+		if (m_size > 0) {
+			void* p = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED)
+				die(path);
+			m_data = static_cast<const char*>(p);
+		}
+		close(fd);
+	}
+
+	~MappedFile()
+	{
+		if (m_data != NULL)
+			munmap(const_cast<char*>(m_data), m_size);
+	}
+
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+  private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	static void die(const std::string& path)
+	{
+		std::cerr << "error: `" << path << "': "
+			<< strerror(errno) << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	const char* m_data;
+	size_t m_size;
+};
+
+#endif
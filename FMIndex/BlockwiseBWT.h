@@ -0,0 +1,364 @@
+#ifndef BLOCKWISEBWT_H
+#define BLOCKWISEBWT_H 1
+
+#include "sais.hxx"
+#include <algorithm>
+#include <cassert>
+#include <cstddef> // for ptrdiff_t
+#include <cstdlib> // for abort
+#include <limits> // for numeric_limits
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Build the Burrows-Wheeler transform of a string in blocks of its
+ * suffixes, so that the full suffix array is never stored.
+ *
+ * The suffixes are divided into blocks by splitter suffixes. Each
+ * block is collected by a scan of the string, sorted, and written to
+ * the BWT before the next block is collected.
+ *
+ * The cost of comparing two suffixes is bounded by a difference
+ * cover sample. The suffixes that begin at positions whose residue
+ * modulo PERIOD is in the difference cover are ranked beforehand.
+ * For any two suffixes, there is an offset less than PERIOD at which
+ * both suffixes continue with a ranked suffix, so that a comparison
+ * reads at most PERIOD symbols.
+ *
+ * Karkkainen J (2007) Fast BWT in small space by blockwise suffix
+ * sorting. Theoretical Computer Science 387:249-257.
+ *
+ * @param T the type of a symbol
+ * @param Index a signed type large enough to index the string
+ */
+template <typename T, typename Index>
+class BlockwiseBWT
+{
+  public:
+	/** The period of the difference cover, which is a square. */
+	enum { PERIOD = 1024 };
+
+	/** The suffixes of a block are sorted by their prefixes of this
+	 * length before they are compared using the sample. */
+	enum { SORT_DEPTH = 32 };
+
+	/** Rank the sampled suffixes of the string [t, t + n), whose
+	 * symbols are less than sigma.
+	 */
+	BlockwiseBWT(const T* t, size_t n, unsigned sigma)
+		: m_t(t), m_n(n)
+	{
+		assert(n > 0);
+		assert(sigma <= std::numeric_limits<T>::max());
+		(void)sigma;
+		buildCover();
+		rankSamples();
+	}
+
+	/** Write the BWT of the string, n + 1 symbols, to out. Row 0 is
+	 * the empty suffix, and the symbol of the row of the whole
+	 * string is the specified sentinel.
+	 * @param blockSize the expected number of suffixes of a block
+	 * @return the row of the whole string
+	 */
+	template <typename OutIt>
+	size_t bwt(OutIt out, size_t blockSize, T sentinel) const
+	{
+		assert(blockSize > 0);
+		*out++ = m_t[m_n - 1];
+
+		std::vector<Index> splitters
+			= chooseSplitters((m_n + blockSize - 1) / blockSize);
+		size_t row = 1, sentinelRow = 0;
+		std::vector<Index> block;
+		block.reserve(std::min(m_n, blockSize + blockSize / 4));
+		for (size_t b = 0; b <= splitters.size(); ++b) {
+			collect(block, b > 0 ? splitters[b - 1] : -1,
+					b < splitters.size() ? splitters[b] : -1);
+			if (!block.empty())
+				sortPrefixes(&block[0], 0, block.size(), 0,
+						SORT_DEPTH, SortSuffixes(*this, &block[0]));
+			for (typename std::vector<Index>::const_iterator
+					it = block.begin(); it != block.end(); ++it) {
+				if (*it == 0) {
+					sentinelRow = row;
+					*out++ = sentinel;
+				} else
+					*out++ = m_t[*it - 1];
+				++row;
+			}
+		}
+		assert(row == m_n + 1);
+		return sentinelRow;
+	}
+
+  private:
+	/** Compare the suffixes at two positions. */
+	struct SuffixLess
+	{
+		const BlockwiseBWT& m_bwt;
+		SuffixLess(const BlockwiseBWT& bwt) : m_bwt(bwt) { }
+		bool operator()(Index i, Index j) const
+		{
+			return m_bwt.less(i, j);
+		}
+	};
+
+	/** Sort a range of suffixes that share a prefix. */
+	struct SortSuffixes
+	{
+		const BlockwiseBWT& m_bwt;
+		Index* m_a;
+		SortSuffixes(const BlockwiseBWT& bwt, Index* a)
+			: m_bwt(bwt), m_a(a) { }
+		void operator()(size_t lo, size_t hi) const
+		{
+			if (hi - lo > 1)
+				std::sort(m_a + lo, m_a + hi, SuffixLess(m_bwt));
+		}
+	};
+
+	/** Name a range of sampled suffixes that share a prefix by the
+	 * index of the first of them. */
+	struct NameSamples
+	{
+		BlockwiseBWT& m_bwt;
+		Index* m_a;
+		NameSamples(BlockwiseBWT& bwt, Index* a)
+			: m_bwt(bwt), m_a(a) { }
+		void operator()(size_t lo, size_t hi) const
+		{
+			for (size_t i = lo; i < hi; ++i)
+				m_bwt.m_rank[m_bwt.samplePosition(m_a[i])] = lo;
+		}
+	};
+
+	/** Return whether the suffix at position i is less than the
+	 * suffix at position j.
+	 */
+	bool less(size_t i, size_t j) const
+	{
+		if (i == j)
+			return false;
+		size_t h = (j % PERIOD + PERIOD - i % PERIOD) % PERIOD;
+		size_t delta = (m_offset[h] + PERIOD - i % PERIOD) % PERIOD;
+		for (size_t k = 0; k < delta; ++k, ++i, ++j) {
+			if (i == m_n)
+				return true;
+			if (j == m_n)
+				return false;
+			if (m_t[i] != m_t[j])
+				return m_t[i] < m_t[j];
+		}
+		if (i == m_n)
+			return true;
+		if (j == m_n)
+			return false;
+		return m_rank[samplePosition(i)] < m_rank[samplePosition(j)];
+	}
+
+	/** Return the symbol at offset depth of the suffix at position
+	 * p plus one, or zero past the end of the string.
+	 */
+	unsigned key(size_t p, size_t depth) const
+	{
+		return p + depth < m_n ? m_t[p + depth] + 1 : 0;
+	}
+
+	/** Build the difference cover {0, ..., r-1} and {r, 2r, ...,
+	 * (r-1)r} of PERIOD = r^2, and the offset table of the cover.
+	 */
+	void buildCover()
+	{
+		unsigned r = 1;
+		while (r * r < PERIOD)
+			++r;
+		assert(r * r == PERIOD);
+		m_class.assign(PERIOD, -1);
+		unsigned numClasses = 0;
+		for (unsigned d = 0; d < PERIOD; ++d)
+			if (d < r || d % r == 0)
+				m_class[d] = numClasses++;
+
+		// The first position of each class in the sample.
+		m_classStart.assign(numClasses + 1, 0);
+		for (unsigned d = 0; d < PERIOD; ++d) {
+			int c = m_class[d];
+			if (c >= 0)
+				m_classStart[c + 1] = m_classStart[c]
+					+ (d < m_n ? (m_n - d + PERIOD - 1) / PERIOD : 0);
+		}
+
+		// For each difference h, a residue d in the cover such that
+		// d + h is also in the cover.
+		m_offset.assign(PERIOD, PERIOD);
+		for (unsigned h = 0; h < PERIOD; ++h) {
+			for (unsigned d = 0; d < PERIOD; ++d) {
+				if (m_class[d] >= 0
+						&& m_class[(d + h) % PERIOD] >= 0) {
+					m_offset[h] = d;
+					break;
+				}
+			}
+			assert(m_offset[h] < PERIOD);
+		}
+	}
+
+	/** Return the index in the sample of the sampled position p. */
+	size_t samplePosition(size_t p) const
+	{
+		int c = m_class[p % PERIOD];
+		assert(c >= 0);
+		return m_classStart[c] + p / PERIOD;
+	}
+
+	/** Rank the sampled suffixes. The sampled suffixes are named by
+	 * their prefixes of length PERIOD. The names of each class are
+	 * concatenated in order of position, and the suffixes of this
+	 * reduced string are sorted. A prefix that includes the end of
+	 * the string has a unique name, and so the suffixes of the
+	 * reduced string are ordered as the sampled suffixes are.
+	 */
+	void rankSamples()
+	{
+		size_t m = m_classStart.back();
+		std::vector<Index> sa;
+		sa.reserve(m);
+		for (size_t p = 0; p < m_n; ++p)
+			if (m_class[p % PERIOD] >= 0)
+				sa.push_back(p);
+		assert(sa.size() == m);
+
+		std::vector<Index>& names = m_rank;
+		names.resize(m);
+		sortPrefixes(&sa[0], 0, m, 0, PERIOD,
+				NameSamples(*this, &sa[0]));
+
+		Index status = saisxx(names.begin(), sa.begin(),
+				(Index)m, (Index)m);
+		assert(status == 0);
+		if (status != 0)
+			abort();
+		for (size_t j = 0; j < m; ++j)
+			names[sa[j]] = j;
+	}
+
+	/** Sort the suffixes at positions [a + lo, a + hi), which share
+	 * a prefix of length depth, by their prefixes of length maxDepth
+	 * using multikey quicksort. Call f(lo, hi) for each range of
+	 * suffixes that share a prefix of length maxDepth.
+	 */
+	template <typename F>
+	void sortPrefixes(Index* a, size_t lo, size_t hi, size_t depth,
+			size_t maxDepth, const F& f) const
+	{
+		while (hi - lo > 1 && depth < maxDepth) {
+			// The median of three.
+			unsigned x = key(a[lo], depth),
+				y = key(a[lo + (hi - lo) / 2], depth),
+				z = key(a[hi - 1], depth);
+			unsigned pivot = std::max(std::min(x, y),
+					std::min(std::max(x, y), z));
+
+			// Partition into less than, equal to and greater than.
+			size_t lt = lo, i = lo, gt = hi;
+			while (i < gt) {
+				unsigned c = key(a[i], depth);
+				if (c < pivot)
+					std::swap(a[lt++], a[i++]);
+				else if (c > pivot)
+					std::swap(a[i], a[--gt]);
+				else
+					++i;
+			}
+			sortPrefixes(a, lo, lt, depth, maxDepth, f);
+			sortPrefixes(a, gt, hi, depth, maxDepth, f);
+			lo = lt;
+			hi = gt;
+			if (pivot == 0) {
+				// The end of the string is unique.
+				assert(hi - lo == 1);
+				break;
+			}
+			++depth;
+		}
+		f(lo, hi);
+	}
+
+	/** Choose splitters that divide the suffixes into about the
+	 * specified number of blocks.
+	 */
+	std::vector<Index> chooseSplitters(size_t numBlocks) const
+	{
+		std::vector<Index> splitters;
+		if (numBlocks <= 1)
+			return splitters;
+
+		// Sort a pseudorandom sample of the suffixes.
+		const size_t OVERSAMPLE = 16;
+		std::vector<Index> sample;
+		uint64_t x = 1;
+		for (size_t i = 0; i < numBlocks * OVERSAMPLE; ++i) {
+			x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+			sample.push_back((x >> 16) % m_n);
+		}
+		std::sort(sample.begin(), sample.end());
+		sample.erase(std::unique(sample.begin(), sample.end()),
+				sample.end());
+		std::sort(sample.begin(), sample.end(), SuffixLess(*this));
+
+		for (size_t b = 1; b < numBlocks; ++b) {
+			Index p = sample[b * sample.size() / numBlocks];
+			if (splitters.empty() || splitters.back() != p)
+				splitters.push_back(p);
+		}
+		return splitters;
+	}
+
+	/** Collect the positions of the suffixes that are at least the
+	 * suffix at lower and less than the suffix at upper. A negative
+	 * bound is unbounded.
+	 */
+	void collect(std::vector<Index>& block, Index lower, Index upper)
+		const
+	{
+		const ptrdiff_t CHUNK = 1 << 16;
+		block.clear();
+		ptrdiff_t n = m_n;
+#pragma omp parallel for schedule(dynamic)
+		for (ptrdiff_t first = 0; first < n; first += CHUNK) {
+			std::vector<Index> local;
+			ptrdiff_t last = std::min(first + CHUNK, n);
+			for (ptrdiff_t p = first; p < last; ++p) {
+				if ((lower < 0 || p == lower || less(lower, p))
+						&& (upper < 0 || (p != upper
+								&& less(p, upper))))
+					local.push_back(p);
+			}
+#pragma omp critical(BlockwiseBWT_collect)
+			block.insert(block.end(), local.begin(), local.end());
+		}
+	}
+
+	/** The string */
+	const T* m_t;
+
+	/** The length of the string */
+	size_t m_n;
+
+	/** The index of each residue in the difference cover, or -1 */
+	std::vector<int> m_class;
+
+	/** The index in the sample of the first position of each
+	 * residue of the difference cover */
+	std::vector<size_t> m_classStart;
+
+	/** For each difference h, a residue d of the difference cover
+	 * such that d + h is also in the difference cover */
+	std::vector<unsigned> m_offset;
+
+	/** The rank of each sampled suffix */
+	std::vector<Index> m_rank;
+};
+
+#endif
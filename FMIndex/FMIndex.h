@@ -2,13 +2,19 @@
 #define FMINDEX_H 1
 
 #include "config.h"
-#include "BitArrays.h"
+#include "AlignedIO.h"
+#include "BlockwiseBWT.h"
+#include "OccTable.h"
+#include "RankBitVector.h"
 #include "IOUtil.h"
 #include "sais.hxx"
 #include <boost/integer.hpp>
+#include <boost/shared_ptr.hpp>
 #include <algorithm>
 #include <cassert>
+#include <cstddef> // for ptrdiff_t
 #include <cstdlib> // for exit
+#include <cstring> // for memchr and memcpy
 #include <iostream>
 #include <iterator>
 #include <limits> // for numeric_limits
@@ -72,7 +78,9 @@ struct Match : public SAInterval
 	}
 };
 
-FMIndex() : m_sampleSA(1) { }
+FMIndex() : m_sampleSA(1), m_samplePositions(false),
+	m_blockSize(0), m_mappedSA(NULL), m_mappedSASize(0),
+	m_lookupLength(0), m_mappedLookup(NULL) { }
 
 /** Return the size of the string not counting the sentinel. */
 size_t size() const { return m_occ.size() - 1; }
@@ -99,8 +107,17 @@ void decode(It first, It last) const
 		*it = m_alphabet[*it];
 }
 
+/** Set the number of suffixes of a block of the construction of the
+ * BWT. A string longer than one block is sorted in blocks, so that
+ * its full suffix array is never stored. Zero, the default, sorts
+ * the string in a single block.
+ */
+void setBlockSize(size_t n) { m_blockSize = n; }
+
 /** Build the BWT of [first, last).
  * The BWT including the sentinel is stored in [first, last].
+ * The suffix array uses 32-bit indexes when the string is small
+ * enough, and 64-bit indexes otherwise.
  * @return the position of the sentinel
  */
 template<typename It>
@@ -112,34 +129,35 @@ size_type buildBWT(It first, It last) const
 	encode(first, last);
 	std::replace(first, last, SENTINEL(), T(0));
 
-	std::cerr << "Building the Burrows-Wheeler transform...\n";
 	size_t n = last - first;
-	std::vector<sais_size_type> sa(n);
-	assert(sizeof (size_type) == sizeof (sais_size_type));
-	sais_size_type sentinel = saisxx_bwt(first, first,
-			&sa[0],
-			(sais_size_type)n,
-			(sais_size_type)m_alphabet.size());
-	assert(sentinel >= 0);
-	if (sentinel < 0)
-		abort();
+	bool small = n < size_t(std::numeric_limits<int32_t>::max());
+	if (m_blockSize > 0 && n > m_blockSize) {
+		std::cerr << "Building the Burrows-Wheeler transform "
+			"in blocks of " << m_blockSize << " suffixes...\n";
+		return small ? blockwiseBWT<int32_t>(first, n)
+			: blockwiseBWT<sais_size_type>(first, n);
+	}
+
+	std::cerr << "Building the Burrows-Wheeler transform...\n";
+	size_t sentinel = small ? saisBWT<int32_t>(first, n)
+		: saisBWT<sais_size_type>(first, n);
 	// Insert the sentinel.
 	std::copy_backward(first + sentinel, last, last + 1);
 	first[sentinel] = SENTINEL();
 	return sentinel;
 }
 
-/** Set the specified element of the sampled suffix array. */
-void setSA(size_t sai, size_t pos)
-{
-	if (sai % m_sampleSA == 0) {
-		size_t i = sai / m_sampleSA;
-		assert(i < m_sa.size());
-		m_sa[i] = pos;
-	}
-}
-
-/** Construct the suffix array from the FM index. */
+/** Construct the suffix array from the FM index.
+ * The text is walked backward from its end by the LF mapping. To
+ * walk in parallel, the text is divided into segments at the
+ * occurrences of its rarest symbol, which is usually the separator
+ * of the sequences. A segment begins at the row of a suffix that
+ * starts with the separator and ends at the row of the preceding
+ * separator. Each sample records its offset in its segment until
+ * the segments are chained together and their positions are known.
+ * When the samples are at positions of the text, the segments are
+ * walked a second time once their positions are known.
+ */
 void constructSuffixArray()
 {
 	// The length of the original string.
@@ -147,15 +165,103 @@ void constructSuffixArray()
 	assert(n > 0);
 	assert(m_sampleSA > 0);
 	m_sa.resize(n / m_sampleSA + 1);
-	size_t sai = 0;
-	for (size_t i = n; i > 0; i--) {
-		setSA(sai, i);
-		T c = m_occ.at(sai);
-		assert(c != SENTINEL());
-		sai = m_cf[c] + m_occ.rank(c, sai);
-		assert(sai > 0);
+	m_marked = RankBitVector();
+
+	// Divide the text at the rarest symbol, unless the segments
+	// would use more memory than the samples.
+	T sep = SENTINEL();
+	for (unsigned c = 0; c < m_cf.size(); ++c) {
+		size_t count = m_occ.count(c);
+		if (count > 0 && count <= m_sa.size() / 2
+				&& count < std::numeric_limits<uint32_t>::max()
+				&& (sep == SENTINEL() || count < m_occ.count(sep)))
+			sep = c;
+	}
+
+	// Segment 0 begins at row 0, the suffix of the sentinel.
+	// Segment k > 0 begins at the k'th suffix that starts with sep.
+	ptrdiff_t numSegments = 1
+		+ (sep == SENTINEL() ? 0 : m_occ.count(sep));
+	size_t sepRow = sep == SENTINEL() ? 0 : m_cf[sep] - 1;
+
+	// Walk each segment and find the segment that precedes it.
+	std::vector<size_type> length(numSegments), prev(numSegments);
+	std::vector<uint32_t> segment(
+			m_samplePositions ? 0 : m_sa.size());
+#pragma omp parallel for schedule(dynamic)
+	for (ptrdiff_t k = 0; k < numSegments; ++k) {
+		size_t sai = k == 0 ? 0 : sepRow + k;
+		size_t offset = 0;
+		for (;;) {
+			if (!m_samplePositions && sai % m_sampleSA == 0) {
+				m_sa[sai / m_sampleSA] = offset;
+				segment[sai / m_sampleSA] = k;
+			}
+			T c = m_occ.at(sai);
+			if (c == SENTINEL()) {
+				prev[k] = 0;
+				break;
+			}
+			sai = m_cf[c] + m_occ.rank(c, sai);
+			offset++;
+			if (c == sep) {
+				prev[k] = sai - sepRow;
+				break;
+			}
+		}
+		length[k] = offset;
 	}
-	setSA(sai, 0);
+
+	// Chain the segments to find the position at which each begins.
+	std::vector<size_type>& pos = length;
+	size_t i = n;
+	for (ptrdiff_t k = 0;;) {
+		size_t len = length[k];
+		pos[k] = i;
+		i -= len;
+		if (prev[k] == 0)
+			break;
+		k = prev[k];
+	}
+	assert(i == 0);
+
+	ptrdiff_t numSamples = m_sa.size();
+	if (!m_samplePositions) {
+		// Convert the offsets of the samples to positions.
+#pragma omp parallel for
+		for (ptrdiff_t j = 0; j < numSamples; ++j)
+			m_sa[j] = pos[segment[j]] - m_sa[j];
+		return;
+	}
+
+	// Find the row of each sampled position.
+	std::vector<size_type>& rows = m_sa;
+#pragma omp parallel for schedule(dynamic)
+	for (ptrdiff_t k = 0; k < numSegments; ++k) {
+		size_t sai = k == 0 ? 0 : sepRow + k;
+		for (size_t i = pos[k];; i--) {
+			if (i % m_sampleSA == 0)
+				rows[i / m_sampleSA] = sai;
+			T c = m_occ.at(sai);
+			if (c == SENTINEL())
+				break;
+			sai = m_cf[c] + m_occ.rank(c, sai);
+			if (c == sep)
+				break;
+		}
+	}
+
+	// Mark the sampled rows and store their positions in the order
+	// of the rows.
+	m_marked.assign(n + 1);
+	for (ptrdiff_t j = 0; j < numSamples; ++j)
+		m_marked.set(rows[j]);
+	m_marked.build();
+	std::vector<size_type> sa(numSamples);
+#pragma omp parallel for
+	for (ptrdiff_t j = 0; j < numSamples; ++j)
+		sa[m_marked.rank(rows[j])] = j * m_sampleSA;
+	m_sa.swap(sa);
 }
 
 /** Build an FM-index of the specified BWT. */
@@ -167,6 +273,7 @@ void assignBWT(It first, It last)
 			< std::numeric_limits<size_type>::max());
 
 	std::cerr << "Building the character occurrence table...\n";
+	clearLookup();
 	m_occ.assign(first, last);
 	countOccurrences();
 
@@ -175,7 +282,11 @@ void assignBWT(It first, It last)
 	constructSuffixArray();
 }
 
-/** Build an FM-index of the specified data. */
+/** Build an FM-index of the specified data.
+ * The BWT is built first, and the suffix array is then sampled from
+ * the FM-index at the period set by sampleSA, so that the full
+ * suffix array is never stored.
+ */
 template<typename It>
 void assign(It first, It last)
 {
@@ -183,69 +294,120 @@ void assign(It first, It last)
 	assert(size_t(last - first)
 			< std::numeric_limits<size_type>::max());
 
-	encode(first, last);
-	std::replace(first, last, SENTINEL(), T(0));
-
-	// Construct the suffix array.
-	std::cerr << "Building the suffix array...\n";
-	size_t n = last - first;
-	m_sampleSA = 1;
-	m_sa.resize(n + 1);
-	m_sa[0] = n;
-
-	assert(sizeof (size_type) == sizeof (sais_size_type));
-	int status = saisxx(first,
-			reinterpret_cast<sais_size_type*>(&m_sa[1]),
-			(sais_size_type)n,
-			(sais_size_type)m_alphabet.size());
-	assert(status == 0);
-	if (status != 0)
-		abort();
-
-	// Construct the Burrows-Wheeler transform.
 	std::vector<T> bwt;
-	std::cerr << "Building the Burrows-Wheeler transform...\n";
-	bwt.resize(m_sa.size());
-	for (size_t i = 0; i < m_sa.size(); i++)
-		bwt[i] = m_sa[i] == 0 ? SENTINEL() : first[m_sa[i] - 1];
-
-	std::cerr << "Building the character occurrence table...\n";
-	m_occ.assign(bwt.begin(), bwt.end());
-	countOccurrences();
+	bwt.reserve(last - first + 1);
+	bwt.assign(first, last);
+	bwt.push_back(0);
+	buildBWT(bwt.begin(), bwt.end() - 1);
+	assignBWT(bwt.begin(), bwt.end());
 }
 
-/** Sample the suffix array. */
-void sampleSA(unsigned period)
+/** Sample the suffix array every period rows of the BWT or, when
+ * positions is true, every period positions of the text. Sampling by
+ * position uses an additional bit per row of the BWT, and bounds the
+ * number of steps of the LF mapping that locate a row to period - 1,
+ * rather than period on average.
+ *
+ * When called before the index is built, set the sampling of the
+ * index to be built. Otherwise resample the suffix array, which must
+ * be sampled at a divisor of period in the same manner, or must not
+ * be sampled.
+ */
+void sampleSA(unsigned period, bool positions)
 {
 	assert(period > 0);
-	if (period == m_sampleSA)
+	if (period == m_sampleSA && positions == m_samplePositions)
 		return;
-	assert(m_sampleSA == 1);
-	m_sampleSA = period;
-	if (m_sampleSA == 1 || m_sa.empty())
+	if (saSize() == 0) {
+		// The index is not yet built.
+		m_sampleSA = period;
+		m_samplePositions = positions;
 		return;
+	}
+	if (period % m_sampleSA != 0 || (m_sampleSA > 1
+				&& positions != m_samplePositions)) {
+		std::cerr << "error: the suffix array is sampled every "
+			<< m_sampleSA << (m_samplePositions ? " positions"
+					: " rows")
+			<< " and cannot be sampled every " << period
+			<< (positions ? " positions" : " rows") << ".\n";
+		exit(EXIT_FAILURE);
+	}
+	if (m_mappedSA != NULL) {
+		// Copy the memory mapped suffix array.
+		m_sa.assign(m_mappedSA, m_mappedSA + m_mappedSASize);
+		m_mappedSA = NULL;
+		m_mappedSASize = 0;
+	}
+
 	std::vector<size_type>::iterator out = m_sa.begin();
-	for (size_t i = 0; i < m_sa.size(); i += m_sampleSA)
-		*out++ = m_sa[i];
+	if (!positions) {
+		unsigned step = period / m_sampleSA;
+		for (size_t i = 0; i < m_sa.size(); i += step)
+			*out++ = m_sa[i];
+	} else {
+		// Mark the rows whose position is a multiple of period.
+		RankBitVector marked;
+		marked.assign(m_occ.size());
+		for (size_t i = 0; i < m_occ.size(); ++i) {
+			size_t j = i;
+			if (m_samplePositions) {
+				if (!m_marked.at(i))
+					continue;
+				j = m_marked.rank(i);
+			}
+			if (m_sa[j] % period == 0) {
+				marked.set(i);
+				*out++ = m_sa[j];
+			}
+		}
+		marked.build();
+		m_marked = marked;
+	}
 	m_sa.erase(out, m_sa.end());
 	assert(!m_sa.empty());
+	m_sampleSA = period;
+	m_samplePositions = positions;
+}
+
+/** Sample the suffix array in the same manner as it is sampled. */
+void sampleSA(unsigned period)
+{
+	sampleSA(period, m_samplePositions);
 }
 
+/** Return whether the suffix array is sampled at positions of the
+ * text rather than at rows of the BWT. */
+bool samplePositions() const { return m_samplePositions; }
+
 /** Return the specified element of the suffix array. */
 size_t at(size_t i) const
 {
 	assert(i < m_occ.size());
 	size_t n = 0;
-	while (i % m_sampleSA != 0) {
+	while (!isSampled(i)) {
 		T c = m_occ.at(i);
 		i = c == SENTINEL() ? 0 : m_cf[c] + m_occ.rank(c, i);
 		n++;
 	}
-	assert(i / m_sampleSA < m_sa.size());
-	size_t pos = m_sa[i / m_sampleSA] + n;
+	size_t pos = sampleAt(i) + n;
 	return pos < m_occ.size() ? pos : pos - m_occ.size();
 }
 
+/** Locate the rows of the specified interval, at most max of them,
+ * so that the cost of locating a repetitive match may be bounded.
+ * @return the end of the output range
+ */
+template <typename OutIt>
+OutIt locate(SAInterval sai, OutIt out,
+		size_t max = std::numeric_limits<size_t>::max()) const
+{
+	size_t u = sai.u - sai.l > max ? sai.l + max : sai.u;
+	for (size_t i = sai.l; i < u; ++i)
+		*out++ = at(i);
+	return out;
+}
+
 /** Return the specified element of the suffix array. */
 size_t operator[](size_t i) const
 {
@@ -326,12 +488,24 @@ SAInterval findExact(It first, It last, SAInterval sai) const
 	return sai;
 }
 
+/** Search for an exact match starting from the lookup table. */
+template <typename It>
+SAInterval findExact(It first, It last) const
+{
+	assert(first < last);
+	SAInterval sai(*this);
+	if (size_t(last - first) >= m_lookupLength
+			&& lookup(last, sai))
+		last -= m_lookupLength;
+	return first < last ? findExact(first, last, sai) : sai;
+}
+
 /** Search for an exact match. */
 template <typename String>
 SAInterval findExact(const String& q) const
 {
-	String s(q.size());
-	std::transform(q.begin(), q.end(), s.begin(), Translate(*this));
+	String s(q);
+	std::transform(s.begin(), s.end(), s.begin(), Translate(*this));
 	return findExact(s.begin(), s.end());
 }
 
@@ -403,8 +577,18 @@ Match findSuffix(It first, It last, MemoIt memoIt) const
 	assert(first < last);
 
 	SAInterval sai(*this);
-	It it;
-	for (it = last - 1; it >= first && !sai.empty(); --it) {
+	It it = last - 1;
+	if (size_t(last - first) >= m_lookupLength) {
+		// Skip the first steps of the search using the lookup table.
+		SAInterval sai1 = sai;
+		if (lookup(last, sai1) && !sai1.empty()) {
+			sai = sai1;
+			it -= m_lookupLength;
+			memoIt += m_lookupLength - 1;
+			*memoIt++ = sai;
+		}
+	}
+	for (; it >= first && !sai.empty(); --it) {
 		T c = *it;
 		if (c == SENTINEL())
 			break;
@@ -504,25 +688,61 @@ void setAlphabet(const std::string& s)
 	setAlphabet(s.begin(), s.end());
 }
 
+/** Build a table of the suffix array intervals of every string of
+ * length q of the alphabet excluding the separator symbol '\0'.
+ * A search of a query looks up the interval of its last q symbols
+ * rather than computing it one symbol at a time.
+ */
+void buildLookup(unsigned q)
+{
+	clearLookup();
+	unsigned sigma = m_alphabet.size() - 1;
+	if (q == 0 || sigma == 0)
+		return;
+	size_t n = 1;
+	for (unsigned i = 0; i < q; ++i) {
+		if (n > std::numeric_limits<size_t>::max() / sigma / 2) {
+			std::cerr << "error: the lookup table of "
+				<< q << "-mers is too large\n";
+			exit(EXIT_FAILURE);
+		}
+		n *= sigma;
+	}
+	m_lookupLength = q;
+	m_lookup.resize(2 * n);
+
+	// Extend the interval of each symbol to the left.
+#pragma omp parallel for schedule(dynamic)
+	for (int c = 1; c <= int(sigma); ++c)
+		buildLookup(update(SAInterval(*this), c), 1, c - 1, sigma);
+}
+
+/** Return the length of the strings of the lookup table. */
+unsigned lookupLength() const { return m_lookupLength; }
+
 #define STRINGIFY(X) #X
-#define FM_VERSION_BITS(BITS) "FM " STRINGIFY(BITS) " 1"
+#define FM_VERSION_BITS(BITS) "FM " STRINGIFY(BITS) " 5"
 #define FM_VERSION FM_VERSION_BITS(FMBITS)
 
-/** Store an index. */
+/** Store an index. The arrays are aligned to a cache line, so that
+ * the index file may be memory mapped by mapFile.
+ */
 friend std::ostream& operator<<(std::ostream& out, const FMIndex& o)
 {
-	out << FM_VERSION << '\n'
-		<< o.m_sampleSA << '\n';
-
-	out << o.m_alphabet.size() << '\n';
-	out.write(reinterpret_cast<const char*>(&o.m_alphabet[0]),
-			o.m_alphabet.size() * sizeof o.m_alphabet[0]);
-
-	out << o.m_sa.size() << '\n';
-	out.write(reinterpret_cast<const char*>(&o.m_sa[0]),
-		o.m_sa.size() * sizeof o.m_sa[0]);
-
-	return out << o.m_occ;
+	out << FM_VERSION << '\n';
+	size_t offset = sizeof FM_VERSION;
+
+	uint64_t header[5] = { o.m_sampleSA, o.m_alphabet.size(),
+		o.saSize(), o.m_lookupLength, o.m_samplePositions };
+	writeAligned(out, header, sizeof header, offset);
+	writeAligned(out, &o.m_alphabet[0],
+			o.m_alphabet.size() * sizeof o.m_alphabet[0], offset);
+	writeAligned(out, o.sa(), o.saSize() * sizeof *o.sa(), offset);
+	o.m_marked.write(out, offset);
+	writeAligned(out, o.lookupTable(),
+			o.lookupTableSize() * sizeof *o.lookupTable(), offset);
+	o.m_occ.write(out, offset);
+	return out;
 }
 
 /** Load an index. */
@@ -531,40 +751,225 @@ friend std::istream& operator>>(std::istream& in, FMIndex& o)
 	std::string version;
 	std::getline(in, version);
 	assert(in);
+	checkVersion(version);
+	size_t offset = version.size() + 1;
+
+	uint64_t header[5];
+	readAligned(in, header, sizeof header, offset);
+	assert(in);
+	o.m_sampleSA = header[0];
+	assert(header[1] < std::numeric_limits<size_type>::max());
+	o.m_alphabet.resize(header[1]);
+	readAligned(in, &o.m_alphabet[0],
+			o.m_alphabet.size() * sizeof o.m_alphabet[0], offset);
+	o.setAlphabet(o.m_alphabet.begin(), o.m_alphabet.end());
+
+	assert(header[2] < std::numeric_limits<size_type>::max());
+	o.m_file.reset();
+	o.m_mappedSA = NULL;
+	o.m_mappedSASize = 0;
+	o.m_sa.resize(header[2]);
+	readAligned(in, &o.m_sa[0], o.m_sa.size() * sizeof o.m_sa[0],
+			offset);
+	o.m_samplePositions = header[4];
+	o.m_marked.read(in, offset);
+
+	o.clearLookup();
+	o.m_lookupLength = header[3];
+	o.m_lookup.resize(o.lookupTableSize());
+	readAligned(in, o.m_lookup.empty() ? NULL : &o.m_lookup[0],
+			o.m_lookup.size() * sizeof o.m_lookup[0], offset);
+
+	o.m_occ.read(in, offset);
+	assert(in);
+	o.countOccurrences();
+	return in;
+}
+
+/** Memory map the specified index file and use it in place, rather
+ * than reading it into memory. Processes that map the same index
+ * file share its pages.
+ */
+void mapFile(const std::string& path)
+{
+	m_file.reset(new MappedFile(path));
+	const char* base = m_file->data();
+	size_t size = m_file->size();
+	const char* eol = size == 0 ? NULL : static_cast<const char*>(
+			memchr(base, '\n', std::min(size, INDEX_ALIGN)));
+	checkVersion(eol == NULL ? std::string()
+			: std::string(base, eol));
+	size_t offset = eol - base + 1;
+
+	uint64_t header[5];
+	memcpy(header, mapAligned(base, size, sizeof header, offset),
+			sizeof header);
+	m_sampleSA = header[0];
+	const char* p = mapAligned(base, size, header[1], offset);
+	m_alphabet.assign(p, p + header[1]);
+	setAlphabet(m_alphabet.begin(), m_alphabet.end());
+
+	m_sa.clear();
+	m_mappedSASize = header[2];
+	m_mappedSA = reinterpret_cast<const size_type*>(mapAligned(
+				base, size, m_mappedSASize * sizeof (size_type),
+				offset));
+	m_samplePositions = header[4];
+	m_marked.attach(base, size, offset);
+
+	clearLookup();
+	m_lookupLength = header[3];
+	m_mappedLookup = reinterpret_cast<const size_type*>(mapAligned(
+				base, size, lookupTableSize() * sizeof (size_type),
+				offset));
+
+	m_occ.attach(base, size, offset);
+	countOccurrences();
+}
+
+private:
+
+/** Build the BWT of [first, first + n) in place using a temporary
+ * suffix array of the specified index type.
+ * @return the position of the sentinel
+ */
+template<typename Index, typename It>
+size_t saisBWT(It first, size_t n) const
+{
+	std::vector<Index> sa(n);
+	Index sentinel = saisxx_bwt(first, first, &sa[0],
+			(Index)n, (Index)m_alphabet.size());
+	assert(sentinel >= 0);
+	if (sentinel < 0)
+		abort();
+	return sentinel;
+}
+
+/** Build the BWT of [first, first + n) in blocks of suffixes, and
+ * store the BWT including the sentinel in [first, first + n].
+ * @return the position of the sentinel
+ */
+template<typename Index, typename It>
+size_t blockwiseBWT(It first, size_t n) const
+{
+	std::vector<T> bwt(n + 1);
+	size_t sentinel;
+	{
+		BlockwiseBWT<T, Index> sorter(&first[0], n, m_alphabet.size());
+		sentinel = sorter.bwt(bwt.begin(), m_blockSize, SENTINEL());
+	}
+	std::copy(bwt.begin(), bwt.end(), first);
+	return sentinel;
+}
+
+/** Exit with an error if the version of an index file does not
+ * match the version of this program. */
+static void checkVersion(const std::string& version)
+{
 	if (version != FM_VERSION) {
 		std::cerr << "error: the version of this FM-index, `"
 			<< version << "', does not match the version required "
 			"by this program, `" FM_VERSION "'.\n";
 		exit(EXIT_FAILURE);
 	}
+}
 
-	in >> o.m_sampleSA;
-	assert(in);
+/** Fill the lookup table with the intervals of the strings that end
+ * with the suffix of the specified interval, length and code.
+ * @param stride the difference between the codes of two strings
+ * that differ by one in the symbol preceding the suffix
+ */
+void buildLookup(SAInterval sai, unsigned length, size_t code,
+		size_t stride)
+{
+	if (sai.empty())
+		return;
+	if (length == m_lookupLength) {
+		m_lookup[2 * code] = sai.l;
+		m_lookup[2 * code + 1] = sai.u;
+		return;
+	}
+	unsigned sigma = m_alphabet.size() - 1;
+	for (unsigned c = 1; c <= sigma; ++c)
+		buildLookup(update(sai, c), length + 1,
+				code + (c - 1) * stride, stride * sigma);
+}
 
-	size_t n;
-	in >> n >> expect("\n");
-	assert(in);
-	assert(n < std::numeric_limits<size_type>::max());
-	o.m_alphabet.resize(n);
-	in.read(reinterpret_cast<char*>(&o.m_alphabet[0]),
-			n * sizeof o.m_alphabet[0]);
-	o.setAlphabet(o.m_alphabet.begin(), o.m_alphabet.end());
+/** Look up the interval of the string of length m_lookupLength that
+ * ends at last.
+ * @return false if there is no lookup table or if the string
+ * contains a symbol that is not in the table
+ */
+template <typename It>
+bool lookup(It last, SAInterval& sai) const
+{
+	if (m_lookupLength == 0)
+		return false;
+	unsigned sigma = m_alphabet.size() - 1;
+	size_t code = 0;
+	for (It it = last - m_lookupLength; it != last; ++it) {
+		T c = *it;
+		if (c == 0 || c > sigma)
+			return false;
+		code = code * sigma + c - 1;
+	}
+	const size_type* p = lookupTable() + 2 * code;
+	sai = SAInterval(p[0], p[1]);
+	return true;
+}
 
-	in >> n >> expect("\n");
-	assert(in);
-	assert(n < std::numeric_limits<size_type>::max());
-	o.m_sa.resize(n);
-	in.read(reinterpret_cast<char*>(&o.m_sa[0]),
-			n * sizeof o.m_sa[0]);
+/** Remove the lookup table. */
+void clearLookup()
+{
+	m_lookupLength = 0;
+	m_lookup.clear();
+	m_mappedLookup = NULL;
+}
 
-	in >> o.m_occ;
-	assert(in);
-	o.countOccurrences();
+/** Return the lookup table. */
+const size_type* lookupTable() const
+{
+	return m_mappedLookup != NULL ? m_mappedLookup
+		: m_lookup.empty() ? NULL : &m_lookup[0];
+}
 
-	return in;
+/** Return the number of elements of the lookup table. */
+size_t lookupTableSize() const
+{
+	if (m_lookupLength == 0)
+		return 0;
+	size_t n = 2;
+	for (unsigned i = 0; i < m_lookupLength; ++i)
+		n *= m_alphabet.size() - 1;
+	return n;
 }
 
-private:
+/** Return whether the position of the specified row is sampled. */
+bool isSampled(size_t i) const
+{
+	return m_samplePositions ? m_marked.at(i) : i % m_sampleSA == 0;
+}
+
+/** Return the sampled position of the specified row. */
+size_t sampleAt(size_t i) const
+{
+	assert(isSampled(i));
+	size_t j = m_samplePositions ? m_marked.rank(i) : i / m_sampleSA;
+	assert(j < saSize());
+	return sa()[j];
+}
+
+/** Return the sampled suffix array. */
+const size_type* sa() const
+{
+	return m_mappedSA != NULL ? m_mappedSA : &m_sa[0];
+}
+
+/** Return the size of the sampled suffix array. */
+size_t saSize() const
+{
+	return m_mappedSA != NULL ? m_mappedSASize : m_sa.size();
+}
 
 /** Build the cumulative frequency table m_cf from m_occ. */
 void countOccurrences()
@@ -578,11 +983,40 @@ void countOccurrences()
 }
 
 	unsigned m_sampleSA;
+
+	/** Whether the suffix array is sampled at positions of the text
+	 * rather than at rows of the BWT */
+	bool m_samplePositions;
+
+	/** The number of suffixes of a block of the construction of the
+	 * BWT, or zero for a single block */
+	size_t m_blockSize;
+
+	/** The rows of the BWT whose positions are sampled, when the
+	 * suffix array is sampled at positions of the text */
+	RankBitVector m_marked;
 	std::vector<T> m_alphabet;
 	std::vector<T> m_mapping;
 	std::vector<size_type> m_cf;
 	std::vector<size_type> m_sa;
-	BitArrays m_occ;
+	OccTable m_occ;
+
+	/** The memory mapped index file */
+	boost::shared_ptr<MappedFile> m_file;
+
+	/** The suffix array of the memory mapped index file */
+	const size_type* m_mappedSA;
+	size_t m_mappedSASize;
+
+	/** The length of the strings of the lookup table */
+	unsigned m_lookupLength;
+
+	/** The lower and upper bounds of the suffix array interval of
+	 * each string of length m_lookupLength */
+	std::vector<size_type> m_lookup;
+
+	/** The lookup table of the memory mapped index file */
+	const size_type* m_mappedLookup;
 };
 
 #endif
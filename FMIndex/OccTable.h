@@ -0,0 +1,446 @@
+#ifndef OCCTABLE_H
+#define OCCTABLE_H 1
+
+#include "AlignedIO.h"
+#include "BitUtil.h" // for popcount
+#include <algorithm>
+#include <cassert>
+#include <cstddef> // for ptrdiff_t
+#include <cstring> // for memcpy
+#include <istream>
+#include <limits> // for numeric_limits
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * A character occurrence table of a string of symbols from a small
+ * alphabet, such as the Burrows-Wheeler transform of DNA.
+ *
+ * The string is divided into blocks, each of which occupies one
+ * cache line. A block stores the counts of the symbols preceding
+ * the block followed by the symbols of the block, which are
+ * bit-sliced into planes of 64 bits: bit t of the code of the symbol
+ * at position j is bit j of plane t. The rank of a symbol is the
+ * count stored in its block plus the popcount of the positions of
+ * the block whose code matches the symbol, so that a rank query
+ * touches a single cache line.
+ *
+ * The counts of a block are 32 bits wide and are relative to a
+ * superblock of 2^31 positions, whose absolute counts are stored in a
+ * small separate table. The count of the last symbol of the alphabet
+ * is not stored and is derived from the counts of the other symbols.
+ *
+ * The blocks are either owned by the table or are part of a memory
+ * mapped index file.
+ */
+class OccTable
+{
+	/** A symbol. */
+	typedef uint8_t T;
+
+	/** The sentinel symbol. */
+	static T SENTINEL() { return std::numeric_limits<T>::max(); }
+
+	/** The number of 64-bit words of a block. */
+	static const unsigned BLOCK_WORDS = 8;
+
+	/** The number of bits of the index of a superblock. */
+	static const unsigned SUPER_BITS = 31;
+
+	/** The base-2 logarithm of the number of blocks of a chunk,
+	 * which is constructed by one thread. */
+	static const unsigned CHUNK_BITS = 12;
+
+  public:
+
+OccTable() : m_size(0), m_sigma(0), m_sentinel(0),
+	m_bits(0), m_countWords(0), m_planes(0), m_stride(0),
+	m_blockShift(0), m_blocks(NULL) { }
+
+OccTable(const OccTable& o) { *this = o; }
+
+/** Copy the blocks, which are aligned to a cache line. */
+OccTable& operator=(const OccTable& o)
+{
+	if (this == &o)
+		return *this;
+	m_size = o.m_size;
+	m_sigma = o.m_sigma;
+	m_sentinel = o.m_sentinel;
+	m_bits = o.m_bits;
+	m_countWords = o.m_countWords;
+	m_planes = o.m_planes;
+	m_stride = o.m_stride;
+	m_blockShift = o.m_blockShift;
+	m_counts = o.m_counts;
+	m_super = o.m_super;
+	if (o.m_data.empty()) {
+		// The blocks are memory mapped.
+		m_data.clear();
+		m_blocks = o.m_blocks;
+	} else {
+		allocate();
+		std::copy(o.m_blocks, o.m_blocks + numBlocks() * m_stride,
+				block(0));
+	}
+	return *this;
+}
+
+/** Count the occurrences of the symbols of [first, last).
+ * The string is divided into chunks of blocks, which are stored in
+ * parallel. The counts of the chunks are then summed, and the counts
+ * of the blocks are computed in parallel from the stored symbols.
+ */
+template<typename It>
+void assign(It first, It last)
+{
+	assert(first < last);
+	const ptrdiff_t n = last - first;
+
+	// Determine the size of the alphabet ignoring the sentinel.
+	T sigma = 0;
+#pragma omp parallel
+	{
+		T x = 0;
+#pragma omp for nowait
+		for (ptrdiff_t i = 0; i < n; ++i)
+			if (first[i] != SENTINEL())
+				x = std::max(x, first[i]);
+#pragma omp critical(sigma)
+		sigma = std::max(sigma, x);
+	}
+	sigma++;
+	assert(sigma < SENTINEL());
+	setAlphabetSize(sigma, n);
+
+	m_sentinel = m_size;
+	allocate();
+
+	// Store the symbols and count the symbols of each chunk.
+	const unsigned chunkShift = std::min(m_blockShift + CHUNK_BITS,
+			unsigned(SUPER_BITS));
+	const ptrdiff_t numChunks = (m_size >> chunkShift) + 1;
+	std::vector<size_t> chunkCounts(numChunks * m_sigma);
+#pragma omp parallel for schedule(dynamic)
+	for (ptrdiff_t chunk = 0; chunk < numChunks; ++chunk) {
+		size_t* counts = &chunkCounts[chunk * m_sigma];
+		ptrdiff_t end = std::min(n, (chunk + 1) << chunkShift);
+		for (ptrdiff_t i = chunk << chunkShift; i < end; ++i) {
+			T c = first[i];
+			if (c == SENTINEL()) {
+				m_sentinel = i;
+				c = m_sigma;
+			} else {
+				assert(c < m_sigma);
+				counts[c]++;
+			}
+			uint64_t* p = block(i >> m_blockShift)
+				+ m_countWords + (i % blockSize() / 64) * m_bits;
+			for (unsigned t = 0; t < m_bits; ++t)
+				if (c & 1 << t)
+					p[t] |= uint64_t(1) << i % 64;
+		}
+	}
+
+	// Replace the counts of each chunk by the counts preceding it.
+	m_counts.assign(m_sigma, 0);
+	m_super.assign(((m_size >> SUPER_BITS) + 1) * m_sigma, 0);
+	for (ptrdiff_t chunk = 0; chunk < numChunks; ++chunk) {
+		size_t* counts = &chunkCounts[chunk * m_sigma];
+		size_t i = size_t(chunk) << chunkShift;
+		if (i % (size_t(1) << SUPER_BITS) == 0)
+			std::copy(m_counts.begin(), m_counts.end(),
+					&m_super[(i >> SUPER_BITS) * m_sigma]);
+		for (unsigned c = 0; c < m_sigma; ++c)
+			std::swap(counts[c], m_counts[c]);
+		for (unsigned c = 0; c < m_sigma; ++c)
+			m_counts[c] += counts[c];
+	}
+
+	// Store the counts of each block.
+#pragma omp parallel for schedule(dynamic)
+	for (ptrdiff_t chunk = 0; chunk < numChunks; ++chunk) {
+		std::vector<size_t> counts(&chunkCounts[chunk * m_sigma],
+				&chunkCounts[(chunk + 1) * m_sigma]);
+		size_t b = size_t(chunk) << (chunkShift - m_blockShift);
+		size_t end = std::min(numBlocks(),
+				size_t(chunk + 1) << (chunkShift - m_blockShift));
+		for (; b < end; ++b) {
+			setCounts(b << m_blockShift, counts);
+			const uint64_t* plane = block(b) + m_countWords;
+			for (unsigned j = 0; j < m_planes; ++j, plane += m_bits)
+				for (unsigned c = 0; c < m_sigma; ++c)
+					counts[c] += popcount(match(plane, c));
+		}
+	}
+}
+
+/** Return the size of the string. */
+size_t size() const { return m_size; }
+
+/** Return the number of occurrences of the specified symbol. */
+size_t count(T c) const
+{
+	return c < m_sigma ? m_counts[c] : 0;
+}
+
+/** Return the count of symbol c in s[0, i). */
+size_t rank(T c, size_t i) const
+{
+	assert(i <= m_size);
+	if (c >= m_sigma)
+		return 0;
+	size_t b = i >> m_blockShift;
+	const uint64_t* p = block(b);
+	size_t n = blockCount(p, b, c);
+	const uint64_t* plane = p + m_countWords;
+	unsigned j = i % blockSize() / 64;
+	for (unsigned sub = 0; sub < j; ++sub, plane += m_bits)
+		n += popcount(match(plane, c));
+	unsigned offset = i % 64;
+	if (offset > 0)
+		n += popcount(match(plane, c)
+				& ((uint64_t(1) << offset) - 1));
+	return n;
+}
+
+/** Return the symbol at the specified position. */
+T at(size_t i) const
+{
+	assert(i < m_size);
+	const uint64_t* p = block(i >> m_blockShift)
+		+ m_countWords + (i % blockSize() / 64) * m_bits;
+	unsigned offset = i % 64;
+	T c = 0;
+	for (unsigned t = 0; t < m_bits; ++t)
+		c |= (p[t] >> offset & 1) << t;
+	return c == m_sigma ? SENTINEL() : c;
+}
+
+/** Store this data structure. Each array is aligned to a cache
+ * line relative to the start of the stream.
+ * @param offset the offset of the stream, which is updated
+ */
+void write(std::ostream& out, size_t& offset) const
+{
+	uint64_t header[3] = { m_size, m_sigma, m_sentinel };
+	writeAligned(out, header, sizeof header, offset);
+	writeAligned(out, &m_counts[0],
+			m_counts.size() * sizeof m_counts[0], offset);
+	writeAligned(out, &m_super[0],
+			m_super.size() * sizeof m_super[0], offset);
+	writeAligned(out, m_blocks,
+			numBlocks() * m_stride * sizeof (uint64_t), offset);
+}
+
+/** Load this data structure.
+ * @param offset the offset of the stream, which is updated
+ */
+void read(std::istream& in, size_t& offset)
+{
+	uint64_t header[3];
+	readAligned(in, header, sizeof header, offset);
+	if (!in)
+		return;
+	setHeader(header);
+	allocate();
+	readAligned(in, &m_counts[0],
+			m_counts.size() * sizeof m_counts[0], offset);
+	readAligned(in, &m_super[0],
+			m_super.size() * sizeof m_super[0], offset);
+	readAligned(in, block(0),
+			numBlocks() * m_stride * sizeof (uint64_t), offset);
+}
+
+/** Use the blocks of a memory mapped index file in place.
+ * @param offset the offset in the file, which is updated
+ * @param size the size of the file
+ */
+void attach(const char* base, size_t size, size_t& offset)
+{
+	uint64_t header[3];
+	memcpy(header, mapAligned(base, size, sizeof header, offset),
+			sizeof header);
+	setHeader(header);
+	size_t n = m_counts.size() * sizeof m_counts[0];
+	memcpy(&m_counts[0], mapAligned(base, size, n, offset), n);
+	n = m_super.size() * sizeof m_super[0];
+	memcpy(&m_super[0], mapAligned(base, size, n, offset), n);
+	std::vector<uint64_t>().swap(m_data);
+	m_blocks = reinterpret_cast<const uint64_t*>(mapAligned(base, size,
+				numBlocks() * m_stride * sizeof (uint64_t), offset));
+}
+
+/** Store this data structure. */
+friend std::ostream& operator<<(std::ostream& out, const OccTable& o)
+{
+	size_t offset = 0;
+	o.write(out, offset);
+	return out;
+}
+
+/** Load this data structure. */
+friend std::istream& operator>>(std::istream& in, OccTable& o)
+{
+	size_t offset = 0;
+	o.read(in, offset);
+	return in;
+}
+
+  private:
+
+/** Set the size of the alphabet and the layout of a block. */
+void setAlphabetSize(unsigned sigma, size_t size)
+{
+	m_size = size;
+	m_sigma = sigma;
+
+	// The code m_sigma represents the sentinel.
+	m_bits = 1;
+	while (m_sigma >> m_bits != 0)
+		m_bits++;
+
+	// The 32-bit count of the last symbol is not stored.
+	m_countWords = m_sigma / 2;
+
+	// Use as many planes of 64 positions as fit in one cache line,
+	// rounded down to a power of two.
+	m_planes = 1;
+	if (m_countWords + m_bits <= BLOCK_WORDS) {
+		while (m_countWords + 2 * m_planes * m_bits <= BLOCK_WORDS)
+			m_planes *= 2;
+		m_stride = BLOCK_WORDS;
+	} else
+		m_stride = m_countWords + m_bits;
+
+	m_blockShift = 6;
+	for (unsigned x = m_planes; x > 1; x /= 2)
+		m_blockShift++;
+}
+
+/** Return the number of positions of a block. */
+size_t blockSize() const { return size_t(1) << m_blockShift; }
+
+/** Return the number of blocks. Position m_size, which is queried
+ * by rank, may begin a block. */
+size_t numBlocks() const { return (m_size >> m_blockShift) + 1; }
+
+/** Set the size of the string and of the alphabet from a stored
+ * header. */
+void setHeader(const uint64_t header[3])
+{
+	assert(header[1] > 0);
+	assert(header[1] < SENTINEL());
+	setAlphabetSize(header[1], header[0]);
+	m_sentinel = header[2];
+	m_counts.resize(m_sigma);
+	m_super.resize(((m_size >> SUPER_BITS) + 1) * m_sigma);
+}
+
+/** Allocate zeroed blocks, the first of which is aligned to a
+ * cache line. */
+void allocate()
+{
+	m_data.assign(numBlocks() * m_stride + BLOCK_WORDS - 1, 0);
+	uintptr_t p = reinterpret_cast<uintptr_t>(&m_data[0]);
+	const uintptr_t mask = BLOCK_WORDS * sizeof (uint64_t) - 1;
+	m_blocks = reinterpret_cast<const uint64_t*>((p + mask) & ~mask);
+}
+
+/** Return the specified block. */
+const uint64_t* block(size_t b) const
+{
+	assert(b < numBlocks());
+	return m_blocks + b * m_stride;
+}
+
+/** Return the specified block, which is owned by this table. */
+uint64_t* block(size_t b)
+{
+	assert(b < numBlocks());
+	assert(!m_data.empty());
+	return const_cast<uint64_t*>(m_blocks) + b * m_stride;
+}
+
+/** Store the counts of the symbols preceding position i, which
+ * begins a block. The counts of its superblock are already stored.
+ */
+void setCounts(size_t i, const std::vector<size_t>& counts)
+{
+	const size_t* super = &m_super[(i >> SUPER_BITS) * m_sigma];
+	uint32_t* p = reinterpret_cast<uint32_t*>(
+			block(i >> m_blockShift));
+	for (unsigned c = 0; c < m_sigma - 1u; ++c)
+		p[c] = counts[c] - super[c];
+}
+
+/** Return the count of symbol c preceding block b. */
+size_t blockCount(const uint64_t* p, size_t b, T c) const
+{
+	size_t start = b << m_blockShift;
+	const size_t* super = &m_super[(start >> SUPER_BITS) * m_sigma];
+	const uint32_t* counts = reinterpret_cast<const uint32_t*>(p);
+	if (c < m_sigma - 1u)
+		return super[c] + counts[c];
+
+	// Derive the count of the last symbol.
+	size_t n = start - (start >> SUPER_BITS << SUPER_BITS);
+	for (unsigned i = 0; i < m_sigma - 1u; ++i)
+		n -= counts[i];
+	if (m_sentinel < start
+			&& m_sentinel >= start >> SUPER_BITS << SUPER_BITS)
+		n--;
+	return super[c] + n;
+}
+
+/** Return a mask of the positions of a plane of 64 positions
+ * whose symbol is c. */
+uint64_t match(const uint64_t* plane, T c) const
+{
+	// Invert the planes of the zero bits of c.
+	uint64_t x = ~uint64_t(0);
+	for (unsigned t = 0; t < m_bits; ++t)
+		x &= plane[t] ^ (uint64_t(c >> t & 1) - 1);
+	return x;
+}
+
+	/** The length of the string */
+	size_t m_size;
+
+	/** The size of the alphabet */
+	unsigned m_sigma;
+
+	/** The position of the sentinel */
+	size_t m_sentinel;
+
+	/** The number of bits of the code of a symbol */
+	unsigned m_bits;
+
+	/** The number of words of the counts of a block */
+	unsigned m_countWords;
+
+	/** The number of planes of 64 positions of a block */
+	unsigned m_planes;
+
+	/** The number of words of a block */
+	unsigned m_stride;
+
+	/** The base-2 logarithm of the number of positions of a block */
+	unsigned m_blockShift;
+
+	/** The number of occurrences of each symbol */
+	std::vector<size_t> m_counts;
+
+	/** The absolute counts of each superblock */
+	std::vector<size_t> m_super;
+
+	/** The first block, which is aligned to a cache line */
+	const uint64_t* m_blocks;
+
+	/** The storage of the blocks, which is empty when the blocks
+	 * are memory mapped */
+	std::vector<uint64_t> m_data;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef RANKBITVECTOR_H
+#define RANKBITVECTOR_H 1
+
+#include "AlignedIO.h"
+#include "BitUtil.h" // for popcount
+#include <algorithm>
+#include <cassert>
+#include <cstring> // for memcpy
+#include <istream>
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * A bit vector that counts the set bits preceding a position.
+ *
+ * The bits are divided into blocks, each of which occupies one cache
+ * line. A block stores the number of set bits preceding the block
+ * followed by seven words of bits, so that a rank query touches a
+ * single cache line.
+ *
+ * The blocks are either owned by the vector or are part of a memory
+ * mapped index file.
+ */
+class RankBitVector
+{
+	/** The number of 64-bit words of a block. */
+	static const unsigned BLOCK_WORDS = 8;
+
+	/** The number of bits of a block. */
+	static const unsigned BLOCK_BITS = 64 * (BLOCK_WORDS - 1);
+
+  public:
+
+RankBitVector() : m_size(0), m_blocks(NULL) { allocate(); }
+
+RankBitVector(const RankBitVector& o) : m_blocks(NULL) { *this = o; }
+
+/** Copy the blocks, which are aligned to a cache line. */
+RankBitVector& operator=(const RankBitVector& o)
+{
+	if (this == &o)
+		return *this;
+	m_size = o.m_size;
+	if (o.m_data.empty()) {
+		// The blocks are memory mapped.
+		m_data.clear();
+		m_blocks = o.m_blocks;
+	} else {
+		allocate();
+		std::copy(o.m_blocks, o.m_blocks + numBlocks() * BLOCK_WORDS,
+				block(0));
+	}
+	return *this;
+}
+
+/** Clear the vector and resize it to n unset bits. */
+void assign(size_t n)
+{
+	m_size = n;
+	allocate();
+}
+
+/** Set the specified bit. Call build once all the bits are set. */
+void set(size_t i)
+{
+	assert(i < m_size);
+	block(0)[wordIndex(i)] |= uint64_t(1) << i % 64;
+}
+
+/** Count the set bits preceding each block. */
+void build()
+{
+	uint64_t count = 0;
+	for (size_t b = 0; b < numBlocks(); ++b) {
+		uint64_t* p = block(b);
+		p[0] = count;
+		for (unsigned j = 1; j < BLOCK_WORDS; ++j)
+			count += popcount(p[j]);
+	}
+}
+
+/** Return the number of bits. */
+size_t size() const { return m_size; }
+
+/** Return the specified bit. */
+bool at(size_t i) const
+{
+	assert(i < m_size);
+	return m_blocks[wordIndex(i)] >> i % 64 & 1;
+}
+
+/** Return the number of set bits in [0, i). */
+size_t rank(size_t i) const
+{
+	assert(i <= m_size);
+	const uint64_t* p = m_blocks + i / BLOCK_BITS * BLOCK_WORDS;
+	unsigned j = i % BLOCK_BITS;
+	size_t count = p[0];
+	for (unsigned k = 1; k <= j / 64; ++k)
+		count += popcount(p[k]);
+	if (j % 64 > 0)
+		count += popcount(p[j / 64 + 1]
+				& ((uint64_t(1) << j % 64) - 1));
+	return count;
+}
+
+/** Store this data structure.
+ * @param offset the offset of the stream, which is updated
+ */
+void write(std::ostream& out, size_t& offset) const
+{
+	uint64_t header = m_size;
+	writeAligned(out, &header, sizeof header, offset);
+	writeAligned(out, m_blocks,
+			numBlocks() * BLOCK_WORDS * sizeof (uint64_t), offset);
+}
+
+/** Load this data structure.
+ * @param offset the offset of the stream, which is updated
+ */
+void read(std::istream& in, size_t& offset)
+{
+	uint64_t header;
+	readAligned(in, &header, sizeof header, offset);
+	if (!in)
+		return;
+	assign(header);
+	readAligned(in, block(0),
+			numBlocks() * BLOCK_WORDS * sizeof (uint64_t), offset);
+}
+
+/** Use the blocks of a memory mapped index file in place.
+ * @param offset the offset in the file, which is updated
+ * @param size the size of the file
+ */
+void attach(const char* base, size_t size, size_t& offset)
+{
+	uint64_t header;
+	memcpy(&header, mapAligned(base, size, sizeof header, offset),
+			sizeof header);
+	m_size = header;
+	std::vector<uint64_t>().swap(m_data);
+	m_blocks = reinterpret_cast<const uint64_t*>(mapAligned(base, size,
+				numBlocks() * BLOCK_WORDS * sizeof (uint64_t), offset));
+}
+
+  private:
+
+/** Return the number of blocks, including a block for the rank of
+ * the end of the vector. */
+size_t numBlocks() const { return m_size / BLOCK_BITS + 1; }
+
+/** Return the index of the word of the specified bit. */
+static size_t wordIndex(size_t i)
+{
+	return i / BLOCK_BITS * BLOCK_WORDS + i % BLOCK_BITS / 64 + 1;
+}
+
+/** Allocate zeroed blocks, the first of which is aligned to a
+ * cache line. */
+void allocate()
+{
+	m_data.assign((numBlocks() + 1) * BLOCK_WORDS - 1, 0);
+	uintptr_t p = reinterpret_cast<uintptr_t>(&m_data[0]);
+	const uintptr_t mask = BLOCK_WORDS * sizeof (uint64_t) - 1;
+	m_blocks = reinterpret_cast<const uint64_t*>((p + mask) & ~mask);
+}
+
+/** Return the specified block, which is owned by this vector. */
+uint64_t* block(size_t b)
+{
+	assert(b < numBlocks());
+	assert(!m_data.empty());
+	return const_cast<uint64_t*>(m_blocks) + b * BLOCK_WORDS;
+}
+
+	/** The number of bits */
+	size_t m_size;
+
+	/** The first block, which is aligned to a cache line */
+	const uint64_t* m_blocks;
+
+	/** The storage of the blocks, which is empty when the blocks
+	 * are memory mapped */
+	std::vector<uint64_t> m_data;
+};
+
+#endif
@@ -0,0 +1,373 @@
+#ifndef ARENA_GRAPH_H
+#define ARENA_GRAPH_H
+
+#include "Common/OpenHashMap.h"
+#include <boost/graph/graph_traits.hpp>
+#include <cassert>
+#include <iterator>
+#include <climits>
+#include <vector>
+
+/**
+ * A directed graph whose vertices are stored in an open-addressing
+ * hash table and whose adjacency lists are stored in a single
+ * array of edges. Clearing the graph retains its storage, so that
+ * a graph may be reused for many small searches, such as the
+ * traversal histories of a bidirectional BFS, without allocating
+ * memory once it has grown to its working size.
+ */
+template <class VertexType>
+class ArenaGraph
+{
+public:
+
+	typedef ArenaGraph<VertexType> Graph;
+	typedef boost::graph_traits<Graph> GraphTraits;
+	typedef typename GraphTraits::vertex_descriptor vertex_descriptor;
+	typedef typename GraphTraits::edge_descriptor edge_descriptor;
+	typedef typename GraphTraits::out_edge_iterator out_edge_iterator;
+	typedef typename GraphTraits::adjacency_iterator adjacency_iterator;
+	typedef typename GraphTraits::degree_size_type degree_size_type;
+	typedef typename GraphTraits::vertex_iterator vertex_iterator;
+	typedef typename GraphTraits::vertices_size_type vertices_size_type;
+
+	/** The index of a nonexistent edge. */
+	static const unsigned NIL = UINT_MAX;
+
+	/** The first and last out-edges of a vertex. */
+	struct EdgeList {
+		unsigned first;
+		unsigned last;
+		degree_size_type size;
+		EdgeList() : first(NIL), last(NIL), size(0) { }
+	};
+
+	/** An out-edge and the index of the next out-edge of the same
+	 * vertex. */
+	struct Edge {
+		vertex_descriptor target;
+		unsigned next;
+		Edge(const vertex_descriptor& v) : target(v), next(NIL) { }
+	};
+
+	typedef OpenHashMap<vertex_descriptor, EdgeList> VertexMap;
+	typedef typename VertexMap::const_iterator VertexMapIterator;
+
+	ArenaGraph() { }
+
+	/** Remove all vertices and edges without releasing storage. */
+	void clear()
+	{
+		m_vertices.clear();
+		m_edges.clear();
+	}
+
+	size_t approxMemSize() const
+	{
+		return m_vertices.approxMemSize()
+			+ m_edges.size() * sizeof (Edge);
+	}
+
+	std::pair<VertexMapIterator, VertexMapIterator>
+	get_vertex_map_entries() const
+	{
+		return std::make_pair(m_vertices.begin(), m_vertices.end());
+	}
+
+	vertices_size_type num_vertices() const
+	{
+		return m_vertices.size();
+	}
+
+	/** Return the index of the first out-edge of v. */
+	unsigned first_edge(const vertex_descriptor& v) const
+	{
+		const EdgeList* p = m_vertices.find(v);
+		return p == NULL ? NIL : p->first;
+	}
+
+	/** Return the out-edge with the specified index. */
+	const Edge& get_edge(unsigned i) const
+	{
+		assert(i < m_edges.size());
+		return m_edges[i];
+	}
+
+	degree_size_type out_degree(const vertex_descriptor& v) const
+	{
+		const EdgeList* p = m_vertices.find(v);
+		return p == NULL ? 0 : p->size;
+	}
+
+	std::pair<edge_descriptor, bool>
+	add_edge(const vertex_descriptor& u, const vertex_descriptor& v)
+	{
+		EdgeList& edges = m_vertices[u];
+		for (unsigned i = edges.first; i != NIL; i = m_edges[i].next) {
+			if (m_edges[i].target == v)
+				return std::make_pair(edge_descriptor(u, v), false);
+		}
+
+		unsigned i = m_edges.size();
+		m_edges.push_back(Edge(v));
+		if (edges.first == NIL)
+			edges.first = i;
+		else
+			m_edges[edges.last].next = i;
+		edges.last = i;
+		edges.size++;
+
+		// Inserting v may move the entry of u.
+		m_vertices[v];
+		return std::make_pair(edge_descriptor(u, v), true);
+	}
+
+private:
+
+	VertexMap m_vertices;
+	std::vector<Edge> m_edges;
+};
+
+namespace boost {
+
+template <class VertexType>
+struct graph_traits< ArenaGraph<VertexType> > {
+
+	// Graph
+	typedef VertexType vertex_descriptor;
+	typedef std::pair<vertex_descriptor, vertex_descriptor> edge_descriptor;
+	typedef boost::directed_tag directed_category;
+	typedef boost::disallow_parallel_edge_tag edge_parallel_category;
+	struct traversal_category
+		: boost::incidence_graph_tag,
+		boost::adjacency_graph_tag,
+		boost::vertex_list_graph_tag { };
+
+	// BidirectionalGraph
+	typedef void in_edge_iterator;
+
+	// VertexListGraph
+	typedef unsigned vertices_size_type;
+
+	// EdgeListGraph
+	typedef void edge_iterator;
+	typedef void edges_size_type;
+
+	// IncidenceGraph
+	typedef unsigned degree_size_type;
+
+	typedef ArenaGraph<VertexType> Graph;
+
+	class vertex_iterator
+		: public std::iterator<std::input_iterator_tag,
+			const vertex_descriptor>
+	{
+		public:
+
+			vertex_iterator() { }
+
+			vertex_iterator(typename Graph::VertexMapIterator it)
+				: m_it(it) { }
+
+			vertex_descriptor operator*() const
+			{
+				return m_it->first;
+			}
+
+			bool operator==(const vertex_iterator& it) const
+			{
+				return m_it == it.m_it;
+			}
+
+			bool operator!=(const vertex_iterator& it) const
+			{
+				return m_it != it.m_it;
+			}
+
+			vertex_iterator& operator++()
+			{
+				++m_it;
+				return *this;
+			}
+
+			vertex_iterator operator++(int)
+			{
+				vertex_iterator it = *this;
+				++*this;
+				return it;
+			}
+
+		private:
+
+			typename Graph::VertexMapIterator m_it;
+	};
+
+	struct adjacency_iterator
+		: public std::iterator<std::input_iterator_tag, vertex_descriptor>
+	{
+		public:
+
+			adjacency_iterator() : m_g(NULL), m_i(Graph::NIL) { }
+
+			adjacency_iterator(const Graph& g, unsigned i)
+				: m_g(&g), m_i(i) { }
+
+			vertex_descriptor operator*() const
+			{
+				return m_g->get_edge(m_i).target;
+			}
+
+			bool operator==(const adjacency_iterator& it) const
+			{
+				return m_i == it.m_i;
+			}
+
+			bool operator!=(const adjacency_iterator& it) const
+			{
+				return !(*this == it);
+			}
+
+			adjacency_iterator& operator++()
+			{
+				m_i = m_g->get_edge(m_i).next;
+				return *this;
+			}
+
+			adjacency_iterator operator++(int)
+			{
+				adjacency_iterator it = *this;
+				++*this;
+				return it;
+			}
+
+		private:
+
+			const Graph* m_g;
+			unsigned m_i;
+	};
+
+	struct out_edge_iterator
+		: public std::iterator<std::input_iterator_tag, edge_descriptor>
+	{
+	public:
+
+		out_edge_iterator() : m_g(NULL), m_i(Graph::NIL) { }
+
+		out_edge_iterator(const Graph& g, vertex_descriptor u, unsigned i)
+			: m_g(&g), m_u(u), m_i(i) { }
+
+		edge_descriptor operator*() const
+		{
+			return edge_descriptor(m_u, m_g->get_edge(m_i).target);
+		}
+
+		bool operator==(const out_edge_iterator& it) const
+		{
+			return m_i == it.m_i;
+		}
+
+		bool operator!=(const out_edge_iterator& it) const
+		{
+			return !(*this == it);
+		}
+
+		out_edge_iterator& operator++()
+		{
+			m_i = m_g->get_edge(m_i).next;
+			return *this;
+		}
+
+		out_edge_iterator operator++(int)
+		{
+			out_edge_iterator it = *this;
+			++*this;
+			return it;
+		}
+
+	private:
+
+		const Graph* m_g;
+		vertex_descriptor m_u;
+		unsigned m_i;
+
+	}; // out_edge_iterator
+
+}; // graph_traits
+
+}
+
+// IncidenceGraph
+
+template <class VertexType>
+std::pair<
+	typename ArenaGraph<VertexType>::out_edge_iterator,
+	typename ArenaGraph<VertexType>::out_edge_iterator>
+out_edges(
+	typename ArenaGraph<VertexType>::vertex_descriptor v,
+	const ArenaGraph<VertexType>& g)
+{
+	typedef ArenaGraph<VertexType> Graph;
+	typedef typename Graph::out_edge_iterator out_edge_iterator;
+	return std::make_pair(out_edge_iterator(g, v, g.first_edge(v)),
+		out_edge_iterator(g, v, Graph::NIL));
+}
+
+template <class VertexType>
+typename ArenaGraph<VertexType>::degree_size_type
+out_degree(
+	typename ArenaGraph<VertexType>::vertex_descriptor v,
+	const ArenaGraph<VertexType>& g)
+{
+	return g.out_degree(v);
+}
+
+// AdjacencyGraph
+
+template <class VertexType>
+std::pair<
+	typename ArenaGraph<VertexType>::adjacency_iterator,
+	typename ArenaGraph<VertexType>::adjacency_iterator>
+adjacent_vertices(
+	typename ArenaGraph<VertexType>::vertex_descriptor v,
+	const ArenaGraph<VertexType>& g)
+{
+	typedef ArenaGraph<VertexType> Graph;
+	typedef typename Graph::adjacency_iterator adjacency_iterator;
+	return std::make_pair(adjacency_iterator(g, g.first_edge(v)),
+		adjacency_iterator(g, Graph::NIL));
+}
+
+// VertexListGraph
+
+template <class VertexType>
+std::pair<
+	typename ArenaGraph<VertexType>::vertex_iterator,
+	typename ArenaGraph<VertexType>::vertex_iterator>
+vertices(const ArenaGraph<VertexType>& g)
+{
+	typedef typename ArenaGraph<VertexType>::vertex_iterator vertex_iterator;
+	typename ArenaGraph<VertexType>::VertexMapIterator first, last;
+	boost::tie(first, last) = g.get_vertex_map_entries();
+	return std::make_pair(vertex_iterator(first), vertex_iterator(last));
+}
+
+template <class VertexType>
+typename ArenaGraph<VertexType>::vertices_size_type
+num_vertices(const ArenaGraph<VertexType>& g)
+{
+	return g.num_vertices();
+}
+
+// MutableGraph
+
+template <class VertexType>
+std::pair<typename ArenaGraph<VertexType>::edge_descriptor, bool>
+add_edge(
+	typename ArenaGraph<VertexType>::vertex_descriptor u,
+	typename ArenaGraph<VertexType>::vertex_descriptor v,
+	ArenaGraph<VertexType>& g)
+{
+	return g.add_edge(u, v);
+}
+
+#endif
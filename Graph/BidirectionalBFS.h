@@ -4,6 +4,7 @@
 #include "Graph/DefaultColorMap.h"
 #include "Graph/BidirectionalBFSVisitor.h"
 #include "Graph/Path.h"
+#include <cassert>
 #include <vector>
 #include <boost/graph/breadth_first_search.hpp>
 
@@ -141,18 +142,76 @@ void bidirectionalBFS(
 
 } // bidirectionalBFS
 
+/**
+ * A FIFO queue stored in a vector. The storage of popped elements
+ * is not released until the queue is cleared, so that a queue may
+ * be reused by successive searches without allocating memory.
+ */
+template <typename T>
+class VectorQueue
+{
+  public:
+	VectorQueue() : m_head(0) { }
+
+	bool empty() const { return m_head == m_v.size(); }
+	size_t size() const { return m_v.size() - m_head; }
+
+	T& top() { assert(!empty()); return m_v[m_head]; }
+	const T& top() const { assert(!empty()); return m_v[m_head]; }
+
+	void push(const T& x) { m_v.push_back(x); }
+	void pop() { assert(!empty()); ++m_head; }
+
+	void clear() { m_v.clear(); m_head = 0; }
+
+  private:
+	std::vector<T> m_v;
+	size_t m_head;
+};
+
+/**
+ * The color maps and queues of a bidirectional BFS, which may be
+ * reused by successive searches to avoid allocating memory.
+ */
+template <class BidirectionalGraph>
+struct BidirectionalBFSBuffers
+{
+	typedef typename graph_traits<BidirectionalGraph>::vertex_descriptor V;
+
+	DefaultColorMap<BidirectionalGraph> colorMap1;
+	DefaultColorMap<BidirectionalGraph> colorMap2;
+	VectorQueue<V> q1;
+	VectorQueue<V> q2;
+
+	void clear()
+	{
+		colorMap1.clear();
+		colorMap2.clear();
+		q1.clear();
+		q2.clear();
+	}
+};
+
+template <class BidirectionalGraph>
+void bidirectionalBFS(const BidirectionalGraph& g,
+	typename graph_traits<BidirectionalGraph>::vertex_descriptor start,
+	typename graph_traits<BidirectionalGraph>::vertex_descriptor goal,
+	BidirectionalBFSVisitor<BidirectionalGraph>& visitor,
+	BidirectionalBFSBuffers<BidirectionalGraph>& buffers)
+{
+	buffers.clear();
+	bidirectionalBFS(g, start, goal, buffers.q1, buffers.q2, visitor,
+		buffers.colorMap1, buffers.colorMap2);
+}
+
 template <class BidirectionalGraph>
 void bidirectionalBFS(const BidirectionalGraph& g,
 	typename graph_traits<BidirectionalGraph>::vertex_descriptor start,
 	typename graph_traits<BidirectionalGraph>::vertex_descriptor goal,
 	BidirectionalBFSVisitor<BidirectionalGraph>& visitor)
 {
-	typedef typename graph_traits<BidirectionalGraph>::vertex_descriptor V;
-	DefaultColorMap<BidirectionalGraph> colorMap1;
-	DefaultColorMap<BidirectionalGraph> colorMap2;
-	boost::queue<V> q1;
-	boost::queue<V> q2;
-	bidirectionalBFS(g, start, goal, q1, q2, visitor, colorMap1, colorMap2);
+	BidirectionalBFSBuffers<BidirectionalGraph> buffers;
+	bidirectionalBFS(g, start, goal, visitor, buffers);
 }
 
 #endif
@@ -1,14 +1,13 @@
 #ifndef CONSTRAINED_BIDI_BFS_VISITOR_H
 #define CONSTRAINED_BIDI_BFS_VISITOR_H
 
-#include "Common/UnorderedMap.h"
-#include "Common/UnorderedSet.h"
+#include "Common/OpenHashMap.h"
 #include "Common/IOUtil.h"
 #include "Graph/Path.h"
+#include "Graph/ArenaGraph.h"
 #include "Graph/HashGraph.h"
 #include "Graph/BidirectionalBFSVisitor.h"
 #include "Graph/AllPathsSearch.h"
-#include "Common/MemUtils.h"
 #include <boost/graph/graph_traits.hpp>
 #include <iostream>
 #include <sstream>
@@ -25,7 +24,7 @@ protected:
 	typedef typename boost::graph_traits<G>::edge_descriptor E;
 	typedef unsigned short depth_t;
 	typedef std::vector< Path<V> > PathList;
-	typedef unordered_map<V, depth_t, hash<V> > DepthMap;
+	typedef OpenHashMap<V, depth_t, hash<V> > DepthMap;
 
 	struct EdgeHash {
 		const G& m_g;
@@ -37,7 +36,8 @@ protected:
 		}
 	};
 
-	typedef unordered_set<E, EdgeHash> EdgeSet;
+	/** A set of edges. The mapped value is unused. */
+	typedef OpenHashMap<E, bool, EdgeHash> EdgeSet;
 
 	const G& m_graph;
 	V m_start;
@@ -47,7 +47,7 @@ protected:
 	unsigned m_maxPaths;
 
 	/** records history of forward/reverse traversals */
-	HashGraph<V> m_traversalGraph[2];
+	ArenaGraph<V> m_traversalGraph[2];
 
 	/** records depth of vertices during forward/reverse traversal */
 	DepthMap m_depthMap[2];
@@ -100,21 +100,70 @@ public:
 		size_t memLimit
 		) :
 			m_graph(graph),
-			m_start(start),
-			m_goal(goal),
-			m_maxPaths(maxPaths),
-			m_minPathLength(minPathLength),
-			m_maxPathLength(maxPathLength),
-			m_maxBranches(maxBranches),
-			m_memLimit(memLimit),
+			m_commonEdges(EdgeHash(m_graph))
+	{
+		reset(start, goal, maxPaths, minPathLength, maxPathLength,
+			maxBranches, memLimit);
+	}
+
+	/**
+	 * Construct a visitor that must be prepared by reset() before
+	 * each search. A visitor that is reused for many searches does
+	 * not allocate memory once its tables have grown to their
+	 * working size.
+	 */
+	ConstrainedBidiBFSVisitor(const G& graph) :
+			m_graph(graph),
+			m_maxPaths(0),
+			m_minPathLength(0),
+			m_maxPathLength(0),
+			m_maxBranches(0),
+			m_memLimit(0),
 			m_memCheckCounter(0),
 			m_exceededMemLimit(false),
 			m_peakActiveBranches(0),
 			m_tooManyBranches(false),
 			m_tooManyPaths(false),
 			m_numNodesVisited(0),
-			m_commonEdges(m_maxPaths, EdgeHash(m_graph))
+			m_commonEdges(EdgeHash(m_graph))
+	{
+		m_maxDepth[FORWARD] = m_maxDepth[REVERSE] = 0;
+		m_maxDepthVisited[FORWARD] = m_maxDepthVisited[REVERSE] = 0;
+	}
+
+	/**
+	 * Prepare this visitor for a new search, retaining the
+	 * storage of its tables.
+	 */
+	void reset(
+		const V& start,
+		const V& goal,
+		unsigned maxPaths,
+		depth_t minPathLength,
+		depth_t maxPathLength,
+		unsigned maxBranches,
+		size_t memLimit)
 	{
+		m_start = start;
+		m_goal = goal;
+		m_maxPaths = maxPaths;
+		m_minPathLength = minPathLength;
+		m_maxPathLength = maxPathLength;
+		m_maxBranches = maxBranches;
+		m_memLimit = memLimit;
+		m_memCheckCounter = 0;
+		m_exceededMemLimit = false;
+		m_peakActiveBranches = 0;
+		m_tooManyBranches = false;
+		m_tooManyPaths = false;
+		m_numNodesVisited = 0;
+
+		for (unsigned i = 0; i < 2; i++) {
+			m_traversalGraph[i].clear();
+			m_depthMap[i].clear();
+		}
+		m_commonEdges.clear();
+		m_pathsFound.clear();
 
 		depth_t maxDepth = maxPathLength - 1;
 		m_maxDepth[FORWARD] = maxDepth / 2 + maxDepth % 2;
@@ -248,18 +297,18 @@ public:
 		return
 			m_traversalGraph[FORWARD].approxMemSize() +
 			m_traversalGraph[REVERSE].approxMemSize() +
-			approxMemSize(m_depthMap[FORWARD]) +
-			approxMemSize(m_depthMap[REVERSE]);
+			m_depthMap[FORWARD].approxMemSize() +
+			m_depthMap[REVERSE].approxMemSize();
 	}
 
 	void getTraversalGraph(HashGraph<V>& traversalGraph)
 	{
-		typedef typename HashGraph<V>::vertex_iterator vertex_iterator;
-		typedef typename HashGraph<V>::adjacency_iterator adjacency_iterator;
+		typedef typename ArenaGraph<V>::vertex_iterator vertex_iterator;
+		typedef typename ArenaGraph<V>::adjacency_iterator adjacency_iterator;
 
 		Direction dir[] = { FORWARD, REVERSE };
 		for (unsigned i = 0; i < 2; i++) {
-			HashGraph<V>& g = m_traversalGraph[dir[i]];
+			const ArenaGraph<V>& g = m_traversalGraph[dir[i]];
 			vertex_iterator vi, vi_end;
 			boost::tie(vi, vi_end) = vertices(g);
 			for(; vi != vi_end; vi++) {
@@ -276,7 +325,7 @@ protected:
 
 	BFSVisitorResult recordCommonEdge(const E& e)
 	{
-		m_commonEdges.insert(e);
+		m_commonEdges.insert(std::make_pair(e, true));
 		if (m_maxPaths != NO_LIMIT &&
 			m_commonEdges.size() > m_maxPaths) {
 			m_tooManyPaths = true;
@@ -379,7 +428,7 @@ protected:
 
 		typename EdgeSet::const_iterator i = m_commonEdges.begin();
 		for (; i != m_commonEdges.end(); i++) {
-			PathSearchResult result = buildPaths(*i);
+			PathSearchResult result = buildPaths(i->first);
 			if (result == FOUND_PATH) {
 				overallResult = FOUND_PATH;
 			}
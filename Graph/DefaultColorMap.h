@@ -1,7 +1,7 @@
 #ifndef DEFAULTCOLORMAP_H
 #define DEFAULTCOLORMAP_H
 
-#include "UnorderedMap.h"
+#include "Common/OpenHashMap.h"
 #include <boost/graph/graph_traits.hpp>
 #include <boost/graph/properties.hpp>
 
@@ -15,9 +15,12 @@ public:
 	typedef boost::default_color_type value_type;
 	typedef boost::read_write_property_map_tag category;
 
-	typedef unordered_map<key_type, value_type, hash<key_type> >
+	typedef OpenHashMap<key_type, value_type, hash<key_type> >
 		map_type;
 	map_type map;
+
+	/** Reset all vertices to white without releasing storage. */
+	void clear() { map.clear(); }
 };
 
 namespace boost {
@@ -34,12 +37,11 @@ template <typename G>
 typename DefaultColorMap<G>::value_type
 get(const DefaultColorMap<G>& colorMap, typename DefaultColorMap<G>::key_type key)
 {
-	typedef typename DefaultColorMap<G>::map_type::const_iterator It;
-
-	It i = colorMap.map.find(key);
+	const typename DefaultColorMap<G>::value_type* p
+		= colorMap.map.find(key);
 
-	if (i != colorMap.map.end())
-		return i->second;
+	if (p != NULL)
+		return *p;
 
 	return boost::white_color;
 }
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <iostream>
 #include <iterator>
 #include <utility>
 
@@ -19,59 +20,46 @@ namespace opt {
 	int multimap;
 }
 
-template <>
-void Aligner<SeqPosHashMultiMap>::addReferenceSequence(
-		const Kmer& kmer, Position pos)
-{
-	assert(opt::multimap == opt::MULTIMAP);
-	m_target.insert(make_pair(kmer, pos));
-}
-
-template <class SeqPosHashMap>
-void Aligner<SeqPosHashMap>::addReferenceSequence(
-		const Kmer& kmer, Position pos)
-{
-	assert(opt::multimap != opt::MULTIMAP);
-	Kmer rc_kmer = reverseComplement(kmer);
-	map_iterator findIt = m_target.find(rc_kmer);
-
-	if (findIt != m_target.end()) {
-		if (!findIt->second.isDuplicate())
-			findIt->second.setDuplicate(
-					contigIndexToID(findIt->second.contig),
-					contigIndexToID(pos.contig), kmer.str());
-		return;
-	}
-
-	pair<map_iterator, bool> inserted
-		= m_target.insert(make_pair(kmer, pos));
-
-	if (!inserted.second)
-		if (!inserted.first->second.isDuplicate())
-			inserted.first->second.setDuplicate(
-					contigIndexToID(inserted.first->second.contig),
-					contigIndexToID(pos.contig), kmer.str());
-}
-
-/** Create an index of the target sequence. */
-template <class SeqPosHashMap>
-void Aligner<SeqPosHashMap>::addReferenceSequence(
+/** Add the k-mer of a target sequence to the index. */
+template <class SeqPosIndex>
+void Aligner<SeqPosIndex>::addReferenceSequence(
 		const StringID& idString, const Sequence& seq)
 {
 	unsigned id = contigIDToIndex(idString);
+	if (id >= Position::MAX_CONTIGS) {
+		cerr << "error: the target has more than "
+			<< Position::MAX_CONTIGS << " sequences\n";
+		exit(EXIT_FAILURE);
+	}
+	m_lengths.push_back(seq.length());
 	int size = seq.length();
 	for(int i = 0; i < (size - m_hashSize + 1); ++i)
 	{
 		Sequence subseq(seq, i, m_hashSize);
 		if (subseq.find_first_not_of("ACGT0123") != string::npos)
 			continue;
-		addReferenceSequence(Kmer(subseq), Position(id, i));
+		m_target.insert(make_pair(Kmer(subseq), Position(id, i)));
+	}
+}
+
+/** Create an index of the target sequence. */
+template <class SeqPosIndex>
+void Aligner<SeqPosIndex>::buildIndex()
+{
+	m_target.build(opt::multimap != opt::MULTIMAP);
+	if (opt::multimap == opt::ERROR && m_target.hasDuplicate()) {
+		const typename SeqPosIndex::Duplicate& dup
+			= m_target.firstDuplicate();
+		Position pos = dup.first.second;
+		pos.setDuplicate(contigIndexToID(dup.first.second.contig),
+				contigIndexToID(dup.second.second.contig),
+				dup.second.first.str());
 	}
 }
 
-template <class SeqPosHashMap>
+template <class SeqPosIndex>
 template <class oiterator>
-void Aligner<SeqPosHashMap>::alignRead(
+void Aligner<SeqPosIndex>::alignRead(
 		const string& qid, const Sequence& seq,
 		oiterator dest)
 {
@@ -85,8 +73,8 @@ void Aligner<SeqPosHashMap>::alignRead(
 /** Store all alignments for a given Kmer in the parameter aligns.
  *  @param[out] aligns Map of contig IDs to alignment vectors.
  */
-template <class SeqPosHashMap>
-void Aligner<SeqPosHashMap>::alignKmer(
+template <class SeqPosIndex>
+void Aligner<SeqPosIndex>::alignKmer(
 		AlignmentSet& aligns, const Sequence& seq,
 		bool isRC, bool good, int read_ind, int seqLen)
 {
@@ -119,9 +107,9 @@ void Aligner<SeqPosHashMap>::alignKmer(
 	}
 }
 
-template <class SeqPosHashMap>
-typename Aligner<SeqPosHashMap>::AlignmentSet
-Aligner<SeqPosHashMap>::getAlignmentsInternal(
+template <class SeqPosIndex>
+typename Aligner<SeqPosIndex>::AlignmentSet
+Aligner<SeqPosIndex>::getAlignmentsInternal(
 		const Sequence& seq, bool isRC)
 {
 	// The results
@@ -176,9 +164,9 @@ static int compareQueryPos(const Alignment& a1, const Alignment& a2)
 }
 
 /** Coalesce the k-mer alignments into a read alignment. */
-template <class SeqPosHashMap>
+template <class SeqPosIndex>
 template <class oiterator>
-void Aligner<SeqPosHashMap>::coalesceAlignments(
+void Aligner<SeqPosIndex>::coalesceAlignments(
 		const string& qid, const string& seq,
 		const AlignmentSet& alignSet,
 		oiterator& dest)
@@ -222,28 +210,17 @@ void Aligner<SeqPosHashMap>::coalesceAlignments(
 }
 
 // Explicit instantiation.
-template void Aligner<SeqPosHashMultiMap>::addReferenceSequence(
+template void Aligner<SeedIndex>::addReferenceSequence(
 		const StringID& id, const Sequence& seq);
 
-template void Aligner<SeqPosHashUniqueMap>::addReferenceSequence(
-		const StringID& id, const Sequence& seq);
+template void Aligner<SeedIndex>::buildIndex();
 
-template void Aligner<SeqPosHashMultiMap>::
+template void Aligner<SeedIndex>::
 alignRead<affix_ostream_iterator<Alignment> >(
 		const string& qid, const Sequence& seq,
 		affix_ostream_iterator<Alignment> dest);
 
-template void Aligner<SeqPosHashUniqueMap>::
-alignRead<affix_ostream_iterator<Alignment> >(
-		const string& qid, const Sequence& seq,
-		affix_ostream_iterator<Alignment> dest);
-
-template void Aligner<SeqPosHashMultiMap>::
-alignRead<ostream_iterator<SAMRecord> >(
-		const string& qid, const Sequence& seq,
-		ostream_iterator<SAMRecord> dest);
-
-template void Aligner<SeqPosHashUniqueMap>::
+template void Aligner<SeedIndex>::
 alignRead<ostream_iterator<SAMRecord> >(
 		const string& qid, const Sequence& seq,
 		ostream_iterator<SAMRecord> dest);
@@ -7,7 +7,7 @@
 #include "ConstString.h"
 #include "Functional.h"
 #include "Kmer.h"
-#include "UnorderedMap.h"
+#include "SeedIndex.h"
 #include <cassert>
 #include <cstdlib>
 #include <cstring> // for strcpy
@@ -22,88 +22,39 @@
 
 typedef std::string StringID;
 
-/** A tuple of a target ID and position. */
-struct Position
-{
-	uint32_t contig;
-	uint32_t pos; // 0 indexed
-	Position(uint32_t contig = std::numeric_limits<uint32_t>::max(),
-			uint32_t pos = std::numeric_limits<uint32_t>::max())
-		: contig(contig), pos(pos) { }
-
-	/** Mark this seed as a duplicate. */
-	void setDuplicate(const char* thisContig, const char* otherContig,
-			const Sequence& kmer)
-	{
-		if (opt::multimap == opt::IGNORE)
-			contig = std::numeric_limits<uint32_t>::max();
-		else {
-			std::cerr << "error: duplicate k-mer in "
-				<< thisContig
-				<< " also in "
-				<< otherContig
-				<< ": " << kmer << '\n';
-			exit(EXIT_FAILURE);
-		}
-	}
-
-	/** Return whether this seed is a duplciate. */
-	bool isDuplicate() const
-	{
-		return contig == std::numeric_limits<uint32_t>::max();
-	}
-};
-
-typedef unordered_multimap<Kmer, Position, hash<Kmer> >
-	SeqPosHashMultiMap;
-
-#if HAVE_GOOGLE_SPARSE_HASH_MAP
-# include <google/sparse_hash_map>
-typedef google::sparse_hash_map<Kmer, Position, hash<Kmer> >
-	SeqPosHashUniqueMap;
-#else
-typedef unordered_map<Kmer, Position, hash<Kmer> >
-	SeqPosHashUniqueMap;
-#endif
-
-
 typedef std::vector<Alignment> AlignmentVector;
 
 /**
  * Index a target sequence and align query sequences to that indexed
  * target.
  */
-template <class SeqPosHashMap>
+template <class SeqPosIndex>
 class Aligner
 {
 	public:
-		typedef typename SeqPosHashMap::iterator map_iterator;
-		typedef typename SeqPosHashMap::const_iterator
+		typedef typename SeqPosIndex::const_iterator
 			map_const_iterator;
 
-		Aligner(int hashSize, size_t buckets)
-			: m_hashSize(hashSize), m_target(buckets) { }
+		explicit Aligner(int hashSize) : m_hashSize(hashSize) { }
 
-		Aligner(int hashSize, size_t buckets, float factor)
-			: m_hashSize(hashSize)
-		{
-			m_target.max_load_factor(factor);
-			m_target.rehash(buckets);
-		}
+		/** Reserve memory for the specified number of k-mer. */
+		void reserve(size_t n) { m_target.reserve(n); }
 
 		void addReferenceSequence(const StringID& id,
 				const Sequence& seq);
-		void addReferenceSequence(const Kmer& kmer, Position pos);
+
+		/** Build the index of the target once all the target
+		 * sequences are added. */
+		void buildIndex();
 
 		template <class oiterator>
 		void alignRead(const std::string& qid, const Sequence& seq,
 				oiterator dest);
 
 		size_t size() const { return m_target.size(); }
-		size_t bucket_count() const
-		{
-			return m_target.bucket_count();
-		}
+
+		/** Return the number of target sequences. */
+		size_t numContigs() const { return m_dict.size(); }
 
 		/** Return the number of duplicate k-mer in the target. */
 		size_t countDuplicates() const
@@ -111,7 +62,44 @@ class Aligner
 			assert(opt::multimap == opt::IGNORE);
 			return count_if(m_target.begin(), m_target.end(),
 					compose1(std::mem_fun_ref(&Position::isDuplicate),
-						mem_var(&SeqPosHashMap::value_type::second)));
+						mem_var(&SeqPosIndex::value_type::second)));
+		}
+
+		/** Write the SAM header of the target sequences. */
+		void writeSAMHeader(std::ostream& out) const
+		{
+			for (size_t i = 0; i < m_dict.size(); ++i)
+				out << "@SQ\tSN:" << m_dict[i]
+					<< "\tLN:" << m_lengths[i] << '\n';
+		}
+
+		/** Store the index of the target. */
+		friend std::ostream& operator<<(std::ostream& out,
+				const Aligner& o)
+		{
+			uint64_t n = o.m_dict.size();
+			out.write(reinterpret_cast<const char*>(&n), sizeof n);
+			for (size_t i = 0; i < o.m_dict.size(); ++i)
+				out << o.m_dict[i] << '\t' << o.m_lengths[i] << '\n';
+			return out << o.m_target;
+		}
+
+		/** Load the index of the target. */
+		friend std::istream& operator>>(std::istream& in, Aligner& o)
+		{
+			uint64_t n;
+			if (!in.read(reinterpret_cast<char*>(&n), sizeof n))
+				return in;
+			for (uint64_t i = 0; i < n; ++i) {
+				std::string id;
+				unsigned length;
+				if (!(std::getline(in, id, '\t') >> length)
+						|| in.get() != '\n')
+					return in;
+				o.contigIDToIndex(id);
+				o.m_lengths.push_back(length);
+			}
+			return in >> o.m_target;
 		}
 
 	private:
@@ -136,11 +124,14 @@ class Aligner
 		int m_hashSize;
 
 		/** A map of k-mer to contig coordinates. */
-		SeqPosHashMap m_target;
+		SeqPosIndex m_target;
 
 		/** A dictionary of contig IDs. */
 		std::vector<const_string> m_dict;
 
+		/** The lengths of the contigs. */
+		std::vector<unsigned> m_lengths;
+
 		unsigned contigIDToIndex(const std::string& id)
 		{
 			m_dict.push_back(id);
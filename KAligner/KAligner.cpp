@@ -6,11 +6,10 @@
 #include "Iterator.h"
 #include "IOUtil.h"
 #include "MemoryUtil.h"
+#include "RingBuffer.h"
 #include "SAM.h"
 #include "StringUtil.h" // for toSI
 #include "Uncompress.h"
-#include "Pipe.h"
-#include "PipeMux.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
@@ -21,10 +20,15 @@
 #include <getopt.h>
 #include <iostream>
 #include <pthread.h>
+#include <queue>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <sys/stat.h>
 #include <sys/time.h>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 
@@ -50,8 +54,12 @@ static const char USAGE_MESSAGE[] =
 "                        [default]\n"
 "  -m, --multimap        allow duplicate k-mer in the target\n"
 "      --no-multimap     disallow duplicate k-mer in the target\n"
-"  -j, --threads=N       use N threads [2] up to one per query file\n"
-"                        or if N is 0 use one thread per query file\n"
+"      --index=FILE      load the index of the target from FILE if\n"
+"                        it exists and was built from the same\n"
+"                        target, or else store it in FILE\n"
+"  -j, --threads=N       use N threads to align the reads [2]\n"
+"                        or if N is 0 use one thread per query file.\n"
+"                        Each query file is also read by its own thread\n"
 "  -v, --verbose         display verbose output\n"
 "      --no-sam          output the results in KAligner format\n"
 "      --sam             output the results in SAM format\n"
@@ -71,6 +79,9 @@ namespace opt {
 	static unsigned section = 1;
 	static unsigned nsections = 1;
 
+	/** The file of the index of the target */
+	static string indexPath;
+
 	/** Output formats */
 	static int format;
 }
@@ -78,7 +89,7 @@ namespace opt {
 static const char shortopts[] = "ij:k:l:mo:s:v";
 
 
-enum { OPT_HELP = 1, OPT_VERSION, OPT_SYNC };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_SYNC, OPT_INDEX };
 
 static const struct option longopts[] = {
 	{ "kmer",        required_argument, NULL, 'k' },
@@ -86,6 +97,7 @@ static const struct option longopts[] = {
 	{ "no-multi",    no_argument,     &opt::multimap, opt::ERROR },
 	{ "multimap",    no_argument,     &opt::multimap, opt::MULTIMAP },
 	{ "ignore-multimap", no_argument, &opt::multimap, opt::IGNORE },
+	{ "index",       required_argument, NULL, OPT_INDEX },
 	{ "threads",     required_argument,	NULL, 'j' },
 	{ "verbose",     no_argument,       NULL, 'v' },
 	{ "no-sam",      no_argument,       &opt::format, KALIGNER },
@@ -172,17 +184,17 @@ static size_t countKmer(const string& path)
 	return kmer;
 }
 
-template <class SeqPosHashMap>
 static void readContigsIntoDB(string refFastaFile,
-		Aligner<SeqPosHashMap>& aligner);
+		Aligner<SeedIndex>& aligner);
+static void writeIndex(const string& path, const string& targetPath,
+		const Aligner<SeedIndex>& aligner);
+static bool readIndex(const string& path, const string& targetPath,
+		Aligner<SeedIndex>& aligner);
 static void *alignReadsToDB(void *arg);
 static void *readFile(void *arg);
 
-/** Unique aligner using map */
-static Aligner<SeqPosHashUniqueMap> *g_aligner_u;
-
-/** Multimap aligner using multimap */
-static Aligner<SeqPosHashMultiMap> *g_aligner_m;
+/** The aligner and the index of the target */
+static Aligner<SeedIndex> *g_aligner;
 
 /** Number of reads. */
 static unsigned g_readCount;
@@ -193,84 +205,100 @@ static unsigned g_alignedCount;
 /** Guard cerr. */
 static pthread_mutex_t g_mutexCerr = PTHREAD_MUTEX_INITIALIZER;
 
-/** Stores the output string and the read index number for an
- * alignment. */
+/** The number of query records of a batch. */
+static const size_t BATCH_SIZE = 1024;
+
+/** The maximum number of batches that are read but not yet printed,
+ * which bounds the memory used when a worker falls behind. */
+static const size_t MAX_BATCHES = 64;
+
+/** A batch of query records and its index in the output. */
+struct Batch
+{
+	vector<FastaRecord> records;
+	size_t index;
+};
+
+/** Stores the output string and the batch index number for the
+ * alignments of a batch. */
 struct OutData
 {
 	string s;
 	size_t index;
 
-	OutData(string s = string(), size_t index = 0)
+	OutData(const string& s = string(), size_t index = 0)
 		: s(s), index(index) { }
 
-	/** Operator needed for sorting priority queue. */
-	bool operator<(const OutData& a) const
-	{
-		// Smaller index number has higher priority.
-		return index > a.index;
-	}
+	/** Order the priority queue by index. */
+	struct Compare {
+		bool operator()(const OutData* a, const OutData* b) const
+		{
+			// Smaller index number has higher priority.
+			return a->index > b->index;
+		}
+	};
 };
 
-/** Shares data between workers and the output thread. */
-static Pipe<OutData> g_pipeOut(1<<7);
+/** Shares batches of records between producer and worker threads. */
+static RingBuffer<Batch*> g_readQueue(MAX_BATCHES);
 
-/** Shares data between producer and worker threads. */
-static PipeMux<FastaRecord> g_pipeMux(1);
+/** Shares batches of alignments between workers and the output
+ * thread. */
+static RingBuffer<OutData*> g_outQueue(MAX_BATCHES);
 
-/** Notification of the current size of the g_pqueue. */
-static size_t g_pqSize;
-static const size_t MAX_PQ_SIZE = 1000;
+/** The number of batches read. */
+static size_t g_batchCount;
 
-/** Conditional variable used to block workers until the g_pqueue has
- * become small enough. */
-static pthread_cond_t g_pqSize_cv = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t g_mutexPqSize = PTHREAD_MUTEX_INITIALIZER;
+/** The number of batches read but not yet printed. */
+static volatile size_t g_pendingBatches;
+
+/** The number of producer threads that are running. */
+static volatile unsigned g_producersRunning;
+
+/** The number of worker threads that are running. */
+static volatile unsigned g_workersRunning;
+
+/** Return whether all the threads counted by n have finished. */
+static bool finished(volatile unsigned& n)
+{
+	bool done = n == 0;
+	__sync_synchronize();
+	return done;
+}
 
 static void* printAlignments(void*)
 {
-	priority_queue<OutData> pqueue;
-	size_t index = 1;
-	for (pair<OutData, size_t> p = g_pipeOut.pop();
-			p.second > 0; p = g_pipeOut.pop()) {
-		pqueue.push(p.first);
-		while (!pqueue.empty()) {
-			const OutData& rec = pqueue.top();
-			if (index == rec.index) {
-				// Print the record at the current index.
-				index++;
-				assert(rec.index > 0);
-				cout << rec.s;
-				assert_good(cout, "stdout");
-				pqueue.pop();
-			} else if (g_pipeMux.invalidEntry(index)) {
-				// Skip this index since it is invalid.
-				index++;
-			} else {
-				// The record for this index has not been added, get
-				// another record from the pipe.
-				break;
+	priority_queue<OutData*, vector<OutData*>, OutData::Compare> pqueue;
+	size_t index = 0;
+	for (unsigned attempts = 0;;) {
+		OutData* p;
+		if (!g_outQueue.tryPop(p)) {
+			// Check the queue once more after the workers finish.
+			if (!finished(g_workersRunning)) {
+				backoff(attempts);
+				continue;
 			}
+			if (!g_outQueue.tryPop(p))
+				break;
+		}
+		attempts = 0;
+		pqueue.push(p);
+
+		// Print the batches that are next in order.
+		while (!pqueue.empty() && pqueue.top()->index == index) {
+			OutData* rec = pqueue.top();
+			pqueue.pop();
+			cout << rec->s;
+			assert_good(cout, "stdout");
+			delete rec;
+			index++;
+			__sync_fetch_and_sub(&g_pendingBatches, 1);
 		}
-
-		// Let waiting workers continue if the pqueue is small enough.
-		pthread_mutex_lock(&g_mutexPqSize);
-		g_pqSize = pqueue.size();
-		if (g_pqSize < MAX_PQ_SIZE)
-			pthread_cond_broadcast(&g_pqSize_cv);
-		pthread_mutex_unlock(&g_mutexPqSize);
 	}
+	assert(pqueue.empty());
 	return NULL;
 }
 
-/** Store a FastaReader and Pipe. */
-struct WorkerArg {
-	FastaReader& in;
-	Pipe<FastaRecord>& out;
-	WorkerArg(FastaReader& in, Pipe<FastaRecord>& out)
-		: in(in), out(out) { }
-	~WorkerArg() { delete &in; }
-};
-
 static pthread_t getReadFiles(const char *readsFile)
 {
 	if (opt::verbose > 0) {
@@ -281,10 +309,9 @@ static pthread_t getReadFiles(const char *readsFile)
 
 	FastaReader* in = new FastaReader(
 			readsFile, FastaReader::FOLD_CASE);
-	WorkerArg* arg = new WorkerArg(*in, *g_pipeMux.addPipe());
 
 	pthread_t thread;
-	pthread_create(&thread, NULL, readFile, static_cast<void*>(arg));
+	pthread_create(&thread, NULL, readFile, static_cast<void*>(in));
 
 	return thread;
 }
@@ -316,6 +343,7 @@ int main(int argc, char** argv)
 			case 'v': opt::verbose++; break;
 			case 's': arg >> opt::section >> delim >>
 					  opt::nsections; break;
+			case OPT_INDEX: arg >> opt::indexPath; break;
 			case OPT_HELP:
 				cout << USAGE_MESSAGE;
 				exit(EXIT_SUCCESS);
@@ -364,23 +392,25 @@ int main(int argc, char** argv)
 		"@PG\tID:" PROGRAM "\tVN:" VERSION "\t"
 		"CL:" << commandLine << '\n';
 
-	size_t numKmer = countKmer(refFastaFile);
-	if (opt::multimap == opt::MULTIMAP) {
-		g_aligner_m = new Aligner<SeqPosHashMultiMap>(opt::k,
-				numKmer);
-		readContigsIntoDB(refFastaFile, *g_aligner_m);
-	} else {
-#if HAVE_GOOGLE_SPARSE_HASH_MAP
-		g_aligner_u = new Aligner<SeqPosHashUniqueMap>(opt::k,
-				numKmer, 0.3);
-#else
-		g_aligner_u = new Aligner<SeqPosHashUniqueMap>(opt::k,
-				numKmer);
+#if _OPENMP
+	omp_set_num_threads(opt::threads);
 #endif
-		readContigsIntoDB(refFastaFile, *g_aligner_u);
+
+	g_aligner = new Aligner<SeedIndex>(opt::k);
+	struct stat st;
+	if (opt::indexPath.empty()
+			|| stat(opt::indexPath.c_str(), &st) != 0
+			|| !readIndex(opt::indexPath, refFastaFile, *g_aligner)) {
+		readContigsIntoDB(refFastaFile, *g_aligner);
+		if (!opt::indexPath.empty())
+			writeIndex(opt::indexPath, refFastaFile, *g_aligner);
 	}
+	g_aligner->writeSAMHeader(cout);
 
 	g_readCount = 0;
+	g_producersRunning = numQuery;
+	g_workersRunning = opt::threads;
+	__sync_synchronize();
 
 	vector<pthread_t> producer_threads;
 	transform(argv + optind, argv + argc,
@@ -402,7 +432,6 @@ int main(int argc, char** argv)
 		pthread_join(producer_threads[i], &status);
 	for (size_t i = 0; i < threads.size(); i++)
 		pthread_join(threads[i], &status);
-	g_pipeOut.close();
 	pthread_join(out_thread, &status);
 
 	if (opt::verbose > 0)
@@ -410,30 +439,25 @@ int main(int argc, char** argv)
 			<< " of " << g_readCount << " reads ("
 			<< (float)100 * g_alignedCount / g_readCount << "%)\n";
 
-	if (opt::multimap == opt::MULTIMAP)
-		delete g_aligner_m;
-	else
-		delete g_aligner_u;
+	delete g_aligner;
 
 	return 0;
 }
 
-template <class SeqPosHashMap>
-static void printProgress(const Aligner<SeqPosHashMap>& align,
+static void printProgress(const Aligner<SeedIndex>& align,
 		unsigned count)
 {
-	size_t size = align.size();
-	size_t buckets = align.bucket_count();
 	cerr << "Read " << count << " contigs. "
-		"Hash load: " << size << " / " << buckets
-		<< " = " << (float)size / buckets
-		<< " using " << toSI(getMemoryUsage()) << "B." << endl;
+		"Indexed " << align.size() << " k-mer"
+		" using " << toSI(getMemoryUsage()) << "B." << endl;
 }
 
-template <class SeqPosHashMap>
 static void readContigsIntoDB(string refFastaFile,
-		Aligner<SeqPosHashMap>& aligner)
+		Aligner<SeedIndex>& aligner)
 {
+	size_t numKmer = countKmer(refFastaFile);
+	aligner.reserve(numKmer);
+
 	if (opt::verbose > 0)
 		cerr << "Reading target `" << refFastaFile << "'..." << endl;
 
@@ -452,8 +476,6 @@ static void readContigsIntoDB(string refFastaFile,
 				assert(isalpha(rec.seq[0]));
 		}
 
-		cout << "@SQ\tSN:" << rec.id
-			<< "\tLN:" << rec.seq.length() << '\n';
 		aligner.addReferenceSequence(rec.id, rec.seq);
 
 		count++;
@@ -464,6 +486,12 @@ static void readContigsIntoDB(string refFastaFile,
 	if (opt::verbose > 0)
 		printProgress(aligner, count);
 
+	if (opt::verbose > 0)
+		cerr << "Sorting the index of the target..." << endl;
+	aligner.buildIndex();
+	if (opt::verbose > 0)
+		printProgress(aligner, count);
+
 	if (opt::multimap == opt::IGNORE) {
 		// Count the number of duplicate k-mer in the target.
 		size_t duplicates = aligner.countDuplicates();
@@ -474,21 +502,150 @@ static void readContigsIntoDB(string refFastaFile,
 	}
 }
 
-/** Read each fasta record from 'in', and add it to 'pipe'. */
-static void readFile(FastaReader& in, Pipe<FastaRecord>& pipe)
+/** The signature of an index file, followed by its version. */
+static const char INDEX_MAGIC[] = "KAligner seed index ";
+
+/** The version of the format of an index file. */
+static const char INDEX_VERSION[] = "2\n";
+
+/** The target and options from which an index file was built. The
+ * path of the target follows the header. */
+struct IndexHeader
+{
+	/** The size and modification time of the target */
+	uint64_t targetSize, targetTime;
+
+	uint32_t k, multimap, section, nsections, colourSpace;
+};
+
+/** Return the header of an index of the specified target that is
+ * built with the current options. */
+static IndexHeader indexHeader(const string& targetPath)
+{
+	IndexHeader header;
+	memset(&header, 0, sizeof header);
+	struct stat st;
+	if (stat(targetPath.c_str(), &st) == 0) {
+		header.targetSize = st.st_size;
+		header.targetTime = st.st_mtime;
+	}
+	header.k = opt::k;
+	header.multimap = opt::multimap;
+	header.section = opt::section;
+	header.nsections = opt::nsections;
+	header.colourSpace = opt::colourSpace;
+	return header;
+}
+
+/** Store the index of the target. */
+static void writeIndex(const string& path, const string& targetPath,
+		const Aligner<SeedIndex>& aligner)
+{
+	if (opt::verbose > 0)
+		cerr << "Writing `" << path << "'..." << endl;
+	ofstream out(path.c_str(), ios::binary);
+	assert_good(out, path);
+	IndexHeader header = indexHeader(targetPath);
+	out << INDEX_MAGIC << INDEX_VERSION;
+	out.write(reinterpret_cast<const char*>(&header), sizeof header);
+	out << targetPath << '\n' << aligner;
+	out.close();
+	assert_good(out, path);
+}
+
+/** Load the index of the target, unless the index was built from a
+ * different target, from a target that has since been modified, or
+ * with different options.
+ * @return whether the index was loaded
+ */
+static bool readIndex(const string& path, const string& targetPath,
+		Aligner<SeedIndex>& aligner)
+{
+	if (opt::verbose > 0)
+		cerr << "Reading `" << path << "'..." << endl;
+	ifstream in(path.c_str(), ios::binary);
+	assert_good(in, path);
+	string magic(sizeof INDEX_MAGIC - 1, '\0');
+	in.read(&magic[0], magic.size());
+	if (!in || magic != INDEX_MAGIC) {
+		cerr << PROGRAM ": `" << path
+			<< "' is not a KAligner index file\n";
+		exit(EXIT_FAILURE);
+	}
+	string version;
+	getline(in, version);
+	IndexHeader header;
+	in.read(reinterpret_cast<char*>(&header), sizeof header);
+	string target;
+	getline(in, target);
+	IndexHeader expected = indexHeader(targetPath);
+	if (!in || version + '\n' != INDEX_VERSION
+			|| target != targetPath
+			|| header.targetSize != expected.targetSize
+			|| header.targetTime != expected.targetTime
+			|| header.k != expected.k
+			|| header.multimap != expected.multimap
+			|| header.section != expected.section
+			|| header.nsections != expected.nsections) {
+		cerr << PROGRAM ": `" << path << "' is not an index of the "
+			"current `" << targetPath << "' with these options, "
+			"and is rebuilt\n";
+		return false;
+	}
+	opt::colourSpace = header.colourSpace;
+	in >> aligner;
+	assert_good(in, path);
+	if (opt::verbose > 0)
+		printProgress(aligner, aligner.numContigs());
+	return true;
+}
+
+/** Wait until fewer than MAX_BATCHES batches are pending, and then
+ * add one batch to the pending batches. */
+static void reserveBatch()
 {
-	for (FastaRecord rec; in >> rec;)
-		pipe.push(rec);
+	for (unsigned attempts = 0;;) {
+		size_t n = g_pendingBatches;
+		if (n < MAX_BATCHES && __sync_bool_compare_and_swap(
+					&g_pendingBatches, n, n + 1))
+			return;
+		backoff(attempts);
+	}
+}
+
+/** Read batches of fasta records from 'in', and add them to the
+ * read queue. */
+static void readFile(FastaReader& in)
+{
+	for (;;) {
+		reserveBatch();
+		Batch* batch = new Batch;
+		batch->records.reserve(BATCH_SIZE);
+		while (batch->records.size() < BATCH_SIZE) {
+			batch->records.push_back(FastaRecord());
+			if (!(in >> batch->records.back())) {
+				batch->records.pop_back();
+				break;
+			}
+		}
+		if (batch->records.empty()) {
+			delete batch;
+			__sync_fetch_and_sub(&g_pendingBatches, 1);
+			break;
+		}
+		batch->index = __sync_fetch_and_add(&g_batchCount, 1);
+		g_readQueue.push(batch);
+	}
 	assert(in.eof());
-	pipe.close();
 }
 
 /** Producer thread. */
 static void* readFile(void* arg)
 {
-	WorkerArg* p = static_cast<WorkerArg*>(arg);
-	readFile(p->in, p->out);
-	delete p;
+	FastaReader* in = static_cast<FastaReader*>(arg);
+	readFile(*in);
+	delete in;
+	__sync_fetch_and_sub(&g_producersRunning, 1);
 	return NULL;
 }
 
@@ -502,6 +659,52 @@ static double timeDiff(const timeval& start, const timeval& end)
 	return result;
 }
 
+/** Align a query record. */
+static void alignRead(const FastaRecord& rec, ostream& out,
+		unsigned& alignedCount)
+{
+	const Sequence& seq = rec.seq;
+	ostringstream output;
+	if (seq.find_first_not_of("ACGT0123") == string::npos) {
+		if (opt::colourSpace)
+			assert(isdigit(seq[0]));
+		else
+			assert(isalpha(seq[0]));
+	}
+
+	switch (opt::format) {
+	  case KALIGNER:
+		g_aligner->alignRead(rec.id, seq,
+				affix_ostream_iterator<Alignment>(
+					output, "\t"));
+		break;
+	  case SAM:
+		g_aligner->alignRead(rec.id, seq,
+				ostream_iterator<SAMRecord>(output, "\n"));
+		break;
+	}
+
+	string s = output.str();
+	switch (opt::format) {
+	  case KALIGNER:
+		out << rec.id;
+		if (opt::printSeq) {
+			out << ' ';
+			if (opt::colourSpace)
+				out << rec.anchor;
+			out << seq;
+		}
+		out << s << '\n';
+		break;
+	  case SAM:
+		out << s;
+		break;
+	}
+	if (!s.empty())
+		alignedCount++;
+}
+
+/** Worker thread. */
 static void* alignReadsToDB(void*)
 {
 	opt::chastityFilter = false;
@@ -512,78 +715,45 @@ static void* alignReadsToDB(void*)
 	gettimeofday(&start, NULL);
 	pthread_mutex_unlock(&g_mutexCerr);
 
-	for (pair<FastaRecord, size_t> recPair = g_pipeMux.nextValue();
-			recPair.second > 0; recPair = g_pipeMux.nextValue()) {
-		const FastaRecord& rec = recPair.first;
-		const Sequence& seq = rec.seq;
-		ostringstream output;
-		if (seq.find_first_not_of("ACGT0123") == string::npos) {
-			if (opt::colourSpace)
-				assert(isdigit(seq[0]));
-			else
-				assert(isalpha(seq[0]));
-		}
-
-		switch (opt::format) {
-		  case KALIGNER:
-			if (opt::multimap == opt::MULTIMAP)
-				g_aligner_m->alignRead(rec.id, seq,
-						affix_ostream_iterator<Alignment>(
-							output, "\t"));
-			else
-				g_aligner_u->alignRead(rec.id, seq,
-						affix_ostream_iterator<Alignment>(
-							output, "\t"));
-			break;
-		  case SAM:
-			if (opt::multimap == opt::MULTIMAP)
-				g_aligner_m->alignRead(rec.id, seq,
-						ostream_iterator<SAMRecord>(output, "\n"));
-			else
-				g_aligner_u->alignRead(rec.id, seq,
-						ostream_iterator<SAMRecord>(output, "\n"));
-			break;
-		}
-
-		ostringstream out;
-		string s = output.str();
-		switch (opt::format) {
-		  case KALIGNER:
-			out << rec.id;
-			if (opt::printSeq) {
-				out << ' ';
-				if (opt::colourSpace)
-					out << rec.anchor;
-				out << seq;
+	for (unsigned attempts = 0;;) {
+		Batch* batch;
+		if (!g_readQueue.tryPop(batch)) {
+			// Check the queue once more after the producers finish.
+			if (!finished(g_producersRunning)) {
+				backoff(attempts);
+				continue;
 			}
-			out << s << '\n';
-			break;
-		  case SAM:
-			out << s;
-			break;
+			if (!g_readQueue.tryPop(batch))
+				break;
 		}
-		g_pipeOut.push(OutData(out.str(), recPair.second));
+		attempts = 0;
 
-		// Prevent the priority_queue from growing too large by
-		// waiting for threads going far too slow.
-		pthread_mutex_lock(&g_mutexPqSize);
-		if (g_pqSize >= MAX_PQ_SIZE)
-			pthread_cond_wait(&g_pqSize_cv, &g_mutexPqSize);
-		pthread_mutex_unlock(&g_mutexPqSize);
+		ostringstream out;
+		unsigned alignedCount = 0;
+		for (vector<FastaRecord>::const_iterator it
+				= batch->records.begin();
+				it != batch->records.end(); ++it)
+			alignRead(*it, out, alignedCount);
+		g_outQueue.push(new OutData(out.str(), batch->index));
 
 		if (opt::verbose > 0) {
 			pthread_mutex_lock(&g_mutexCerr);
-			if (!s.empty())
-				g_alignedCount++;
-			if (++g_readCount % 1000000 == 0) {
+			g_alignedCount += alignedCount;
+			static unsigned reported;
+			g_readCount += batch->records.size();
+			if (g_readCount - reported >= 1000000) {
 				gettimeofday(&end, NULL);
 				double result = timeDiff(start, end);
 				cerr << "Aligned " << g_readCount << " reads at "
-					<< (int)(1000000 / result) << " reads/sec.\n";
+					<< (int)((g_readCount - reported) / result)
+					<< " reads/sec.\n";
 				start = end;
+				reported = g_readCount;
 			}
 			pthread_mutex_unlock(&g_mutexCerr);
 		}
+		delete batch;
 	}
+	__sync_fetch_and_sub(&g_workersRunning, 1);
 	return NULL;
 }
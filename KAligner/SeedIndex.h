@@ -0,0 +1,372 @@
+#ifndef SEEDINDEX_H
+#define SEEDINDEX_H 1
+
+#include "KAligner/Options.h"
+#include "Kmer.h"
+#include "Sequence.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef> // for ptrdiff_t
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/** A tuple of a target ID and position. */
+struct Position
+{
+	/** The target ID of a duplicate seed. */
+	static const uint32_t DUPLICATE = (uint32_t(1) << 31) - 1;
+
+	/** The target ID of a seed that is removed from the index. */
+	static const uint32_t REMOVED = DUPLICATE - 1;
+
+	/** The number of target IDs. */
+	static const uint32_t MAX_CONTIGS = REMOVED;
+
+	uint32_t contig : 31;
+
+	/** Whether the k-mer of the target is the reverse complement
+	 * of the k-mer of the index */
+	uint32_t rc : 1;
+
+	uint32_t pos; // 0 indexed
+
+	Position(uint32_t contig = DUPLICATE,
+			uint32_t pos = std::numeric_limits<uint32_t>::max())
+		: contig(contig), rc(false), pos(pos) { }
+
+	/** Mark this seed as a duplicate. */
+	void setDuplicate(const char* thisContig, const char* otherContig,
+			const Sequence& kmer)
+	{
+		if (opt::multimap == opt::IGNORE)
+			contig = DUPLICATE;
+		else {
+			std::cerr << "error: duplicate k-mer in "
+				<< thisContig
+				<< " also in "
+				<< otherContig
+				<< ": " << kmer << '\n';
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/** Return whether this seed is a duplciate. */
+	bool isDuplicate() const
+	{
+		return contig == DUPLICATE;
+	}
+
+	/** Compare the order in which seeds occur in the target. */
+	bool operator<(const Position& o) const
+	{
+		return contig != o.contig ? contig < o.contig : pos < o.pos;
+	}
+};
+
+/**
+ * An index of the k-mer of a target sequence, which maps each k-mer
+ * to its positions in the target.
+ *
+ * The seeds are stored in a flat array sorted by k-mer, so that a
+ * seed uses no more memory than its k-mer and position. A directory
+ * of the offset of the seeds of each prefix of the k-mer, up to 12
+ * bases long, narrows the binary search of a lookup to a few seeds.
+ *
+ * When the seeds are unique, a k-mer and its reverse complement
+ * share a single seed, which is stored by the lesser of the two
+ * k-mer and records the orientation in which it occurs in the target.
+ */
+class SeedIndex
+{
+  public:
+	typedef std::pair<Kmer, Position> value_type;
+	typedef std::vector<value_type>::const_iterator const_iterator;
+	typedef const_iterator iterator;
+
+	/** A seed and its duplicate that occurs later in the target. */
+	typedef std::pair<value_type, value_type> Duplicate;
+
+	SeedIndex()
+		: m_unique(false), m_prefixLength(0), m_hasDuplicate(false) { }
+
+	void reserve(size_t n) { m_seeds.reserve(n); }
+
+	/** Add the specified seed, which follows the seeds already added
+	 * in the target. */
+	void insert(const value_type& x) { m_seeds.push_back(x); }
+
+	/** Sort the seeds in parallel and build the directory.
+	 * @param unique if true, keep only the first occurrence of each
+	 * k-mer or its reverse complement, and mark it as a duplicate
+	 * if the k-mer occurs more than once
+	 */
+	void build(bool unique)
+	{
+		m_unique = unique;
+		if (m_unique)
+			canonicalize();
+		setPrefixLength();
+		sortSeeds();
+		if (m_unique) {
+			removeDuplicates();
+			buildDirectory();
+		}
+	}
+
+	/** Return the range of the seeds of the specified k-mer. */
+	std::pair<const_iterator, const_iterator>
+	equal_range(const Kmer& key) const
+	{
+		if (!m_unique)
+			return find(key);
+		Kmer rc = reverseComplement(key);
+		bool isRC = rc < key;
+		std::pair<const_iterator, const_iterator> range
+			= find(isRC ? rc : key);
+		if (range.first != range.second
+				&& !range.first->second.isDuplicate()
+				&& range.first->second.rc != isRC)
+			range.second = range.first;
+		return range;
+	}
+
+	const_iterator begin() const { return m_seeds.begin(); }
+	const_iterator end() const { return m_seeds.end(); }
+	size_t size() const { return m_seeds.size(); }
+
+	/** Return whether a k-mer of the target is duplicated when the
+	 * seeds are unique. */
+	bool hasDuplicate() const { return m_hasDuplicate; }
+
+	/** Return the first seed of the target that is duplicated, and
+	 * the first duplicate of that seed. */
+	const Duplicate& firstDuplicate() const
+	{
+		assert(m_hasDuplicate);
+		return m_firstDuplicate;
+	}
+
+	/** Store this index. */
+	friend std::ostream& operator<<(std::ostream& out,
+			const SeedIndex& o)
+	{
+		uint64_t header[3] = { o.m_seeds.size(), sizeof (value_type),
+			o.m_unique };
+		out.write(reinterpret_cast<const char*>(header), sizeof header);
+		out.write(reinterpret_cast<const char*>(&o.m_seeds[0]),
+				o.m_seeds.size() * sizeof (value_type));
+		return out;
+	}
+
+	/** Load this index. */
+	friend std::istream& operator>>(std::istream& in, SeedIndex& o)
+	{
+		uint64_t header[3];
+		if (!in.read(reinterpret_cast<char*>(header), sizeof header))
+			return in;
+		if (header[1] != sizeof (value_type)) {
+			std::cerr << "error: the seed index was built with a "
+				"different maximum k-mer size\n";
+			exit(EXIT_FAILURE);
+		}
+		o.m_unique = header[2];
+		o.m_seeds.resize(header[0]);
+		in.read(reinterpret_cast<char*>(&o.m_seeds[0]),
+				o.m_seeds.size() * sizeof (value_type));
+		o.m_hasDuplicate = false;
+		o.setPrefixLength();
+		o.buildDirectory();
+		return in;
+	}
+
+  private:
+	typedef std::vector<value_type>::iterator seed_iterator;
+
+	/** Order seeds by k-mer and then by position. */
+	struct CompareSeed {
+		bool operator()(const value_type& a, const value_type& b) const
+		{
+			int c = a.first.compare(b.first);
+			return c != 0 ? c < 0 : a.second < b.second;
+		}
+	};
+
+	/** Order seeds by k-mer. */
+	struct CompareKmer {
+		bool operator()(const value_type& a, const Kmer& b) const
+		{
+			return a.first < b;
+		}
+		bool operator()(const Kmer& a, const value_type& b) const
+		{
+			return a < b.first;
+		}
+	};
+
+	/** Return the range of the seeds whose k-mer is key. */
+	std::pair<const_iterator, const_iterator>
+	find(const Kmer& key) const
+	{
+		size_t p = prefix(key);
+		return std::equal_range(m_seeds.begin() + m_dir[p],
+				m_seeds.begin() + m_dir[p + 1], key, CompareKmer());
+	}
+
+	/** Return the code of the first bases of the k-mer. */
+	size_t prefix(const Kmer& kmer) const
+	{
+		size_t code = 0;
+		for (unsigned i = 0; i < m_prefixLength; ++i)
+			code = code << 2 | kmer.at(i);
+		return code;
+	}
+
+	/** Choose the length of the prefix of the directory, so that
+	 * a prefix has eight seeds on average. */
+	void setPrefixLength()
+	{
+		m_prefixLength = std::min(Kmer::length(), 12u);
+		while (m_prefixLength > 1
+				&& size_t(8) << 2 * m_prefixLength > m_seeds.size())
+			m_prefixLength--;
+	}
+
+	/** Store each seed by the lesser of its k-mer and the reverse
+	 * complement of its k-mer. */
+	void canonicalize()
+	{
+		ptrdiff_t n = m_seeds.size();
+#pragma omp parallel for
+		for (ptrdiff_t i = 0; i < n; ++i) {
+			value_type& x = m_seeds[i];
+			Kmer rc = reverseComplement(x.first);
+			if (rc < x.first) {
+				x.first = rc;
+				x.second.rc = true;
+			}
+		}
+	}
+
+	/** Sort the seeds. The seeds are first moved in place to the
+	 * bucket of their first few bases, and the buckets are then
+	 * sorted in parallel. */
+	void sortSeeds()
+	{
+		const unsigned bases = std::min(m_prefixLength, 4u);
+		const unsigned shift = 2 * (m_prefixLength - bases);
+		const size_t n = size_t(1) << 2 * bases;
+		std::vector<size_t> first(n + 1), next(n);
+		for (const_iterator it = m_seeds.begin();
+				it != m_seeds.end(); ++it)
+			first[(prefix(it->first) >> shift) + 1]++;
+		for (size_t b = 1; b <= n; ++b)
+			first[b] += first[b - 1];
+		std::copy(first.begin(), first.end() - 1, next.begin());
+		for (size_t b = 0; b < n; ++b) {
+			while (next[b] < first[b + 1]) {
+				size_t d = prefix(m_seeds[next[b]].first) >> shift;
+				if (d == b)
+					next[b]++;
+				else
+					std::swap(m_seeds[next[b]], m_seeds[next[d]++]);
+			}
+		}
+
+#pragma omp parallel for schedule(dynamic)
+		for (ptrdiff_t b = 0; b < ptrdiff_t(n); ++b)
+			std::sort(m_seeds.begin() + first[b],
+					m_seeds.begin() + first[b + 1], CompareSeed());
+		buildDirectory();
+	}
+
+	/** Keep the first occurrence of each k-mer, and mark it as a
+	 * duplicate if the k-mer occurs more than once. */
+	void removeDuplicates()
+	{
+		m_hasDuplicate = false;
+		ptrdiff_t n = m_dir.size() - 1;
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (ptrdiff_t b = 0; b < n; ++b) {
+			seed_iterator end = m_seeds.begin() + m_dir[b + 1];
+			for (seed_iterator first = m_seeds.begin() + m_dir[b];
+					first != end;) {
+				seed_iterator last = first + 1;
+				while (last != end && last->first == first->first)
+					++last;
+				if (last - first > 1) {
+					recordDuplicate(first[0], first[1]);
+					for (seed_iterator it = first + 1; it != last; ++it)
+						it->second.contig = Position::REMOVED;
+					first->second.contig = Position::DUPLICATE;
+				}
+				first = last;
+			}
+		}
+
+		seed_iterator out = m_seeds.begin();
+		for (const_iterator it = m_seeds.begin();
+				it != m_seeds.end(); ++it)
+			if (it->second.contig != Position::REMOVED)
+				*out++ = *it;
+		m_seeds.erase(out, m_seeds.end());
+	}
+
+	/** Return the seed in the orientation in which it occurs in the
+	 * target. */
+	static value_type orient(value_type x)
+	{
+		if (x.second.rc) {
+			x.first.reverseComplement();
+			x.second.rc = false;
+		}
+		return x;
+	}
+
+	/** Record the duplicate that occurs first in the target. */
+	void recordDuplicate(const value_type& first,
+			const value_type& second)
+	{
+#pragma omp critical(recordDuplicate)
+		if (!m_hasDuplicate
+				|| second.second < m_firstDuplicate.second.second) {
+			m_hasDuplicate = true;
+			m_firstDuplicate = Duplicate(orient(first), orient(second));
+		}
+	}
+
+	/** Count the seeds of each prefix and store the offset of the
+	 * first seed of each prefix. */
+	void buildDirectory()
+	{
+		m_dir.assign((size_t(1) << 2 * m_prefixLength) + 1, 0);
+		for (const_iterator it = m_seeds.begin();
+				it != m_seeds.end(); ++it)
+			m_dir[prefix(it->first) + 1]++;
+		for (size_t i = 1; i < m_dir.size(); ++i)
+			m_dir[i] += m_dir[i - 1];
+	}
+
+	/** The seeds sorted by k-mer and then by position */
+	std::vector<value_type> m_seeds;
+
+	/** Whether a k-mer and its reverse complement share one seed */
+	bool m_unique;
+
+	/** The number of bases of the prefix of the directory */
+	unsigned m_prefixLength;
+
+	/** The offset of the first seed of each prefix */
+	std::vector<size_t> m_dir;
+
+	/** Whether a k-mer is duplicated when the seeds are unique */
+	bool m_hasDuplicate;
+
+	/** The first duplicate k-mer of the target */
+	Duplicate m_firstDuplicate;
+};
+
+#endif
@@ -8,6 +8,7 @@
 
 #include "Common/IOUtil.h"
 #include "Common/Kmer.h"
+#include "Common/RollingHash.h"
 #include "Common/SeqExt.h" // for NUM_BASES
 #include "Graph/Properties.h"
 #include "Common/Uncompress.h"
@@ -68,6 +69,40 @@ struct DBGBloomIndexMap
 	}
 };
 
+/** Return whether the vertex with the specified hash exists. */
+template <typename BF>
+static inline bool
+vertex_exists_hash(size_t hash, const DBGBloom<BF>& g)
+{
+	return g.m_bloom[hash % g.m_bloom.size()] > g.m_depthThresh;
+}
+
+/**
+ * Return a bit mask of the neighbours of the specified vertex that
+ * are present in the graph, in which bit i is set when the
+ * neighbour with base i exists. The hashes of the neighbours are
+ * computed from a single rolling hash of u, and the four Bloom
+ * filter probes are independent of one another.
+ * @param dir SENSE for successors and ANTISENSE for predecessors
+ */
+template <typename BF>
+static inline unsigned
+neighbourMask(const DBGBloom<BF>& g, const Kmer& u, extDirection dir)
+{
+	size_t hashes[NUM_BASES];
+	RollingHash h(u);
+	if (dir == SENSE)
+		h.successors(u.at(0), hashes);
+	else
+		h.predecessors(u.at(Kmer::length() - 1), hashes);
+
+	unsigned mask = 0;
+	for (unsigned i = 0; i < NUM_BASES; ++i)
+		if (vertex_exists_hash(hashes[i], g))
+			mask |= 1 << i;
+	return mask;
+}
+
 // Graph
 
 namespace boost {
@@ -109,18 +144,17 @@ struct adjacency_iterator
 	/** Skip to the next edge that is present. */
 	void next()
 	{
-		for (; m_i < NUM_BASES; ++m_i) {
+		for (; m_i < NUM_BASES && !(m_mask & 1 << m_i); ++m_i)
+			;
+		if (m_i < NUM_BASES)
 			m_v.setLastBase(SENSE, m_i);
-			if (vertex_exists(m_v, m_g))
-				break;
-		}
 	}
 
   public:
-	adjacency_iterator(const DBGBloom<BF>& g) : m_g(g), m_i(NUM_BASES) { }
+	adjacency_iterator(const DBGBloom<BF>&) : m_i(NUM_BASES), m_mask(0) { }
 
 	adjacency_iterator(const DBGBloom<BF>& g, vertex_descriptor u)
-		: m_g(g), m_v(u), m_i(0)
+		: m_v(u), m_i(0), m_mask(neighbourMask(g, u, SENSE))
 	{
 		m_v.shift(SENSE);
 		next();
@@ -151,9 +185,9 @@ struct adjacency_iterator
 	}
 
   private:
-	const DBGBloom<BF>& m_g;
 	vertex_descriptor m_v;
 	short unsigned m_i;
+	unsigned m_mask;
 }; // adjacency_iterator
 
 /** IncidenceGraph */
@@ -163,20 +197,19 @@ struct out_edge_iterator
 	/** Skip to the next edge that is present. */
 	void next()
 	{
-		for (; m_i < NUM_BASES; ++m_i) {
+		for (; m_i < NUM_BASES && !(m_mask & 1 << m_i); ++m_i)
+			;
+		if (m_i < NUM_BASES)
 			m_v.setLastBase(SENSE, m_i);
-			if (vertex_exists(m_v, *m_g))
-				break;
-		}
 	}
 
   public:
 	out_edge_iterator() { }
 
-	out_edge_iterator(const DBGBloom<BF>& g) : m_g(&g), m_i(NUM_BASES) { }
+	out_edge_iterator(const DBGBloom<BF>&) : m_i(NUM_BASES), m_mask(0) { }
 
 	out_edge_iterator(const DBGBloom<BF>& g, vertex_descriptor u)
-		: m_g(&g), m_u(u), m_v(u), m_i(0)
+		: m_u(u), m_v(u), m_i(0), m_mask(neighbourMask(g, u, SENSE))
 	{
 		m_v.shift(SENSE);
 		next();
@@ -214,10 +247,10 @@ struct out_edge_iterator
 	}
 
   private:
-	const DBGBloom<BF>* m_g;
 	vertex_descriptor m_u;
 	vertex_descriptor m_v;
 	unsigned m_i;
+	unsigned m_mask;
 }; // out_edge_iterator
 
 /** BidirectionalGraph */
@@ -227,20 +260,19 @@ struct in_edge_iterator
 	/** Skip to the next edge that is present. */
 	void next()
 	{
-		for (; m_i < NUM_BASES; ++m_i) {
+		for (; m_i < NUM_BASES && !(m_mask & 1 << m_i); ++m_i)
+			;
+		if (m_i < NUM_BASES)
 			m_v.setLastBase(ANTISENSE, m_i);
-			if (vertex_exists(m_v, *m_g))
-				break;
-		}
 	}
 
   public:
 	in_edge_iterator() { }
 
-	in_edge_iterator(const DBGBloom<BF>& g) : m_g(&g), m_i(NUM_BASES) { }
+	in_edge_iterator(const DBGBloom<BF>&) : m_i(NUM_BASES), m_mask(0) { }
 
 	in_edge_iterator(const DBGBloom<BF>& g, vertex_descriptor u)
-		: m_g(&g), m_u(u), m_v(u), m_i(0)
+		: m_u(u), m_v(u), m_i(0), m_mask(neighbourMask(g, u, ANTISENSE))
 	{
 		m_v.shift(ANTISENSE);
 		next();
@@ -278,10 +310,10 @@ struct in_edge_iterator
 	}
 
   private:
-	const DBGBloom<BF>* m_g;
 	vertex_descriptor m_u;
 	vertex_descriptor m_v;
 	unsigned m_i;
+	unsigned m_mask;
 }; // in_edge_iterator
 
 }; // graph_traits<DBGBloom>
@@ -356,6 +388,15 @@ in_edges(
 	return std::make_pair(Iit(g, u), Iit(g));
 }
 
+template <typename Graph>
+static inline
+typename graph_traits<Graph>::degree_size_type
+degree(typename graph_traits<Graph>::vertex_descriptor u,
+		const Graph& g)
+{
+	return in_degree(u, g) + out_degree(u, g);
+}
+
 // VertexListGraph
 template <typename Graph>
 static inline
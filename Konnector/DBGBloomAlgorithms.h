@@ -7,6 +7,7 @@
 
 #include "Common/Kmer.h"
 #include "Common/KmerIterator.h"
+#include "Common/RollingHash.h"
 #include "Common/Warnings.h"
 #include "DBGBloom.h"
 #include "Common/StringUtil.h"
@@ -15,6 +16,7 @@
 #include "Graph/Path.h"
 #include <climits>
 #include <algorithm> // for std::max
+#include <cstring> // for strchr
 #define NO_MATCH UINT_MAX
 
 static inline Sequence pathToSeq(Path<Kmer> path)
@@ -110,6 +112,37 @@ public:
 
 };
 
+/**
+ * Compute the rolling hashes of the k-mers of a sequence. Characters
+ * other than ACGT are hashed as A.
+ * @param codes [out] the base code of each position
+ * @param invalid [out] invalid[i] is the number of characters other
+ * than ACGT preceding position i
+ * @param hashes [out] the hash of the k-mer starting at each position
+ */
+static inline void hashKmers(const Sequence& seq, unsigned k,
+		std::vector<uint8_t>& codes, std::vector<unsigned>& invalid,
+		std::vector<RollingHash>& hashes)
+{
+	assert(k == Kmer::length());
+	assert(seq.length() >= k);
+	codes.resize(seq.length());
+	invalid.assign(seq.length() + 1, 0);
+	for (size_t i = 0; i < seq.length(); i++) {
+		bool valid = strchr("ACGTacgt", seq[i]) != NULL && seq[i] != 0;
+		codes[i] = valid ? baseToCode(seq[i]) : 0;
+		invalid[i + 1] = invalid[i] + !valid;
+	}
+
+	hashes.clear();
+	hashes.reserve(seq.length() - k + 1);
+	hashes.push_back(RollingHash(&codes[0]));
+	for (size_t i = 1; i < seq.length() - k + 1; i++) {
+		hashes.push_back(hashes.back());
+		hashes.back().rollRight(codes[i - 1], codes[i + k - 1]);
+	}
+}
+
 template<typename Graph>
 static inline bool correctSingleBaseError(const Graph& g, unsigned k,
 		FastaRecord& read, size_t& correctedPos, bool rc = false)
@@ -118,29 +151,38 @@ static inline bool correctSingleBaseError(const Graph& g, unsigned k,
 		return false;
 
 	SUPPRESS_UNUSED_WARNING(correctedPos);
+	// The Bloom filter hash of a k-mer and of its reverse complement
+	// are equal.
+	SUPPRESS_UNUSED_WARNING(rc);
 
 	const std::string bases = "AGCT";
 	const size_t minScore = 3;
 	std::vector<BaseChangeScore> scores;
 
+	// Hash the k-mers of the read once, and derive the hash of each
+	// k-mer with a changed base from the hash of the original k-mer.
+	std::vector<uint8_t> codes;
+	std::vector<unsigned> invalid;
+	std::vector<RollingHash> hashes;
+	hashKmers(read.seq, k, codes, invalid, hashes);
+
 	for (size_t i = 0; i < read.seq.length(); i++) {
 
+		// Score the k-mers that overlap position i.
 		size_t overlapStart = std::max((int) (i - k + 1), 0);
-		size_t overlapEnd = std::min(i + k - 1, read.seq.length() - 1);
-		assert(overlapStart < overlapEnd);
-		Sequence overlapStr = read.seq.substr(overlapStart,
-				overlapEnd - overlapStart + 1);
-		size_t changePos = i - overlapStart;
+		size_t overlapEnd = std::min(i, read.seq.length() - k);
+		unsigned invalidBase = invalid[i + 1] - invalid[i];
 
 		for (size_t j = 0; j < bases.size(); j++) {
 			if (read.seq[i] == bases[j])
 				continue;
-			overlapStr[changePos] = bases[j];
+			uint8_t base = baseToCode(bases[j]);
 			size_t score = 0;
-			for (KmerIterator it(overlapStr, k, rc); it != KmerIterator::end();
-					it++)
-			{
-				if (vertex_exists(*it, g))
+			for (size_t pos = overlapStart; pos <= overlapEnd; pos++) {
+				if (invalid[pos + k] - invalid[pos] != invalidBase)
+					continue;
+				if (vertex_exists_hash(hashes[pos].substitute(
+								i - pos, codes[i], base), g))
 					score++;
 			}
 			if (score > minScore)
@@ -167,6 +209,54 @@ static inline bool correctSingleBaseError(const Graph& g, unsigned k,
 	return true;
 }
 
+/** Return whether every k-mer of the sequence is in the graph. */
+template<typename Graph>
+static inline bool allKmersExist(const Graph& g, unsigned k,
+		const Sequence& seq)
+{
+	if (seq.length() < k)
+		return true;
+	std::vector<uint8_t> codes;
+	std::vector<unsigned> invalid;
+	std::vector<RollingHash> hashes;
+	hashKmers(seq, k, codes, invalid, hashes);
+	for (size_t i = 0; i < hashes.size(); i++)
+		if (invalid[i + k] == invalid[i]
+				&& !vertex_exists_hash(hashes[i].hash(), g))
+			return false;
+	return true;
+}
+
+/**
+ * Correct the single-base errors of a read one at a time, until
+ * every k-mer of the read is in the graph. The read is not modified
+ * unless it is corrected completely.
+ * @param maxCorrections the maximum number of bases to change
+ * @param numCorrected [out] the number of bases changed
+ * @return whether every k-mer of the resulting read is in the graph
+ */
+template<typename Graph>
+static inline bool correctErrors(const Graph& g, unsigned k,
+		FastaRecord& read, unsigned maxCorrections,
+		unsigned& numCorrected)
+{
+	numCorrected = 0;
+	if (allKmersExist(g, k, read.seq))
+		return true;
+	Sequence orig = read.seq;
+	for (unsigned n = 1; n <= maxCorrections; n++) {
+		size_t pos;
+		if (!correctSingleBaseError(g, k, read, pos))
+			break;
+		if (allKmersExist(g, k, read.seq)) {
+			numCorrected = n;
+			return true;
+		}
+	}
+	read.seq = orig;
+	return false;
+}
+
 /** Uppercase only bases that are present in original reads.
  *  @return number of mis-matching bases. */
 static inline unsigned maskNew(const FastaRecord& read1,
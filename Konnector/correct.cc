@@ -0,0 +1,352 @@
+/**
+ * Correct read errors using a Bloom filter de Bruijn graph
+ * Copyright 2014 Canada's Michael Smith Genome Science Centre
+ */
+
+#include "config.h"
+
+#include "Bloom/CascadingBloomFilter.h"
+#include "DBGBloom.h"
+#include "DBGBloomAlgorithms.h"
+
+#include "Common/IOUtil.h"
+#include "Common/Options.h"
+#include "Common/ParallelBatches.h"
+#include "Common/StringUtil.h"
+#include "DataLayer/FastaConcat.h"
+#include "DataLayer/Options.h"
+
+#include <cassert>
+#include <fstream>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#if _OPENMP
+# include <omp.h>
+# include "Bloom/ConcurrentBloomFilter.h"
+#endif
+
+using namespace std;
+
+#define PROGRAM "abyss-bloom-correct"
+
+static const char VERSION_MESSAGE[] =
+PROGRAM " (" PACKAGE_NAME ") " VERSION "\n"
+"\n"
+"Copyright 2014 Canada's Michael Smith Genome Science Centre\n";
+
+static const char USAGE_MESSAGE[] =
+"Usage: " PROGRAM " -k <kmer_size> [options]... <reads1> [reads2]...\n"
+"Correct the single-base errors of the reads using a Bloom filter\n"
+"de Bruijn graph of the k-mers that occur at least twice, and write\n"
+"the reads in their original order.\n"
+"\n"
+" Options:\n"
+"\n"
+"  -j, --threads=N            use N parallel threads [1]\n"
+"  -k, --kmer=N               the size of a k-mer\n"
+"  -b, --bloom-size=N         size of bloom filter [500M]\n"
+"  -i, --input-bloom=FILE     load bloom filter from FILE\n"
+"  -c, --max-corrections=N    change at most N bases of a read [4]\n"
+"  -o, --out=FILE             write the reads to FILE [stdout]\n"
+"      --fasta                write FASTA format\n"
+"      --fastq                write FASTQ format, or FASTA when the\n"
+"                             reads have no quality [default]\n"
+"      --chastity             discard unchaste reads [default]\n"
+"      --no-chastity          do not discard unchaste reads\n"
+"      --trim-masked          trim masked bases from the ends of reads\n"
+"      --no-trim-masked       do not trim masked bases from the ends\n"
+"                             of reads [default]\n"
+"  -q, --trim-quality=N       trim bases from the ends of reads whose\n"
+"                             quality is less than the threshold\n"
+"      --standard-quality     zero quality is `!' (33)\n"
+"                             default for FASTQ and SAM files\n"
+"      --illumina-quality     zero quality is `@' (64)\n"
+"                             default for qseq and export files\n"
+"  -v, --verbose              display verbose output\n"
+"      --help                 display this help and exit\n"
+"      --version              output version information and exit\n"
+"\n"
+"Report bugs to <" PACKAGE_BUGREPORT ">.\n";
+
+/** The number of reads that are read and corrected at once. */
+const unsigned g_batchSize = 10000;
+
+namespace opt {
+
+	/** The number of parallel threads. */
+	static unsigned threads = 1;
+
+	/** The size of the bloom filter in bytes. */
+	static size_t bloomSize = 500 * 1024 * 1024;
+
+	/** Input bloom filter file (if empty, build bloom filter) */
+	static string inputBloomPath;
+
+	/** The maximum number of bases to change in a read. */
+	static unsigned maxCorrections = 4;
+
+	/** The output path. */
+	static string outPath("-");
+
+	/** Write FASTA rather than FASTQ. */
+	static int fasta;
+
+	/** The size of a k-mer. */
+	unsigned k;
+}
+
+static const char shortopts[] = "b:c:i:j:k:o:q:v";
+
+enum { OPT_HELP = 1, OPT_VERSION };
+
+static const struct option longopts[] = {
+	{ "bloom-size",       required_argument, NULL, 'b' },
+	{ "max-corrections",  required_argument, NULL, 'c' },
+	{ "input-bloom",      required_argument, NULL, 'i' },
+	{ "threads",          required_argument, NULL, 'j' },
+	{ "kmer",             required_argument, NULL, 'k' },
+	{ "out",              required_argument, NULL, 'o' },
+	{ "fasta",            no_argument, &opt::fasta, 1 },
+	{ "fastq",            no_argument, &opt::fasta, 0 },
+	{ "chastity",         no_argument, &opt::chastityFilter, 1 },
+	{ "no-chastity",      no_argument, &opt::chastityFilter, 0 },
+	{ "trim-masked",      no_argument, &opt::trimMasked, 1 },
+	{ "no-trim-masked",   no_argument, &opt::trimMasked, 0 },
+	{ "trim-quality",     required_argument, NULL, 'q' },
+	{ "standard-quality", no_argument, &opt::qualityOffset, 33 },
+	{ "illumina-quality", no_argument, &opt::qualityOffset, 64 },
+	{ "verbose",          no_argument, NULL, 'v' },
+	{ "help",             no_argument, NULL, OPT_HELP },
+	{ "version",          no_argument, NULL, OPT_VERSION },
+	{ NULL, 0, NULL, 0 }
+};
+
+/** Counters */
+static struct {
+	size_t reads;
+	size_t noErrors;
+	size_t corrected;
+	size_t uncorrected;
+	size_t bases;
+} g_count;
+
+/** Correct the batches of reads of a stream. */
+template <typename Graph, typename FastaStream>
+class CorrectWorker
+{
+  public:
+	typedef NoWorkspace Workspace;
+
+	CorrectWorker(const Graph& g, FastaStream& in, ostream& out)
+		: m_g(g), m_in(in), m_out(out)
+	{
+		for (unsigned i = 0; i < 2; i++) {
+			m_reads[i].resize(g_batchSize);
+			m_numCorrected[i].resize(g_batchSize);
+		}
+	}
+
+	/** Read a batch of reads.
+	 * @return the number of reads read
+	 */
+	unsigned read(unsigned buf)
+	{
+		vector<FastqRecord>& reads = m_reads[buf];
+		unsigned n = 0;
+		while (n < reads.size() && m_in >> reads[n])
+			n++;
+		return n;
+	}
+
+	/** Correct a read. */
+	void process(unsigned buf, unsigned i, Workspace&)
+	{
+		unsigned bases;
+		m_numCorrected[buf][i] = correctErrors(m_g, opt::k,
+				m_reads[buf][i], opt::maxCorrections, bases)
+			? bases : -1;
+	}
+
+	/** Write a batch of reads and count the corrections. */
+	void write(unsigned buf, unsigned n)
+	{
+		for (unsigned i = 0; i < n; i++) {
+			const FastqRecord& read = m_reads[buf][i];
+			if (opt::fasta)
+				m_out << (const FastaRecord&)read;
+			else
+				m_out << read;
+			int numCorrected = m_numCorrected[buf][i];
+			g_count.reads++;
+			if (numCorrected < 0) {
+				g_count.uncorrected++;
+			} else if (numCorrected == 0) {
+				g_count.noErrors++;
+			} else {
+				g_count.corrected++;
+				g_count.bases += numCorrected;
+			}
+			if (opt::verbose > 1 && g_count.reads % 100000 == 0)
+				cerr << "Processed " << g_count.reads << " reads\n";
+		}
+	}
+
+  private:
+	const Graph& m_g;
+	FastaStream& m_in;
+	ostream& m_out;
+	vector<FastqRecord> m_reads[2];
+	vector<int> m_numCorrected[2];
+};
+
+/** Correct the reads of the specified stream and write them in
+ * their original order. */
+template <typename Graph, typename FastaStream>
+static void correctReads(const Graph& g, FastaStream& in, ostream& out)
+{
+	CorrectWorker<Graph, FastaStream> worker(g, in, out);
+	processBatches(worker);
+}
+
+/**
+ * Correct read errors using a Bloom filter de Bruijn graph
+ */
+int main(int argc, char** argv)
+{
+	bool die = false;
+
+	for (int c; (c = getopt_long(argc, argv,
+					shortopts, longopts, NULL)) != -1;) {
+		istringstream arg(optarg != NULL ? optarg : "");
+		switch (c) {
+		  case '?':
+			die = true; break;
+		  case 'b':
+			opt::bloomSize = SIToBytes(arg); break;
+		  case 'c':
+			arg >> opt::maxCorrections; break;
+		  case 'i':
+			arg >> opt::inputBloomPath; break;
+		  case 'j':
+			arg >> opt::threads; break;
+		  case 'k':
+			arg >> opt::k; break;
+		  case 'o':
+			arg >> opt::outPath; break;
+		  case 'q':
+			arg >> opt::qualityThreshold; break;
+		  case 'v':
+			opt::verbose++; break;
+		  case OPT_HELP:
+			cout << USAGE_MESSAGE;
+			exit(EXIT_SUCCESS);
+		  case OPT_VERSION:
+			cout << VERSION_MESSAGE;
+			exit(EXIT_SUCCESS);
+		}
+		if (optarg != NULL && (!arg.eof() || arg.fail())) {
+			cerr << PROGRAM ": invalid option: `-"
+				<< (char)c << optarg << "'\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (opt::k == 0) {
+		cerr << PROGRAM ": missing mandatory option `-k'\n";
+		die = true;
+	}
+
+	if (argc - optind < 1) {
+		cerr << PROGRAM ": missing input file arguments\n";
+		die = true;
+	}
+
+	if (die) {
+		cerr << "Try `" << PROGRAM
+			<< " --help' for more information.\n";
+		exit(EXIT_FAILURE);
+	}
+
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
+	Kmer::setLength(opt::k);
+
+	assert(opt::bloomSize > 0);
+
+	BloomFilter bloom;
+
+	if (!opt::inputBloomPath.empty()) {
+
+		if (opt::verbose)
+			std::cerr << "Loading bloom filter from `"
+				<< opt::inputBloomPath << "'...\n";
+
+		const char* inputPath = opt::inputBloomPath.c_str();
+		ifstream inputBloom(inputPath, ios_base::in | ios_base::binary);
+		assert_good(inputBloom, inputPath);
+		inputBloom >> bloom;
+		assert_good(inputBloom, inputPath);
+		inputBloom.close();
+
+	} else {
+
+		// Specify bloom filter size in bits. Divide by two
+		// because counting bloom filter requires twice as
+		// much space.
+		size_t bits = opt::bloomSize * 8 / 2;
+		CascadingBloomFilter tempBloom(bits);
+#ifdef _OPENMP
+		ConcurrentBloomFilter<CascadingBloomFilter> cbf(tempBloom, 1000);
+		for (int i = optind; i < argc; i++)
+			Bloom::loadFile(cbf, opt::k, string(argv[i]), opt::verbose);
+#else
+		for (int i = optind; i < argc; i++)
+			Bloom::loadFile(tempBloom, opt::k, string(argv[i]), opt::verbose);
+#endif
+		bloom = tempBloom.getBloomFilter(tempBloom.MAX_COUNT-1);
+	}
+
+	if (opt::verbose)
+		cerr << "Bloom filter FPR: " << setprecision(3)
+			<< 100 * bloom.FPR() << "%\n";
+
+	DBGBloom<BloomFilter> g(bloom);
+
+	ofstream fout;
+	if (opt::outPath != "-") {
+		fout.open(opt::outPath.c_str());
+		assert_good(fout, opt::outPath);
+	}
+	ostream& out = opt::outPath == "-" ? cout : fout;
+
+	if (opt::verbose > 0)
+		cerr << "Correcting reads\n";
+
+	FastaConcat in(argv + optind, argv + argc, FastaReader::FOLD_CASE);
+	correctReads(g, in, out);
+	assert(in.eof());
+
+	if (opt::verbose > 0) {
+		cerr <<
+			"Processed " << g_count.reads << " reads\n"
+			"No errors: " << g_count.noErrors
+				<< " (" << setprecision(3) << (float)100
+					* g_count.noErrors / g_count.reads << "%)\n"
+			"Corrected: " << g_count.corrected
+				<< " (" << setprecision(3) << (float)100
+					* g_count.corrected / g_count.reads << "%)\n"
+			"Uncorrected: " << g_count.uncorrected
+				<< " (" << setprecision(3) << (float)100
+					* g_count.uncorrected / g_count.reads << "%)\n"
+			"Corrected bases: " << g_count.bases << '\n';
+	}
+
+	assert_good(out, opt::outPath);
+	return 0;
+}
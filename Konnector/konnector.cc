@@ -13,6 +13,7 @@
 #include "Align/alignGlobal.h"
 #include "Common/IOUtil.h"
 #include "Common/Options.h"
+#include "Common/ParallelBatches.h"
 #include "Common/StringUtil.h"
 #include "DataLayer/FastaConcat.h"
 #include "DataLayer/FastaInterleave.h"
@@ -111,6 +112,9 @@ static const char USAGE_MESSAGE[] =
 
 const unsigned g_progressStep = 1000;
 
+/** The number of read pairs that are read and connected at once. */
+const unsigned g_batchSize = 10000;
+
 namespace opt {
 
 	/** The number of parallel threads. */
@@ -278,36 +282,31 @@ static void seqanTests()
 }
 #endif
 
-/** Connect a read pair. */
-template <typename Graph>
-static void connectPair(const Graph& g,
+/** Return true if the specified read pair should be skipped. */
+static inline bool skipPair(const FastqRecord& read1)
+{
+	return !opt::readName.empty() &&
+		read1.id.find(opt::readName) == string::npos;
+}
+
+/** Update the counters and write the output for a read pair. */
+static void writePair(
 	const FastqRecord& read1,
 	const FastqRecord& read2,
+	const ConnectPairsResult& result,
 	const ConnectPairsParams& params,
 	ofstream& mergedStream,
 	ofstream& read1Stream,
 	ofstream& read2Stream,
 	ofstream& traceStream)
 {
-	bool skip = false;
-
-	if (!opt::readName.empty() &&
-		read1.id.find(opt::readName) == string::npos) {
-#pragma omp atomic
+	if (skipPair(read1)) {
 		++g_count.skipped;
-		skip = true;
-	}
-
-	if (!skip) {
-
-		ConnectPairsResult result =
-			connectPairs(opt::k, read1, read2, g, params);
+	} else {
 
-		vector<FastaRecord>& paths = result.mergedSeqs;
+		const vector<FastaRecord>& paths = result.mergedSeqs;
 
-		if (!opt::tracefilePath.empty())
-#pragma omp critical(tracefile)
-		{
+		if (!opt::tracefilePath.empty()) {
 			traceStream << result;
 			assert_good(traceStream, opt::tracefilePath);
 		}
@@ -317,12 +316,9 @@ static void connectPair(const Graph& g,
 			case NO_PATH:
 				assert(paths.empty());
 				if (result.foundStartKmer && result.foundGoalKmer)
-#pragma omp atomic
 					++g_count.noPath;
-				else {
-#pragma omp atomic
+				else
 					++g_count.noStartOrGoalKmer;
-				}
 				break;
 
 			case FOUND_PATH:
@@ -330,82 +326,145 @@ static void connectPair(const Graph& g,
 				if (result.pathMismatches > params.maxPathMismatches ||
 						result.readMismatches > params.maxReadMismatches) {
 					if (result.pathMismatches > params.maxPathMismatches)
-#pragma omp atomic
 						++g_count.tooManyMismatches;
 					else
 						++g_count.tooManyReadMismatches;
-#pragma omp critical(read1Stream)
 					read1Stream << read1;
-#pragma omp critical(read2Stream)
 					read2Stream << read2;
 				}
 				else if (paths.size() > 1) {
-#pragma omp atomic
 					++g_count.multiplePaths;
-#pragma omp critical(mergedStream)
 					mergedStream << result.consensusSeq;
 				}
 				else {
-#pragma omp atomic
 					++g_count.uniquePath;
-#pragma omp critical(mergedStream)
 					mergedStream << paths.front();
 				}
 				break;
 
 			case TOO_MANY_PATHS:
-#pragma omp atomic
 				++g_count.tooManyPaths;
 				break;
 
 			case TOO_MANY_BRANCHES:
-#pragma omp atomic
 				++g_count.tooManyBranches;
 				break;
 
 			case PATH_CONTAINS_CYCLE:
-#pragma omp atomic
 				++g_count.containsCycle;
 				break;
 
 			case EXCEEDED_MEM_LIMIT:
-#pragma omp atomic
 				++g_count.exceededMemLimit;
 				break;
 		}
 
 		if (result.pathResult != FOUND_PATH) {
-#pragma omp critical(read1Stream)
 			read1Stream << read1;
-#pragma omp critical(read2Stream)
 			read2Stream << read2;
 		}
 	}
 
-#pragma omp critical(cerr)
+	g_count.readPairsProcessed++;
+	if (opt::verbose >= 2
+			&& g_count.readPairsProcessed % g_progressStep == 0) {
+		cerr << "Merged " << g_count.uniquePath + g_count.multiplePaths << " of "
+			<< g_count.readPairsProcessed << " read pairs "
+			<< "(no start/goal kmer: " << g_count.noStartOrGoalKmer << ", "
+			<< "no path: " << g_count.noPath << ", "
+			<< "too many paths: " << g_count.tooManyPaths << ", "
+			<< "too many branches: " << g_count.tooManyBranches << ", "
+			<< "too many path/path mismatches: " << g_count.tooManyMismatches << ", "
+			<< "too many path/read mismatches: " << g_count.tooManyReadMismatches << ", "
+			<< "contains cycle: " << g_count.containsCycle << ", "
+			<< "exceeded mem limit: " << g_count.exceededMemLimit << ", "
+			<< "skipped: " << g_count.skipped
+			<< ")\n";
+	}
+}
+
+/** Connect the batches of read pairs of a stream. */
+template <typename Graph, typename FastaStream>
+class ConnectWorker
+{
+  public:
+	/** Each thread reuses one workspace for its graph searches. */
+	struct Workspace : ConnectPairsWorkspace<Graph>
 	{
-		g_count.readPairsProcessed++;
-		if (opt::verbose >= 2)
-		{
-			if(g_count.readPairsProcessed % g_progressStep == 0) {
-				cerr << "Merged " << g_count.uniquePath + g_count.multiplePaths << " of "
-					<< g_count.readPairsProcessed << " read pairs "
-					<< "(no start/goal kmer: " << g_count.noStartOrGoalKmer << ", "
-					<< "no path: " << g_count.noPath << ", "
-					<< "too many paths: " << g_count.tooManyPaths << ", "
-					<< "too many branches: " << g_count.tooManyBranches << ", "
-					<< "too many path/path mismatches: " << g_count.tooManyMismatches << ", "
-					<< "too many path/read mismatches: " << g_count.tooManyReadMismatches << ", "
-					<< "contains cycle: " << g_count.containsCycle << ", "
-					<< "exceeded mem limit: " << g_count.exceededMemLimit << ", "
-					<< "skipped: " << g_count.skipped
-					<< ")\n";
-			}
+		explicit Workspace(const ConnectWorker& worker)
+			: ConnectPairsWorkspace<Graph>(worker.graph()) { }
+	};
+
+	ConnectWorker(const Graph& g,
+		FastaStream& in,
+		const ConnectPairsParams& params,
+		ofstream& mergedStream,
+		ofstream& read1Stream,
+		ofstream& read2Stream,
+		ofstream& traceStream)
+		: m_g(g), m_in(in), m_params(params),
+		m_mergedStream(mergedStream),
+		m_read1Stream(read1Stream),
+		m_read2Stream(read2Stream),
+		m_traceStream(traceStream)
+	{
+		for (unsigned i = 0; i < 2; i++) {
+			m_reads1[i].resize(g_batchSize);
+			m_reads2[i].resize(g_batchSize);
+			m_results[i].resize(g_batchSize);
 		}
 	}
-}
 
-/** Connect read pairs. */
+	const Graph& graph() const { return m_g; }
+
+	/** Read a batch of read pairs.
+	 * @return the number of pairs read
+	 */
+	unsigned read(unsigned buf)
+	{
+		unsigned n = 0;
+		while (n < g_batchSize
+				&& m_in >> m_reads1[buf][n] >> m_reads2[buf][n])
+			n++;
+		return n;
+	}
+
+	/** Connect a read pair. */
+	void process(unsigned buf, unsigned i, Workspace& workspace)
+	{
+		const FastqRecord& read1 = m_reads1[buf][i];
+		m_results[buf][i] = !skipPair(read1)
+			? connectPairs(opt::k, read1, m_reads2[buf][i], m_g,
+				m_params, workspace)
+			: ConnectPairsResult();
+	}
+
+	/** Write a batch of read pairs. */
+	void write(unsigned buf, unsigned n)
+	{
+		for (unsigned i = 0; i < n; i++)
+			writePair(m_reads1[buf][i], m_reads2[buf][i],
+				m_results[buf][i], m_params, m_mergedStream,
+				m_read1Stream, m_read2Stream, m_traceStream);
+	}
+
+  private:
+	const Graph& m_g;
+	FastaStream& m_in;
+	const ConnectPairsParams& m_params;
+	ofstream& m_mergedStream;
+	ofstream& m_read1Stream;
+	ofstream& m_read2Stream;
+	ofstream& m_traceStream;
+	vector<FastqRecord> m_reads1[2], m_reads2[2];
+	vector<ConnectPairsResult> m_results[2];
+};
+
+/**
+ * Connect read pairs. The pairs of a batch are connected in
+ * parallel, and the results are written in input order by a single
+ * thread, so that the output streams and counters need no locking.
+ */
 template <typename Graph, typename FastaStream>
 static void connectPairs(const Graph& g,
 	FastaStream& in,
@@ -415,17 +474,9 @@ static void connectPairs(const Graph& g,
 	ofstream& read2Stream,
 	ofstream& traceStream)
 {
-#pragma omp parallel
-	for (FastqRecord a, b;;) {
-		bool good;
-#pragma omp critical(in)
-		good = in >> a >> b;
-		if (good)
-			connectPair(g, a, b, params, mergedStream, read1Stream,
-				read2Stream, traceStream);
-		else
-			break;
-	}
+	ConnectWorker<Graph, FastaStream> worker(g, in, params,
+		mergedStream, read1Stream, read2Stream, traceStream);
+	processBatches(worker);
 }
 
 /**
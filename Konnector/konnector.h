@@ -189,13 +189,29 @@ static inline void writeDot(
 	assert_good(*params.dotStream, params.dotPath);
 };
 
+/**
+ * Storage for the graph search of connectPairs. Each thread should
+ * reuse one workspace for all of its read pairs, so that the graph
+ * search does not allocate memory once the workspace has grown to
+ * its working size.
+ */
+template <typename Graph>
+struct ConnectPairsWorkspace
+{
+	ConstrainedBidiBFSVisitor<Graph> visitor;
+	BidirectionalBFSBuffers<Graph> buffers;
+
+	ConnectPairsWorkspace(const Graph& g) : visitor(g) { }
+};
+
 template <typename Graph>
 static inline ConnectPairsResult connectPairs(
 	unsigned k,
 	const FastaRecord& read1,
 	const FastaRecord& read2,
 	const Graph& g,
-	const ConnectPairsParams& params)
+	const ConnectPairsParams& params,
+	ConnectPairsWorkspace<Graph>& workspace)
 {
 	ConnectPairsResult result;
 
@@ -268,10 +284,11 @@ static inline ConnectPairsResult connectPairs(
 				pRead1->seq.length() - k + 1 - startKmerPos,
 				pRead2->seq.length() - k + 1 - goalKmerPos));
 
-	ConstrainedBidiBFSVisitor<Graph> visitor(g, startKmer, goalKmer,
+	ConstrainedBidiBFSVisitor<Graph>& visitor = workspace.visitor;
+	visitor.reset(startKmer, goalKmer,
 			params.maxPaths, minPathLen, maxPathLen, params.maxBranches,
 			params.memLimit);
-	bidirectionalBFS(g, startKmer, goalKmer, visitor);
+	bidirectionalBFS(g, startKmer, goalKmer, visitor, workspace.buffers);
 
 	std::vector< Path<Kmer> > paths;
 	result.readNamePrefix = pRead1->id.substr(0, pRead1->id.find_last_of("/"));
@@ -338,4 +355,16 @@ static inline ConnectPairsResult connectPairs(
 	return result;
 }
 
+template <typename Graph>
+static inline ConnectPairsResult connectPairs(
+	unsigned k,
+	const FastaRecord& read1,
+	const FastaRecord& read2,
+	const Graph& g,
+	const ConnectPairsParams& params)
+{
+	ConnectPairsWorkspace<Graph> workspace(g);
+	return connectPairs(k, read1, read2, g, params, workspace);
+}
+
 #endif
@@ -15,6 +15,10 @@
 #include <iterator>
 #include <string>
 
+#if _OPENMP
+# include <omp.h>
+#endif
+
 using namespace std;
 
 #define PROGRAM "abyss-index"
@@ -37,7 +41,17 @@ static const char USAGE_MESSAGE[] =
 "      --fa2bwt            build the BWT directly without the SA\n"
 "      --bwt2fm            build the FM index from the BWT\n"
 "  -a, --alphabet=STRING   use the alphabet STRING [-ACGT]\n"
+"  -b, --block-size=N      build the BWT in blocks of N suffixes, so\n"
+"                          that the full suffix array is never\n"
+"                          stored [0, a single block]\n"
 "  -s, --sample=N          sample the suffix array [16]\n"
+"      --sample-positions  sample the suffix array every N positions\n"
+"                          of FILE rather than every N rows of the\n"
+"                          BWT, which speeds up locating matches\n"
+"                          but uses an additional bit per base\n"
+"  -q, --lookup=N          store the suffix array intervals of every\n"
+"                          N-mer to speed up searches [0]\n"
+"  -j, --threads=N         use N parallel threads [1]\n"
 "  -d, --decompress        decompress the index FILE\n"
 "  -c, --stdout            write output to standard output\n"
 "  -v, --verbose           display verbose output\n"
@@ -50,6 +64,18 @@ namespace opt {
 	/** Sample the suffix array. */
 	static unsigned sampleSA = 16;
 
+	/** Sample the suffix array at positions of the text. */
+	static int samplePositions;
+
+	/** The number of suffixes of a block of the BWT construction. */
+	static size_t blockSize;
+
+	/** The length of the strings of the lookup table. */
+	static unsigned lookup;
+
+	/** The number of parallel threads. */
+	static unsigned threads = 1;
+
 	/** Which indexes to create. */
 	enum { NONE, FAI, FM, BOTH };
 	static int indexes = BOTH;
@@ -73,7 +99,7 @@ namespace opt {
 	static int verbose;
 }
 
-static const char shortopts[] = "a:cds:v";
+static const char shortopts[] = "a:b:cdj:q:s:v";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
@@ -84,8 +110,12 @@ static const struct option longopts[] = {
 	{ "fa2bwt", no_argument, &opt::fa2bwt, true },
 	{ "bwt2fm", no_argument, &opt::bwt2fm, true },
 	{ "alphabet", optional_argument, NULL, 'a' },
+	{ "block-size", required_argument, NULL, 'b' },
 	{ "decompress", no_argument, NULL, 'd' },
 	{ "sample", required_argument, NULL, 's' },
+	{ "sample-positions", no_argument, &opt::samplePositions, true },
+	{ "lookup", required_argument, NULL, 'q' },
+	{ "threads", required_argument, NULL, 'j' },
 	{ "stdout", no_argument, NULL, 'c' },
 	{ "help", no_argument, NULL, OPT_HELP },
 	{ "version", no_argument, NULL, OPT_VERSION },
@@ -127,7 +157,7 @@ static void buildFMIndexFromBWT(FMIndex& fm, const string& path)
 		fm.setAlphabet(opt::alphabet);
 
 	fm.encode(bwt.begin(), bwt.end());
-	fm.sampleSA(opt::sampleSA);
+	fm.sampleSA(opt::sampleSA, opt::samplePositions);
 	fm.assignBWT(bwt.begin(), bwt.end());
 }
 
@@ -157,16 +187,16 @@ static void buildFMIndex(FMIndex& fm, const string& path)
 	} else
 		fm.setAlphabet(opt::alphabet);
 
+	fm.setBlockSize(opt::blockSize);
 	if (opt::fa2bwt) {
 		// Build the BWT first.
 		s.push_back(0);
 		fm.buildBWT(s.begin(), s.end() - 1);
-		fm.sampleSA(opt::sampleSA);
+		fm.sampleSA(opt::sampleSA, opt::samplePositions);
 		fm.assignBWT(s.begin(), s.end());
 	} else {
-		// Construct the suffix array first.
+		fm.sampleSA(opt::sampleSA, opt::samplePositions);
 		fm.assign(s.begin(), s.end());
-		fm.sampleSA(opt::sampleSA);
 	}
 }
 
@@ -182,8 +212,11 @@ int main(int argc, char **argv)
 				opt::alphabet = arg.str();
 				arg.clear(ios::eofbit);
 				break;
+			case 'b': arg >> opt::blockSize; break;
 			case 'c': opt::toStdout = true; break;
 			case 'd': opt::decompress = true; break;
+			case 'j': arg >> opt::threads; break;
+			case 'q': arg >> opt::lookup; break;
 			case 's': arg >> opt::sampleSA; break;
 			case 'v': opt::verbose++; break;
 			case OPT_HELP:
@@ -216,6 +249,11 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	if (opt::decompress) {
 		// Decompress the index.
 		string fmPath(argv[optind]);
@@ -265,6 +303,12 @@ int main(int argc, char **argv)
 		buildFMIndex(fm, path);
 	}
 
+	if (opt::lookup > 0) {
+		if (opt::verbose > 0)
+			std::cerr << "Building the lookup table...\n";
+		fm.buildLookup(opt::lookup);
+	}
+
 	if (opt::verbose > 0) {
 		size_t n = fm.size();
 		ssize_t bytes = getMemoryUsage();
@@ -6,6 +6,7 @@
 #include "FastaReader.h"
 #include "IOUtil.h"
 #include "MemoryUtil.h"
+#include "ParallelBatches.h"
 #include "SAM.h"
 #include "StringUtil.h"
 #include "Uncompress.h"
@@ -17,11 +18,12 @@
 #include <cstdlib>
 #include <getopt.h>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <stdint.h>
 #include <string>
 #include <utility>
-#include <queue>
+#include <vector>
 #if _OPENMP
 # include <omp.h>
 #endif
@@ -51,8 +53,7 @@ static const char USAGE_MESSAGE[] =
 "  -d, --dup               identify and print duplicate sequence\n"
 "                          IDs between QUERY and TARGET\n"
 "      --order             print alignments in the same order as\n"
-"                          read from QUERY\n"
-"      --no-order          print alignments ASAP [default]\n"
+"                          read from QUERY [default]\n"
 "      --multi             Align unaligned segments of primary\n"
 "                          alignment\n"
 "      --no-multi          don't Align unaligned segments [default]\n"
@@ -85,8 +86,9 @@ namespace opt {
 	/** Align unaligned segments of primary alignment. */
 	static int multi;
 
-	/** Ensure output order matches input order. */
-	static int order;
+	/** Ensure output order matches input order. The output is
+	 * always in order, and this option is kept for compatibility. */
+	static int order = 1;
 
 	/** Verbose output. */
 	static int verbose;
@@ -199,37 +201,44 @@ static SAMRecord toSAM(const FastaIndex& faIndex,
 	return a;
 }
 
+/** The positions of the matches of a query. */
+typedef vector<size_t> Positions;
+
 /** Return the position of the current contig. */
-static size_t getMyPos(const Match& m, const FastaIndex& faIndex,
-		const FMIndex& fmIndex, const string& id)
+static size_t getMyPos(const Match& m, const Positions& positions,
+		const FastaIndex& faIndex, const FMIndex& fmIndex,
+		const string& id)
 {
-	for (size_t i = m.l; i < m.u; i++) {
-		if (faIndex[fmIndex[i]].get<0>().id == id)
-			return fmIndex[i];
+	for (Positions::const_iterator it = positions.begin();
+			it != positions.end(); ++it) {
+		if (faIndex[*it].get<0>().id == id)
+			return *it;
 	}
-	return fmIndex[m.l];
+	return positions.empty() ? fmIndex[m.l] : positions.front();
 }
 
 /** Return the earlies position of all contigs in m. */
-static size_t getMinPos(const Match& m, size_t maxLen,
-		const FastaIndex& faIndex, const FMIndex& fmIndex)
+static size_t getMinPos(const Positions& positions, size_t maxLen,
+		const FastaIndex& faIndex)
 {
 	size_t minPos = numeric_limits<size_t>::max();
-	for (size_t i = m.l; i < m.u; i++) {
-		size_t pos = fmIndex[i];
+	for (Positions::const_iterator it = positions.begin();
+			it != positions.end(); ++it) {
+		size_t pos = *it;
 		if (faIndex[pos].get<0>().size == maxLen && pos < minPos)
-			minPos = fmIndex[i];
+			minPos = pos;
 	}
 	return minPos;
 }
 
 /** Return the largest length of all contig in m. */
-static size_t getMaxLen(const Match& m, const FastaIndex& faIndex,
-		const FMIndex& fmIndex)
+static size_t getMaxLen(const Positions& positions,
+		const FastaIndex& faIndex)
 {
 	size_t maxLen = 0;
-	for (size_t i = m.l; i < m.u; i++) {
-		size_t len = faIndex[fmIndex[i]].get<0>().size;
+	for (Positions::const_iterator it = positions.begin();
+			it != positions.end(); ++it) {
+		size_t len = faIndex[*it].get<0>().size;
 		if (len > maxLen)
 			maxLen = len;
 	}
@@ -240,40 +249,41 @@ static size_t getMaxLen(const Match& m, const FastaIndex& faIndex,
  * contig in m. */
 static void printDuplicates(const Match& m, const Match& rcm,
 		const FastaIndex& faIndex, const FMIndex& fmIndex,
-		const FastqRecord& rec)
+		const FastqRecord& rec, ostream& out)
 {
+	// Locate each match once.
+	Positions positions, rcPositions;
+	positions.reserve(m.size());
+	fmIndex.locate(m, back_inserter(positions));
+	if (!opt::ss) {
+		rcPositions.reserve(rcm.size());
+		fmIndex.locate(rcm, back_inserter(rcPositions));
+	}
+
 	size_t myLen = m.qspan();
 	size_t maxLen;
 	if (opt::ss)
-		maxLen = getMaxLen(m, faIndex, fmIndex);
+		maxLen = getMaxLen(positions, faIndex);
 	else
-		maxLen = max(getMaxLen(m, faIndex, fmIndex),
-				getMaxLen(rcm, faIndex, fmIndex));
+		maxLen = max(getMaxLen(positions, faIndex),
+				getMaxLen(rcPositions, faIndex));
 	if (myLen < maxLen) {
 #pragma omp atomic
 		g_count.multimapped++;
-#pragma omp critical(cout)
-		{
-			cout << rec.id << '\n';
-			assert_good(cout, "stdout");
-		}
+		out << rec.id << '\n';
 		return;
 	}
-	size_t myPos = getMyPos(m, faIndex, fmIndex, rec.id);
+	size_t myPos = getMyPos(m, positions, faIndex, fmIndex, rec.id);
 	size_t minPos;
 	if (opt::ss)
-		minPos = getMinPos(m, maxLen, faIndex, fmIndex);
+		minPos = getMinPos(positions, maxLen, faIndex);
 	else
-		minPos = min(getMinPos(m, maxLen, faIndex, fmIndex),
-				getMinPos(rcm, maxLen, faIndex, fmIndex));
+		minPos = min(getMinPos(positions, maxLen, faIndex),
+				getMinPos(rcPositions, maxLen, faIndex));
 	if (myPos > minPos) {
 #pragma omp atomic
 		g_count.multimapped++;
-#pragma omp critical(cout)
-		{
-			cout << rec.id << '\n';
-			assert_good(cout, "stdout");
-		}
+		out << rec.id << '\n';
 	}
 #pragma omp atomic
 	g_count.unique++;
@@ -296,11 +306,9 @@ pair<Match, Match> findMatch(const FMIndex& fmIndex, const string& seq)
 	return make_pair(m, rcm);
 }
 
-static queue<string> g_pq;
-
-/** Return the mapping of the specified sequence. */
+/** Write the mapping of the specified sequence to out. */
 static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
-		const FastqRecord& rec)
+		const FastqRecord& rec, ostream& out)
 {
 	if (rec.seq.empty()) {
 		cerr << PROGRAM ": error: "
@@ -312,7 +320,7 @@ static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
 	tie(m, rcm) = findMatch(fmIndex, rec.seq);
 
 	if (opt::dup) {
-		printDuplicates(m, rcm, faIndex, fmIndex, rec);
+		printDuplicates(m, rcm, faIndex, fmIndex, rec, out);
 		return;
 	}
 
@@ -386,27 +394,12 @@ static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
 		reverse(sam.qual.begin(), sam.qual.end());
 #endif
 
-	bool print = opt::order == 0;
-	do {
-#pragma omp critical(cout)
-		{
-#pragma omp critical(g_pq)
-			if (!print) {
-				print = g_pq.front() == rec.id;
-				if (print)
-					g_pq.pop();
-			}
-			if (print) {
-				cout << sam;
+	out << sam;
 #if SAM_SEQ_QUAL
-				if (alts.size() > 0)
-					cout << "\tXA:Z:" << join(alts, ";");
+	if (alts.size() > 0)
+		out << "\tXA:Z:" << join(alts, ";");
 #endif
-				cout << '\n';
-				assert_good(cout, "stdout");
-			}
-		}
-	} while (!print); // spinlock :(
+	out << '\n';
 
 	if (sam.isUnmapped())
 #pragma omp atomic
@@ -419,26 +412,72 @@ static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
 		g_count.unique++;
 }
 
-/** Map the sequences of the specified file. */
-static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
-		FastaInterleave& in)
+/** The number of sequences that are read and mapped at once. */
+static const unsigned g_batchSize = 10000;
+
+/** Map the batches of sequences of a stream. */
+class MapWorker
 {
-#pragma omp parallel
-	for (FastqRecord rec;;) {
-		bool good;
-#pragma omp critical(in)
-		{
-			good = in >> rec;
-			if (opt::order) {
-#pragma omp critical(g_pq)
-				g_pq.push(rec.id);
-			}
+  public:
+	typedef NoWorkspace Workspace;
+
+	MapWorker(const FastaIndex& faIndex, const FMIndex& fmIndex,
+			FastaInterleave& in)
+		: m_faIndex(faIndex), m_fmIndex(fmIndex), m_in(in)
+	{
+		for (unsigned i = 0; i < 2; i++) {
+			m_recs[i].resize(g_batchSize);
+			m_out[i].resize(g_batchSize);
 		}
-		if (good)
-			find(faIndex, fmIndex, rec);
-		else
-			break;
 	}
+
+	/** Read a batch of sequences.
+	 * @return the number of sequences read
+	 */
+	unsigned read(unsigned buf)
+	{
+		vector<FastqRecord>& recs = m_recs[buf];
+		unsigned n = 0;
+		while (n < recs.size() && m_in >> recs[n])
+			n++;
+		return n;
+	}
+
+	/** Map a sequence. */
+	void process(unsigned buf, unsigned i, Workspace&)
+	{
+		ostringstream ss;
+		find(m_faIndex, m_fmIndex, m_recs[buf][i], ss);
+		m_out[buf][i] = ss.str();
+	}
+
+	/** Write the output of a batch of sequences. */
+	void write(unsigned buf, unsigned n)
+	{
+		const vector<string>& out = m_out[buf];
+		for (unsigned i = 0; i < n; i++)
+			cout.write(out[i].data(), out[i].size());
+		assert_good(cout, "stdout");
+	}
+
+  private:
+	const FastaIndex& m_faIndex;
+	const FMIndex& m_fmIndex;
+	FastaInterleave& m_in;
+	vector<FastqRecord> m_recs[2];
+	vector<string> m_out[2];
+};
+
+/**
+ * Map the sequences of the specified file. The sequences are mapped
+ * in parallel in batches, and the output is in the order of the
+ * input.
+ */
+static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
+		FastaInterleave& in)
+{
+	MapWorker worker(faIndex, fmIndex, in);
+	processBatches(worker);
 	assert(in.eof());
 }
 
@@ -461,6 +500,8 @@ static void buildFMIndex(FMIndex& fm, const char* path)
 
 	transform(s.begin(), s.end(), s.begin(), ::toupper);
 	fm.setAlphabet("-ACGT");
+	if (opt::sampleSA > 1)
+		fm.sampleSA(opt::sampleSA);
 	fm.assign(s.begin(), s.end());
 }
 
@@ -597,16 +638,14 @@ int main(int argc, char** argv)
 				<< " B/sequence.\n";
 	}
 
-	// Read the FM index.
+	// Memory map the FM index.
 	FMIndex fmIndex;
 	in.open(fmPath.c_str());
 	if (in) {
-		if (opt::verbose > 0)
-			cerr << "Reading `" << fmPath << "'...\n";
-		assert_good(in, fmPath);
-		in >> fmIndex;
-		assert_good(in, fmPath);
 		in.close();
+		if (opt::verbose > 0)
+			cerr << "Mapping `" << fmPath << "'...\n";
+		fmIndex.mapFile(fmPath);
 	} else
 		buildFMIndex(fmIndex, targetFile);
 	if (opt::sampleSA > 1)
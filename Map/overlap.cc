@@ -304,6 +304,8 @@ static void buildFMIndex(FMIndex& fm, const char* path)
 
 	transform(s.begin(), s.end(), s.begin(), ::toupper);
 	fm.setAlphabet("-ACGT");
+	if (opt::sampleSA > 1)
+		fm.sampleSA(opt::sampleSA);
 	fm.assign(s.begin(), s.end());
 }
 
@@ -450,16 +452,14 @@ int main(int argc, char** argv)
 		faIndex.index(fastaFile);
 	}
 
-	// Read the FM index.
+	// Memory map the FM index.
 	FMIndex fmIndex;
 	in.open(fmPath.c_str());
 	if (in) {
-		if (opt::verbose > 0)
-			cerr << "Reading `" << fmPath << "'...\n";
-		assert_good(in, fmPath);
-		in >> fmIndex;
-		assert_good(in, fmPath);
 		in.close();
+		if (opt::verbose > 0)
+			cerr << "Mapping `" << fmPath << "'...\n";
+		fmIndex.mapFile(fmPath);
 	} else
 		buildFMIndex(fmIndex, fastaFile);
 	if (opt::sampleSA > 1)
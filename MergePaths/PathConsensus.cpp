@@ -1,4 +1,3 @@
-#include "dialign.h"
 #include "config.h"
 #include "Common/Options.h"
 #include "ConstString.h"
@@ -17,6 +16,7 @@
 #include <algorithm>
 #include <cctype>
 #include <climits>
+#include <cstddef>
 #include <cstdlib>
 #include <fstream>
 #include <getopt.h>
@@ -24,8 +24,12 @@
 #include <iterator>
 #include <map>
 #include <set>
+#include <sstream>
 #include <string>
 #include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 using boost::tie;
@@ -60,15 +64,16 @@ static const char USAGE_MESSAGE[] =
 "  -a, --branches=N      maximum number of sequences to align\n"
 "                        default: 4\n"
 "  -p, --identity=REAL   minimum identity, default: 0.9\n"
+"  -j, --threads=N       use N parallel threads [1]\n"
 "  -v, --verbose         display verbose output\n"
 "      --help            display this help and exit\n"
 "      --version         output version information and exit\n"
 "\n"
-" DIALIGN-TX options:\n"
-"  -D, --dialign-d=N     dialign debug level, default: 0\n"
-"  -M, --dialign-m=FILE  score matrix, default: dna_matrix.scr\n"
+" DIALIGN-TX options, which are accepted for compatibility and have\n"
+" no effect, because the paths are aligned by alignGlobal:\n"
+"  -D, --dialign-d=N     dialign debug level\n"
+"  -M, --dialign-m=FILE  score matrix\n"
 "  -P, --dialign-p=FILE  diagonal length probability distribution\n"
-"                        default: dna_diag_prob_100_exp_550000\n"
 "\n"
 "Report bugs to <" PACKAGE_BUGREPORT ">.\n";
 
@@ -83,6 +88,9 @@ namespace opt {
 	static string dialign_score;
 	static string dialign_prob;
 
+	/** Number of threads. */
+	static int threads = 1;
+
 	/** Output format. */
 	int format; // used by ContigProperties
 
@@ -92,7 +100,7 @@ namespace opt {
 	unsigned distanceError = 6;
 }
 
-static const char shortopts[] = "d:k:o:s:g:a:p:vD:M:P:";
+static const char shortopts[] = "d:k:o:s:g:a:p:j:vD:M:P:";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
@@ -104,6 +112,7 @@ static const struct option longopts[] = {
 	{ "graph",       required_argument, NULL, 'g' },
 	{ "branches",    required_argument, NULL, 'a' },
 	{ "identity",    required_argument, NULL, 'p' },
+	{ "threads",     required_argument, NULL, 'j' },
 	{ "verbose",     no_argument,       NULL, 'v' },
 	{ "help",        no_argument,       NULL, OPT_HELP },
 	{ "version",     no_argument,       NULL, OPT_VERSION },
@@ -344,10 +353,12 @@ static string createConsensus(const Sequence& a, const Sequence& b)
 /** Merge the specified two contigs, default overlap is k-1,
  * generate a consensus sequence of the overlapping region. The result
  * is stored in the first argument.
+ * @param log the stream of warnings
  */
 static void mergeContigs(const Graph& g,
 		unsigned overlap, Sequence& seq,
-		const Sequence& s, const ContigNode& node, const Path& path)
+		const Sequence& s, const ContigNode& node, const Path& path,
+		ostream& log)
 {
 	assert(s.length() > overlap);
 	Sequence ao;
@@ -359,7 +370,7 @@ static void mergeContigs(const Graph& g,
 		o = createConsensus(ao, bo);
 	} while (o.empty() && chomp(seq, 'n'));
 	if (o.empty()) {
-		cerr << "warning: the head of "
+		log << "warning: the head of "
 			<< get(vertex_name, g, node)
 			<< " does not match the tail of the previous contig\n"
 			<< ao << '\n' << bo << '\n' << path << endl;
@@ -372,7 +383,8 @@ static void mergeContigs(const Graph& g,
 	}
 }
 
-static Sequence mergePath(const Graph&g, const Path& path)
+static Sequence mergePath(const Graph&g, const Path& path,
+		ostream& log)
 {
 	Sequence seq;
 	Path::const_iterator prev_it;
@@ -385,7 +397,7 @@ static Sequence mergePath(const Graph&g, const Path& path)
 			assert(d < 0);
 			unsigned overlap = -d;
 			mergeContigs(g, overlap, seq,
-					getSequence(*it), *it, path);
+					getSequence(*it), *it, path, log);
 		}
 		prev_it = it;
 	}
@@ -399,12 +411,33 @@ static ContigProperties calculatePathProperties(const Graph& g,
 	return addProp(g, path.begin(), path.end());
 }
 
+/** A new contig of the consensus sequence of the paths of a gap,
+ * which replaces the paths between their common prefix and suffix.
+ */
+struct NewContig
+{
+	size_t longestPrefix;
+	size_t longestSuffix;
+	Sequence seq;
+	unsigned coverage;
+
+	NewContig() : longestPrefix(0), longestSuffix(0), coverage(0) { }
+	NewContig(size_t longestPrefix, size_t longestSuffix,
+			const Sequence& seq, unsigned coverage)
+		: longestPrefix(longestPrefix), longestSuffix(longestSuffix),
+		seq(seq), coverage(coverage) { }
+};
+
 /* Resolve ambiguous region using pairwise alignment
  * (Needleman-Wunsch) ('solutions' contain exactly two paths, from a
  * source contig to a dest contig)
+ * @param[out] newContig the new contig of the consensus sequence,
+ * when an empty path is returned
+ * @param log the stream of verbose output
  */
 static ContigPath alignPair(const Graph& g,
-		const ContigPaths& solutions, ofstream& out)
+		const ContigPaths& solutions, NewContig& newContig,
+		ostream& log)
 {
 	assert(solutions.size() == 2);
 	assert(solutions[0].size() > 1);
@@ -418,7 +451,7 @@ static ContigPath alignPair(const Graph& g,
 		// This entire sequence may be deleted.
 		const ContigPath& sol(fstSol.empty() ? sndSol : fstSol);
 		assert(!sol.empty());
-		Sequence consensus(mergePath(g, sol));
+		Sequence consensus(mergePath(g, sol, log));
 		assert(consensus.size() > opt::k - 1);
 		string::iterator first = consensus.begin() + opt::k - 1;
 		transform(first, consensus.end(), first, ::tolower);
@@ -426,25 +459,20 @@ static ContigPath alignPair(const Graph& g,
 		unsigned match = opt::k - 1;
 		float identity = (float)match / consensus.size();
 		if (opt::verbose > 2)
-			cerr << consensus << '\n';
+			log << consensus << '\n';
 		if (opt::verbose > 1)
-			cerr << identity
+			log << identity
 				<< (identity < opt::identity ? " (too low)\n" : "\n");
 		if (identity < opt::identity)
 			return ContigPath();
 
 		unsigned coverage = calculatePathProperties(g, sol).coverage;
-		ContigNode u = outputNewContig(g,
-				solutions, 1, 1, consensus, coverage, out);
-		ContigPath path;
-		path.push_back(solutions.front().front());
-		path.push_back(u);
-		path.push_back(solutions.front().back());
-		return path;
+		newContig = NewContig(1, 1, consensus, coverage);
+		return ContigPath();
 	}
 
-	Sequence fstPathContig(mergePath(g, fstSol));
-	Sequence sndPathContig(mergePath(g, sndSol));
+	Sequence fstPathContig(mergePath(g, fstSol, log));
+	Sequence sndPathContig(mergePath(g, sndSol, log));
 	if (fstPathContig == sndPathContig) {
 		// These two paths have identical sequence.
 		if (fstSol.size() == sndSol.size()) {
@@ -458,12 +486,12 @@ static ContigPath alignPair(const Graph& g,
 					== get(vertex_complement, g, *it.second));
 			assert(equal(it.first+1, It(fstSol.end()), it.second+1));
 			if (opt::verbose > 1)
-				cerr << "Palindrome: "
+				log << "Palindrome: "
 					<< get(vertex_contig_name, g, *it.first) << '\n';
 			return solutions[0];
 		} else {
 			// The paths are different lengths.
-			cerr << PROGRAM ": warning: "
+			log << PROGRAM ": warning: "
 				"Two paths have identical sequence, which may be "
 				"caused by a transitive edge in the overlap graph.\n"
 				<< '\t' << fstSol << '\n'
@@ -479,7 +507,7 @@ static ContigPath alignPair(const Graph& g,
 	float lengthRatio = (float)minLength / maxLength;
 	if (lengthRatio < opt::identity) {
 		if (opt::verbose > 1)
-			cerr << minLength << '\t' << maxLength
+			log << minLength << '\t' << maxLength
 				<< '\t' << lengthRatio << "\t(different length)\n";
 		return ContigPath();
 	}
@@ -489,29 +517,28 @@ static ContigPath alignPair(const Graph& g,
 		   	align);
 	float identity = (float)match / align.size();
 	if (opt::verbose > 2)
-		cerr << align;
+		log << align;
 	if (opt::verbose > 1)
-		cerr << identity
+		log << identity
 			<< (identity < opt::identity ? " (too low)\n" : "\n");
 	if (identity < opt::identity)
 		return ContigPath();
 
 	unsigned coverage = calculatePathProperties(g, fstSol).coverage
 		+ calculatePathProperties(g, sndSol).coverage;
-	ContigNode u = outputNewContig(g, solutions, 1, 1,
-			align.consensus(), coverage, out);
-	ContigPath path;
-	path.push_back(solutions.front().front());
-	path.push_back(u);
-	path.push_back(solutions.front().back());
-	return path;
+	newContig = NewContig(1, 1, align.consensus(), coverage);
+	return ContigPath();
 }
 
 /* Resolve ambiguous region using multiple alignment of all paths in
  * `solutions'.
+ * @param[out] newContig the new contig of the consensus sequence,
+ * when an empty path is returned
+ * @param log the stream of verbose output
  */
 static ContigPath alignMulti(const Graph& g,
-		const vector<Path>& solutions, ofstream& out)
+		const vector<Path>& solutions, NewContig& newContig,
+		ostream& log)
 {
 	// Find the size of the smallest path.
 	const Path& firstSol = solutions.front();
@@ -566,7 +593,7 @@ static ContigPath alignMulti(const Graph& g,
 	reverse(vspath.begin(), vspath.end());
 
 	if (opt::verbose > 1 && vppath.size() + vspath.size() > 2)
-		cerr << vppath << " * " << vspath << '\n';
+		log << vppath << " * " << vspath << '\n';
 
 	// Get sequence of ambiguous region in paths
 	assert(longestPrefix > 0 && longestSuffix > 0);
@@ -578,7 +605,7 @@ static ContigPath alignMulti(const Graph& g,
 		Path path(solIter->begin() + longestPrefix,
 				solIter->end() - longestSuffix);
 		if (!path.empty()) {
-			amb_seqs.push_back(mergePath(g, path));
+			amb_seqs.push_back(mergePath(g, path, log));
 			coverage += calculatePathProperties(g, path).coverage;
 		} else {
 			// The prefix and suffix paths overlap by k-1 bp.
@@ -595,7 +622,7 @@ static ContigPath alignMulti(const Graph& g,
 	float lengthRatio = (float)minLength / maxLength;
 	if (lengthRatio < opt::identity) {
 		if (opt::verbose > 1)
-			cerr << minLength << '\t' << maxLength
+			log << minLength << '\t' << maxLength
 				<< '\t' << lengthRatio << "\t(different length)\n";
 		return ContigPath();
 	}
@@ -606,10 +633,10 @@ static ContigPath alignMulti(const Graph& g,
 	string consensus = alignment.consensus();
 
 	if (opt::verbose > 2)
-	   	cerr << alignment << consensus << '\n';
+	   	log << alignment << consensus << '\n';
 	float identity = (float)matches / consensus.size();
 	if (opt::verbose > 1)
-		cerr << identity
+		log << identity
 			<< (identity < opt::identity ? " (too low)\n" : "\n");
 	if (identity < opt::identity)
 		return ContigPath();
@@ -621,7 +648,7 @@ static ContigPath alignMulti(const Graph& g,
 		ContigID palindrome1
 			= solutions[0].rbegin()[longestSuffix].contigIndex();
 		if (opt::verbose > 1)
-			cerr << "Palindrome: "
+			log << "Palindrome: "
 				<< get(g_contigNames, palindrome0) << '\n'
 				<< "Palindrome: "
 				<< get(g_contigNames, palindrome1) << '\n';
@@ -642,34 +669,62 @@ static ContigPath alignMulti(const Graph& g,
 		return solutions[0];
 	}
 
-	ContigNode u = outputNewContig(g, solutions,
-		longestPrefix, longestSuffix, consensus, coverage, out);
-	ContigPath path(vppath);
-	path.push_back(u);
-	path.insert(path.end(), vspath.begin(), vspath.end());
-	return path;
+	assert(vppath.size() == longestPrefix);
+	assert(vspath.size() == longestSuffix);
+	newContig = NewContig(longestPrefix, longestSuffix,
+			consensus, coverage);
+	return ContigPath();
 }
 
 /** Align the sequences of the specified paths.
- * @return the consensus sequence
+ * @param[out] newContig the new contig of the consensus sequence,
+ * when an empty path is returned
+ * @return the consensus path
  */
 static ContigPath align(const Graph& g, const vector<Path>& sequences,
-		ofstream& out)
+		NewContig& newContig, ostream& log)
 {
 	assert(sequences.size() > 1);
 	return sequences.size() == 2
-		? alignPair(g, sequences, out)
-		: alignMulti(g, sequences, out);
+		? alignPair(g, sequences, newContig, log)
+		: alignMulti(g, sequences, newContig, log);
 }
 
-/** Return the consensus sequence of the specified gap. */
-static ContigPath fillGap(const Graph& g,
-		const AmbPathConstraint& apConstraint,
-		vector<bool>& seen,
-		ofstream& outFasta)
+/** The outcome of filling a gap. */
+enum GapOutcome {
+	GAP_TOO_COMPLEX, GAP_TOO_MANY, GAP_NO_PATHS, GAP_ONE_PATH,
+	GAP_MERGED, GAP_NOT_MERGED
+};
+
+/** The paths through a gap and their consensus. */
+struct GapConsensus
+{
+	GapOutcome outcome;
+
+	/** The paths through the gap */
+	ContigPaths solutions;
+
+	/** The consensus path, which is empty if the paths are replaced
+	 * by a new contig */
+	ContigPath consensus;
+
+	/** The new contig of the consensus sequence */
+	NewContig newContig;
+
+	/** The verbose output */
+	string log;
+};
+
+/** Find the paths through the specified gap and align their
+ * sequences. The graph is not modified, so that gaps may be filled
+ * in parallel.
+ */
+static void fillGap(const Graph& g,
+		const AmbPathConstraint& apConstraint, GapConsensus& gap)
 {
+	ostringstream log;
 	if (opt::verbose > 1)
-		cerr << "\n* "
+		log << "\n* "
 			<< get(vertex_name, g, apConstraint.source) << ' '
 			<< apConstraint.dist << "N "
 			<< get(vertex_name, g, apConstraint.dest) << '\n';
@@ -678,7 +733,7 @@ static ContigPath fillGap(const Graph& g,
 	constraints.push_back(Constraint(apConstraint.dest,
 				apConstraint.dist + opt::distanceError));
 
-	ContigPaths solutions;
+	ContigPaths& solutions = gap.solutions;
 	unsigned numVisited = 0;
 	constrainedSearch(g, apConstraint.source,
 			constraints, solutions, numVisited);
@@ -688,41 +743,83 @@ static ContigPath fillGap(const Graph& g,
 			solIt != solutions.end(); solIt++)
 		solIt->insert(solIt->begin(), apConstraint.source);
 
-	ContigPath consensus;
 	bool tooManySolutions = solutions.size() > opt::numBranches;
 	if (tooComplex) {
-		stats.tooComplex++;
+		gap.outcome = GAP_TOO_COMPLEX;
 		if (opt::verbose > 1)
-			cerr << solutions.size() << " paths (too complex)\n";
+			log << solutions.size() << " paths (too complex)\n";
 	} else if (tooManySolutions) {
-		stats.numTooManySolutions++;
+		gap.outcome = GAP_TOO_MANY;
 		if (opt::verbose > 1)
-			cerr << solutions.size() << " paths (too many)\n";
+			log << solutions.size() << " paths (too many)\n";
 	} else if (solutions.empty()) {
-		stats.numNoSolutions++;
+		gap.outcome = GAP_NO_PATHS;
 		if (opt::verbose > 1)
-			cerr << "no paths\n";
+			log << "no paths\n";
 	} else if (solutions.size() == 1) {
+		gap.outcome = GAP_ONE_PATH;
 		if (opt::verbose > 1)
-			cerr << "1 path\n" << solutions.front() << '\n';
-		stats.numMerged++;
+			log << "1 path\n" << solutions.front() << '\n';
 	} else {
 		assert(solutions.size() > 1);
 		if (opt::verbose > 2)
 			copy(solutions.begin(), solutions.end(),
-					ostream_iterator<ContigPath>(cerr, "\n"));
+					ostream_iterator<ContigPath>(log, "\n"));
 		else if (opt::verbose > 1)
-			cerr << solutions.size() << " paths\n";
-		consensus = align(g, solutions, outFasta);
-		if (!consensus.empty()) {
-			stats.numMerged++;
-			// Mark contigs that are used in a consensus.
-			markSeen(seen, solutions, true);
-			if (opt::verbose > 1)
-				cerr << consensus << '\n';
-		} else
-			stats.notMerged++;
+			log << solutions.size() << " paths\n";
+		gap.consensus = align(g, solutions, gap.newContig, log);
+		gap.outcome = !gap.consensus.empty()
+			|| !gap.newContig.seq.empty()
+			? GAP_MERGED : GAP_NOT_MERGED;
+	}
+	gap.log = log.str();
+}
+
+/** Output the new contig of a filled gap, and return the consensus
+ * path of the gap. The gaps are added in order, so that the new
+ * contigs are numbered in the same order for any number of threads.
+ */
+static ContigPath addGap(const Graph& g, const GapConsensus& gap,
+		vector<bool>& seen, ofstream& outFasta)
+{
+	cerr << gap.log;
+	switch (gap.outcome) {
+	  case GAP_TOO_COMPLEX:
+		stats.tooComplex++;
+		return ContigPath();
+	  case GAP_TOO_MANY:
+		stats.numTooManySolutions++;
+		return ContigPath();
+	  case GAP_NO_PATHS:
+		stats.numNoSolutions++;
+		return ContigPath();
+	  case GAP_ONE_PATH:
+		stats.numMerged++;
+		return ContigPath();
+	  case GAP_NOT_MERGED:
+		stats.notMerged++;
+		return ContigPath();
+	  case GAP_MERGED:
+		break;
 	}
+
+	ContigPath consensus = gap.consensus;
+	const NewContig& nc = gap.newContig;
+	if (consensus.empty()) {
+		const ContigPath& sol = gap.solutions.front();
+		ContigNode u = outputNewContig(g, gap.solutions,
+				nc.longestPrefix, nc.longestSuffix,
+				nc.seq, nc.coverage, outFasta);
+		consensus.assign(sol.begin(), sol.begin() + nc.longestPrefix);
+		consensus.push_back(u);
+		consensus.insert(consensus.end(),
+				sol.end() - nc.longestSuffix, sol.end());
+	}
+	stats.numMerged++;
+	// Mark contigs that are used in a consensus.
+	markSeen(seen, gap.solutions, true);
+	if (opt::verbose > 1)
+		cerr << consensus << '\n';
 	return consensus;
 }
 
@@ -750,6 +847,7 @@ int main(int argc, char** argv)
 		case 'a': arg >> opt::numBranches; break;
 		case 's': arg >> opt::consensusPath; break;
 		case 'g': arg >> opt::graphPath; break;
+		case 'j': arg >> opt::threads; break;
 		case 'D': arg >> opt::dialign_debug; break;
 		case 'M': arg >> opt::dialign_score; break;
 		case 'P': arg >> opt::dialign_prob; break;
@@ -794,6 +892,11 @@ int main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	const char *contigFile = argv[optind++];
 	string adjFile(argv[optind++]);
 	string allPaths(argv[optind++]);
@@ -838,22 +941,36 @@ int main(int argc, char** argv)
 	ofstream fa(opt::consensusPath.c_str());
 	assert_good(fa, opt::consensusPath);
 
-	init_parameters();
-	set_parameters_dna();
-	para->DEBUG = opt::dialign_debug;
-	para->SCR_MATRIX_FILE_NAME = (char*)opt::dialign_score.c_str();
-	para->DIAG_PROB_FILE_NAME = (char*)opt::dialign_prob.c_str();
-	initDialign();
-
 	// Contigs that were seen in a consensus.
 	vector<bool> seen(contigs.size());
 
-	// resolve ambiguous paths recorded in g_ambpath_contig
-	g_contigNames.unlock();
+	// Paths that share a sequence align the same pair of sequences.
+	setAlignGlobalCacheSize();
+
+	// Resolve the ambiguous paths recorded in g_ambpath_contig.
+	// The gaps of a batch are filled in parallel, and then their new
+	// contigs are added to the graph in order.
+	const size_t BATCH_SIZE = 1024;
+	vector<AmbPath2Contig::iterator> batch;
+	vector<GapConsensus> gaps;
+	batch.reserve(BATCH_SIZE);
 	for (AmbPath2Contig::iterator ambIt = g_ambpath_contig.begin();
-			ambIt != g_ambpath_contig.end(); ambIt++)
-		ambIt->second = fillGap(g, ambIt->first, seen, fa);
-	g_contigNames.lock();
+			ambIt != g_ambpath_contig.end();) {
+		batch.clear();
+		for (; ambIt != g_ambpath_contig.end()
+				&& batch.size() < BATCH_SIZE; ++ambIt)
+			batch.push_back(ambIt);
+		gaps.clear();
+		gaps.resize(batch.size());
+#pragma omp parallel for schedule(dynamic)
+		for (ptrdiff_t i = 0; i < (ptrdiff_t)batch.size(); ++i)
+			fillGap(g, batch[i]->first, gaps[i]);
+
+		g_contigNames.unlock();
+		for (size_t i = 0; i < batch.size(); ++i)
+			batch[i]->second = addGap(g, gaps[i], seen, fa);
+		g_contigNames.lock();
+	}
 	assert_good(fa, opt::consensusPath);
 	fa.close();
 	if (opt::verbose > 1)
@@ -910,9 +1027,6 @@ int main(int argc, char** argv)
 	assert_good(out, opt::out);
 	out.close();
 
-	free_prob_dist(pdist);
-	free(para);
-
 	cerr <<
 		"Ambiguous paths: " << stats.numAmbPaths << "\n"
 		"Merged:          " << stats.numMerged << "\n"
@@ -920,6 +1034,8 @@ int main(int argc, char** argv)
 		"Too many paths:  " << stats.numTooManySolutions << "\n"
 		"Too complex:     " << stats.tooComplex << "\n"
 		"Dissimilar:      " << stats.notMerged << "\n";
+	if (opt::verbose > 0)
+		printAlignGlobalCacheStats(cerr);
 
 	if (!opt::graphPath.empty()) {
 		ofstream fout(opt::graphPath.c_str());
@@ -7,6 +7,7 @@
 #include "StringUtil.h"
 #include "Uncompress.h"
 #include "UnorderedMap.h"
+#include "city.h"
 #include <algorithm>
 #include <climits>
 #include <cmath>
@@ -21,6 +22,9 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 
@@ -47,6 +51,7 @@ static const char USAGE_MESSAGE[] =
 "      --sam             alignments are in SAM format\n"
 "      --kaligner        alignments are in KAligner format\n"
 "  -c, --cover=COVERAGE  coverage cut-off for distance estimates\n"
+"  -j, --threads=N       use N parallel threads [1]\n"
 "  -v, --verbose         display verbose output\n"
 "      --help            display this help and exit\n"
 "      --version         output version information and exit\n"
@@ -60,6 +65,7 @@ namespace opt {
 	static string distPath;
 	static string fragPath;
 	static string histPath;
+	static int threads = 1;
 
 	/** Input alignment format. */
 	static int inputFormat;
@@ -69,7 +75,7 @@ namespace opt {
  	int format = ADJ; // used by Estimate
 }
 
-static const char shortopts[] = "d:l:f:h:c:v";
+static const char shortopts[] = "d:l:f:h:c:j:v";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
@@ -81,6 +87,7 @@ static const struct option longopts[] = {
 	{ "kaligner",no_argument, &opt::inputFormat, opt::KALIGNER },
 	{ "sam",     no_argument, &opt::inputFormat, opt::SAM },
 	{ "cover",   required_argument, NULL, 'c' },
+	{ "threads", required_argument, NULL, 'j' },
 	{ "verbose", no_argument,       NULL, 'v' },
 	{ "help",    no_argument,       NULL, OPT_HELP },
 	{ "version", no_argument,       NULL, OPT_VERSION },
@@ -102,14 +109,115 @@ static Histogram histogram;
 
 typedef vector<Alignment> AlignmentVector;
 
-/** A map of read IDs to alignments. */
-typedef unordered_map<string, AlignmentVector> ReadAlignMap;
+/** An alignment whose target is identified by its index in
+ * g_contigNames. */
+struct CompactAlignment
+{
+	unsigned contig;
+	int contig_start_pos;
+	int read_start_pos;
+	int align_length;
+	unsigned read_length : 31;
+	unsigned isRC : 1;
+
+	operator Alignment() const
+	{
+		return Alignment(string(get(g_contigNames, contig)),
+				contig_start_pos, read_start_pos, align_length,
+				read_length, isRC);
+	}
+};
+
+/** The alignments of a read. A single alignment, which is the
+ * common case, is stored inline, and more alignments are stored on
+ * the heap. */
+class AlignmentList
+{
+  public:
+	typedef const CompactAlignment* const_iterator;
+
+	AlignmentList() : m_size(0) { }
+	AlignmentList(const AlignmentList& o) : m_size(0) { *this = o; }
+	~AlignmentList() { clear(); }
+
+	AlignmentList& operator=(const AlignmentList& o)
+	{
+		if (this != &o)
+			assign(o.begin(), o.end());
+		return *this;
+	}
+
+	void assign(const_iterator first, const_iterator last)
+	{
+		clear();
+		m_size = last - first;
+		if (m_size == 1)
+			m_one = *first;
+		else if (m_size > 1) {
+			m_many = new CompactAlignment[m_size];
+			copy(first, last, m_many);
+		}
+	}
+
+	void clear()
+	{
+		if (m_size > 1)
+			delete[] m_many;
+		m_size = 0;
+	}
+
+	const_iterator begin() const { return m_size > 1 ? m_many : &m_one; }
+	const_iterator end() const { return begin() + m_size; }
+	size_t size() const { return m_size; }
+
+  private:
+	unsigned m_size;
+	union {
+		CompactAlignment m_one;
+		CompactAlignment* m_many;
+	};
+};
+
+/** Return the alignments of a read with the names of their targets.
+ */
+static AlignmentVector toAlignments(AlignmentList::const_iterator first,
+		AlignmentList::const_iterator last)
+{
+	return AlignmentVector(first, last);
+}
+
+/** The key of a read pair, which is a hash of the ID of one read
+ * of the pair. */
+typedef uint128 PairKey;
+
+/** Hash a pair key, which is already a hash of the read ID. */
+struct HashPairKey {
+	size_t operator()(const PairKey& key) const { return key.first; }
+};
+
+/** A read whose mate has not been seen yet. */
+struct PendingRead
+{
+	AlignmentList alignments;
+
+	/** Whether this read is the read of the pair whose ID is hashed
+	 * for the key of the pair */
+	bool keyed;
+
+	/** Whether the alignments of this read are flipped */
+	bool flip;
+};
+
+/** A map of read pairs to the read whose mate has not been seen. */
+typedef unordered_map<PairKey, PendingRead, HashPairKey> ReadAlignMap;
 
 /** A map of contig IDs to distance estimates. */
 typedef unordered_map<string, EstimateRecord> EstimateMap;
 static EstimateMap estMap;
 
 static bool checkUniqueAlignments(const AlignmentVector& alignVec);
+static bool isSingleEnd(const string& id);
+static bool needsFlipping(const string& id);
 static string makePairID(string id);
 
 /**
@@ -152,9 +260,9 @@ static void addEstimate(EstimateMap& map, const Alignment& a,
 
 }
 
-static void doReadIntegrity(const ReadAlignMap::value_type& a)
+static void doReadIntegrity(const AlignmentVector& alignments)
 {
-	AlignmentVector::const_iterator refAlignIter = a.second.begin();
+	AlignmentVector::const_iterator refAlignIter = alignments.begin();
 	unsigned firstStart, lastEnd, largestSize;
 	Alignment first, last, largest;
 
@@ -164,8 +272,8 @@ static void doReadIntegrity(const ReadAlignMap::value_type& a)
 	first = last = largest = *refAlignIter;
 	++refAlignIter;
 
-	//for each alignment in the vector a.second
-	for (; refAlignIter != a.second.end(); ++refAlignIter) {
+	//for each alignment in the vector alignments
+	for (; refAlignIter != alignments.end(); ++refAlignIter) {
 		if ((unsigned)refAlignIter->read_start_pos < firstStart) {
 			firstStart = refAlignIter->read_start_pos;
 			first = *refAlignIter;
@@ -292,62 +400,68 @@ static void generateDistFile()
 	distFile.close();
 }
 
-static bool isSingleEnd(const string& id);
-static bool needsFlipping(const string& id);
-
 /**
  * Return an alignment flipped as necessary to produce an alignment
  * pair whose expected orientation is forward-reverse.  If the
  * expected orientation is forward-forward, then reverse the first
  * alignment, so that the alignment is forward-reverse, which is
  * required by DistanceEst.
+ * @param flip whether the ID of the read needs flipping
  */
-static const Alignment flipAlignment(const Alignment& a,
-		const string& id)
+static const Alignment flipAlignment(const Alignment& a, bool flip)
 {
-	return needsFlipping(id) ? a.flipQuery() : a;
+	return flip ? a.flipQuery() : a;
 }
 
-static void handleAlignmentPair(const ReadAlignMap::value_type& curr,
-		const ReadAlignMap::value_type& pair)
+/** A read and its alignments. */
+typedef pair<AlignmentVector, bool> ReadAlignments;
+
+/** Handle a read and its mate.
+ * @param curr the alignments of the read and whether it needs
+ * flipping
+ * @param pair the alignments of the mate and whether it needs
+ * flipping
+ */
+static void handleAlignmentPair(const ReadAlignments& curr,
+		const ReadAlignments& pair)
 {
-	const string& currID = curr.first;
-	const string& pairID = pair.first;
+	bool currFlip = curr.second;
+	bool pairFlip = pair.second;
 
 	// Both reads must align to a unique location.
 	// The reads are allowed to span more than one contig, but
 	// at least one of the two reads must span no more than
 	// two contigs.
 	const unsigned MAX_SPAN = 2;
-	if (curr.second.empty() && pair.second.empty()) {
+	if (curr.first.empty() && pair.first.empty()) {
 		stats.bothUnaligned++;
-	} else if (curr.second.empty() || pair.second.empty()) {
+	} else if (curr.first.empty() || pair.first.empty()) {
 		stats.oneUnaligned++;
-	} else if (!checkUniqueAlignments(curr.second)
-			|| !checkUniqueAlignments(pair.second)) {
+	} else if (!checkUniqueAlignments(curr.first)
+			|| !checkUniqueAlignments(pair.first)) {
 		stats.numMulti++;
-	} else if (curr.second.size() > MAX_SPAN
-			&& pair.second.size() > MAX_SPAN) {
+	} else if (curr.first.size() > MAX_SPAN
+			&& pair.first.size() > MAX_SPAN) {
 		stats.numSplit++;
 	} else {
 		// Iterate over the vectors, outputting the aligments
 		bool counted = false;
 		for (AlignmentVector::const_iterator refAlignIter
-					= curr.second.begin();
-				refAlignIter != curr.second.end(); ++refAlignIter) {
+					= curr.first.begin();
+				refAlignIter != curr.first.end(); ++refAlignIter) {
 			for (AlignmentVector::const_iterator pairAlignIter
-						= pair.second.begin();
-					pairAlignIter != pair.second.end();
+						= pair.first.begin();
+					pairAlignIter != pair.first.end();
 					++pairAlignIter) {
 				const Alignment& a0 = flipAlignment(*refAlignIter,
-						currID);
+						currFlip);
 				const Alignment& a1 = flipAlignment(*pairAlignIter,
-						pairID);
+						pairFlip);
 
 				bool sameTarget = a0.contig == a1.contig;
 				if (sameTarget
-						&& curr.second.size() == 1
-						&& pair.second.size() == 1) {
+						&& curr.first.size() == 1
+						&& pair.first.size() == 1) {
 					// Same target and the only alignment.
 					if (a0.isRC != a1.isRC) {
 						// Correctly oriented. Add this alignment to
@@ -397,71 +511,357 @@ static void printProgress(const ReadAlignMap& map)
 	}
 }
 
-static void handleAlignment(
-		const ReadAlignMap::value_type& alignments,
-		ReadAlignMap& out)
+/** A line of the input that has been parsed. */
+struct ParsedLine
 {
-	if (!isSingleEnd(alignments.first)) {
-		string pairID = makePairID(alignments.first);
-		ReadAlignMap::iterator pairIter = out.find(pairID);
-		if (pairIter != out.end()) {
-			handleAlignmentPair(*pairIter, alignments);
-			out.erase(pairIter);
-		} else if (!out.insert(alignments).second) {
-			cerr << "error: duplicate read ID `" << alignments.first
-				<< "'\n";
-			exit(EXIT_FAILURE);
+	/** The start of the line */
+	const char* line;
+
+	/** Whether this line is a header, which is copied to the output
+	 */
+	bool header;
+
+	/** The length of the read ID in the line, and the suffix of the
+	 * read ID, which is added to the ID of a SAM record, or zero */
+	unsigned idLength;
+	char idSuffix;
+
+	/** Whether the read is single-end */
+	bool singleEnd;
+
+	/** Whether the read has the same ID as its mate */
+	bool samePairID;
+
+	/** Whether this read is the read whose ID is hashed for the key
+	 * of the pair */
+	bool keyed;
+
+	/** Whether the alignments of this read are flipped */
+	bool flip;
+
+	PairKey key;
+
+	/** The range of the alignments of this read in the alignments
+	 * of its chunk */
+	size_t first, last;
+
+	/** Return the ID of this read. */
+	string id() const
+	{
+		string s(line, idLength);
+		if (idSuffix != 0) {
+			s += '/';
+			s += idSuffix;
 		}
+		return s;
 	}
+};
 
-	if (!opt::distPath.empty() && alignments.second.size() >= 2)
-		doReadIntegrity(alignments);
+/** An alignment whose target name has not been looked up. */
+struct ParsedAlignment
+{
+	const char* contig;
+	unsigned contigLength;
+	CompactAlignment a;
+};
 
-	stats.alignments++;
-	printProgress(out);
+/** The lines and alignments of a chunk of the input. */
+struct ParsedChunk
+{
+	vector<ParsedLine> lines;
+	vector<ParsedAlignment> alignments;
+};
+
+/** Report an invalid line and exit. */
+static void invalidLine(const char* line)
+{
+	cerr << PROGRAM ": error: invalid alignment: `"
+		<< string(line, strcspn(line, "\n")) << "'\n";
+	exit(EXIT_FAILURE);
+}
+
+/** Return whether c ends a field. */
+static bool isFieldEnd(char c)
+{
+	return c == '\t' || c == ' ' || c == '\n' || c == '\r' || c == '\0';
+}
+
+/** Return whether c ends a line. */
+static bool isLineEnd(char c)
+{
+	return c == '\n' || c == '\0';
+}
+
+/** Skip the white space that separates fields. */
+static const char* skipSpace(const char* p)
+{
+	while (*p == '\t' || *p == ' ' || *p == '\r')
+		++p;
+	return p;
+}
+
+/** Return the end of the field that starts at p. */
+static const char* fieldEnd(const char* p)
+{
+	while (!isFieldEnd(*p))
+		++p;
+	return p;
+}
+
+/** Parse an integer field, and return the start of the next field.
+ */
+static const char* parseInteger(const char* p, int& x,
+		const char* line)
+{
+	char* end;
+	x = strtol(p, &end, 10);
+	if (end == p || !isFieldEnd(*end))
+		invalidLine(line);
+	return skipSpace(end);
+}
+
+/** Parse a SAM record into a read ID and at most one alignment. */
+static void parseSAM(const char* line,
+		ParsedLine& read, vector<ParsedAlignment>& alignments)
+{
+	const char* fields[6];
+	const char* p = line;
+	for (unsigned i = 0; i < 6; ++i) {
+		if (isLineEnd(*p))
+			invalidLine(line);
+		fields[i] = p;
+		p = skipSpace(fieldEnd(p));
+	}
+
+	int flag, pos;
+	parseInteger(fields[1], flag, line);
+	parseInteger(fields[3], pos, line);
+	pos--;
+
+	// Strip /1 or /2 from the read ID and set the paired flags.
+	const char* qname = fields[0];
+	unsigned l = fieldEnd(qname) - qname;
+	bool checkAlign = true;
+	if (l >= 2 && qname[l-2] == '/') {
+		switch (qname[l-1]) {
+			case '1':
+				flag |= SAMAlignment::FPAIRED | SAMAlignment::FREAD1;
+				l -= 2;
+				break;
+			case '2': case '3':
+				flag |= SAMAlignment::FPAIRED | SAMAlignment::FREAD2;
+				l -= 2;
+				break;
+			default:
+				checkAlign = false;
+		}
+		assert(l > 0);
+	}
+	read.idLength = l;
+	read.idSuffix = flag & SAMAlignment::FREAD1 ? '1'
+		: flag & SAMAlignment::FREAD2 ? '2' : 0;
+
+	// Set the unmapped flag if the alignment is not long enough.
+	const char* cigar = fields[5];
+	if (checkAlign) {
+		SAMAlignment::CigarCoord a(cigar);
+		if (a.qspan < opt::minAlign || a.tspan < opt::minAlign)
+			flag |= SAMAlignment::FUNMAP;
+	}
+	if (flag & SAMAlignment::FUNMAP)
+		return;
+
+	bool isRC = flag & SAMAlignment::FREVERSE;
+	Alignment a = SAMAlignment::parseCigar(cigar, isRC);
+	ParsedAlignment x;
+	x.contig = fields[2];
+	x.contigLength = fieldEnd(fields[2]) - fields[2];
+	x.a.contig_start_pos = pos;
+	x.a.read_start_pos = a.read_start_pos;
+	x.a.align_length = a.align_length;
+	x.a.read_length = a.read_length;
+	x.a.isRC = isRC;
+	alignments.push_back(x);
+}
+
+/** Parse a line of KAligner output into a read ID and its
+ * alignments. */
+static void parseKAligner(const char* line,
+		ParsedLine& read, vector<ParsedAlignment>& alignments)
+{
+	const char* p = fieldEnd(line);
+	read.idLength = p - line;
+	read.idSuffix = 0;
+	for (p = skipSpace(p); !isLineEnd(*p);) {
+		ParsedAlignment x;
+		x.contig = p;
+		p = fieldEnd(p);
+		x.contigLength = p - x.contig;
+		int readLength, isRC;
+		p = parseInteger(skipSpace(p), x.a.contig_start_pos, line);
+		p = parseInteger(p, x.a.read_start_pos, line);
+		p = parseInteger(p, x.a.align_length, line);
+		p = parseInteger(p, readLength, line);
+		p = parseInteger(p, isRC, line);
+		if (isRC != 0 && isRC != 1)
+			invalidLine(line);
+		x.a.read_length = readLength;
+		x.a.isRC = isRC;
+		alignments.push_back(x);
+	}
 }
 
-static void readAlignment(const string& line, ReadAlignMap& out)
+/** Parse a line of the input and the ID of its read. */
+static void parseLine(const char* line, ParsedChunk& chunk)
 {
-	istringstream s(line);
-	pair<string, AlignmentVector> v;
+	ParsedLine read;
+	read.line = line;
+	read.header = isLineEnd(*line) || *line == '@';
+	read.idLength = 0;
+	read.idSuffix = 0;
+	read.singleEnd = true;
+	read.samePairID = read.keyed = read.flip = false;
+	read.key = PairKey(0, 0);
+	read.first = read.last = chunk.alignments.size();
+	if (read.header) {
+		chunk.lines.push_back(read);
+		return;
+	}
+
 	switch (opt::inputFormat) {
 	  case opt::SAM:
-	  {
-		SAMRecord sam;
-		s >> sam;
-		assert(s);
-		v.first = sam.qname;
-		if (sam.isRead1())
-			v.first += "/1";
-		else if (sam.isRead2())
-			v.first += "/2";
-		if (!sam.isUnmapped())
-			v.second.push_back(sam);
+		parseSAM(line, read, chunk.alignments);
 		break;
-	  }
 	  case opt::KALIGNER:
-	  {
-		s >> v.first;
-		assert(s);
-		v.second.reserve(count(line.begin(), line.end(), '\t'));
-		v.second.assign(
-					istream_iterator<Alignment>(s),
-					istream_iterator<Alignment>());
-		assert(s.eof());
+		parseKAligner(line, read, chunk.alignments);
 		break;
-	  }
 	}
-	handleAlignment(v, out);
+	read.last = chunk.alignments.size();
+
+	// Both reads of a pair are identified by the hash of the lesser
+	// of their two IDs.
+	string id = read.id();
+	read.singleEnd = isSingleEnd(id);
+	read.flip = needsFlipping(id);
+	if (!read.singleEnd) {
+		string pairID = makePairID(id);
+		read.samePairID = pairID == id;
+		read.keyed = id <= pairID;
+		const string& keyID = read.keyed ? id : pairID;
+		read.key = CityHash128(keyID.data(), keyID.size());
+	}
+	chunk.lines.push_back(read);
+}
+
+/** The number of bytes of the input that are read at once */
+static const size_t BLOCK_SIZE = 4 << 20;
+
+/** The number of bytes of the input that are parsed by one task */
+static const size_t CHUNK_SIZE = 64 << 10;
+
+/** Parse a block of the input in parallel. The block is split into
+ * chunks at line boundaries. */
+static void parseBlock(const string& block, vector<ParsedChunk>& chunks)
+{
+	vector<size_t> starts(1, 0);
+	while (starts.back() < block.size()) {
+		size_t end = starts.back() + CHUNK_SIZE;
+		end = end < block.size() ? block.find('\n', end) : string::npos;
+		starts.push_back(end == string::npos ? block.size() : end + 1);
+	}
+
+	chunks.resize(starts.size() - 1);
+#pragma omp parallel for schedule(dynamic)
+	for (ptrdiff_t i = 0; i < (ptrdiff_t)chunks.size(); ++i) {
+		ParsedChunk& chunk = chunks[i];
+		chunk.lines.clear();
+		chunk.alignments.clear();
+		const char* p = block.c_str() + starts[i];
+		const char* end = block.c_str() + starts[i + 1];
+		while (p < end) {
+			parseLine(p, chunk);
+			p = static_cast<const char*>(memchr(p, '\n', end - p));
+			p = p == NULL ? end : p + 1;
+		}
+	}
+}
+
+/** Return the index of the specified contig, and add it to the
+ * dictionary of contig names if it is new.
+ */
+static unsigned contigIndex(const char* name, unsigned length)
+{
+	static string s;
+	s.assign(name, length);
+	if (g_contigNames.count(s) > 0)
+		return g_contigNames.getIndex(s);
+	return g_contigNames.insert(s);
+}
+
+static void handleAlignment(const ParsedLine& read,
+		const vector<CompactAlignment>& alignments,
+		ReadAlignMap& out)
+{
+	const CompactAlignment* first = alignments.empty() ? NULL
+		: &alignments[0];
+	const CompactAlignment* last = first + alignments.size();
+	if (!read.singleEnd) {
+		ReadAlignMap::iterator pairIter = out.find(read.key);
+		if (pairIter == out.end()) {
+			PendingRead& x = out[read.key];
+			x.alignments.assign(first, last);
+			x.keyed = read.keyed;
+			x.flip = read.flip;
+		} else if (read.samePairID
+				|| pairIter->second.keyed != read.keyed) {
+			const AlignmentList& pair = pairIter->second.alignments;
+			handleAlignmentPair(
+					ReadAlignments(toAlignments(pair.begin(), pair.end()),
+						pairIter->second.flip),
+					ReadAlignments(toAlignments(first, last),
+						read.flip));
+			out.erase(pairIter);
+		} else {
+			cerr << "error: duplicate read ID `" << read.id()
+				<< "'\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (!opt::distPath.empty() && alignments.size() >= 2)
+		doReadIntegrity(toAlignments(first, last));
+
+	stats.alignments++;
+	printProgress(out);
 }
 
 static void readAlignments(istream& in, ReadAlignMap* pout)
 {
-	for (string line; getline(in, line);)
-		if (line.empty() || line[0] == '@')
-			cout << line << '\n';
-		else
-			readAlignment(line, *pout);
+	vector<ParsedChunk> chunks;
+	vector<CompactAlignment> alignments;
+	for (string block; readLines(in, block, BLOCK_SIZE);) {
+		parseBlock(block, chunks);
+		for (vector<ParsedChunk>::const_iterator chunk = chunks.begin();
+				chunk != chunks.end(); ++chunk) {
+			for (vector<ParsedLine>::const_iterator it
+						= chunk->lines.begin();
+					it != chunk->lines.end(); ++it) {
+				if (it->header) {
+					cout << string(it->line,
+							strcspn(it->line, "\n")) << '\n';
+					continue;
+				}
+				alignments.clear();
+				for (size_t i = it->first; i < it->last; ++i) {
+					const ParsedAlignment& x = chunk->alignments[i];
+					alignments.push_back(x.a);
+					alignments.back().contig
+						= contigIndex(x.contig, x.contigLength);
+				}
+				handleAlignment(*it, alignments, *pout);
+			}
+		}
+	}
 	assert(in.eof());
 }
 
@@ -495,6 +895,7 @@ int main(int argc, char* const* argv)
 			case '?': die = true; break;
 			case 'l': arg >> opt::k; break;
 			case 'c': arg >> opt::c; break;
+			case 'j': arg >> opt::threads; break;
 			case 'd': arg >> opt::distPath; break;
 			case 'f': arg >> opt::fragPath; break;
 			case 'h': arg >> opt::histPath; break;
@@ -524,6 +925,11 @@ int main(int argc, char* const* argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	if (!opt::fragPath.empty()) {
 		fragFile.open(opt::fragPath.c_str());
 		assert(fragFile.is_open());
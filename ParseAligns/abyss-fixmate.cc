@@ -6,8 +6,10 @@
 #include "Uncompress.h"
 #include "UnorderedMap.h"
 #include "ContigID.h"
+#include "city.h"
 #include <algorithm>
 #include <climits>
+#include <cstdio> // for perror and remove
 #include <cstdlib>
 #include <fstream>
 #include <functional>
@@ -17,7 +19,10 @@
 #include <iterator>
 #include <sstream>
 #include <string>
+#include <stdint.h>
+#include <unistd.h> // for rmdir
 #include <boost/unordered_map.hpp>
+#include <boost/version.hpp>
 
 using namespace std;
 
@@ -46,6 +51,9 @@ static const char USAGE_MESSAGE[] =
 "  -s, --same=SAME       write properly-paired reads to this file\n"
 "  -h, --hist=FILE       write the fragment size histogram to FILE\n"
 "  -c, --cov=FILE        write the physical coverage to FILE\n"
+"  -m, --max-mem=N       keep at most N bytes of unpaired alignments in\n"
+"                        memory, and spill the rest to temporary files\n"
+"                        in TMPDIR [unlimited]\n"
 "  -v, --verbose         display verbose output\n"
 "      --help            display this help and exit\n"
 "      --version         output version information and exit\n"
@@ -59,9 +67,13 @@ namespace opt {
 	static int qname;
 	static int verbose;
 	static int print_all;
+
+	/** The memory budget of the unpaired alignments, or zero for no
+	 * limit */
+	static size_t maxMem;
 }
 
-static const char shortopts[] = "h:c:l:s:v";
+static const char shortopts[] = "h:c:l:m:s:v";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
@@ -73,6 +85,7 @@ static const struct option longopts[] = {
 	{ "min-align", required_argument, NULL, 'l' },
 	{ "hist",      required_argument, NULL, 'h' },
 	{ "cov",       required_argument, NULL, 'c' },
+	{ "max-mem",   required_argument, NULL, 'm' },
 	{ "same",      required_argument, NULL, 's' },
 	{ "verbose",   no_argument,       NULL, 'v' },
 	{ "help",      no_argument,       NULL, OPT_HELP },
@@ -108,7 +121,7 @@ static void handlePair(SAMRecord& a0, SAMRecord& a1)
 {
 	if ((a0.isRead1() && a1.isRead1())
 			|| (a0.isRead2() && a1.isRead2())) {
-		cerr << "error: duplicate read ID `" << a0.qname
+		cerr << "error: duplicate read ID `" << a1.qname
 			<< (a0.isRead1() ? "/1" : "")
 			<< (a0.isRead2() ? "/2" : "")
 			<< "'\n";
@@ -154,11 +167,189 @@ static void handlePair(SAMRecord& a0, SAMRecord& a1)
 	}
 }
 
+/** The key of a read, which is a 128-bit hash of its name. */
+typedef uint128 ReadKey;
+
+/** Return the key of the specified read name. */
+static ReadKey readKey(const string& qname)
+{
+	return CityHash128(qname.data(), qname.size());
+}
+
+/** Hash a read key, which is already a hash of the read name. */
+struct HashReadKey {
+	size_t operator()(const ReadKey& key) const { return key.first; }
+};
+
+/** Return the index of the specified target name in g_contigNames,
+ * and add the name if it is not already present. */
+static unsigned contigIndex(const string& name)
+{
+	if (g_contigNames.count(name) > 0)
+		return g_contigNames.getIndex(name);
+	return g_contigNames.insert(name);
+}
+
+#if SAM_SEQ_QUAL
+/** An alignment whose mate has not been seen yet. */
+typedef SAMRecord PendingAlignment;
+
+static PendingAlignment pack(const SAMRecord& sam) { return sam; }
+static SAMRecord unpack(const PendingAlignment& a) { return a; }
+#else
+/** An alignment whose mate has not been seen yet, which stores the
+ * index of its target rather than its name. The read name is stored
+ * only when it is printed. */
+struct PendingAlignment {
+	uint32_t rname;
+	int32_t pos;
+	uint16_t flag;
+	uint16_t mapq;
+	string cigar;
+	string qname;
+};
+
+static PendingAlignment pack(const SAMRecord& sam)
+{
+	PendingAlignment a;
+	a.rname = contigIndex(sam.rname);
+	a.pos = sam.pos;
+	a.flag = sam.flag;
+	a.mapq = sam.mapq;
+	a.cigar = sam.cigar;
+	if (opt::qname || opt::print_all)
+		a.qname = sam.qname;
+	return a;
+}
+
+static SAMRecord unpack(const PendingAlignment& a)
+{
+	SAMAlignment sam;
+	sam.rname = string(get(g_contigNames, a.rname));
+	sam.pos = a.pos;
+	sam.flag = a.flag;
+	sam.mapq = a.mapq;
+	sam.cigar = a.cigar;
+	return SAMRecord(sam, a.qname.empty() ? "*" : a.qname);
+}
+#endif
+
+/** Write a string to a binary file. */
+static void write(ostream& out, const string& s)
+{
+	uint32_t n = s.size();
+	out.write(reinterpret_cast<const char*>(&n), sizeof n);
+	out.write(s.data(), n);
+}
+
+/** Read a string from a binary file. */
+static void read(istream& in, string& s)
+{
+	uint32_t n = 0;
+	in.read(reinterpret_cast<char*>(&n), sizeof n);
+	s.resize(n);
+	if (n > 0)
+		in.read(&s[0], n);
+}
+
+/** Write a fixed-size field to a binary file. */
+template <typename T>
+static void write(ostream& out, const T& x)
+{
+	out.write(reinterpret_cast<const char*>(&x), sizeof x);
+}
+
+/** Read a fixed-size field from a binary file. */
+template <typename T>
+static void read(istream& in, T& x)
+{
+	in.read(reinterpret_cast<char*>(&x), sizeof x);
+}
+
+/** Write an unpaired alignment to a spill file. */
+static void write(ostream& out,
+		const ReadKey& key, const PendingAlignment& a)
+{
+	write(out, key.first);
+	write(out, key.second);
 #if SAM_SEQ_QUAL
-typedef boost::unordered_map<string, SAMRecord> Alignments;
+	write(out, contigIndex(a.rname));
+	write(out, a.pos);
+	write(out, a.flag);
+	write(out, a.mapq);
+	write(out, a.cigar);
+	write(out, a.qname);
+	write(out, contigIndex(a.mrnm));
+	write(out, a.mpos);
+	write(out, a.isize);
+	write(out, a.seq);
+	write(out, a.qual);
+	write(out, a.tags);
 #else
-typedef boost::unordered_map<string, SAMAlignment> Alignments;
+	write(out, a.rname);
+	write(out, a.pos);
+	write(out, a.flag);
+	write(out, a.mapq);
+	write(out, a.cigar);
+	write(out, a.qname);
 #endif
+}
+
+/** Read an unpaired alignment from a spill file. */
+static bool read(istream& in, ReadKey& key, PendingAlignment& a)
+{
+	read(in, key.first);
+	read(in, key.second);
+#if SAM_SEQ_QUAL
+	unsigned rname = 0, mrnm = 0;
+	read(in, rname);
+	read(in, a.pos);
+	read(in, a.flag);
+	read(in, a.mapq);
+	read(in, a.cigar);
+	read(in, a.qname);
+	read(in, mrnm);
+	read(in, a.mpos);
+	read(in, a.isize);
+	read(in, a.seq);
+	read(in, a.qual);
+	read(in, a.tags);
+	if (in) {
+		a.rname = string(get(g_contigNames, rname));
+		a.mrnm = string(get(g_contigNames, mrnm));
+	}
+#else
+	read(in, a.rname);
+	read(in, a.pos);
+	read(in, a.flag);
+	read(in, a.mapq);
+	read(in, a.cigar);
+	read(in, a.qname);
+#endif
+	return !in.fail();
+}
+
+/** Return the number of bytes of the heap used by a string. */
+static size_t heapSize(const string& s)
+{
+	return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+typedef boost::unordered_map<ReadKey, PendingAlignment, HashReadKey>
+	Alignments;
+
+/** Return the approximate memory used by an unpaired alignment. */
+static size_t memoryUsage(const PendingAlignment& a)
+{
+	// An element of the map is a node of a linked list.
+	size_t n = sizeof (Alignments::value_type) + 2 * sizeof (void*)
+		+ heapSize(a.cigar) + heapSize(a.qname);
+#if SAM_SEQ_QUAL
+	n += heapSize(a.rname) + heapSize(a.mrnm) + heapSize(a.seq)
+		+ heapSize(a.qual) + heapSize(a.tags);
+#endif
+	return n;
+}
 
 static void printProgress(const Alignments& map)
 {
@@ -180,28 +371,239 @@ static void printProgress(const Alignments& map)
 	}
 }
 
-static void handleAlignment(SAMRecord& sam, Alignments& map)
+/** The directory of the spill files */
+static string g_spillDir;
+
+/** The number of spill files that have been created */
+static unsigned g_numSpillFiles;
+
+/** Return the path of the specified spill file. */
+static string spillPath(unsigned i)
 {
-	pair<Alignments::iterator, bool> it = map.insert(
-			make_pair(sam.qname, sam));
-	if (!it.second) {
-#if SAM_SEQ_QUAL
-		SAMRecord& a0 = it.first->second;
-#else
-		SAMRecord a0(it.first->second, it.first->first);
-#endif
+	ostringstream path;
+	path << g_spillDir << '/' << i;
+	return path.str();
+}
+
+/** Remove the spill files that remain and their directory, so that
+ * an error exit does not leave them in TMPDIR. */
+static void removeSpillDir()
+{
+	if (g_spillDir.empty())
+		return;
+	for (unsigned i = 0; i < g_numSpillFiles; ++i)
+		remove(spillPath(i).c_str());
+	rmdir(g_spillDir.c_str());
+	g_spillDir.clear();
+}
+
+/**
+ * The alignments whose mate has not been seen yet. When the table
+ * uses more memory than its budget, its alignments are moved to
+ * spill files on disk, which are partitioned by the hash of the read
+ * name, so that the two alignments of a pair are always in the same
+ * partition. Each partition is paired in turn after the input is
+ * read, and a partition that does not fit in the budget is itself
+ * partitioned again by a different part of the hash.
+ */
+class PendingMates
+{
+  public:
+	/** Construct a table that uses at most maxBytes of memory.
+	 * @param maxBytes the budget, or zero for no limit
+	 * @param level the depth of the partitions of this table
+	 */
+	PendingMates(size_t maxBytes, unsigned level = 0)
+		: m_map(1), m_maxBytes(maxBytes), m_bytes(0), m_level(level),
+		m_mateless(0) { }
+
+	~PendingMates()
+	{
+		for (unsigned i = 0; i < m_files.size(); ++i)
+			delete m_files[i];
+	}
+
+	/** Pair the specified alignment with its mate, or store it
+	 * until its mate is seen. */
+	void insert(const ReadKey& key, SAMRecord& sam)
+	{
+		Alignments::iterator it = m_map.find(key);
+		if (it == m_map.end()) {
+			insert(key, pack(sam));
+			return;
+		}
+		SAMRecord a0 = unpack(it->second);
 		handlePair(a0, sam);
+		erase(it);
+	}
 
-#include <boost/version.hpp>
+	/** Pair the unpaired alignment with its mate, or store it
+	 * until its mate is seen. */
+	void insert(const ReadKey& key, const PendingAlignment& a)
+	{
+		pair<Alignments::iterator, bool> inserted
+			= m_map.insert(make_pair(key, a));
+		if (!inserted.second) {
+			SAMRecord a0 = unpack(inserted.first->second);
+			SAMRecord a1 = unpack(a);
+			handlePair(a0, a1);
+			erase(inserted.first);
+			return;
+		}
+		m_bytes += memoryUsage(a);
+		if (m_maxBytes > 0 && m_level < MAX_LEVEL
+				&& m_bytes + m_map.bucket_count() * sizeof (void*)
+					> m_maxBytes)
+			spill();
+	}
+
+	/** Pair the alignments of the spill files after the input is
+	 * read, and count the alignments whose mate was not seen.
+	 * Print them if all alignments are printed.
+	 */
+	void finish()
+	{
+		if (!m_files.empty()) {
+			spill();
+			for (unsigned i = 0; i < m_files.size(); ++i) {
+				delete m_files[i];
+				m_files[i] = NULL;
+				finishPartition(m_paths[i]);
+			}
+			m_files.clear();
+			m_paths.clear();
+		}
+
+		m_mateless += m_map.size();
+		if (opt::print_all) {
+			for (Alignments::const_iterator it = m_map.begin();
+					it != m_map.end(); ++it) {
+				SAMRecord a0 = unpack(it->second);
+				a0.noMate();
+				cout << a0 << '\n';
+				assert(cout.good());
+			}
+		}
+	}
+
+	/** Return the number of alignments whose mate was not seen. */
+	size_t mateless() const { return m_mateless; }
+
+	const Alignments& map() const { return m_map; }
+
+  private:
+	/** The number of bits of the hash that select a partition */
+	static const unsigned PARTITION_BITS = 6;
+
+	/** The maximum depth of the partitions, which is limited by the
+	 * number of bits of the hash */
+	static const unsigned MAX_LEVEL = 64 / PARTITION_BITS;
+
+	/** Remove a paired alignment from the table. */
+	void erase(Alignments::iterator it)
+	{
+		m_bytes -= memoryUsage(it->second);
 #if BOOST_VERSION >= 104300
 		// erase() is slow on older compilers so we use quick_erase()
-		map.quick_erase(it.first);
+		m_map.quick_erase(it);
 #else
-		map.erase(it.first);
+		m_map.erase(it);
 #endif
 	}
+
+	/** Return the partition of the specified read. */
+	unsigned partition(const ReadKey& key) const
+	{
+		return key.second >> (PARTITION_BITS * m_level)
+			& ((1 << PARTITION_BITS) - 1);
+	}
+
+	/** Move the alignments of the table to the spill files. */
+	void spill()
+	{
+		if (m_files.empty())
+			openSpillFiles();
+		if (opt::verbose > 0)
+			cerr << "Spilling " << m_map.size()
+				<< " unpaired alignments to `" << g_spillDir
+				<< "'..." << endl;
+		for (Alignments::const_iterator it = m_map.begin();
+				it != m_map.end(); ++it) {
+			ofstream& out = *m_files[partition(it->first)];
+			write(out, it->first, it->second);
+			assert_good(out, g_spillDir);
+		}
+		Alignments(1).swap(m_map);
+		m_bytes = 0;
+	}
+
+	/** Create a spill file for each partition. */
+	void openSpillFiles()
+	{
+		if (g_spillDir.empty()) {
+			const char* tmpdir = getenv("TMPDIR");
+			string path = string(tmpdir != NULL && *tmpdir != '\0'
+					? tmpdir : "/tmp") + "/" PROGRAM ".XXXXXX";
+			if (mkdtemp(&path[0]) == NULL) {
+				perror(path.c_str());
+				exit(EXIT_FAILURE);
+			}
+			g_spillDir = path;
+			atexit(removeSpillDir);
+		}
+		for (unsigned i = 0; i < 1U << PARTITION_BITS; ++i) {
+			string path = spillPath(g_numSpillFiles++);
+			m_paths.push_back(path);
+			m_files.push_back(new ofstream(path.c_str(), ios::binary));
+			assert_good(*m_files.back(), path);
+		}
+	}
+
+	/** Pair the alignments of one spill file, and remove it. */
+	void finishPartition(const string& path)
+	{
+		PendingMates table(m_maxBytes, m_level + 1);
+		{
+			ifstream in(path.c_str(), ios::binary);
+			assert_good(in, path);
+			ReadKey key;
+			PendingAlignment a;
+			while (read(in, key, a))
+				table.insert(key, a);
+			assert(in.eof());
+		}
+		if (remove(path.c_str()) != 0) {
+			perror(path.c_str());
+			exit(EXIT_FAILURE);
+		}
+		table.finish();
+		m_mateless += table.mateless();
+	}
+
+	Alignments m_map;
+
+	/** The memory budget of this table in bytes */
+	size_t m_maxBytes;
+
+	/** The approximate memory used by the alignments of the table */
+	size_t m_bytes;
+
+	/** The depth of the partitions of this table */
+	unsigned m_level;
+
+	/** The number of alignments whose mate was not seen */
+	size_t m_mateless;
+
+	/** The spill file of each partition */
+	vector<string> m_paths;
+	vector<ofstream*> m_files;
+};
+
+static void handleAlignment(SAMRecord& sam, PendingMates& table)
+{
+	table.insert(readKey(sam.qname), sam);
 	stats.alignments++;
-	printProgress(map);
+	printProgress(table.map());
 }
 
 static void assert_eof(istream& in)
@@ -254,7 +656,7 @@ void parseTag(string line) {
 	g_contigCov.push_back(vector<int>(length));	
 }
 
-static void readAlignments(istream& in, Alignments* pMap)
+static void readAlignments(istream& in, PendingMates* pMap)
 {
 	for (SAMRecord sam; in >> ws;) {
 		if (in.peek() == '@') {
@@ -271,12 +673,10 @@ static void readAlignments(istream& in, Alignments* pMap)
 		} else if (in >> sam)
 			handleAlignment(sam, *pMap);
 	}
-	if (!opt::covPath.empty())
-		printCov(opt::covPath);
 	assert_eof(in);
 }
 
-static void readAlignmentsFile(string path, Alignments* pMap)
+static void readAlignmentsFile(string path, PendingMates* pMap)
 {
 	if (opt::verbose > 0)
 		cerr << "Reading `" << path << "'..." << endl;
@@ -330,6 +730,7 @@ int main(int argc, char* const* argv)
 			case 's': arg >> opt::fragPath; break;
 			case 'h': arg >> opt::histPath; break;
 			case 'c': arg >> opt::covPath; break;
+			case 'm': opt::maxMem = SIToBytes(arg); break;
 			case 'v': opt::verbose++; break;
 			case OPT_HELP:
 				cout << USAGE_MESSAGE;
@@ -356,7 +757,7 @@ int main(int argc, char* const* argv)
 		assert(g_fragFile.is_open());
 	}
 
-	Alignments alignments(1);
+	PendingMates alignments(opt::maxMem);
 	if (optind < argc) {
 		for_each(argv + optind, argv + argc,
 				bind2nd(ptr_fun(readAlignmentsFile), &alignments));
@@ -368,29 +769,27 @@ int main(int argc, char* const* argv)
 	if (opt::verbose > 0)
 		cerr << "Read " << stats.alignments << " alignments" << endl;
 
-	// Print the unpaired alignments.
-	if (opt::print_all) {
-		for (Alignments::iterator it = alignments.begin();
-				it != alignments.end(); it++) {
-#if SAM_SEQ_QUAL
-			SAMRecord& a0 = it->second;
-#else
-			SAMRecord a0(it->second, it->first);
-#endif
-			a0.noMate();
-			cout << a0 << '\n';
-			assert(cout.good());
+	// Pair the spilled alignments, and print the unpaired alignments.
+	alignments.finish();
+	if (!g_spillDir.empty()) {
+		if (rmdir(g_spillDir.c_str()) != 0) {
+			perror(g_spillDir.c_str());
+			exit(EXIT_FAILURE);
 		}
+		g_spillDir.clear();
 	}
 
+	if (!opt::covPath.empty())
+		printCov(opt::covPath);
+
 	unsigned numRF = g_histogram.count(INT_MIN, 0);
 	unsigned numFR = g_histogram.count(1, INT_MAX);
-	size_t sum = alignments.size()
+	size_t sum = alignments.mateless()
 		+ stats.bothUnaligned + stats.oneUnaligned
 		+ numFR + numRF + stats.numFF
 		+ stats.numDifferent;
 	cerr <<
-		"Mateless   " << percent(alignments.size(), sum) << "\n"
+		"Mateless   " << percent(alignments.mateless(), sum) << "\n"
 		"Unaligned  " << percent(stats.bothUnaligned, sum) << "\n"
 		"Singleton  " << percent(stats.oneUnaligned, sum) << "\n"
 		"FR         " << percent(numFR, sum) << "\n"
@@ -399,7 +798,7 @@ int main(int argc, char* const* argv)
 		"Different  " << percent(stats.numDifferent, sum) << "\n"
 		"Total      " << sum << endl;
 	
-	if (alignments.size() == sum) {
+	if (alignments.mateless() == sum) {
 		cerr << PROGRAM ": error: All reads are mateless. This "
 			"can happen when first and second read IDs do not match."
 			<< endl;
@@ -609,6 +609,9 @@ int main(int argc, char** argv)
 	if (opt::dot)
 		cout << "digraph bubbles {\n";
 
+	if (opt::identity > 0)
+		setAlignGlobalCacheSize();
+
 	Bubbles bubbles = discoverBubbles(g);
 	for (Bubbles::const_iterator it = bubbles.begin();
 			it != bubbles.end(); ++it)
@@ -636,6 +639,8 @@ int main(int argc, char** argv)
 			<< " Too many: " << (g_count.tooMany + 1) / 2
 			<< " Dissimilar: " << (g_count.dissimilar + 1) / 2
 			<< '\n';
+	if (opt::verbose > 0 && opt::identity > 0)
+		printAlignGlobalCacheStats(cerr);
 
 	if (!opt::graphPath.empty()) {
 		// Remove the popped contigs from the adjacency graph.
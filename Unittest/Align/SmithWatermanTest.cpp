@@ -0,0 +1,572 @@
+#include "Align/smith_waterman.h"
+#include "Align/Options.h"
+#include "Common/Sequence.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** Return a random sequence of the specified length. */
+static string randomSeq(size_t n, const string& alphabet = "ACGT")
+{
+	string s(n, 'A');
+	for (size_t i = 0; i < n; ++i)
+		s[i] = alphabet[rand() % alphabet.size()];
+	return s;
+}
+
+/** Return the sequence with the specified number of random
+ * substitutions, insertions and deletions. */
+static string mutate(string s, unsigned n)
+{
+	for (unsigned i = 0; i < n && !s.empty(); ++i) {
+		size_t pos = rand() % s.size();
+		switch (rand() % 3) {
+		  case 0: s[pos] = "ACGT"[rand() % 4]; break;
+		  case 1: s.insert(pos, 1, "ACGT"[rand() % 4]); break;
+		  case 2: s.erase(pos, 1); break;
+		}
+	}
+	return s;
+}
+
+/** Return the overlaps of a and b. */
+static vector<overlap_align> overlaps(const string& a, const string& b,
+		bool multi, bool simd)
+{
+	setAlignOverlapSIMD(simd);
+	vector<overlap_align> v;
+	alignOverlap(a, b, 0, v, multi, false);
+	setAlignOverlapSIMD(true);
+	return v;
+}
+
+/** Check that the overlaps are the same, in the same order. */
+static void checkEqual(const vector<overlap_align>& expected,
+		const vector<overlap_align>& actual,
+		const string& a, const string& b)
+{
+	ASSERT_EQ(expected.size(), actual.size()) << a << ' ' << b;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		EXPECT_EQ(expected[i].overlap_t_pos, actual[i].overlap_t_pos)
+			<< a << ' ' << b;
+		EXPECT_EQ(expected[i].overlap_h_pos, actual[i].overlap_h_pos);
+		EXPECT_EQ(expected[i].overlap_str, actual[i].overlap_str);
+		EXPECT_EQ(expected[i].overlap_match, actual[i].overlap_match);
+	}
+}
+
+/** Check that alignOverlap finds the same overlaps of a and b using
+ * SSE2 as it does one cell at a time. */
+static void checkSIMD(const string& a, const string& b)
+{
+	for (int multi = 0; multi < 2; ++multi)
+		checkEqual(overlaps(a, b, multi, false),
+				overlaps(a, b, multi, true), a, b);
+}
+
+/** Return whether the characters a and b match.
+ * @param c [out] the consensus character
+ */
+static bool isMatch(char a, char b, char& c)
+{
+	if (a == b) {
+		c = a;
+	} else if (toupper(a) == toupper(b)) {
+		c = islower(a) || islower(b) ? tolower(a) : a;
+	} else if (a == 'N' || a == 'n') {
+		c = b;
+	} else if (b == 'N' || b == 'n') {
+		c = a;
+	} else {
+		c = ambiguityOr(a, b);
+		return ambiguityIsSubset(a, b);
+	}
+	return true;
+}
+
+/** Return the score of the alignment of a and b. */
+static int matchScore(char a, char b)
+{
+	char c;
+	return isMatch(a, b, c) ? opt::match : opt::mismatch;
+}
+
+/** Return the score of a gap, either newly opened or extended. */
+static int gapScore(bool prevIsGap)
+{
+	return prevIsGap ? opt::gap_extend : opt::gap_open;
+}
+
+typedef vector<vector<int> > Matrix;
+
+/** Backtrack from the cell (i_max, j_max) of the last row.
+ * @return the number of matches, or zero if the alignment does not
+ * start at the first character of b
+ */
+static unsigned backtrackReference(int i_max, int j_max,
+		const Matrix& I_i, const Matrix& I_j,
+		const string& seq_a, const string& seq_b, overlap_align& o)
+{
+	int i = i_max, j = j_max;
+	int next_i = I_i[i][j], next_j = I_j[i][j];
+	string match;
+	unsigned num_of_match = 0;
+	char c;
+	while ((i != next_i || j != next_j) && next_j != 0 && next_i != 0) {
+		if (next_i == i) {
+			match += tolower(seq_b[j-1]);
+		} else if (next_j == j) {
+			match += tolower(seq_a[i-1]);
+		} else if (isMatch(seq_a[i-1], seq_b[j-1], c)) {
+			match += c;
+			num_of_match++;
+		} else
+			match += ambiguityOr(seq_a[i-1], seq_b[j-1]);
+		i = next_i;
+		j = next_j;
+		next_i = I_i[i][j];
+		next_j = I_j[i][j];
+	}
+	if (j > 1)
+		return 0;
+	if (isMatch(seq_a[i-1], seq_b[j-1], c)) {
+		match += c;
+		num_of_match++;
+	} else
+		match += ambiguityOr(seq_a[i-1], seq_b[j-1]);
+	reverse(match.begin(), match.end());
+	o = overlap_align(i - 1, j_max - 1, match, num_of_match);
+	return num_of_match;
+}
+
+/** Compare the indices of the last row by descending score. */
+struct CompareScore {
+	const vector<double>& h;
+	CompareScore(const vector<double>& h) : h(h) { }
+	bool operator()(int a, int b) const { return h[a] > h[b]; }
+};
+
+/** Find the overlaps of seq_a and seq_b as the previous alignOverlap
+ * did, by filling the whole matrix one cell at a time with scores of
+ * type double.
+ */
+static vector<overlap_align> alignOverlapReference(
+		const string& seq_a, const string& seq_b, bool multi_align)
+{
+	int N_a = seq_a.length(), N_b = seq_b.length();
+	vector<vector<double> > H(N_a + 1, vector<double>(N_b + 1));
+	Matrix I_i(N_a + 1, vector<int>(N_b + 1));
+	Matrix I_j = I_i;
+	vector<vector<bool> > V(N_a + 1, vector<bool>(N_b + 1));
+	for (int i = 0; i <= N_a; i++) {
+		H[i][0] = 0;
+		I_i[i][0] = i - 1;
+		V[i][0] = true;
+	}
+	for (int j = 0; j <= N_b; j++) {
+		H[0][j] = 0;
+		I_j[0][j] = j - 1;
+		V[0][j] = false;
+	}
+	V[0][0] = true;
+
+	for (int i = 1; i <= N_a; i++) {
+		for (int j = 1; j <= N_b; j++) {
+			double scores[3] = {
+				V[i-1][j-1] ? H[i-1][j-1]
+					+ matchScore(seq_a[i-1], seq_b[j-1]) : -DBL_MAX,
+				V[i-1][j] ? H[i-1][j] + gapScore(I_j[i-1][j] == j)
+					: -DBL_MAX,
+				V[i][j-1] ? H[i][j-1] + gapScore(I_i[i][j-1] == i)
+					: -DBL_MAX
+			};
+			int k = max_element(scores, scores + 3) - scores;
+			H[i][j] = scores[k];
+			I_i[i][j] = k == 2 ? i : i - 1;
+			I_j[i][j] = k == 1 ? j : j - 1;
+			V[i][j] = H[i][j] != -DBL_MAX;
+		}
+	}
+
+	vector<int> order(N_b);
+	for (int j = 0; j < N_b; j++)
+		order[j] = j + 1;
+	sort(order.begin(), order.end(), CompareScore(H[N_a]));
+
+	vector<overlap_align> overlaps;
+	bool found = false;
+	for (int j = 0; j < N_b; j++) {
+		double H_max = H[N_a][order[j]];
+		if (H_max == 0)
+			break;
+		overlap_align o;
+		if (backtrackReference(N_a, order[j], I_i, I_j,
+					seq_a, seq_b, o) == 0)
+			continue;
+		overlaps.push_back(o);
+		if (!found) {
+			found = true;
+			if (!multi_align || (j + 1 < N_b
+						&& H[N_a][order[j+1]] < H_max))
+				break;
+		}
+	}
+	return overlaps;
+}
+
+/** Check that alignOverlap finds the overlaps of a and b that the
+ * previous implementation found, using SSE2 and one cell at a time.
+ */
+static void checkReference(const string& a, const string& b)
+{
+	for (int multi = 0; multi < 2; ++multi) {
+		vector<overlap_align> expected
+			= alignOverlapReference(a, b, multi);
+		checkEqual(expected, overlaps(a, b, multi, false), a, b);
+		checkEqual(expected, overlaps(a, b, multi, true), a, b);
+	}
+}
+
+/** Set the scores of abyss-mergepairs, with which findUngappedOverlaps
+ * does not need alignOverlap, and restore the scores at the end of
+ * the scope. */
+struct MergeScores {
+	int match, mismatch, gap_open, gap_extend;
+	MergeScores()
+		: match(opt::match), mismatch(opt::mismatch),
+		gap_open(opt::gap_open), gap_extend(opt::gap_extend)
+	{
+		opt::match = 1;
+		opt::mismatch = -2;
+		opt::gap_open = -10000;
+		opt::gap_extend = -10000;
+	}
+	~MergeScores()
+	{
+		opt::match = match;
+		opt::mismatch = mismatch;
+		opt::gap_open = gap_open;
+		opt::gap_extend = gap_extend;
+	}
+};
+
+TEST(alignOverlap, exact)
+{
+	vector<overlap_align> v = overlaps(
+			"GATTACAGATTACA", "TTACACCCGG", false, true);
+	ASSERT_EQ(1U, v.size());
+	EXPECT_EQ(9U, v[0].overlap_t_pos);
+	EXPECT_EQ(4U, v[0].overlap_h_pos);
+	EXPECT_EQ("TTACA", v[0].overlap_str);
+	EXPECT_EQ(5U, v[0].overlap_match);
+}
+
+TEST(alignOverlap, simdOverlaps)
+{
+	srand(1);
+	for (unsigned i = 0; i < 200; ++i) {
+		string overlap = randomSeq(1 + rand() % 60);
+		string a = randomSeq(rand() % 40) + overlap;
+		string b = mutate(overlap, rand() % 4) + randomSeq(rand() % 40);
+		if (b.empty())
+			b = "A";
+		checkSIMD(a, b);
+	}
+}
+
+TEST(alignOverlap, simdRepeats)
+{
+	// Low complexity sequences have many alignments of equal score,
+	// which are chosen by the order in which ties are broken.
+	srand(5);
+	for (unsigned i = 0; i < 200; ++i) {
+		string overlap = randomSeq(1 + rand() % 60, "AC");
+		string a = randomSeq(rand() % 20, "AC") + overlap;
+		string b = mutate(overlap, rand() % 6)
+			+ randomSeq(rand() % 20, "AC");
+		if (b.empty())
+			b = "A";
+		checkSIMD(a, b);
+	}
+}
+
+TEST(alignOverlap, simdUnrelated)
+{
+	srand(2);
+	for (unsigned i = 0; i < 100; ++i)
+		checkSIMD(randomSeq(1 + rand() % 50), randomSeq(1 + rand() % 50));
+	checkSIMD("A", "A");
+	checkSIMD("A", "C");
+}
+
+TEST(alignOverlap, simdAmbiguityCodes)
+{
+	srand(3);
+	const string iupac = "ACGTNRYKMSWBDHVacgtn";
+	for (unsigned i = 0; i < 200; ++i) {
+		string overlap = randomSeq(1 + rand() % 40, iupac);
+		string a = randomSeq(rand() % 20, iupac) + overlap;
+		string b = mutate(overlap, rand() % 3)
+			+ randomSeq(rand() % 20, iupac);
+		if (b.empty())
+			b = "N";
+		checkSIMD(a, b);
+	}
+}
+
+TEST(alignOverlap, workspace)
+{
+	// An alignment that is larger than the workspace keeps between
+	// calls does not change the result of the next alignment.
+	srand(4);
+	OverlapWorkspace workspace;
+	string a = randomSeq(300), b = randomSeq(200);
+	vector<overlap_align> expected = overlaps(a, b, true, true);
+	vector<overlap_align> actual, unused;
+	alignOverlap(a, b, 0, actual, true, false, workspace);
+	checkEqual(expected, actual, a, b);
+
+	string overlap = randomSeq(2000);
+	alignOverlap(randomSeq(3000) + overlap, overlap + randomSeq(3000),
+			0, unused, false, false, workspace);
+	actual.clear();
+	alignOverlap(a, b, 0, actual, true, false, workspace);
+	checkEqual(expected, actual, a, b);
+}
+
+TEST(alignOverlap, referenceOverlaps)
+{
+	srand(7);
+	for (unsigned i = 0; i < 200; ++i) {
+		string overlap = randomSeq(1 + rand() % 60);
+		string a = randomSeq(rand() % 40) + overlap;
+		string b = mutate(overlap, rand() % 4) + randomSeq(rand() % 40);
+		if (b.empty())
+			b = "A";
+		checkReference(a, b);
+	}
+	for (unsigned i = 0; i < 50; ++i)
+		checkReference(randomSeq(1 + rand() % 50),
+				randomSeq(1 + rand() % 50));
+}
+
+TEST(alignOverlap, referenceTies)
+{
+	// Low complexity sequences have many overlaps of equal score.
+	srand(8);
+	for (unsigned i = 0; i < 200; ++i) {
+		string overlap = randomSeq(1 + rand() % 40, "AC");
+		string a = randomSeq(rand() % 20, "AC") + overlap;
+		string b = mutate(overlap, rand() % 6)
+			+ randomSeq(rand() % 20, "AC");
+		if (b.empty())
+			b = "A";
+		checkReference(a, b);
+	}
+	checkReference("ACACACACAC", "ACACACACAC");
+	checkReference("AAAAAAAA", "AAAA");
+	checkReference("AAAA", "AAAAAAAA");
+
+	// The scores of abyss-mergepairs tie more often.
+	MergeScores scores;
+	srand(9);
+	for (unsigned i = 0; i < 200; ++i)
+		checkReference(randomSeq(1 + rand() % 30, "AC"),
+				randomSeq(1 + rand() % 30, "AC"));
+
+	// A gap and a mismatch of equal score tie too.
+	opt::match = 2;
+	opt::mismatch = opt::gap_open = opt::gap_extend = -1;
+	for (unsigned i = 0; i < 200; ++i) {
+		string overlap = randomSeq(1 + rand() % 30, "AC");
+		checkReference(randomSeq(rand() % 10, "AC") + overlap,
+				mutate(overlap, rand() % 6));
+	}
+}
+
+TEST(alignOverlap, referenceEnds)
+{
+	// The first or last base of the overlap is a mismatch.
+	srand(10);
+	for (unsigned i = 0; i < 200; ++i) {
+		string overlap = randomSeq(2 + rand() % 40);
+		string b = overlap;
+		if (rand() % 2)
+			b[0] = b[0] == 'A' ? 'C' : 'A';
+		if (rand() % 2)
+			b[b.size() - 1] = b[b.size() - 1] == 'G' ? 'T' : 'G';
+		checkReference(randomSeq(rand() % 20) + overlap,
+				b + randomSeq(rand() % 20));
+	}
+	checkReference("GATTACA", "CATTACG");
+	checkReference("GATTACA", "TTACG");
+	checkReference("GATTACA", "CATTA");
+}
+
+TEST(alignOverlap, referenceAmbiguityCodes)
+{
+	srand(11);
+	const string iupac = "ACGTNRYKMSWBDHVacgtn";
+	for (unsigned i = 0; i < 200; ++i) {
+		string overlap = randomSeq(1 + rand() % 40, iupac);
+		string a = randomSeq(rand() % 20, iupac) + overlap;
+		string b = mutate(overlap, rand() % 3)
+			+ randomSeq(rand() % 20, iupac);
+		if (b.empty())
+			b = "N";
+		checkReference(a, b);
+	}
+}
+
+/** Compare overlaps by their position on the first sequence. */
+static bool compareTPos(const overlap_align& a, const overlap_align& b)
+{
+	return a.overlap_t_pos < b.overlap_t_pos;
+}
+
+/** Check that findUngappedOverlaps finds the overlaps of a and b that
+ * alignOverlap finds. The order of the overlaps is not compared.
+ * @return whether findUngappedOverlaps found the overlaps without
+ * alignOverlap
+ */
+static bool checkUngapped(const string& a, const string& b)
+{
+	vector<overlap_align> expected, actual;
+	alignOverlap(a, b, 0, expected, true, false);
+	if (!findUngappedOverlaps(a, b, actual)) {
+		EXPECT_TRUE(actual.empty());
+		return false;
+	}
+	sort(expected.begin(), expected.end(), compareTPos);
+	sort(actual.begin(), actual.end(), compareTPos);
+	EXPECT_EQ(expected.size(), actual.size()) << a << ' ' << b;
+	if (expected.size() != actual.size())
+		return true;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		EXPECT_EQ(expected[i].overlap_t_pos, actual[i].overlap_t_pos)
+			<< a << ' ' << b;
+		EXPECT_EQ(expected[i].overlap_h_pos, actual[i].overlap_h_pos);
+		EXPECT_EQ(expected[i].overlap_str, actual[i].overlap_str);
+		EXPECT_EQ(expected[i].overlap_match, actual[i].overlap_match);
+	}
+	return true;
+}
+
+TEST(findUngappedOverlaps, noMatch)
+{
+	// A read pair of poly-G has no overlap with a match.
+	MergeScores scores;
+	string a(150, 'G'), b(150, 'C');
+	vector<overlap_align> v;
+	EXPECT_TRUE(findUngappedOverlaps(a, b, v));
+	EXPECT_TRUE(v.empty());
+	EXPECT_TRUE(checkUngapped(a, b));
+	EXPECT_TRUE(checkUngapped("A", "C"));
+	EXPECT_TRUE(checkUngapped(string(150, 'G'), string(100, 'C')));
+	EXPECT_TRUE(checkUngapped("AAAA", "CGTA"));
+
+	// When the second read is longer, alignOverlap may report a
+	// gapped overlap.
+	EXPECT_FALSE(checkUngapped(string(100, 'G'), string(150, 'C')));
+	EXPECT_FALSE(checkUngapped("AAA", "CGTA"));
+
+	// The best overlap with a match scores zero.
+	EXPECT_TRUE(checkUngapped("AAA", "CAA"));
+}
+
+TEST(findUngappedOverlaps, unique)
+{
+	MergeScores scores;
+	vector<overlap_align> v;
+	EXPECT_TRUE(findUngappedOverlaps(
+				"GATTACAGATTACA", "TTACACCCGG", v));
+	ASSERT_EQ(1U, v.size());
+	EXPECT_EQ(9U, v[0].overlap_t_pos);
+	EXPECT_EQ(4U, v[0].overlap_h_pos);
+	EXPECT_EQ("TTACA", v[0].overlap_str);
+	EXPECT_EQ(5U, v[0].overlap_match);
+	EXPECT_TRUE(checkUngapped("GATTACAGATTACA", "TTACACCCGG"));
+	EXPECT_TRUE(checkUngapped("A", "A"));
+
+	// An N matches any base.
+	EXPECT_TRUE(checkUngapped("GATTACAGATNACA", "TTACNCCCGG"));
+}
+
+TEST(findUngappedOverlaps, ties)
+{
+	MergeScores scores;
+	// More than one overlap with a match scores best, and another
+	// overlap scores zero.
+	EXPECT_TRUE(checkUngapped("AAAA", "ACAA"));
+	// More than one overlap with a match scores best, and no
+	// overlap scores zero.
+	EXPECT_TRUE(checkUngapped("AAAC", "CAAC"));
+	// An overlap without a match scores best too, and the order of
+	// the overlaps is not known.
+	EXPECT_FALSE(checkUngapped("AAAA", "CCAA"));
+	// Without an overlap that scores zero, the order of the overlaps
+	// depends on the longer second read.
+	EXPECT_FALSE(checkUngapped("AAAC", "CAACA"));
+	// A tandem repeat has many overlaps of equal score.
+	EXPECT_TRUE(checkUngapped(
+				"ACACACACACACACACACAC", "ACACACACACACACACACAC"));
+	EXPECT_TRUE(checkUngapped("GGGGGGGGGG", "GGGGG"));
+}
+
+TEST(findUngappedOverlaps, fallback)
+{
+	vector<overlap_align> v;
+	{
+		// A gap costs less than the difference between an overlap of
+		// all matches and an overlap of all mismatches.
+		MergeScores scores;
+		string a = randomSeq(4000), b = a.substr(1000) + randomSeq(1000);
+		EXPECT_FALSE(findUngappedOverlaps(a, b, v));
+		EXPECT_FALSE(checkUngapped(a, b));
+		opt::gap_open = opt::gap_extend = -12;
+		EXPECT_FALSE(findUngappedOverlaps("GATTACA", "TACAGG", v));
+	}
+	EXPECT_FALSE(findUngappedOverlaps("GATTACA", "TACAGG", v));
+
+	// A read with a base other than ACGTN is aligned.
+	MergeScores scores;
+	EXPECT_FALSE(findUngappedOverlaps("GATTRCA", "TACAGG", v));
+	EXPECT_FALSE(findUngappedOverlaps("", "TACAGG", v));
+	EXPECT_TRUE(v.empty());
+}
+
+TEST(findUngappedOverlaps, random)
+{
+	// Compare read pairs that overlap, with substitutions and Ns,
+	// read pairs that do not overlap, and low complexity read pairs,
+	// which have many overlaps of equal score.
+	MergeScores scores;
+	srand(6);
+	unsigned found = 0, aligned = 0;
+	for (unsigned i = 0; i < 2000; ++i) {
+		const char* alphabet = i % 4 == 0 ? "AC"
+			: i % 4 == 1 ? "ACGTN" : "ACGT";
+		string fragment = randomSeq(1 + rand() % 200, alphabet);
+		size_t lenA = 1 + rand() % fragment.size();
+		size_t lenB = 1 + rand() % fragment.size();
+		string a = fragment.substr(0, lenA);
+		string b = fragment.substr(fragment.size() - lenB);
+		for (unsigned j = rand() % 4; j > 0; --j)
+			b[rand() % b.size()] = alphabet[rand() % strlen(alphabet)];
+		if (i % 8 == 7)
+			b = randomSeq(lenB, alphabet);
+		if (checkUngapped(a, b))
+			found++;
+		else
+			aligned++;
+	}
+	EXPECT_GT(found, 1000U);
+	EXPECT_GT(aligned, 0U);
+}
@@ -0,0 +1,325 @@
+#include "Align/alignGlobal.h"
+#include "Common/Sequence.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char GAP = '*';
+static const int MATCH = 5;
+static const int MISMATCH = -4;
+static const int GAP_OPEN = -12;
+static const int GAP_EXTEND = -4;
+
+/** Return the score of the alignment of a and b. */
+static int score(char a, char b, char& c)
+{
+	if (a == b) {
+		c = a;
+		return MATCH;
+	} else {
+		c = ambiguityOr(a, b);
+		return c == a || c == b ? MATCH : MISMATCH;
+	}
+}
+
+typedef vector<vector<int> > Matrix;
+
+/** Align a and b by computing the full score matrices, and break
+ * ties in the same order as alignGlobal.
+ * @return the number of matches
+ */
+static unsigned alignFull(const string& seqA, const string& seqB,
+		NWAlignment& align)
+{
+	unsigned lenA = seqA.size(), lenB = seqB.size();
+	Matrix f(lenA + 1, vector<int>(lenB + 1));
+	Matrix g = f, h = f;
+	for (unsigned i = 0; i <= lenA; i++) {
+		f[i][0] = g[i][0] = i == 0 ? 0
+			: GAP_OPEN + GAP_EXTEND * ((int)i - 1);
+		h[i][0] = INT_MIN/2;
+	}
+	for (unsigned j = 0; j <= lenB; j++) {
+		f[0][j] = h[0][j] = j == 0 ? 0
+			: GAP_OPEN + GAP_EXTEND * ((int)j - 1);
+		g[0][j] = INT_MIN/2;
+	}
+	for (unsigned i = 1; i <= lenA; i++) {
+		for (unsigned j = 1; j <= lenB; j++) {
+			char c;
+			g[i][j] = max(f[i-1][j] + GAP_OPEN,
+					g[i-1][j] + GAP_EXTEND);
+			h[i][j] = max(f[i][j-1] + GAP_OPEN,
+					h[i][j-1] + GAP_EXTEND);
+			f[i][j] = max(f[i-1][j-1] + score(seqA[i-1], seqB[j-1], c),
+					max(g[i][j], h[i][j]));
+		}
+	}
+
+	string alignA, alignB, consensus;
+	unsigned matches = 0;
+	unsigned i = lenA, j = lenB;
+	while (i > 0 && j > 0) {
+		char a = seqA[i-1], b = seqB[j-1], c;
+		int s = score(a, b, c);
+		if (f[i][j] == f[i-1][j-1] + s) {
+			alignA += a;
+			alignB += b;
+			consensus += c;
+			if (s == MATCH)
+				matches++;
+			i--;
+			j--;
+		} else if (f[i][j] == f[i-1][j] + GAP_OPEN
+				|| f[i][j] == g[i-1][j] + GAP_EXTEND) {
+			bool open;
+			do {
+				open = g[i][j] != g[i-1][j] + GAP_EXTEND;
+				alignA += seqA[i-1];
+				alignB += GAP;
+				consensus += tolower(seqA[i-1]);
+				i--;
+			} while (!open);
+		} else {
+			bool open;
+			do {
+				open = h[i][j] != h[i][j-1] + GAP_EXTEND;
+				alignA += GAP;
+				alignB += seqB[j-1];
+				consensus += tolower(seqB[j-1]);
+				j--;
+			} while (!open);
+		}
+	}
+	for (; i > 0; i--) {
+		alignA += seqA[i-1];
+		alignB += GAP;
+		consensus += tolower(seqA[i-1]);
+	}
+	for (; j > 0; j--) {
+		alignA += GAP;
+		alignB += seqB[j-1];
+		consensus += tolower(seqB[j-1]);
+	}
+	align.query_align.assign(alignA.rbegin(), alignA.rend());
+	align.target_align.assign(alignB.rbegin(), alignB.rend());
+	align.match_align.assign(consensus.rbegin(), consensus.rend());
+	return matches;
+}
+
+/** Return a random sequence of the specified length. */
+static string randomSeq(size_t n, const string& alphabet = "ACGT")
+{
+	string s(n, 'A');
+	for (size_t i = 0; i < n; ++i)
+		s[i] = alphabet[rand() % alphabet.size()];
+	return s;
+}
+
+/** Return the sequence with the specified number of random
+ * substitutions, insertions and deletions of up to 20 bases. */
+static string mutate(string s, unsigned n)
+{
+	for (unsigned i = 0; i < n && !s.empty(); ++i) {
+		size_t pos = rand() % s.size();
+		size_t len = 1 + rand() % (rand() % 4 == 0 ? 20 : 1);
+		switch (rand() % 3) {
+		  case 0: s[pos] = "ACGT"[rand() % 4]; break;
+		  case 1: s.insert(pos, randomSeq(len)); break;
+		  case 2: s.erase(pos, len); break;
+		}
+	}
+	return s;
+}
+
+/** Check that alignGlobal finds the alignment of the full matrices. */
+static void check(const string& a, const string& b)
+{
+	NWAlignment expected, actual;
+	unsigned expectedMatches = alignFull(a, b, expected);
+	unsigned actualMatches = alignGlobal(a, b, actual);
+	EXPECT_EQ(expectedMatches, actualMatches) << a << ' ' << b;
+	EXPECT_EQ(expected.query_align, actual.query_align);
+	EXPECT_EQ(expected.target_align, actual.target_align);
+	EXPECT_EQ(expected.match_align, actual.match_align);
+}
+
+/** Check pairs of related, unrelated and ambiguous sequences. */
+static void checkRandom(unsigned seed, unsigned maxLen)
+{
+	srand(seed);
+	for (unsigned i = 0; i < 100; ++i) {
+		string a = randomSeq(rand() % maxLen);
+		check(a, mutate(a, rand() % 10));
+		check(randomSeq(rand() % maxLen), randomSeq(rand() % maxLen));
+		string ambiguous = randomSeq(rand() % maxLen, "ACGTRYKMSWN");
+		check(ambiguous, mutate(ambiguous, rand() % 10));
+
+		// The best alignment is far from the main diagonal, and is
+		// found by widening the band.
+		string b = randomSeq(rand() % maxLen);
+		string shift = randomSeq(rand() % maxLen);
+		check(shift + b, mutate(b, rand() % 10) + randomSeq(shift.size()));
+	}
+}
+
+TEST(alignGlobal, exact)
+{
+	NWAlignment align;
+	EXPECT_EQ(7U, alignGlobal("GATTACA", "GATTACA", align));
+	EXPECT_EQ("GATTACA", align.match_align);
+	EXPECT_EQ(4U, alignGlobal("GATTACA", "GACA", align));
+	EXPECT_EQ("GATTACA", align.query_align);
+	EXPECT_EQ("G***ACA", align.target_align);
+	EXPECT_EQ("GattACA", align.match_align);
+}
+
+TEST(alignGlobal, empty)
+{
+	check("", "");
+	check("", "ACGT");
+	check("ACGT", "");
+	check("A", "ACGTACGTACGT");
+}
+
+TEST(alignGlobal, ambiguityCodes)
+{
+	NWAlignment align;
+	EXPECT_EQ(4U, alignGlobal("ACGT", "RCKN", align));
+	EXPECT_EQ("RCKN", align.match_align);
+	check("ACGTNNNNACGT", "ACGTACGT");
+	check("RYKMSWRYKMSW", "ACGTACGTACGT");
+}
+
+TEST(alignGlobal, lengthDifference)
+{
+	srand(1);
+	for (unsigned i = 0; i < 20; ++i) {
+		string b = randomSeq(200 + rand() % 800);
+		size_t pos = rand() % (b.size() - 50);
+		check(b.substr(pos, 1 + rand() % 50), b);
+		check(b, mutate(b.substr(pos, 1 + rand() % 50), 2));
+		check(randomSeq(rand() % 10), b);
+	}
+}
+
+TEST(alignGlobal, random)
+{
+	checkRandom(2, 300);
+}
+
+TEST(alignGlobal, checkpoints)
+{
+	// Keep only some of the rows of the score matrices, so that the
+	// blocks of rows are computed again by the backtrack.
+	setAlignGlobalMaxCells(1);
+	checkRandom(3, 300);
+	check("", "ACGT");
+	check("ACGT", "");
+	setAlignGlobalMaxCells(1000);
+	checkRandom(4, 300);
+	setAlignGlobalMaxCells();
+}
+
+/** Return the statistics of the alignment cache. */
+static string cacheStats()
+{
+	ostringstream ss;
+	printAlignGlobalCacheStats(ss);
+	return ss.str();
+}
+
+TEST(alignGlobal, cache)
+{
+	// An alignment larger than the budget of 480 bytes is not cached.
+	setAlignGlobalCacheSize(16, 16 * 3 * 10);
+	string a = "GATTACA", b = "GACA";
+	check(a, b);
+	check(a, b);
+	EXPECT_EQ("Alignment cache: 1 hits of 2 lookups (50%)\n",
+			cacheStats());
+
+	a = "GATTACAGATTACA";
+	check(a, b);
+	check(a, b);
+	EXPECT_EQ("Alignment cache: 2 hits of 4 lookups (50%)\n",
+			cacheStats());
+
+	srand(5);
+	a = randomSeq(200);
+	check(a, a);
+	check(a, a);
+	EXPECT_EQ("Alignment cache: 2 hits of 6 lookups (33%)\n",
+			cacheStats());
+	setAlignGlobalCacheSize(0);
+}
+
+TEST(alignGlobal, cacheEviction)
+{
+	// A new alignment evicts the older alignments when the cache
+	// exceeds its budget of 90 bytes.
+	setAlignGlobalCacheSize(1024, 3 * 30);
+	srand(6);
+	string a = randomSeq(25);
+	check("GATTACA", "GACA");
+	check(a, a);
+	check(a, a);
+	check("GATTACA", "GACA");
+	EXPECT_EQ("Alignment cache: 1 hits of 4 lookups (25%)\n",
+			cacheStats());
+	setAlignGlobalCacheSize(0);
+}
+
+TEST(alignGlobal, cacheLong)
+{
+	// One slot holds an alignment larger than the budget divided by
+	// the number of slots.
+	setAlignGlobalCacheSize();
+	srand(7);
+	string a = randomSeq(20000), b = mutate(a, 20);
+	NWAlignment expected, actual;
+	unsigned matches = alignGlobal(a, b, expected);
+	EXPECT_EQ(matches, alignGlobal(a, b, actual));
+	EXPECT_EQ(expected.query_align, actual.query_align);
+	EXPECT_EQ(expected.target_align, actual.target_align);
+	EXPECT_EQ(expected.match_align, actual.match_align);
+	EXPECT_EQ("Alignment cache: 1 hits of 2 lookups (50%)\n",
+			cacheStats());
+	setAlignGlobalCacheSize(0);
+}
+
+TEST(alignGlobal, cacheThreads)
+{
+	// Threads that share the cache and evict each other's alignments
+	// find the alignments that are computed without the cache.
+	srand(8);
+	const unsigned n = 32;
+	vector<string> a(n), b(n);
+	vector<NWAlignment> expected(n);
+	for (unsigned i = 0; i < n; ++i) {
+		a[i] = randomSeq(50 + rand() % 250);
+		b[i] = mutate(a[i], rand() % 10);
+		alignGlobal(a[i], b[i], expected[i]);
+	}
+
+	setAlignGlobalCacheSize(16, 3 * 2000);
+	unsigned errors = 0;
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < 2000; ++i) {
+		unsigned k = i % n;
+		NWAlignment align;
+		alignGlobal(a[k], b[k], align);
+		if (align.match_align != expected[k].match_align) {
+#pragma omp atomic
+			++errors;
+		}
+	}
+	EXPECT_EQ(0U, errors);
+	setAlignGlobalCacheSize(0);
+}
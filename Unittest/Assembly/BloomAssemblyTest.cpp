@@ -0,0 +1,211 @@
+#include "Assembly/BloomAssembly.h"
+#include "Bloom/Bloom.h"
+#include "Bloom/BloomFilter.h"
+#include "Common/Kmer.h"
+#include "Common/Sequence.h"
+#include "DataLayer/FastaReader.h"
+#include "DataLayer/FastaWriter.h"
+#include <gtest/gtest.h>
+#include <set>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Test fixture for BloomAssembler.
+ *
+ * The k-mers of the graph are loaded directly into the Bloom filter,
+ * and the reads that seed the unitigs are written to a temporary
+ * FASTA file.
+ */
+class BloomAssemblyTest : public testing::Test {
+
+protected:
+
+	static const unsigned k = 11;
+	// set this large to avoid false positives
+	static const size_t bloomFilterSize = 1000000;
+
+	/** A sequence without a repeated (k-1)-mer */
+	string seq;
+
+	BloomFilter bloom;
+	string readsPath, unitigsPath;
+
+	BloomAssemblyTest() : bloom(bloomFilterSize)
+	{
+		Kmer::setLength(k);
+		seq = "GCTAAAGACAATTACATAACATACACGTCA"
+			"GCACGAAACTTGTTGGCCCAGTGTGAATCG";
+		readsPath = tempPath();
+		unitigsPath = tempPath();
+	}
+
+	~BloomAssemblyTest()
+	{
+		unlink(readsPath.c_str());
+		unlink(unitigsPath.c_str());
+	}
+
+	static string tempPath()
+	{
+		char path[] = "/tmp/BloomAssemblyTest.XXXXXX";
+		int fd = mkstemp(path);
+		assert(fd >= 0);
+		close(fd);
+		return path;
+	}
+
+	/** Assemble the unitigs seeded by the specified read.
+	 * @param trimLen remove dangling unitigs shorter than this
+	 * @return the unitigs
+	 */
+	vector<string> assemble(const string& read, unsigned trimLen,
+			BloomAssembler::Stats& stats)
+	{
+		ofstream reads(readsPath.c_str());
+		reads << ">1\n" << read << '\n';
+		reads.close();
+
+		BloomAssembler assembler(bloom, trimLen);
+		{
+			FastaWriter out(unitigsPath.c_str());
+			assembler.assemble(readsPath, out);
+		}
+		stats = assembler.stats();
+
+		vector<string> unitigs;
+		FastaReader in(unitigsPath.c_str(), FastaReader::FOLD_CASE);
+		for (string s; in >> s;)
+			unitigs.push_back(s);
+		return unitigs;
+	}
+
+	/** Return whether a and b are the same sequence, in either
+	 * orientation. */
+	static bool sameSequence(const string& a, const string& b)
+	{
+		return a == b || a == reverseComplement(Sequence(b));
+	}
+
+};
+
+TEST_F(BloomAssemblyTest, LinearUnitig)
+{
+	Bloom::loadSeq(bloom, k, seq);
+	BloomAssembler::Stats stats;
+	vector<string> unitigs = assemble(seq, 1, stats);
+	ASSERT_EQ(1U, unitigs.size());
+	EXPECT_TRUE(sameSequence(seq, unitigs[0]));
+	EXPECT_EQ(1U, stats.unitigs);
+	EXPECT_EQ(0U, stats.tips);
+}
+
+TEST_F(BloomAssemblyTest, LinearUnitigFromMiddle)
+{
+	Bloom::loadSeq(bloom, k, seq);
+	BloomAssembler::Stats stats;
+	vector<string> unitigs = assemble(seq.substr(20, 20), 1, stats);
+	ASSERT_EQ(1U, unitigs.size());
+	EXPECT_TRUE(sameSequence(seq, unitigs[0]));
+}
+
+TEST_F(BloomAssemblyTest, TipRemoval)
+{
+	// A tip of three k-mers branches from the middle of the
+	// sequence. It is neither a branch of the unitig nor output.
+	const unsigned pos = 30;
+	ASSERT_NE('T', seq[pos]);
+	string tip = seq.substr(pos - (k - 1), k - 1) + "TTA";
+	Bloom::loadSeq(bloom, k, seq);
+	Bloom::loadSeq(bloom, k, tip);
+
+	BloomAssembler::Stats stats;
+	vector<string> unitigs = assemble(seq + "\n>2\n" + tip, 10, stats);
+	ASSERT_EQ(1U, unitigs.size());
+	EXPECT_TRUE(sameSequence(seq, unitigs[0]));
+	EXPECT_EQ(1U, stats.unitigs);
+	EXPECT_EQ(1U, stats.tips);
+	EXPECT_LT(0U, stats.falseBranches);
+}
+
+TEST_F(BloomAssemblyTest, Cycle)
+{
+	// The last k-mer joins the first, so that every k-mer of the
+	// cycle has one successor and one predecessor.
+	string cycle = seq + seq.substr(0, k - 1);
+	Bloom::loadSeq(bloom, k, cycle);
+
+	BloomAssembler::Stats stats;
+	vector<string> unitigs = assemble(seq.substr(20, 20), 1, stats);
+	ASSERT_EQ(1U, unitigs.size());
+	EXPECT_EQ(1U, stats.unitigs);
+	// Each k-mer of the cycle is written once.
+	const string& unitig = unitigs[0];
+	ASSERT_EQ(cycle.size(), unitig.size());
+	string rotations = seq + seq;
+	string rc = reverseComplement(Sequence(unitig));
+	EXPECT_TRUE(rotations.find(unitig.substr(0, seq.size()))
+			!= string::npos
+			|| rotations.find(rc.substr(0, seq.size()))
+			!= string::npos);
+}
+
+TEST_F(BloomAssemblyTest, FalsePositiveBranch)
+{
+	// A false positive k-mer branches from the middle of the
+	// sequence, and has no neighbours of its own.
+	const unsigned pos = 40;
+	ASSERT_NE('A', seq[pos]);
+	string fp = seq.substr(pos - (k - 1), k - 1) + "A";
+	Bloom::loadSeq(bloom, k, seq);
+	Bloom::loadSeq(bloom, k, fp);
+
+	BloomAssembler::Stats stats;
+	vector<string> unitigs = assemble(seq, 1, stats);
+	ASSERT_EQ(1U, unitigs.size());
+	EXPECT_TRUE(sameSequence(seq, unitigs[0]));
+	EXPECT_EQ(1U, stats.unitigs);
+	EXPECT_EQ(1U, stats.falseBranches);
+}
+
+TEST_F(BloomAssemblyTest, ManyUnitigs)
+{
+	// Each k-mer of the reads is assembled, and each unitig is
+	// written once, even when the Bloom filter is small enough to
+	// have many false positives.
+	bloom = BloomFilter(40000);
+	srand(1);
+	string reads;
+	vector<string> kmers;
+	for (unsigned i = 0; i < 200; ++i) {
+		string read(40, 'A');
+		for (unsigned j = 0; j < read.size(); ++j)
+			read[j] = "ACGT"[rand() % 4];
+		Bloom::loadSeq(bloom, k, read);
+		reads += (i == 0 ? "" : "\n>r\n") + read;
+		for (unsigned j = 0; j + k <= read.size(); ++j)
+			kmers.push_back(read.substr(j, k));
+	}
+
+	BloomAssembler::Stats stats;
+	vector<string> unitigs = assemble(reads, 1, stats);
+	EXPECT_EQ(unitigs.size(), stats.unitigs);
+	set<string> assembled, seen;
+	for (unsigned i = 0; i < unitigs.size(); ++i) {
+		const string& u = unitigs[i];
+		string rc = reverseComplement(Sequence(u));
+		EXPECT_TRUE(seen.insert(min(u, rc)).second) << u;
+		for (unsigned j = 0; j + k <= u.size(); ++j) {
+			assembled.insert(u.substr(j, k));
+			assembled.insert(rc.substr(j, k));
+		}
+	}
+	for (unsigned i = 0; i < kmers.size(); ++i)
+		EXPECT_EQ(1U, assembled.count(kmers[i])) << kmers[i];
+}
@@ -0,0 +1,93 @@
+#include "Common/RingBuffer.h"
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <vector>
+
+using namespace std;
+
+TEST(RingBufferTest, fifo)
+{
+	RingBuffer<int> q(5);
+	EXPECT_EQ(8u, q.capacity());
+	int x;
+	EXPECT_FALSE(q.tryPop(x));
+	for (int i = 0; i < 8; ++i)
+		EXPECT_TRUE(q.tryPush(i));
+	EXPECT_FALSE(q.tryPush(8));
+	for (int i = 0; i < 8; ++i) {
+		ASSERT_TRUE(q.tryPop(x));
+		EXPECT_EQ(i, x);
+	}
+	EXPECT_FALSE(q.tryPop(x));
+
+	// Wrap around the end of the ring.
+	for (int i = 0; i < 100; ++i) {
+		EXPECT_TRUE(q.tryPush(i));
+		ASSERT_TRUE(q.tryPop(x));
+		EXPECT_EQ(i, x);
+	}
+}
+
+static const unsigned NUM_THREADS = 4;
+static const unsigned NUM_ITEMS = 20000;
+
+static RingBuffer<unsigned> g_queue(16);
+static volatile unsigned g_producers;
+
+/** Push the items of one producer. */
+static void* produce(void* arg)
+{
+	unsigned id = *static_cast<unsigned*>(arg);
+	for (unsigned i = 0; i < NUM_ITEMS; ++i)
+		g_queue.push(id * NUM_ITEMS + i);
+	__sync_fetch_and_sub(&g_producers, 1);
+	return NULL;
+}
+
+/** Pop items until the producers finish, and count each item. */
+static void* consume(void* arg)
+{
+	vector<unsigned>& seen = *static_cast<vector<unsigned>*>(arg);
+	vector<unsigned> last(NUM_THREADS, 0);
+	for (unsigned attempts = 0;;) {
+		unsigned x;
+		if (!g_queue.tryPop(x)) {
+			bool done = g_producers == 0;
+			__sync_synchronize();
+			if (done && !g_queue.tryPop(x))
+				break;
+			else if (!done) {
+				backoff(attempts);
+				continue;
+			}
+		}
+		// The items of each producer are popped in order.
+		unsigned id = x / NUM_ITEMS, i = x % NUM_ITEMS;
+		EXPECT_TRUE(i == 0 || i > last[id]);
+		last[id] = i;
+		__sync_fetch_and_add(&seen[x], 1);
+	}
+	return NULL;
+}
+
+TEST(RingBufferTest, threads)
+{
+	vector<unsigned> seen(NUM_THREADS * NUM_ITEMS);
+	g_producers = NUM_THREADS;
+	__sync_synchronize();
+
+	unsigned ids[NUM_THREADS];
+	pthread_t producers[NUM_THREADS], consumers[NUM_THREADS];
+	for (unsigned i = 0; i < NUM_THREADS; ++i) {
+		ids[i] = i;
+		pthread_create(&producers[i], NULL, produce, &ids[i]);
+		pthread_create(&consumers[i], NULL, consume, &seen);
+	}
+	for (unsigned i = 0; i < NUM_THREADS; ++i) {
+		pthread_join(producers[i], NULL);
+		pthread_join(consumers[i], NULL);
+	}
+
+	for (unsigned i = 0; i < seen.size(); ++i)
+		ASSERT_EQ(1u, seen[i]) << i;
+}
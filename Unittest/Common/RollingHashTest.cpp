@@ -0,0 +1,50 @@
+#include "Common/RollingHash.h"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace std;
+
+TEST(RollingHash, reverseComplement)
+{
+	Kmer::setLength(5);
+	Kmer kmer("GCTCG");
+	EXPECT_EQ(RollingHash(kmer).hash(),
+			RollingHash(reverseComplement(kmer)).hash());
+
+	Kmer palindrome("ACGTA");
+	EXPECT_EQ(RollingHash(palindrome).hash(),
+			RollingHash(reverseComplement(palindrome)).hash());
+
+	EXPECT_NE(RollingHash(kmer).hash(), RollingHash(palindrome).hash());
+}
+
+TEST(RollingHash, neighbours)
+{
+	const string bases = "ACGT";
+	const string seq = "TACGGATTACAGCTAGGCTAACGTACGATCGATGCATCGACTAGCATCGACT"
+		"AGCATCGATCGATGCTAGCTAGCATCGATCG";
+
+	// Test k-mer lengths that rotate past the width of the hash.
+	unsigned lengths[] = { 4, 25, 63, 64, 65, 96 };
+	for (unsigned l = 0; l < sizeof lengths / sizeof *lengths; ++l) {
+		unsigned k = lengths[l];
+		if (k > MAX_KMER)
+			continue;
+		Kmer::setLength(k);
+		Kmer u(seq.substr(0, k));
+		RollingHash h(u);
+
+		size_t hashes[NUM_BASES];
+		h.successors(u.at(0), hashes);
+		for (unsigned i = 0; i < NUM_BASES; ++i) {
+			Kmer v(seq.substr(1, k - 1) + bases[i]);
+			EXPECT_EQ(RollingHash(v).hash(), hashes[i]);
+		}
+
+		h.predecessors(u.at(k - 1), hashes);
+		for (unsigned i = 0; i < NUM_BASES; ++i) {
+			Kmer v(bases[i] + seq.substr(0, k - 1));
+			EXPECT_EQ(RollingHash(v).hash(), hashes[i]);
+		}
+	}
+}
@@ -56,9 +56,39 @@ TEST(parseCigar, check_alignment)
 	EXPECT_EQ(a, SAMAlignment::parseCigar("40M10I20M10S", false));
 }
 
+/** @Return whether two CigarCoord are equivalent. */
+static bool equal(const SAMAlignment::CigarCoord& a,
+		const SAMAlignment::CigarCoord& b)
+{
+	return a.qlen == b.qlen && a.qstart == b.qstart
+		&& a.qspan == b.qspan && a.tspan == b.tspan;
+}
+
+// Test SAM::CigarCoord
+TEST(CigarCoord, check_coordinates)
+{
+	SAMAlignment::CigarCoord a("10S40M5I20D15H");
+	EXPECT_EQ(70U, a.qlen);
+	EXPECT_EQ(10U, a.qstart);
+	EXPECT_EQ(45U, a.qspan);
+	EXPECT_EQ(60U, a.tspan);
+
+	SAMAlignment::CigarCoord b("*");
+	EXPECT_EQ(0U, b.qlen);
+	EXPECT_EQ(0U, b.tspan);
+
+	// A field of a SAM record is parsed in place.
+	EXPECT_TRUE(equal(a, SAMAlignment::CigarCoord("10S40M5I20D15H\t*")));
+
+	// A trailing length without an operation is ignored.
+	EXPECT_TRUE(equal(a, SAMAlignment::CigarCoord("10S40M5I20D15H7")));
+	EXPECT_TRUE(equal(a, SAMAlignment::CigarCoord("10S40M5I20D15H7\t*")));
+}
+
 // Check that we error when an invalid CIGAR is given.
 TEST(parseCigarDeath, invalid_cigar)
 {
 	EXPECT_DEATH(SAMAlignment::parseCigar("20SS", false), "error: invalid CIGAR: `20SS'");
 	EXPECT_DEATH(SAMAlignment::parseCigar("20m", false), "error: invalid CIGAR: `20m'");
+	EXPECT_DEATH(SAMAlignment::CigarCoord("20S40m"), "error: invalid CIGAR: `20S40m'");
 }
@@ -0,0 +1,231 @@
+#include "FMIndex/FMIndex.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+typedef FMIndex::SAInterval SAInterval;
+typedef FMIndex::Match Match;
+
+/** Return a random sequence of the specified length. */
+static string randomSeq(size_t n)
+{
+	static const char ACGT[] = "ACGT";
+	string s(n, 'A');
+	for (size_t i = 0; i < n; ++i)
+		s[i] = ACGT[rand() % 4];
+	return s;
+}
+
+/** Return an index of the specified text. */
+static FMIndex buildIndex(const string& text, unsigned lookup)
+{
+	FMIndex fm;
+	fm.setAlphabet("-ACGT");
+	string s = text;
+	fm.assign(s.begin(), s.end());
+	fm.buildLookup(lookup);
+	return fm;
+}
+
+class FMIndexLookupTest : public testing::Test
+{
+  protected:
+	string text;
+	FMIndex fm, fmLookup;
+
+	void SetUp()
+	{
+		srand(1);
+		text = randomSeq(2000) + '-' + randomSeq(2000)
+			+ "NN" + randomSeq(1000);
+		fm = buildIndex(text, 0);
+		fmLookup = buildIndex(text, 4);
+	}
+};
+
+TEST_F(FMIndexLookupTest, findExact)
+{
+	EXPECT_EQ(4u, fmLookup.lookupLength());
+	for (unsigned i = 0; i < 1000; ++i) {
+		size_t len = 1 + rand() % 12;
+		string q = rand() % 2 == 0 ? randomSeq(len)
+			: text.substr(rand() % (text.size() - len), len);
+		SAInterval expected = fm.findExact(q);
+		SAInterval actual = fmLookup.findExact(q);
+		if (expected.empty())
+			EXPECT_TRUE(actual.empty()) << q;
+		else
+			EXPECT_TRUE(expected == actual) << q;
+	}
+}
+
+TEST_F(FMIndexLookupTest, find)
+{
+	for (unsigned i = 0; i < 200; ++i) {
+		// Mutate a substring of the text.
+		string q = text.substr(rand() % (text.size() - 50), 50);
+		q[rand() % q.size()] = "ACGT"[rand() % 4];
+		Match expected = fm.find(q, 1);
+		Match actual = fmLookup.find(q, 1);
+		EXPECT_EQ(expected.qstart, actual.qstart) << q;
+		EXPECT_EQ(expected.qend, actual.qend) << q;
+		EXPECT_EQ(expected.num, actual.num) << q;
+		EXPECT_TRUE(expected == actual) << q;
+	}
+}
+
+TEST_F(FMIndexLookupTest, serialize)
+{
+	stringstream ss;
+	ss << fmLookup;
+	ASSERT_TRUE(ss.good());
+	FMIndex fm2;
+	ss >> fm2;
+	ASSERT_TRUE(ss.good());
+	EXPECT_EQ(4u, fm2.lookupLength());
+	string q = text.substr(1234, 20);
+	EXPECT_TRUE(fmLookup.findExact(q) == fm2.findExact(q));
+	EXPECT_EQ(1u, fm2.findExact(q).size());
+}
+
+/** Return an index of the specified text sampled every period rows
+ * or positions. */
+static FMIndex buildSampledIndex(const string& text, unsigned period,
+		bool positions)
+{
+	FMIndex fm;
+	fm.setAlphabet("-ACGT");
+	fm.sampleSA(period, positions);
+	string s = text;
+	fm.assign(s.begin(), s.end());
+	return fm;
+}
+
+TEST(FMIndexSampleTest, locate)
+{
+	srand(2);
+	string text = randomSeq(1500) + '-' + randomSeq(1501);
+	FMIndex full = buildSampledIndex(text, 1, false);
+	FMIndex rows = buildSampledIndex(text, 7, false);
+	FMIndex positions = buildSampledIndex(text, 7, true);
+	EXPECT_FALSE(rows.samplePositions());
+	EXPECT_TRUE(positions.samplePositions());
+	for (size_t i = 0; i <= text.size(); ++i) {
+		ASSERT_EQ(full[i], rows[i]) << i;
+		ASSERT_EQ(full[i], positions[i]) << i;
+	}
+
+	SAInterval sai = full.findExact(string("AC"));
+	ASSERT_GT(sai.size(), 10u);
+	vector<size_t> expected, actual;
+	full.locate(sai, back_inserter(expected));
+	positions.locate(sai, back_inserter(actual), 10);
+	ASSERT_EQ(10u, actual.size());
+	EXPECT_TRUE(equal(actual.begin(), actual.end(), expected.begin()));
+	for (size_t i = 0; i < expected.size(); ++i)
+		EXPECT_EQ(text.substr(expected[i], 2), "AC");
+}
+
+TEST(FMIndexSampleTest, resample)
+{
+	srand(3);
+	string text = randomSeq(3000);
+	FMIndex full = buildSampledIndex(text, 1, false);
+	FMIndex positions = buildSampledIndex(text, 1, false);
+	positions.sampleSA(4, true);
+	FMIndex rows = buildSampledIndex(text, 4, false);
+	rows.sampleSA(8);
+	positions.sampleSA(12);
+
+	// Store and load the resampled index.
+	stringstream ss;
+	ss << positions;
+	FMIndex loaded;
+	ss >> loaded;
+	ASSERT_TRUE(ss.good());
+	EXPECT_TRUE(loaded.samplePositions());
+
+	for (size_t i = 0; i <= text.size(); ++i) {
+		ASSERT_EQ(full[i], rows[i]) << i;
+		ASSERT_EQ(full[i], positions[i]) << i;
+		ASSERT_EQ(full[i], loaded[i]) << i;
+	}
+}
+
+/** Return the BWT of the specified text and the position of its
+ * sentinel, built in blocks of the specified number of suffixes. */
+static pair<vector<FMIndex::value_type>, size_t> buildBWT(
+		const string& text, size_t blockSize)
+{
+	FMIndex fm;
+	fm.setAlphabet("-ACGT");
+	fm.setBlockSize(blockSize);
+	vector<FMIndex::value_type> s(text.begin(), text.end());
+	s.push_back(0);
+	size_t sentinel = fm.buildBWT(s.begin(), s.end() - 1);
+	return make_pair(s, sentinel);
+}
+
+/** Check that the BWT built in blocks of the specified sizes is the
+ * same as the BWT built in a single block. */
+static void checkBlockwiseBWT(const string& text)
+{
+	pair<vector<FMIndex::value_type>, size_t> expected
+		= buildBWT(text, 0);
+	const size_t blockSizes[] = { 50, 500, text.size() - 1 };
+	for (unsigned i = 0; i < sizeof blockSizes / sizeof *blockSizes;
+			++i) {
+		pair<vector<FMIndex::value_type>, size_t> actual
+			= buildBWT(text, blockSizes[i]);
+		EXPECT_EQ(expected.second, actual.second) << blockSizes[i];
+		EXPECT_TRUE(expected.first == actual.first) << blockSizes[i];
+	}
+}
+
+TEST(FMIndexBlockwiseTest, random)
+{
+	srand(4);
+	checkBlockwiseBWT(randomSeq(1000) + '-' + randomSeq(2000)
+			+ "NNN" + randomSeq(500) + '-');
+	checkBlockwiseBWT(randomSeq(10));
+}
+
+TEST(FMIndexBlockwiseTest, repeats)
+{
+	srand(5);
+	// Runs of a symbol that are longer than the period of the
+	// difference cover.
+	checkBlockwiseBWT(string(3000, 'A'));
+	checkBlockwiseBWT(randomSeq(300) + string(2500, 'N')
+			+ randomSeq(300) + string(2500, 'C'));
+
+	// Tandem and interspersed repeats.
+	string tandem;
+	for (unsigned i = 0; i < 1000; ++i)
+		tandem += "ACG";
+	string repeat = randomSeq(1500);
+	checkBlockwiseBWT(tandem + randomSeq(100) + tandem);
+	checkBlockwiseBWT(repeat + '-' + randomSeq(200) + repeat
+			+ randomSeq(200) + repeat);
+}
+
+TEST(FMIndexBlockwiseTest, locate)
+{
+	srand(6);
+	string text = randomSeq(1500) + '-' + randomSeq(1501);
+	FMIndex fm = buildSampledIndex(text, 1, false);
+	FMIndex blockwise;
+	blockwise.setAlphabet("-ACGT");
+	blockwise.setBlockSize(100);
+	string s = text;
+	blockwise.assign(s.begin(), s.end());
+	for (size_t i = 0; i <= text.size(); ++i)
+		ASSERT_EQ(fm[i], blockwise[i]) << i;
+}
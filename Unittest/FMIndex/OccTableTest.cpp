@@ -0,0 +1,104 @@
+#include "FMIndex/OccTable.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const uint8_t SENTINEL = numeric_limits<uint8_t>::max();
+
+/** Return a random string of the specified alphabet size, whose
+ * sentinel is at the specified position. */
+static vector<uint8_t> randomString(unsigned sigma, size_t n,
+		size_t sentinel)
+{
+	vector<uint8_t> s(n);
+	for (size_t i = 0; i < n; ++i)
+		s[i] = rand() % sigma;
+	// Ensure that the last symbol occurs.
+	s[0] = sigma - 1;
+	s[sentinel] = SENTINEL;
+	return s;
+}
+
+/** Check the table against a naive count of the string. */
+static void check(const OccTable& occ, const vector<uint8_t>& s,
+		unsigned sigma)
+{
+	ASSERT_EQ(s.size(), occ.size());
+	vector<size_t> counts(sigma + 1);
+	for (size_t i = 0; i <= s.size(); ++i) {
+		for (unsigned c = 0; c <= sigma; ++c)
+			ASSERT_EQ(counts[c], occ.rank(c, i))
+				<< "c=" << c << " i=" << i;
+		if (i == s.size())
+			break;
+		ASSERT_EQ(s[i], occ.at(i));
+		if (s[i] != SENTINEL)
+			counts[s[i]]++;
+	}
+	for (unsigned c = 0; c <= sigma; ++c)
+		EXPECT_EQ(counts[c], occ.count(c));
+}
+
+TEST(OccTable, rank)
+{
+	srand(1);
+	unsigned sigmas[] = { 1, 2, 4, 5, 7, 8, 20 };
+	size_t sizes[] = { 1, 63, 64, 65, 128, 1000 };
+	for (unsigned x = 0; x < sizeof sigmas / sizeof *sigmas; ++x) {
+		for (unsigned y = 0; y < sizeof sizes / sizeof *sizes; ++y) {
+			unsigned sigma = sigmas[x];
+			size_t n = sizes[y];
+			vector<uint8_t> s = randomString(sigma, n, n / 2);
+			OccTable occ;
+			occ.assign(s.begin(), s.end());
+			check(occ, s, sigma);
+		}
+	}
+}
+
+TEST(OccTable, serialize)
+{
+	srand(2);
+	vector<uint8_t> s = randomString(5, 777, 300);
+	OccTable occ;
+	occ.assign(s.begin(), s.end());
+
+	stringstream ss;
+	ss << occ;
+	OccTable loaded;
+	ss >> loaded;
+	ASSERT_TRUE(ss);
+	check(loaded, s, 5);
+
+	OccTable copy(loaded);
+	check(copy, s, 5);
+}
+
+TEST(OccTable, attach)
+{
+	srand(3);
+	vector<uint8_t> s = randomString(5, 1000, 999);
+	OccTable occ;
+	occ.assign(s.begin(), s.end());
+
+	ostringstream ss;
+	size_t offset = 0;
+	occ.write(ss, offset);
+	string data = ss.str();
+	ASSERT_EQ(data.size(), offset);
+
+	// Use the stored table in place.
+	vector<uint64_t> buf(data.size() / sizeof (uint64_t) + 1);
+	copy(data.begin(), data.end(), reinterpret_cast<char*>(&buf[0]));
+	OccTable attached;
+	offset = 0;
+	attached.attach(reinterpret_cast<const char*>(&buf[0]),
+			data.size(), offset);
+	EXPECT_EQ(data.size(), offset);
+	check(attached, s, 5);
+}
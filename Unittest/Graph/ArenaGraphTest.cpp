@@ -0,0 +1,95 @@
+#include "Graph/ArenaGraph.h"
+#include "Common/UnorderedSet.h"
+#include <string>
+#include <gtest/gtest.h>
+
+using namespace std;
+
+namespace {
+
+class ArenaGraphTest : public ::testing::Test {
+
+protected:
+
+	typedef ArenaGraph<string> Graph;
+	typedef boost::graph_traits<Graph>::edge_descriptor edge_descriptor;
+	typedef boost::graph_traits<Graph>::out_edge_iterator out_edge_iterator;
+	typedef boost::graph_traits<Graph>::vertex_descriptor vertex_descriptor;
+	typedef boost::graph_traits<Graph>::vertex_iterator vertex_iterator;
+
+	Graph simpleCyclicGraph;
+
+	string a;
+	string b;
+	string c;
+	string d;
+
+	unordered_set<string> vertexSet;
+
+	ArenaGraphTest() : a("a"), b("b"), c("c"), d("d") {
+
+		add_edge(a, b, simpleCyclicGraph);
+		add_edge(a, c, simpleCyclicGraph);
+		add_edge(b, d, simpleCyclicGraph);
+		add_edge(c, d, simpleCyclicGraph);
+
+		vertexSet.insert(a);
+		vertexSet.insert(b);
+		vertexSet.insert(c);
+		vertexSet.insert(d);
+
+	}
+};
+
+TEST_F(ArenaGraphTest, out_edge_iterator)
+{
+	out_edge_iterator ei, ei_end;
+	boost::tie(ei, ei_end) = out_edges(a, simpleCyclicGraph);
+
+	ASSERT_TRUE(ei != ei_end);
+	EXPECT_TRUE(*ei == edge_descriptor(a, b));
+	ei++;
+	ASSERT_TRUE(ei != ei_end);
+	EXPECT_TRUE(*ei == edge_descriptor(a, c));
+	ei++;
+	EXPECT_TRUE(ei == ei_end);
+
+	boost::tie(ei, ei_end) = out_edges(d, simpleCyclicGraph);
+	EXPECT_TRUE(ei == ei_end);
+	EXPECT_EQ(2u, out_degree(a, simpleCyclicGraph));
+	EXPECT_EQ(0u, out_degree(d, simpleCyclicGraph));
+}
+
+TEST_F(ArenaGraphTest, parallel_edge)
+{
+	EXPECT_FALSE(add_edge(a, b, simpleCyclicGraph).second);
+	EXPECT_EQ(2u, out_degree(a, simpleCyclicGraph));
+}
+
+TEST_F(ArenaGraphTest, vertex_iterator)
+{
+	vertex_iterator vi, vi_end;
+	boost::tie(vi, vi_end) = vertices(simpleCyclicGraph);
+
+	unordered_set<string> visited;
+	for (; vi != vi_end; ++vi) {
+		EXPECT_TRUE(vertexSet.find(*vi) != vertexSet.end());
+		EXPECT_TRUE(visited.insert(*vi).second);
+	}
+	EXPECT_EQ(4U, visited.size());
+	EXPECT_EQ(4U, num_vertices(simpleCyclicGraph));
+}
+
+TEST_F(ArenaGraphTest, clear)
+{
+	simpleCyclicGraph.clear();
+	EXPECT_EQ(0U, num_vertices(simpleCyclicGraph));
+	EXPECT_EQ(0u, out_degree(a, simpleCyclicGraph));
+
+	add_edge(d, a, simpleCyclicGraph);
+	EXPECT_EQ(2U, num_vertices(simpleCyclicGraph));
+	EXPECT_EQ(1u, out_degree(d, simpleCyclicGraph));
+	EXPECT_EQ(0u, out_degree(a, simpleCyclicGraph));
+}
+
+}
@@ -212,4 +212,27 @@ TEST_F(ConstrainedBidiBFSVisitorTest, NoLimitForBranches)
 	ASSERT_TRUE(path2 == "0,1,3" || path2 == "0,2,3");
 }
 
+TEST_F(ConstrainedBidiBFSVisitorTest, ReuseVisitor)
+{
+	ConstrainedBidiBFSVisitor<Graph> visitor(simpleCyclicGraph);
+	BidirectionalBFSBuffers<Graph> buffers;
+
+	visitor.reset(0, 3, 1, 1, 3, 2, NO_MEM_LIMIT);
+	bidirectionalBFS(simpleCyclicGraph, 0, 3, visitor, buffers);
+	Path<V> uniquePath;
+	EXPECT_EQ(TOO_MANY_PATHS, visitor.uniquePathToGoal(uniquePath));
+
+	visitor.reset(0, 3, 2, 1, 3, NO_LIMIT, NO_MEM_LIMIT);
+	bidirectionalBFS(simpleCyclicGraph, 0, 3, visitor, buffers);
+	PathList paths;
+	EXPECT_EQ(FOUND_PATH, visitor.pathsToGoal(paths));
+	ASSERT_EQ(2u, paths.size());
+	EXPECT_TRUE(paths[0].str() != paths[1].str());
+
+	visitor.reset(0, 0, 1, 1, 1, 2, NO_MEM_LIMIT);
+	bidirectionalBFS(simpleCyclicGraph, 0, 0, visitor, buffers);
+	EXPECT_EQ(FOUND_PATH, visitor.uniquePathToGoal(uniquePath));
+	EXPECT_EQ("0", uniquePath.str());
+}
+
 }
@@ -171,3 +171,29 @@ TEST_F(CorrectSingleBaseErrorTest, SkipFalsePositive)
 	EXPECT_EQ(read.seq, read.seq);
 	EXPECT_TRUE(correctedPos == errorPos1);
 }
+
+TEST_F(CorrectSingleBaseErrorTest, CorrectErrors)
+{
+	BloomFilter bloom(bloomFilterSize);
+	Bloom::loadSeq(bloom, k, correctRead.seq);
+	DBGBloom<BloomFilter> g(bloom);
+
+	unsigned numCorrected = 0;
+	FastaRecord read = correctRead;
+	EXPECT_TRUE(correctErrors(g, k, read, 4, numCorrected));
+	EXPECT_EQ(0U, numCorrected);
+	EXPECT_EQ(correctRead.seq, read.seq);
+
+	read = singleErrorRead;
+	EXPECT_TRUE(correctErrors(g, k, read, 4, numCorrected));
+	EXPECT_EQ(1U, numCorrected);
+	EXPECT_EQ(correctRead.seq, read.seq);
+
+	// A read that is not corrected completely is not modified.
+	read = singleErrorRead;
+	read.seq[0] = 'G';
+	FastaRecord orig = read;
+	EXPECT_FALSE(correctErrors(g, k, read, 1, numCorrected));
+	EXPECT_EQ(0U, numCorrected);
+	EXPECT_EQ(orig.seq, read.seq);
+}
@@ -23,8 +23,6 @@ extern void free_diag(struct diag* dg);
 //unsigned long allocss = 0;
 //unsigned long freess = 0;
 
-long sslen;
-
 
 /**
  *
@@ -46,7 +44,6 @@ struct alignment* create_empty_alignment(struct seq_col *scol) {
   sleep(5);
   */
   struct alignment* algn = malloc(sizeof(struct alignment));
-  sslen = scol->length;
   //allocss += sizeof(struct alignment);
   if(algn==NULL) error("create_empty_alignment(): (1) Out of memory !");
 
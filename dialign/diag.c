@@ -1782,16 +1782,34 @@ void build_guide_tree(struct diag_col *dcol) {
 }
 
 
-/** 
- * Finds all diags of each pair of sequences in in_seq_col by using 
- * the function above 
- * 
- * The pointer returned (and the ones included in the struct)  
- * has to be deallocted explicitely from memory. 
- */ 
-struct diag_col *find_all_diags(struct scr_matrix *smatrix,  
+/**
+ * initializes an empty scratch space
+ */
+void init_diag_scratch(struct diag_scratch *scratch) {
+  scratch->tmp_dist = NULL;
+  scratch->pdist = NULL;
+  scratch->seq_factor = -1;
+  scratch->threshold = 0;
+}
+
+/**
+ * frees the temporary probability distribution of the scratch space
+ */
+void free_diag_scratch(struct diag_scratch *scratch) {
+  if(scratch->tmp_dist!=NULL) free_tmp_pdist(scratch->tmp_dist, scratch->pdist->max_dlen);
+  init_diag_scratch(scratch);
+}
+
+/**
+ * finds all diags as find_all_diags() does, but keeps the temporary
+ * probability distribution in the given scratch space, so that it is 
+ * allocated once and filled again only when the product of the 
+ * lengths of a pair of sequences differs from that of the last fill
+ */
+struct diag_col *find_all_diags_scratch(struct scr_matrix *smatrix,  
 				struct prob_dist *pdist, 
-				struct seq_col *in_seq_col, struct alignment *algn, int round) { 
+				struct seq_col *in_seq_col, struct alignment *algn, int round,
+				struct diag_scratch *scratch) { 
   unsigned int s1, s2, rs2, sl = in_seq_col->length, sp, ap; 
   struct diag_col *all_diags = create_diag_col(sl); 
   struct simple_diag_col *sdcol; 
@@ -1802,7 +1820,14 @@ struct diag_col *find_all_diags(struct scr_matrix *smatrix,
   char hasAli = (round >1);//(algn!=NULL); 
  
   long double **tmp_dist = NULL; 
-  if(!hasAli) tmp_dist = create_tmp_pdist(pdist); 
+  if(!hasAli) {
+    if(scratch->pdist!=pdist) {
+      free_diag_scratch(scratch);
+      scratch->tmp_dist = create_tmp_pdist(pdist);
+      scratch->pdist = pdist;
+    }
+    tmp_dist = scratch->tmp_dist;
+  }
  
   int s2max = sl; 
   int s2width =(int) sqrt(sl); 
@@ -1823,7 +1848,12 @@ struct diag_col *find_all_diags(struct scr_matrix *smatrix,
     for(s2=s1+1;s2<s2max;s2++) { 
       rs2 = s2 % sl; 
       if(!hasAli) { 
-	fill_tmp_pdist(pdist,tmp_dist,in_seq_col->seqs[s1].length,in_seq_col->seqs[rs2].length ); 
+	long double seq_factor = ((long double)in_seq_col->seqs[s1].length)*in_seq_col->seqs[rs2].length;
+	if(seq_factor!=scratch->seq_factor || para->DIAG_CALC_WEIGHT_THRESHOLD!=scratch->threshold) {
+	  fill_tmp_pdist(pdist,tmp_dist,in_seq_col->seqs[s1].length,in_seq_col->seqs[rs2].length ); 
+	  scratch->seq_factor = seq_factor;
+	  scratch->threshold = para->DIAG_CALC_WEIGHT_THRESHOLD;
+	}
       } 
       if(para->DEBUG>5) printf("%i %i\n", s1,s2); 
       //time1 = clock(); 
@@ -1864,7 +1894,6 @@ struct diag_col *find_all_diags(struct scr_matrix *smatrix,
       } 
     } 
   } 
-  if(!hasAli) free_tmp_pdist(tmp_dist, pdist->max_dlen); 
   all_diags->diags= calloc(diag_amount, sizeof(struct diag*)); 
   if(all_diags->diags==NULL) error("find_all_diags(): (1) Out of memory !"); 
  
@@ -1930,6 +1959,24 @@ struct diag_col *find_all_diags(struct scr_matrix *smatrix,
   return all_diags; 
 } 
 
+/** 
+ * Finds all diags of each pair of sequences in in_seq_col by using 
+ * the function above 
+ * 
+ * The pointer returned (and the ones included in the struct)  
+ * has to be deallocted explicitely from memory. 
+ */ 
+struct diag_col *find_all_diags(struct scr_matrix *smatrix,  
+				struct prob_dist *pdist, 
+				struct seq_col *in_seq_col, struct alignment *algn, int round) { 
+  struct diag_scratch scratch;
+  init_diag_scratch(&scratch);
+  struct diag_col *all_diags = find_all_diags_scratch(smatrix, pdist,
+				in_seq_col, algn, round, &scratch);
+  free_diag_scratch(&scratch);
+  return all_diags;
+}
+
 
  
 /** 
@@ -26,7 +26,7 @@
 
 extern char *optarg;
 extern int optind, opterr, optopt;
-struct parameters* para;
+__thread struct parameters* para;
 /****************************
 * PROTEIN DEFAULT VALUES!   *
 ****************************/
@@ -138,7 +138,8 @@ struct parameters
     /*              global variable                 */
     /*                                              */
     /************************************************/
-extern struct parameters* para;
+// the parameters of the alignment of this thread
+extern __thread struct parameters* para;
 
 
 
@@ -62,6 +62,19 @@ struct prob_dist {
 };
 
 
+/**
+ * scratch space of find_all_diags_scratch(), which may be reused by
+ * the alignments of one thread (auxiliary data structure)
+ */
+struct diag_scratch {
+  long double **tmp_dist; // temporary probability distribution of pdist
+  struct prob_dist *pdist; // the distribution of tmp_dist
+  long double seq_factor; // product of the sequence lengths of tmp_dist,
+                          // or -1 if tmp_dist is not filled
+  double threshold;   // DIAG_CALC_WEIGHT_THRESHOLD of tmp_dist
+};
+
+
 /**
  * part of a sequence (auxiliary data structure)
  */